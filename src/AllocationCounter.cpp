@@ -0,0 +1,87 @@
+#include "AllocationCounter.h"
+
+#if defined(SHORTMARCH_COUNT_ALLOCATIONS)
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> g_allocation_count{ 0 };
+std::atomic<uint64_t> g_staging_allocation_count{ 0 };
+std::atomic<unsigned> g_staging_depth{ 0 };
+
+void CountAllocation() {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (g_staging_depth.load(std::memory_order_relaxed) > 0) {
+        g_staging_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void* CountedAlloc(std::size_t size) {
+    CountAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+void* CountedAlignedAlloc(std::size_t size, std::size_t alignment) {
+    CountAllocation();
+#if defined(_MSC_VER)
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+void AlignedFree(void* ptr) {
+#if defined(_MSC_VER)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (void* ptr = CountedAlloc(size)) return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* ptr = CountedAlignedAlloc(size, static_cast<std::size_t>(alignment))) return ptr;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { AlignedFree(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { AlignedFree(ptr); }
+
+namespace allocation_counter {
+bool IsEnabled() { return true; }
+uint64_t GetAllocationCount() { return g_allocation_count.load(std::memory_order_relaxed); }
+StagingScope::StagingScope() { g_staging_depth.fetch_add(1, std::memory_order_relaxed); }
+StagingScope::~StagingScope() { g_staging_depth.fetch_sub(1, std::memory_order_relaxed); }
+uint64_t GetStagingAllocationCount() { return g_staging_allocation_count.load(std::memory_order_relaxed); }
+} // namespace allocation_counter
+
+#else
+
+namespace allocation_counter {
+bool IsEnabled() { return false; }
+uint64_t GetAllocationCount() { return 0; }
+StagingScope::StagingScope() {}
+StagingScope::~StagingScope() {}
+uint64_t GetStagingAllocationCount() { return 0; }
+} // namespace allocation_counter
+
+#endif
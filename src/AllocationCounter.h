@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+// Process-wide count of global operator new calls, used to check that the steady-state frame
+// loop does not touch the heap. Counting replaces the global allocation functions and is only
+// compiled in with SHORTMARCH_COUNT_ALLOCATIONS (CMake option of the same name); otherwise
+// GetAllocationCount() always returns 0.
+namespace allocation_counter {
+
+bool IsEnabled();
+
+// Allocations made so far by all threads
+uint64_t GetAllocationCount();
+
+// While any StagingScope is alive, allocations made by every thread (ThreadPool workers included)
+// are also counted as staging allocations. Wraps the host-side staging paths of the frame loop
+// (uploads, readbacks, film development) so they can be checked apart from UI and command
+// recording; scopes should not be open while unrelated threads are busy.
+class StagingScope {
+public:
+    StagingScope();
+    ~StagingScope();
+
+    StagingScope(const StagingScope&) = delete;
+    StagingScope& operator=(const StagingScope&) = delete;
+};
+
+// Allocations made so far inside a StagingScope
+uint64_t GetStagingAllocationCount();
+
+} // namespace allocation_counter
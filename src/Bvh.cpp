@@ -0,0 +1,302 @@
+#include "Bvh.h"
+#include "ThreadPool.h"
+
+namespace {
+constexpr uint32_t kMaxLeafSize = 4;
+constexpr int kBinCount = 16;
+constexpr float kTraversalCost = 1.0f;
+constexpr float kIntersectionCost = 1.0f;
+
+// Shared, read-only inputs of one build; prim_indices is partitioned in place, every
+// subtree owning a disjoint range of it.
+struct BuildInput {
+    const std::vector<Aabb>* prim_bounds;
+    const std::vector<glm::vec3>* centroids;
+    uint32_t* prim_indices;
+};
+
+// Subtree whose construction was deferred to a parallel task
+struct PendingSubtree {
+    uint32_t node_index;
+    int depth;
+};
+
+struct Bin {
+    Aabb bounds;
+    uint32_t count = 0;
+};
+
+// Scale mapping centroid offsets along an axis to bins, or 0 for an axis too thin to bin (kBinCount / extent
+// would overflow, and a NaN offset cast to int is undefined)
+float BinScale(float extent) {
+    return extent > std::numeric_limits<float>::min() * kBinCount ? kBinCount / extent : 0.0f;
+}
+
+int BinIndex(float centroid, float axis_min, float scale) {
+    return std::min(kBinCount - 1, std::max(0, static_cast<int>((centroid - axis_min) * scale)));
+}
+
+// Finds the best binned-SAH split of a node; returns false when keeping a leaf is cheaper
+bool FindSplit(const BuildInput& input, const BvhNode& node, const Aabb& centroid_box, int* best_axis, int* best_bin) {
+    uint32_t first = node.left_first;
+    uint32_t count = node.prim_count;
+    float best_cost = std::numeric_limits<float>::max();
+
+    for (int axis = 0; axis < 3; ++axis) {
+        float axis_min = centroid_box.min_p[axis];
+        float scale = BinScale(centroid_box.max_p[axis] - axis_min);
+        if (scale == 0.0f) continue;
+
+        Bin bins[kBinCount];
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t prim = input.prim_indices[first + i];
+            int b = BinIndex((*input.centroids)[prim][axis], axis_min, scale);
+            bins[b].bounds.Grow((*input.prim_bounds)[prim]);
+            bins[b].count++;
+        }
+
+        // Sweep from both sides to get the area/count of every split plane
+        float left_area[kBinCount - 1], right_area[kBinCount - 1];
+        uint32_t left_count[kBinCount - 1], right_count[kBinCount - 1];
+        Aabb left_box, right_box;
+        uint32_t left_sum = 0, right_sum = 0;
+        for (int i = 0; i < kBinCount - 1; ++i) {
+            left_sum += bins[i].count;
+            left_count[i] = left_sum;
+            left_box.Grow(bins[i].bounds);
+            left_area[i] = left_box.SurfaceArea();
+            right_sum += bins[kBinCount - 1 - i].count;
+            right_count[kBinCount - 2 - i] = right_sum;
+            right_box.Grow(bins[kBinCount - 1 - i].bounds);
+            right_area[kBinCount - 2 - i] = right_box.SurfaceArea();
+        }
+        for (int i = 0; i < kBinCount - 1; ++i) {
+            if (left_count[i] == 0 || right_count[i] == 0) continue;
+            float cost = left_count[i] * left_area[i] + right_count[i] * right_area[i];
+            if (cost < best_cost) {
+                best_cost = cost;
+                *best_axis = axis;
+                *best_bin = i;
+            }
+        }
+    }
+
+    if (best_cost == std::numeric_limits<float>::max()) {
+        return false; // All centroids coincide
+    }
+    Aabb node_box;
+    node_box.min_p = node.bounds_min;
+    node_box.max_p = node.bounds_max;
+    float parent_area = node_box.SurfaceArea();
+    float split_cost = kTraversalCost + kIntersectionCost * best_cost / std::max(parent_area, 1e-20f);
+    float leaf_cost = kIntersectionCost * count;
+    return count > kMaxLeafSize || split_cost < leaf_cost;
+}
+
+// Recursively builds the subtree rooted at node_index into `nodes`. When `pending` is set,
+// nodes with at most `defer_below` primitives are left as leaves and recorded for later.
+void BuildNode(const BuildInput& input, std::vector<BvhNode>& nodes, uint32_t node_index, int depth,
+               std::vector<PendingSubtree>* pending, uint32_t defer_below) {
+    uint32_t first = nodes[node_index].left_first;
+    uint32_t count = nodes[node_index].prim_count;
+
+    Aabb box, centroid_box;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t prim = input.prim_indices[first + i];
+        box.Grow((*input.prim_bounds)[prim]);
+        centroid_box.Grow((*input.centroids)[prim]);
+    }
+    nodes[node_index].bounds_min = box.min_p;
+    nodes[node_index].bounds_max = box.max_p;
+
+    if (count <= 2 || depth >= MeshBvh::kMaxDepth) {
+        return;
+    }
+    if (pending && count <= defer_below) {
+        pending->push_back({ node_index, depth });
+        return;
+    }
+
+    int axis = 0, bin = 0;
+    if (!FindSplit(input, nodes[node_index], centroid_box, &axis, &bin)) {
+        return;
+    }
+
+    float axis_min = centroid_box.min_p[axis];
+    float scale = BinScale(centroid_box.max_p[axis] - axis_min);
+    uint32_t* begin = input.prim_indices + first;
+    uint32_t* end = begin + count;
+    uint32_t* mid = std::partition(begin, end, [&](uint32_t prim) {
+        return BinIndex((*input.centroids)[prim][axis], axis_min, scale) <= bin;
+    });
+    uint32_t left_count = static_cast<uint32_t>(mid - begin);
+    if (left_count == 0 || left_count == count) {
+        return;
+    }
+
+    uint32_t left_index = static_cast<uint32_t>(nodes.size());
+    BvhNode left{}, right{};
+    left.left_first = first;
+    left.prim_count = left_count;
+    right.left_first = first + left_count;
+    right.prim_count = count - left_count;
+    nodes.push_back(left);
+    nodes.push_back(right);
+
+    nodes[node_index].left_first = left_index;
+    nodes[node_index].prim_count = 0;
+
+    BuildNode(input, nodes, left_index, depth + 1, pending, defer_below);
+    BuildNode(input, nodes, left_index + 1, depth + 1, pending, defer_below);
+}
+} // namespace
+
+void BuildBvh(const std::vector<Aabb>& prim_bounds, std::vector<BvhNode>* nodes, std::vector<uint32_t>* prim_indices) {
+    nodes->clear();
+    prim_indices->clear();
+    size_t prim_count = prim_bounds.size();
+    if (prim_count == 0) {
+        return;
+    }
+
+    std::vector<glm::vec3> centroids(prim_count);
+    prim_indices->resize(prim_count);
+    ParallelFor(0, prim_count, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            centroids[i] = prim_bounds[i].Center();
+            (*prim_indices)[i] = static_cast<uint32_t>(i);
+        }
+    });
+
+    BuildInput input{ &prim_bounds, &centroids, prim_indices->data() };
+    nodes->reserve(prim_count * 2);
+    BvhNode root{};
+    root.left_first = 0;
+    root.prim_count = static_cast<uint32_t>(prim_count);
+    nodes->push_back(root);
+
+    if (prim_count < MeshBvh::kParallelBuildThreshold || ThreadPool::Instance().GetWorkerCount() <= 1) {
+        BuildNode(input, *nodes, 0, 1, nullptr, 0);
+    } else {
+        // Build the top of the tree serially until subtrees are small enough to give every
+        // worker several tasks, then finish each subtree into its own node array.
+        uint32_t defer_below = static_cast<uint32_t>(
+            std::max<size_t>(prim_count / (ThreadPool::Instance().GetWorkerCount() * 8), 1024));
+        std::vector<PendingSubtree> pending;
+        BuildNode(input, *nodes, 0, 1, &pending, defer_below);
+
+        std::vector<std::vector<BvhNode>> subtrees(pending.size());
+        ThreadPool::Instance().Run(pending.size(), [&](size_t i, unsigned) {
+            std::vector<BvhNode>& local = subtrees[i];
+            local.reserve((*nodes)[pending[i].node_index].prim_count * 2);
+            local.push_back((*nodes)[pending[i].node_index]);
+            BuildNode(input, local, 0, pending[i].depth, nullptr, 0);
+        });
+
+        // Splice: the local root replaces the placeholder leaf, the remaining nodes are
+        // appended with their child indices shifted (children stay adjacent pairs).
+        for (size_t i = 0; i < pending.size(); ++i) {
+            const std::vector<BvhNode>& local = subtrees[i];
+            uint32_t base = static_cast<uint32_t>(nodes->size()) - 1; // local index k >= 1 maps to base + k
+            auto remap = [base](BvhNode node) {
+                if (!node.IsLeaf()) node.left_first += base;
+                return node;
+            };
+            (*nodes)[pending[i].node_index] = remap(local[0]);
+            for (size_t k = 1; k < local.size(); ++k) {
+                nodes->push_back(remap(local[k]));
+            }
+        }
+    }
+    nodes->shrink_to_fit();
+}
+
+float ComputeSahCost(const std::vector<BvhNode>& nodes) {
+    if (nodes.empty()) return 0.0f;
+    Aabb root;
+    root.min_p = nodes[0].bounds_min;
+    root.max_p = nodes[0].bounds_max;
+    float root_area = std::max(root.SurfaceArea(), 1e-20f);
+    double cost = 0.0;
+    for (const BvhNode& node : nodes) {
+        Aabb box;
+        box.min_p = node.bounds_min;
+        box.max_p = node.bounds_max;
+        float area = box.SurfaceArea() / root_area;
+        cost += node.IsLeaf() ? area * kIntersectionCost * node.prim_count : area * kTraversalCost;
+    }
+    return static_cast<float>(cost);
+}
+
+void MeshBvh::Build(const glm::vec3* positions, size_t vertex_count, const uint32_t* indices, size_t index_count) {
+    positions_ = positions;
+    indices_ = indices;
+    bounds_ = Aabb();
+
+    size_t triangle_count = vertex_count > 0 ? index_count / 3 : 0;
+    std::vector<Aabb> prim_bounds(triangle_count);
+    ParallelFor(0, triangle_count, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Aabb box;
+            box.Grow(positions[indices[i * 3 + 0]]);
+            box.Grow(positions[indices[i * 3 + 1]]);
+            box.Grow(positions[indices[i * 3 + 2]]);
+            prim_bounds[i] = box;
+        }
+    });
+
+    BuildBvh(prim_bounds, &nodes_, &prim_indices_);
+    if (!nodes_.empty()) {
+        bounds_.min_p = nodes_[0].bounds_min;
+        bounds_.max_p = nodes_[0].bounds_max;
+    }
+}
+
+float MeshBvh::ComputeSahCost() const {
+    return ::ComputeSahCost(nodes_);
+}
+
+bool MeshBvh::IntersectClosest(const CpuRay& ray, CpuHit* hit) const {
+    if (nodes_.empty()) return false;
+    glm::vec3 inv_dir = SafeInverse(ray.direction);
+    float t_max = ray.t_max;
+    bool found = false;
+
+    uint32_t stack[kMaxDepth * 2];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const BvhNode& node = nodes_[stack[--stack_size]];
+        if (node.IsLeaf()) {
+            for (uint32_t i = 0; i < node.prim_count; ++i) {
+                uint32_t prim = prim_indices_[node.left_first + i];
+                glm::vec3 p0, p1, p2;
+                GetTriangle(prim, &p0, &p1, &p2);
+                float t, u, v;
+                if (IntersectTriangle(p0, p1, p2, ray, t_max, &t, &u, &v)) {
+                    t_max = t;
+                    hit->t = t;
+                    hit->u = u;
+                    hit->v = v;
+                    hit->primitive = prim;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        const BvhNode& a = nodes_[node.left_first];
+        const BvhNode& b = nodes_[node.left_first + 1];
+        float ta = IntersectAabb(a.bounds_min, a.bounds_max, ray.origin, inv_dir, ray.t_min, t_max);
+        float tb = IntersectAabb(b.bounds_min, b.bounds_max, ray.origin, inv_dir, ray.t_min, t_max);
+        uint32_t near_index = node.left_first, far_index = node.left_first + 1;
+        if (tb < ta) {
+            std::swap(ta, tb);
+            std::swap(near_index, far_index);
+        }
+        if (tb != std::numeric_limits<float>::infinity()) stack[stack_size++] = far_index;
+        if (ta != std::numeric_limits<float>::infinity()) stack[stack_size++] = near_index;
+    }
+    return found;
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include "long_march.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Axis-aligned bounding box used by the CPU acceleration structures
+struct Aabb {
+    glm::vec3 min_p{ std::numeric_limits<float>::max() };
+    glm::vec3 max_p{ -std::numeric_limits<float>::max() };
+
+    void Grow(const glm::vec3& p) {
+        min_p = glm::min(min_p, p);
+        max_p = glm::max(max_p, p);
+    }
+    void Grow(const Aabb& b) {
+        min_p = glm::min(min_p, b.min_p);
+        max_p = glm::max(max_p, b.max_p);
+    }
+    bool IsEmpty() const { return min_p.x > max_p.x; }
+    glm::vec3 Center() const { return (min_p + max_p) * 0.5f; }
+    float SurfaceArea() const {
+        if (IsEmpty()) return 0.0f;
+        glm::vec3 e = max_p - min_p;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+// CPU ray, mirrors RayDesc in the shaders
+struct CpuRay {
+    glm::vec3 origin;
+    float t_min;
+    glm::vec3 direction;
+    float t_max;
+};
+
+// Result of a triangle query; barycentrics follow BuiltInTriangleIntersectionAttributes
+struct CpuHit {
+    float t = 0.0f;
+    float u = 0.0f; // weight of vertex 1
+    float v = 0.0f; // weight of vertex 2
+    uint32_t primitive = 0;
+    uint32_t instance = 0;
+};
+
+// Compact 32-byte node: interior nodes store the index of their first child (the second one
+// follows it), leaves store the first entry of the primitive index list.
+struct BvhNode {
+    glm::vec3 bounds_min;
+    uint32_t left_first;
+    glm::vec3 bounds_max;
+    uint32_t prim_count; // 0 for interior nodes
+
+    bool IsLeaf() const { return prim_count != 0; }
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode must stay 32 bytes");
+
+// Slab test; returns the entry distance or +inf when the box is missed
+inline float IntersectAabb(const glm::vec3& bounds_min, const glm::vec3& bounds_max,
+                           const glm::vec3& origin, const glm::vec3& inv_dir, float t_min, float t_max) {
+    glm::vec3 t0 = (bounds_min - origin) * inv_dir;
+    glm::vec3 t1 = (bounds_max - origin) * inv_dir;
+    glm::vec3 t_small = glm::min(t0, t1);
+    glm::vec3 t_big = glm::max(t0, t1);
+    float t_enter = std::max(std::max(t_small.x, t_small.y), std::max(t_small.z, t_min));
+    float t_exit = std::min(std::min(t_big.x, t_big.y), std::min(t_big.z, t_max));
+    return t_enter <= t_exit ? t_enter : std::numeric_limits<float>::infinity();
+}
+
+inline glm::vec3 SafeInverse(const glm::vec3& d) {
+    // Same convention as IntersectAABB in volume.hlsl
+    return glm::vec3(d.x != 0.0f ? 1.0f / d.x : 1e30f,
+                     d.y != 0.0f ? 1.0f / d.y : 1e30f,
+                     d.z != 0.0f ? 1.0f / d.z : 1e30f);
+}
+
+// Moller-Trumbore; writes t and barycentrics (u, v) on a hit inside [t_min, t_max]
+inline bool IntersectTriangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2,
+                              const CpuRay& ray, float t_max, float* t, float* u, float* v) {
+    glm::vec3 e1 = p1 - p0;
+    glm::vec3 e2 = p2 - p0;
+    glm::vec3 pvec = glm::cross(ray.direction, e2);
+    float det = glm::dot(e1, pvec);
+    if (std::abs(det) < 1e-12f) return false;
+    float inv_det = 1.0f / det;
+    glm::vec3 tvec = ray.origin - p0;
+    float bu = glm::dot(tvec, pvec) * inv_det;
+    if (bu < 0.0f || bu > 1.0f) return false;
+    glm::vec3 qvec = glm::cross(tvec, e1);
+    float bv = glm::dot(ray.direction, qvec) * inv_det;
+    if (bv < 0.0f || bu + bv > 1.0f) return false;
+    float bt = glm::dot(e2, qvec) * inv_det;
+    if (bt < ray.t_min || bt > t_max) return false;
+    *t = bt;
+    *u = bu;
+    *v = bv;
+    return true;
+}
+
+// Binned-SAH build over arbitrary primitive bounds. Fills the node array (root at index 0) and
+// the primitive list that leaves index into. Used for both mesh and instance hierarchies.
+void BuildBvh(const std::vector<Aabb>& prim_bounds, std::vector<BvhNode>* nodes, std::vector<uint32_t>* prim_indices);
+
+// SAH cost of a tree (traversal cost 1, primitive cost 1, relative to the root area)
+float ComputeSahCost(const std::vector<BvhNode>& nodes);
+
+// Bottom-level BVH over the triangles of one mesh. Vertex and index data are referenced,
+// not copied, so the mesh must outlive the BVH.
+// Built with a binned SAH (16 bins per axis); once the top of the tree has produced enough
+// independent subtrees they are finished in parallel on the ThreadPool.
+class MeshBvh {
+public:
+    // Maximum tree depth produced by the builder; traversal stacks are sized from it
+    static constexpr int kMaxDepth = 64;
+    // Trees over fewer primitives are built on the calling thread only
+    static constexpr size_t kParallelBuildThreshold = 16384;
+
+    void Build(const glm::vec3* positions, size_t vertex_count, const uint32_t* indices, size_t index_count);
+
+    float ComputeSahCost() const;
+
+    bool IsBuilt() const { return !nodes_.empty(); }
+
+    // Closest hit in object space; hit->t is only updated when a closer triangle is found
+    bool IntersectClosest(const CpuRay& ray, CpuHit* hit) const;
+
+    // Any hit in object space. accept(primitive, u, v) can reject candidates (alpha testing).
+    template <class AcceptFn>
+    bool IntersectAny(const CpuRay& ray, AcceptFn&& accept) const;
+
+    const Aabb& GetBounds() const { return bounds_; }
+    const std::vector<BvhNode>& GetNodes() const { return nodes_; }
+    const std::vector<uint32_t>& GetPrimitiveIndices() const { return prim_indices_; }
+    size_t GetTriangleCount() const { return prim_indices_.size(); }
+
+    void GetTriangle(uint32_t primitive, glm::vec3* p0, glm::vec3* p1, glm::vec3* p2) const {
+        *p0 = positions_[indices_[primitive * 3 + 0]];
+        *p1 = positions_[indices_[primitive * 3 + 1]];
+        *p2 = positions_[indices_[primitive * 3 + 2]];
+    }
+
+private:
+    const glm::vec3* positions_ = nullptr;
+    const uint32_t* indices_ = nullptr;
+    std::vector<BvhNode> nodes_;
+    std::vector<uint32_t> prim_indices_;
+    Aabb bounds_;
+};
+
+template <class AcceptFn>
+bool MeshBvh::IntersectAny(const CpuRay& ray, AcceptFn&& accept) const {
+    if (nodes_.empty()) return false;
+    glm::vec3 inv_dir = SafeInverse(ray.direction);
+    uint32_t stack[kMaxDepth * 2];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const BvhNode& node = nodes_[stack[--stack_size]];
+        if (IntersectAabb(node.bounds_min, node.bounds_max, ray.origin, inv_dir, ray.t_min, ray.t_max) ==
+            std::numeric_limits<float>::infinity()) {
+            continue;
+        }
+        if (node.IsLeaf()) {
+            for (uint32_t i = 0; i < node.prim_count; ++i) {
+                uint32_t prim = prim_indices_[node.left_first + i];
+                glm::vec3 p0, p1, p2;
+                GetTriangle(prim, &p0, &p1, &p2);
+                float t, u, v;
+                if (IntersectTriangle(p0, p1, p2, ray, ray.t_max, &t, &u, &v) && accept(prim, u, v)) {
+                    return true;
+                }
+            }
+        } else {
+            stack[stack_size++] = node.left_first;
+            stack[stack_size++] = node.left_first + 1;
+        }
+    }
+    return false;
+}
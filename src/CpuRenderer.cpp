@@ -0,0 +1,1651 @@
+#include "CpuRenderer.h"
+#include "ThreadPool.h"
+#include <chrono>
+
+// The functions below follow the HLSL sources one to one (same names in snake_case where the
+// shader uses them, same constants, same order of random number draws) so that a fix on one
+// side is easy to carry over to the other. See shaders/*.hlsl for the reasoning behind the
+// individual firefly-reduction heuristics.
+
+namespace {
+
+constexpr float kPi = 3.14159265359f;
+constexpr float kEps = 1e-6f;
+const glm::vec3 kLuminance(0.2126f, 0.7152f, 0.0722f);
+
+// ---------------------------------------------------------------------------
+// rng.hlsl
+// ---------------------------------------------------------------------------
+
+uint32_t wang_hash(uint32_t seed) {
+    seed = (seed ^ 61u) ^ (seed >> 16);
+    seed *= 9u;
+    seed = seed ^ (seed >> 4);
+    seed *= 0x27d4eb2u;
+    seed = seed ^ (seed >> 15);
+    return seed;
+}
+
+uint32_t rand_xorshift(uint32_t& rng_state) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+float rand(uint32_t& rng_state) {
+    return static_cast<float>(static_cast<double>(rand_xorshift(rng_state)) * (1.0 / 4294967296.0));
+}
+
+// ---------------------------------------------------------------------------
+// HLSL intrinsics that differ from (or are missing in) glm
+// ---------------------------------------------------------------------------
+
+float saturate(float x) { return glm::clamp(x, 0.0f, 1.0f); }
+glm::vec3 saturate(const glm::vec3& x) { return glm::clamp(x, glm::vec3(0.0f), glm::vec3(1.0f)); }
+float smoothstep(float e0, float e1, float x) {
+    float t = saturate((x - e0) / (e1 - e0));
+    return t * t * (3.0f - 2.0f * t);
+}
+float step(float edge, float x) { return x >= edge ? 1.0f : 0.0f; }
+float frac(float x) { return x - std::floor(x); }
+
+glm::vec3 reflect(const glm::vec3& i, const glm::vec3& n) { return i - 2.0f * glm::dot(n, i) * n; }
+
+glm::vec3 refract(const glm::vec3& i, const glm::vec3& n, float eta) {
+    float cosi = glm::dot(-i, n);
+    float k = 1.0f - eta * eta * (1.0f - cosi * cosi);
+    if (k < 0.0f) return glm::vec3(0.0f);
+    return eta * i + (eta * cosi - std::sqrt(k)) * n;
+}
+
+glm::vec3 transform_vector(const glm::mat4& m, const glm::vec3& v) { return glm::vec3(m * glm::vec4(v, 0.0f)); }
+
+// Bilinear, wrap addressing, texel centers at half-integers (LinearWrap, SampleLevel 0)
+glm::vec4 SampleTexture(const HostTexture& texture, const glm::vec2& uv) {
+    if (!texture.IsValid()) {
+        return glm::vec4(1.0f);
+    }
+    float x = uv.x * texture.width - 0.5f;
+    float y = uv.y * texture.height - 0.5f;
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float tx = x - fx;
+    float ty = y - fy;
+    auto wrap = [](int i, int n) { i %= n; return i < 0 ? i + n : i; };
+    int x0 = wrap(static_cast<int>(fx), texture.width);
+    int y0 = wrap(static_cast<int>(fy), texture.height);
+    int x1 = wrap(x0 + 1, texture.width);
+    int y1 = wrap(y0 + 1, texture.height);
+
+    auto fetch = [&](int px, int py) {
+        size_t texel = static_cast<size_t>(py) * texture.width + px;
+        if (!texture.rgba32f.empty()) {
+            const float* p = &texture.rgba32f[texel * 4];
+            return glm::vec4(p[0], p[1], p[2], p[3]);
+        }
+        // Grey and grey + alpha textures read as (v, v, v, a) like their RGBA8 expansion
+        const uint8_t* p = &texture.rgba8[texel * texture.channels];
+        switch (texture.channels) {
+            case 1: return glm::vec4(p[0], p[0], p[0], 255.0f) * (1.0f / 255.0f);
+            case 2: return glm::vec4(p[0], p[0], p[0], p[1]) * (1.0f / 255.0f);
+            default: return glm::vec4(p[0], p[1], p[2], p[3]) * (1.0f / 255.0f);
+        }
+    };
+    glm::vec4 top = fetch(x0, y0) * (1.0f - tx) + fetch(x1, y0) * tx;
+    glm::vec4 bottom = fetch(x0, y1) * (1.0f - tx) + fetch(x1, y1) * tx;
+    return top * (1.0f - ty) + bottom * ty;
+}
+
+// ---------------------------------------------------------------------------
+// Per-pass state shared by all workers
+// ---------------------------------------------------------------------------
+
+struct TraceContext {
+    const SceneBvh* bvh;
+    const std::vector<Light>* lights;
+    const std::vector<HostTexture>* textures;
+    const std::vector<TextureMipRange>* texture_mips;
+    const HostTexture* skybox;
+    const CpuFrameParams* params;
+    float cone_spread; // Ray cone spread of the camera rays (angle between adjacent pixel rays)
+};
+
+// RayPayload in common.hlsl
+struct Payload {
+    bool hit = false;
+    uint32_t instance_id = 0;
+
+    glm::vec3 position{ 0.0f };
+    glm::vec3 normal{ 0.0f };
+    glm::vec3 geometric_normal{ 0.0f };
+    glm::vec3 albedo{ 0.0f };
+    float roughness = 0.0f;
+    float metallic = 0.0f;
+    glm::vec3 emission{ 0.0f };
+    float ao = 1.0f;
+    float clearcoat = 0.0f;
+    float clearcoat_roughness = 0.0f;
+    float transmission = 0.0f;
+    float ior = 1.0f;
+    float dispersion = 0.0f;
+    int alpha_mode = 0;
+    float alpha = 1.0f;
+    float new_eps = 0.0f;
+    bool front_face = true;
+    glm::vec3 direct_light{ 0.0f };
+    uint32_t rng_state = 0;
+
+    glm::vec3 albedo_layer2{ 0.0f };
+    float roughness_layer2 = 0.0f;
+    float metallic_layer2 = 0.0f;
+    glm::vec3 emission_layer2{ 0.0f };
+    float ao_layer2 = 1.0f;
+    float clearcoat_layer2 = 0.0f;
+    float clearcoat_roughness_layer2 = 0.0f;
+    float transmission_layer2 = 0.0f;
+    float ior_layer2 = 1.0f;
+    float dispersion_layer2 = 0.0f;
+    int alpha_mode_layer2 = 0;
+    float alpha_layer2 = 1.0f;
+
+    float thin = 0.0f;
+    float blend_factor = 0.0f;
+    float layer_thickness = 0.0f;
+    float outline_factor = 0.0f;
+
+    // Ray cone for texture LOD: width at the ray origin and spread per unit distance
+    float cone_width = 0.0f;
+    float cone_spread = 0.0f;
+};
+
+const HostTexture* TextureAt(const TraceContext& ctx, int index) {
+    if (index < 0 || index >= static_cast<int>(ctx.textures->size())) return nullptr;
+    return &(*ctx.textures)[index];
+}
+
+glm::vec4 SampleMaterialTexture(const TraceContext& ctx, int index, const glm::vec2& uv) {
+    const HostTexture* texture = TextureAt(ctx, index);
+    return texture ? SampleTexture(*texture, uv) : glm::vec4(1.0f);
+}
+
+// SampleTexture in common.hlsl: trilinear between the texture's mip levels at the ray cone LOD.
+// lod_offset is the LOD without the texture size; levels without a host copy read level 0.
+glm::vec4 SampleMaterialTexture(const TraceContext& ctx, int index, const glm::vec2& uv, float lod_offset) {
+    const HostTexture* texture = TextureAt(ctx, index);
+    if (!texture) return glm::vec4(1.0f);
+    TextureMipRange range;
+    if (index < static_cast<int>(ctx.texture_mips->size())) range = (*ctx.texture_mips)[index];
+    if (range.level_count <= 1) return SampleTexture(*texture, uv);
+
+    auto sample_level = [&](int level) {
+        const HostTexture* level_texture = level == 0 ? texture : TextureAt(ctx, range.first_level + level - 1);
+        return SampleTexture(level_texture && level_texture->IsValid() ? *level_texture : *texture, uv);
+    };
+    float lod = glm::clamp(lod_offset + 0.5f * std::log2(float(texture->width) * float(texture->height)), 0.0f,
+                           float(range.level_count - 1));
+    int level = static_cast<int>(lod);
+    float blend = lod - static_cast<float>(level);
+    glm::vec4 result = sample_level(level);
+    if (blend > 0.0f && level + 1 < range.level_count) {
+        result = glm::mix(result, sample_level(level + 1), blend);
+    }
+    return result;
+}
+
+// Interpolated UV with the box-mapping fallback used by ClosestHitMain and AnyHitMain
+glm::vec2 InterpolateUv(const CpuInstance& inst, uint32_t i0, uint32_t i1, uint32_t i2, const glm::vec3& bary) {
+    glm::vec2 uv0(0.0f), uv1(0.0f), uv2(0.0f);
+    if (inst.texcoords) {
+        uv0 = inst.texcoords[i0];
+        uv1 = inst.texcoords[i1];
+        uv2 = inst.texcoords[i2];
+    }
+    glm::vec2 uv = uv0 * bary.x + uv1 * bary.y + uv2 * bary.z;
+    bool uv_valid = glm::length(uv0) > 0.001f || glm::length(uv1) > 0.001f || glm::length(uv2) > 0.001f;
+    if (!uv_valid) {
+        glm::vec3 interp_pos = inst.positions[i0] * bary.x + inst.positions[i1] * bary.y + inst.positions[i2] * bary.z;
+        glm::vec3 abs_pos = glm::abs(interp_pos);
+        float max_axis = std::max(abs_pos.x, std::max(abs_pos.y, abs_pos.z));
+        if (abs_pos.x == max_axis) {
+            uv = glm::vec2(interp_pos.z, interp_pos.y) * 0.5f + 0.5f;
+        } else if (abs_pos.y == max_axis) {
+            uv = glm::vec2(interp_pos.x, interp_pos.z) * 0.5f + 0.5f;
+        } else {
+            uv = glm::vec2(interp_pos.x, interp_pos.y) * 0.5f + 0.5f;
+        }
+    }
+    return uv;
+}
+
+// ---------------------------------------------------------------------------
+// Scene queries (TraceRay)
+// ---------------------------------------------------------------------------
+
+bool IntersectScene(const TraceContext& ctx, const CpuRay& ray, CpuHit* hit) {
+    return ctx.bvh->IntersectClosest(ray, hit);
+}
+
+// AnyHitMain: alpha-tested candidates, BLEND uses stochastic transparency
+bool AcceptShadowHit(const TraceContext& ctx, const CpuInstance& inst, uint32_t primitive, float u, float v, uint32_t& rng_state) {
+    const Material& mat = inst.entity->GetMaterial();
+    if (mat.alpha_mode == 0) return true;
+
+    uint32_t i0 = inst.indices[primitive * 3 + 0];
+    uint32_t i1 = inst.indices[primitive * 3 + 1];
+    uint32_t i2 = inst.indices[primitive * 3 + 2];
+    glm::vec3 bary(1.0f - u - v, u, v);
+    glm::vec2 uv = InterpolateUv(inst, i0, i1, i2, bary);
+
+    float alpha_tex = (mat.base_color_tex >= 0) ? SampleMaterialTexture(ctx, mat.base_color_tex, uv).a : 1.0f;
+    float alpha = mat.base_color_factor.a * alpha_tex;
+
+    if (mat.alpha_mode == 1) {
+        return alpha >= 0.5f;
+    }
+    if (mat.alpha_mode == 2) {
+        return !(rand(rng_state) > alpha);
+    }
+    return true;
+}
+
+// shadow.hlsl CastShadowRay; returns true when the segment is blocked
+bool CastShadowRay(const TraceContext& ctx, const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+                   uint32_t& rng_state, uint64_t& ray_count) {
+    ++ray_count;
+    CpuRay ray{ origin, kEps, direction, max_distance };
+    return ctx.bvh->IntersectAny(ray, [&](uint32_t instance, uint32_t primitive, float u, float v) {
+        return AcceptShadowHit(ctx, ctx.bvh->GetInstances()[instance], primitive, u, v, rng_state);
+    });
+}
+
+// ---------------------------------------------------------------------------
+// brdf.hlsl
+// ---------------------------------------------------------------------------
+
+glm::vec3 F_Schlick(const glm::vec3& f0, float u) {
+    return f0 + (1.0f - f0) * std::pow(1.0f - u, 5.0f);
+}
+
+float D_GGX(float NdotH, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float NdotH2 = NdotH * NdotH;
+    float denom = (NdotH2 * (a2 - 1.0f) + 1.0f);
+    return a2 / std::max(kPi * denom * denom, kEps);
+}
+
+float G_Smith(float NdotV, float NdotL, float roughness) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float ggx1 = 2 * NdotV / std::max(NdotV + std::sqrt(a2 + (1.0f - a2) * NdotV * NdotV), kEps);
+    float ggx2 = 2 * NdotL / std::max(NdotL + std::sqrt(a2 + (1.0f - a2) * NdotL * NdotL), kEps);
+    return ggx1 * ggx2;
+}
+
+glm::vec3 apply_cartoon_diffuse(const RenderSettings& settings, const glm::vec3& diffuse, float bands) {
+    float luminance = glm::dot(diffuse, kLuminance);
+    float binary_value = step(settings.binary_threshold, luminance);
+
+    glm::vec3 binary_diffuse = diffuse;
+    if (luminance > kEps) {
+        float target_luminance = binary_value > 0.5f ? 1.0f : std::max(luminance * 0.3f, 0.1f);
+        binary_diffuse = diffuse * (target_luminance / luminance);
+    } else {
+        binary_diffuse = diffuse * 0.1f;
+    }
+
+    if (bands <= 2.0f) {
+        return binary_diffuse;
+    }
+
+    float quantized_luminance = std::round(luminance * bands) / bands;
+    float min_luminance = luminance * 0.7f;
+    quantized_luminance = std::max(quantized_luminance, min_luminance);
+
+    glm::vec3 quantized = diffuse;
+    if (luminance > kEps) {
+        quantized = diffuse * (quantized_luminance / luminance);
+    }
+
+    float max_channel = std::max(std::max(quantized.r, quantized.g), quantized.b);
+    float min_channel = std::min(std::min(quantized.r, quantized.g), quantized.b);
+    float saturation = (max_channel > kEps) ? (max_channel - min_channel) / max_channel : 0.0f;
+
+    float saturation_boost = 2.5f;
+    float new_saturation = std::min(saturation * saturation_boost, 1.0f);
+
+    if (max_channel > kEps && saturation > 0.01f) {
+        glm::vec3 gray(quantized_luminance);
+        quantized = glm::mix(gray, quantized, new_saturation / std::max(saturation, 0.01f));
+    }
+
+    if (saturation > 0.05f) {
+        float color_boost = 1.6f;
+        quantized = glm::mix(quantized, quantized * color_boost, saturation * 0.8f);
+    }
+
+    return quantized;
+}
+
+glm::vec3 apply_cartoon_specular(const RenderSettings& settings, const glm::vec3& specular, float hardness) {
+    if (hardness <= 0.0f) return specular;
+
+    float luminance = glm::dot(specular, kLuminance);
+    float flat_mask = step(settings.highlight_threshold, luminance);
+    glm::vec3 flat_highlight = specular * flat_mask;
+
+    if (hardness > 0.5f) {
+        return flat_highlight;
+    }
+    return glm::mix(specular, flat_highlight, hardness * 2.0f);
+}
+
+glm::vec3 eval_brdf(const RenderSettings& settings, const glm::vec3& N, const glm::vec3& L, const glm::vec3& V,
+                    const glm::vec3& albedo, float roughness, float metallic, float ao = 1.0f,
+                    float clearcoat = 0.0f, float clearcoat_roughness = 0.0f) {
+    glm::vec3 H = glm::normalize(V + L);
+    float NdotL = std::max(glm::dot(N, L), 0.0f);
+    float NdotV = std::max(glm::dot(N, V), 0.0f);
+    float NdotH = std::max(glm::dot(N, H), 0.0f);
+    float VdotH = std::max(glm::dot(V, H), 0.0f);
+
+    if (NdotL <= 0.0f || NdotV <= 0.0f) return glm::vec3(0.0f);
+
+    glm::vec3 F0 = glm::mix(glm::vec3(0.04f), albedo, metallic);
+    glm::vec3 F = glm::max(glm::vec3(0.0f), F_Schlick(F0, VdotH));
+    float D = std::max(0.0f, D_GGX(NdotH, roughness));
+    float G = std::max(0.0f, G_Smith(NdotV, NdotL, roughness));
+
+    glm::vec3 specular = (D * G * F) / std::max(4.0f * NdotV * NdotL, kEps);
+
+    glm::vec3 kS = F;
+    glm::vec3 kD = (1.0f - kS) * (1.0f - metallic);
+    glm::vec3 diffuse = kD * albedo / kPi * ao;
+
+    if (settings.cartoon_enabled == 1) {
+        diffuse = apply_cartoon_diffuse(settings, diffuse, settings.diffuse_bands);
+        specular = apply_cartoon_specular(settings, specular, settings.specular_hardness);
+    }
+
+    glm::vec3 base_layer = diffuse + specular;
+
+    if (clearcoat > 0.0f) {
+        float Fc = F_Schlick(glm::vec3(0.04f), VdotH).r;
+        float Dc = D_GGX(NdotH, clearcoat_roughness);
+        float Gc = G_Smith(NdotV, NdotL, clearcoat_roughness);
+
+        glm::vec3 f_clearcoat = glm::vec3(Dc * Gc * Fc) / std::max(4.0f * NdotV * NdotL, kEps);
+
+        return f_clearcoat * clearcoat + (1.0f - Fc * clearcoat) * base_layer;
+    }
+
+    return base_layer;
+}
+
+// Layer parameters grouped to keep the multi-layer signatures readable
+struct LayerParams {
+    glm::vec3 albedo;
+    float roughness;
+    float metallic;
+    float ao;
+    float clearcoat;
+    float clearcoat_roughness;
+};
+
+struct MultiLayerParams {
+    LayerParams layer1;
+    LayerParams layer2;
+    float thin;
+    float blend_factor;
+    float layer_thickness;
+    float alpha_layer2;
+};
+
+glm::vec3 eval_brdf_multi_layer(const RenderSettings& settings, const glm::vec3& N, const glm::vec3& L, const glm::vec3& V,
+                                const MultiLayerParams& m) {
+    const LayerParams& l1 = m.layer1;
+    const LayerParams& l2 = m.layer2;
+    glm::vec3 brdf_layer1 = eval_brdf(settings, N, L, V, l1.albedo, l1.roughness, l1.metallic, l1.ao, l1.clearcoat, l1.clearcoat_roughness);
+    glm::vec3 brdf_layer2 = eval_brdf(settings, N, L, V, l2.albedo, l2.roughness, l2.metallic, l2.ao, l2.clearcoat, l2.clearcoat_roughness);
+
+    float effective_blend = m.blend_factor * m.alpha_layer2;
+
+    if (m.thin < 0.5f) {
+        return glm::mix(brdf_layer1, brdf_layer2, effective_blend);
+    }
+
+    float NdotV = std::max(glm::dot(N, V), kEps);
+    float F = F_Schlick(glm::vec3(0.04f), NdotV).r;
+    float transmission_factor = 1.0f - F * effective_blend;
+    float reflection_factor = F * effective_blend;
+    glm::vec3 final_brdf = brdf_layer1 * transmission_factor + brdf_layer2 * reflection_factor;
+    return glm::max(final_brdf, glm::vec3(0.0f));
+}
+
+// ---------------------------------------------------------------------------
+// sampling.hlsl
+// ---------------------------------------------------------------------------
+
+glm::vec3 sample_cosine_hemisphere(float u1, float u2) {
+    float r = std::sqrt(u1);
+    float phi = 2.0f * kPi * u2;
+    return glm::vec3(r * std::cos(phi), r * std::sin(phi), std::sqrt(std::max(0.0f, 1.0f - u1)));
+}
+
+glm::vec2 sample_concentric_disk(float u1, float u2) {
+    glm::vec2 u = 2.0f * glm::vec2(u1, u2) - 1.0f;
+    if (std::abs(u.x) < kEps && std::abs(u.y) < kEps) {
+        return glm::vec2(0.0f);
+    }
+    float r;
+    float phi;
+    if (std::abs(u.x) > std::abs(u.y)) {
+        r = u.x;
+        phi = (kPi * 0.25f) * (u.y / u.x);
+    } else {
+        r = u.y;
+        phi = (kPi * 0.5f) - (kPi * 0.25f) * (u.x / u.y);
+    }
+    return r * glm::vec2(std::cos(phi), std::sin(phi));
+}
+
+glm::vec3 sample_GGX_half(float u1, float u2, float roughness) {
+    float a = roughness * roughness;
+    float tan2 = a * a * (u1 / std::max(kEps, 1.0f - u1));
+    float cosTheta = 1.0f / std::sqrt(1.0f + tan2);
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 2.0f * kPi * u2;
+    return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+
+float pdf_GGX_for_direction(const glm::vec3& N, const glm::vec3& V, const glm::vec3& L, float roughness) {
+    glm::vec3 H = glm::normalize(V + L);
+    float NdotH = std::max(glm::dot(N, H), 0.0f);
+    float VdotH = std::max(glm::dot(V, H), 0.0f);
+    float D = D_GGX(NdotH, roughness);
+    return (D * NdotH) / std::max(4.0f * VdotH, kEps);
+}
+
+float pdf_brdf_for_direction(const glm::vec3& N, const glm::vec3& V, const glm::vec3& L,
+                             float roughness, float metallic, float clearcoat, float clearcoat_roughness) {
+    float NdotL = std::max(glm::dot(N, L), 0.0f);
+    if (NdotL <= 0.0f) return 0.0f;
+
+    glm::vec3 F0 = glm::mix(glm::vec3(0.04f), glm::vec3(1.0f), metallic);
+    glm::vec3 F = F_Schlick(F0, std::max(glm::dot(N, V), 0.0f));
+    float luminance = glm::dot(F, kLuminance);
+
+    float q_spec_base = glm::clamp(saturate(luminance), 0.05f, 0.95f);
+    float q_diff_base = 1.0f - q_spec_base;
+
+    float p_clearcoat = 0.0f;
+    if (clearcoat > 0.0f) {
+        p_clearcoat = glm::clamp(clearcoat * 0.5f, 0.0f, 0.5f);
+    }
+    float p_base = 1.0f - p_clearcoat;
+
+    float pdf_diff = NdotL / kPi;
+    float pdf_spec_base = pdf_GGX_for_direction(N, V, L, roughness);
+    float pdf_spec_cc = 0.0f;
+    if (clearcoat > 0.0f) {
+        pdf_spec_cc = pdf_GGX_for_direction(N, V, L, clearcoat_roughness);
+    }
+    return p_clearcoat * pdf_spec_cc + p_base * (q_spec_base * pdf_spec_base + q_diff_base * pdf_diff);
+}
+
+float pdf_light_for_direction(const Light& light, const glm::vec3& position, const glm::vec3& light_dir) {
+    if (light.type == LIGHT_POINT) {
+        return 1.0f;
+    } else if (light.type == LIGHT_SUN) {
+        float theta = std::max(light.angular_radius, 1e-4f);
+        float cosThetaMax = std::cos(theta);
+        float solid_angle = std::max(2.0f * kPi * (1.0f - cosThetaMax), 1e-6f);
+        float cos_angle = glm::dot(glm::normalize(-light.direction), glm::normalize(light_dir));
+        return (cos_angle >= cosThetaMax) ? (1.0f / solid_angle) : 0.0f;
+    } else if (light.type == LIGHT_AREA) {
+        float area = glm::length(glm::cross(light.u, light.v));
+        float dist_sq = glm::dot(light.position - position, light.position - position);
+        float cos_theta = std::max(glm::dot(-light_dir, glm::normalize(light.direction)), 0.0f);
+        return std::max(dist_sq, 1e-2f) / (area * cos_theta);
+    }
+    return 0.0f;
+}
+
+// ---------------------------------------------------------------------------
+// light_sampling.hlsl
+// ---------------------------------------------------------------------------
+
+glm::vec3 SamplePointLight(const Light& light, const glm::vec3& position, glm::vec3& light_dir, float& inv_pdf) {
+    light_dir = glm::normalize(light.position - position);
+    inv_pdf = 1.0f;
+    float dist_sq = glm::dot(light.position - position, light.position - position);
+    return light.color * light.intensity / dist_sq;
+}
+
+glm::vec3 SampleAreaLight(const Light& light, const glm::vec3& position, glm::vec3& light_dir, float& inv_pdf,
+                          glm::vec3& sampled_point, uint32_t& rng_state) {
+    float u1 = rand(rng_state);
+    float u2 = rand(rng_state);
+
+    sampled_point = light.position + (u1 - 0.5f) * light.u + (u2 - 0.5f) * light.v;
+    light_dir = glm::normalize(sampled_point - position);
+
+    float area = glm::length(glm::cross(light.u, light.v));
+    float dist_sq = glm::dot(sampled_point - position, sampled_point - position);
+    float cos_theta = std::max(glm::dot(-light_dir, glm::normalize(light.direction)), 0.0f);
+
+    dist_sq = std::max(dist_sq, 0.01f);
+    cos_theta = std::max(cos_theta, 0.01f);
+
+    inv_pdf = area * cos_theta / dist_sq;
+    inv_pdf = glm::clamp(inv_pdf, 1e-3f, 1e3f);
+
+    return light.color * light.intensity;
+}
+
+glm::vec3 SampleSunLight(const Light& light, glm::vec3& light_dir, float& inv_pdf, uint32_t& rng_state) {
+    glm::vec3 w = glm::normalize(-light.direction);
+    glm::vec3 up = (std::abs(w.z) < 0.999f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 u = glm::normalize(glm::cross(up, w));
+    glm::vec3 v = glm::cross(w, u);
+
+    float theta = std::max(light.angular_radius, 1e-4f);
+    float cosThetaMax = std::cos(theta);
+
+    float u1 = rand(rng_state);
+    float u2 = rand(rng_state);
+    float cosTheta = glm::mix(cosThetaMax, 1.0f, u1);
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 2.0f * kPi * u2;
+
+    light_dir = glm::normalize(u * (sinTheta * std::cos(phi)) + v * (sinTheta * std::sin(phi)) + w * cosTheta);
+
+    float solid_angle = std::max(2.0f * kPi * (1.0f - cosThetaMax), 1e-6f);
+    inv_pdf = solid_angle;
+    return light.color * light.intensity;
+}
+
+// ---------------------------------------------------------------------------
+// direct_lighting.hlsl
+// ---------------------------------------------------------------------------
+
+float mis_weight_power_safe(float pdf_a, float pdf_b) {
+    pdf_a = std::max(pdf_a, kEps);
+    pdf_b = std::max(pdf_b, kEps);
+    float ratio = pdf_a / pdf_b;
+    if (ratio > 100.0f || ratio < 0.01f) {
+        return (pdf_a > pdf_b) ? 1.0f : 0.0f;
+    }
+    float pdf_a_pow = pdf_a * pdf_a;
+    float pdf_b_pow = pdf_b * pdf_b;
+    float pdf_sum = pdf_a_pow + pdf_b_pow;
+    return pdf_sum > kEps ? (pdf_a_pow / pdf_sum) : 0.5f;
+}
+
+// EvaluateLight and EvaluateLightMultiLayer only differ in the BRDF they evaluate (and in which
+// layer drives the cartoon albedo), so both are expressed through this helper. `multi` is null
+// for single-layer materials; `base` always describes the sampled (first) layer.
+glm::vec3 EvaluateLightImpl(const TraceContext& ctx, const Light& light, const glm::vec3& position, const glm::vec3& normal,
+                            const glm::vec3& geometric_normal, const glm::vec3& view_dir, const LayerParams& base,
+                            const MultiLayerParams* multi, uint32_t& rng_state, uint64_t& ray_count) {
+    const RenderSettings& settings = ctx.params->settings;
+    glm::vec3 direct_light(0.0f);
+
+    auto eval = [&](const glm::vec3& L, float safe_floor) {
+        if (multi) {
+            MultiLayerParams m = *multi;
+            m.layer1.roughness = std::max(m.layer1.roughness, safe_floor);
+            m.layer2.roughness = std::max(m.layer2.roughness, safe_floor);
+            return eval_brdf_multi_layer(settings, normal, L, view_dir, m);
+        }
+        return eval_brdf(settings, normal, L, view_dir, base.albedo, std::max(base.roughness, safe_floor), base.metallic,
+                         base.ao, base.clearcoat, base.clearcoat_roughness);
+    };
+
+    // Strategy 1: light sampling (NEE)
+    glm::vec3 light_dir(0.0f);
+    glm::vec3 radiance_light(0.0f);
+    float inv_pdf_light = 1.0f;
+    float pdf_light = 0.0f;
+    float max_distance = 0.0f;
+    glm::vec3 contribution_light(0.0f);
+    bool light_sample_valid = false;
+
+    if (light.type == LIGHT_POINT) {
+        radiance_light = SamplePointLight(light, position, light_dir, inv_pdf_light);
+        pdf_light = 1.0f;
+        max_distance = glm::length(light.position - position);
+    } else if (light.type == LIGHT_SUN) {
+        radiance_light = SampleSunLight(light, light_dir, inv_pdf_light, rng_state);
+        pdf_light = 1.0f / std::max(inv_pdf_light, kEps);
+        max_distance = 1e9f;
+    } else if (light.type == LIGHT_AREA) {
+        glm::vec3 sampled_point;
+        radiance_light = SampleAreaLight(light, position, light_dir, inv_pdf_light, sampled_point, rng_state);
+        pdf_light = 1.0f / std::max(inv_pdf_light, kEps);
+        max_distance = glm::length(sampled_point - position);
+    }
+
+    float NdotL_light = std::max(glm::dot(normal, light_dir), 0.0f);
+    float half_lambert = glm::dot(normal, light_dir) * 0.5f + 0.5f;
+    float toon_ramp = smoothstep(0.35f, 0.4f, half_lambert) * 0.4f + smoothstep(0.65f, 0.7f, half_lambert) * 0.6f;
+    if (NdotL_light > 0.0f) {
+        float light_solid_angle = 0.0f;
+        if (light.type == LIGHT_POINT) {
+            light_solid_angle = 0.01f;
+        } else if (light.type == LIGHT_SUN) {
+            float theta = std::max(light.angular_radius, 1e-4f);
+            light_solid_angle = 2.0f * kPi * (1.0f - std::cos(theta));
+        } else if (light.type == LIGHT_AREA) {
+            float area = glm::length(glm::cross(light.u, light.v));
+            float dist_sq = std::max(glm::dot(light.position - position, light.position - position), 0.01f);
+            light_solid_angle = area / dist_sq;
+        }
+
+        float min_roughness = 0.15f;
+        if (light_solid_angle < 0.1f) {
+            min_roughness = glm::clamp(0.15f / std::sqrt(std::max(light_solid_angle * 10.0f, 0.1f)), 0.15f, 0.4f);
+        }
+
+        glm::vec3 brdf_light = eval(light_dir, min_roughness);
+
+        bool should_ignore_shadow = (settings.cartoon_enabled == 1) && (NdotL_light > settings.shadow_ignore_threshold);
+        bool is_lit = should_ignore_shadow ||
+                      !CastShadowRay(ctx, position + geometric_normal * 1e-3f, light_dir, max_distance - 1e-3f, rng_state, ray_count);
+
+        if (is_lit) {
+            if (settings.cartoon_enabled == 1) {
+                float albedo_lum = glm::dot(base.albedo, kLuminance);
+                glm::vec3 cool_color = albedo_lum * glm::vec3(0.6f, 0.6f, 0.8f) * 0.15f;
+                float light_lum = glm::dot(radiance_light, kLuminance);
+                glm::vec3 warm_color = brdf_light * light_lum;
+                contribution_light = glm::mix(cool_color, warm_color, toon_ramp);
+            } else {
+                contribution_light = brdf_light * radiance_light * NdotL_light;
+            }
+            contribution_light = glm::min(contribution_light, glm::vec3(1e5f));
+            light_sample_valid = true;
+        }
+    }
+
+    // Strategy 2: BRDF sampling (check if direction hits light)
+    glm::vec3 contribution_brdf(0.0f);
+    float pdf_brdf = 0.0f;
+    bool brdf_sample_valid = false;
+
+    float r1 = rand(rng_state);
+    float r2 = rand(rng_state);
+    float r3 = rand(rng_state);
+
+    glm::vec3 up = std::abs(normal.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+    glm::vec3 tangent = glm::normalize(glm::cross(up, normal));
+    glm::vec3 bitangent = glm::cross(normal, tangent);
+
+    glm::vec3 F0 = glm::mix(glm::vec3(0.04f), base.albedo, base.metallic);
+    glm::vec3 F = F_Schlick(F0, std::max(glm::dot(normal, view_dir), 0.0f));
+    float luminance = glm::dot(F, kLuminance);
+
+    float q_spec_base = glm::clamp(saturate(luminance), 0.05f, 0.95f);
+
+    float p_clearcoat = 0.0f;
+    if (base.clearcoat > 0.0f) {
+        p_clearcoat = glm::clamp(base.clearcoat * 0.5f, 0.0f, 0.5f);
+    }
+    float p_base = 1.0f - p_clearcoat;
+
+    glm::vec3 brdf_dir;
+    if (r3 < p_clearcoat) {
+        float r4 = rand(rng_state);
+        float r5 = rand(rng_state);
+        glm::vec3 h_local = sample_GGX_half(r4, r5, base.clearcoat_roughness);
+        glm::vec3 H = glm::normalize(h_local.x * tangent + h_local.y * bitangent + h_local.z * normal);
+        brdf_dir = glm::normalize(reflect(-view_dir, H));
+    } else {
+        float r3_base = (r3 - p_clearcoat) / std::max(kEps, p_base);
+        if (r3_base < q_spec_base) {
+            float r4 = rand(rng_state);
+            float r5 = rand(rng_state);
+            glm::vec3 h_local = sample_GGX_half(r4, r5, base.roughness);
+            glm::vec3 H = glm::normalize(h_local.x * tangent + h_local.y * bitangent + h_local.z * normal);
+            brdf_dir = glm::normalize(reflect(-view_dir, H));
+        } else {
+            glm::vec3 local_diff = sample_cosine_hemisphere(r1, r2);
+            brdf_dir = glm::normalize(local_diff.x * tangent + local_diff.y * bitangent + local_diff.z * normal);
+        }
+    }
+
+    float NdotL_brdf = std::max(glm::dot(normal, brdf_dir), 0.0f);
+    if (NdotL_brdf > 0.0f) {
+        glm::vec3 brdf_to_light = (light.type == LIGHT_SUN) ? glm::normalize(-light.direction)
+                                                            : glm::normalize(light.position - position);
+        float cos_angle = glm::dot(brdf_dir, brdf_to_light);
+
+        bool hits_light = false;
+        if (light.type == LIGHT_POINT) {
+            hits_light = cos_angle > 0.99f;
+        } else if (light.type == LIGHT_SUN) {
+            hits_light = cos_angle >= std::cos(std::max(light.angular_radius, 1e-4f));
+        } else if (light.type == LIGHT_AREA) {
+            hits_light = cos_angle > 0.9f;
+        }
+
+        if (hits_light) {
+            glm::vec3 light_radiance_brdf(0.0f);
+            float dist_to_light = 0.0f;
+            if (light.type == LIGHT_POINT) {
+                dist_to_light = glm::length(light.position - position);
+                light_radiance_brdf = light.color * light.intensity / (dist_to_light * dist_to_light);
+            } else if (light.type == LIGHT_SUN) {
+                dist_to_light = 1e9f;
+                light_radiance_brdf = light.color * light.intensity;
+            } else if (light.type == LIGHT_AREA) {
+                dist_to_light = glm::length(light.position - position);
+                light_radiance_brdf = light.color * light.intensity;
+            }
+
+            bool should_ignore_shadow_brdf = (settings.cartoon_enabled == 1) && (NdotL_brdf > settings.shadow_ignore_threshold);
+            bool is_lit_brdf = should_ignore_shadow_brdf ||
+                               !CastShadowRay(ctx, position + geometric_normal * 1e-3f, brdf_dir, dist_to_light - 1e-3f, rng_state, ray_count);
+
+            if (is_lit_brdf) {
+                glm::vec3 brdf_brdf = eval(brdf_dir, 0.15f);
+                contribution_brdf = glm::min(brdf_brdf * light_radiance_brdf * NdotL_brdf, glm::vec3(1e5f));
+                pdf_brdf = pdf_brdf_for_direction(normal, view_dir, brdf_dir, base.roughness, base.metallic,
+                                                  base.clearcoat, base.clearcoat_roughness);
+                brdf_sample_valid = true;
+            }
+        }
+    }
+
+    // Combine contributions using MIS
+    if (light_sample_valid) {
+        if (light.type == LIGHT_POINT) {
+            direct_light += contribution_light;
+        } else {
+            float pdf_brdf_for_light_dir = pdf_brdf_for_direction(normal, view_dir, light_dir, base.roughness, base.metallic,
+                                                                  base.clearcoat, base.clearcoat_roughness);
+            float w_light = mis_weight_power_safe(pdf_light, pdf_brdf_for_light_dir);
+            direct_light += w_light * contribution_light / std::max(pdf_light, kEps);
+        }
+    }
+
+    if (brdf_sample_valid) {
+        float pdf_light_for_brdf_dir = pdf_light_for_direction(light, position, brdf_dir);
+        float w_brdf = mis_weight_power_safe(pdf_brdf, pdf_light_for_brdf_dir);
+        direct_light += w_brdf * contribution_brdf / std::max(pdf_brdf, kEps);
+    }
+
+    return direct_light;
+}
+
+// ---------------------------------------------------------------------------
+// closesthit.hlsl / miss.hlsl
+// ---------------------------------------------------------------------------
+
+glm::vec2 DirectionToEquirectangularUV(const glm::vec3& direction) {
+    float u = std::atan2(direction.z, direction.x) / (2.0f * kPi) + 0.5f;
+    float v = 0.5f - std::asin(glm::clamp(direction.y, -1.0f, 1.0f)) / kPi;
+    return glm::vec2(u, v);
+}
+
+void MissMain(const TraceContext& ctx, const CpuRay& ray, Payload& payload) {
+    payload.hit = false;
+    glm::vec3 ray_dir = glm::normalize(ray.direction);
+    glm::vec3 sky_color(0.0f);
+    if (ctx.params->sky.use_skybox != 0 && ctx.skybox->IsValid()) {
+        sky_color = glm::vec3(SampleTexture(*ctx.skybox, DirectionToEquirectangularUV(ray_dir)));
+    }
+    payload.emission = sky_color * ctx.params->sky.env_intensity;
+}
+
+void ClosestHitMain(const TraceContext& ctx, const CpuRay& ray, const CpuHit& hit, Payload& payload, uint64_t& ray_count) {
+    const RenderSettings& settings = ctx.params->settings;
+    const CpuInstance& inst = ctx.bvh->GetInstances()[hit.instance];
+    const Material& mat = inst.entity->GetMaterial();
+
+    payload.hit = true;
+    payload.instance_id = inst.entity_index;
+
+    uint32_t index0 = inst.indices[hit.primitive * 3 + 0];
+    uint32_t index1 = inst.indices[hit.primitive * 3 + 1];
+    uint32_t index2 = inst.indices[hit.primitive * 3 + 2];
+    glm::vec3 v0 = inst.positions[index0];
+    glm::vec3 v1 = inst.positions[index1];
+    glm::vec3 v2 = inst.positions[index2];
+
+    glm::vec3 bary(1.0f - hit.u - hit.v, hit.u, hit.v);
+    glm::vec2 uv = InterpolateUv(inst, index0, index1, index2, bary);
+
+    // Ray cone footprint at the hit for texture LOD; generated UVs have no footprint and use level 0
+    glm::vec2 uv0(0.0f), uv1(0.0f), uv2(0.0f);
+    if (inst.texcoords) {
+        uv0 = inst.texcoords[index0];
+        uv1 = inst.texcoords[index1];
+        uv2 = inst.texcoords[index2];
+    }
+    bool uv_valid = glm::length(uv0) > 0.001f || glm::length(uv1) > 0.001f || glm::length(uv2) > 0.001f;
+    glm::vec3 world_edge1 = transform_vector(inst.object_to_world, v1 - v0);
+    glm::vec3 world_edge2 = transform_vector(inst.object_to_world, v2 - v0);
+    glm::vec3 world_cross = glm::cross(world_edge1, world_edge2);
+    float world_area = glm::length(world_cross);
+    glm::vec2 duv1 = uv1 - uv0;
+    glm::vec2 duv2 = uv2 - uv0;
+    float uv_area = std::abs(duv1.x * duv2.y - duv2.x * duv1.y);
+    float cone_width = payload.cone_width + payload.cone_spread * hit.t;
+    float cone_cos = world_area > 0.0f ? std::abs(glm::dot(world_cross / world_area, glm::normalize(ray.direction))) : 1.0f;
+    float texture_lod = -64.0f;
+    if (uv_valid && uv_area > 0.0f && world_area > 0.0f) {
+        texture_lod = 0.5f * std::log2(uv_area / world_area) + std::log2(std::max(cone_width, 1e-8f) / std::max(cone_cos, 1e-2f));
+    }
+    payload.cone_width = cone_width;
+
+    auto tex = [&](int index) { return SampleMaterialTexture(ctx, index, uv, texture_lod); };
+
+    glm::vec4 base_color_sample = (mat.base_color_tex >= 0) ? tex(mat.base_color_tex) : glm::vec4(1.0f);
+    glm::vec4 metallic_roughness_sample = (mat.metallic_roughness_tex >= 0) ? tex(mat.metallic_roughness_tex) : glm::vec4(1.0f);
+    glm::vec3 emissive_tex = (mat.emissive_texture >= 0) ? glm::vec3(tex(mat.emissive_texture)) : glm::vec3(1.0f);
+    float AO_tex = (mat.AO_texture >= 0) ? tex(mat.AO_texture).r : 1.0f;
+
+    glm::vec3 base_color = glm::vec3(mat.base_color_factor) * glm::vec3(base_color_sample);
+    float alpha = mat.base_color_factor.a * base_color_sample.a;
+    float metallic = mat.metallic_factor * metallic_roughness_sample.b;
+    float roughness = std::max(0.1f, mat.roughness_factor * metallic_roughness_sample.g);
+    glm::vec3 emission = mat.emissive_factor * emissive_tex;
+    float AO = 1.0f + (AO_tex - 1.0f) * mat.AO_strength;
+
+    glm::vec4 base_color_sample_layer2 = (mat.base_color_tex_layer2 >= 0) ? tex(mat.base_color_tex_layer2) : glm::vec4(1.0f);
+    glm::vec4 metallic_roughness_sample_layer2 =
+        (mat.metallic_roughness_tex_layer2 >= 0) ? tex(mat.metallic_roughness_tex_layer2) : glm::vec4(1.0f);
+    glm::vec3 emissive_tex_layer2 = (mat.emissive_texture_layer2 >= 0) ? glm::vec3(tex(mat.emissive_texture_layer2)) : glm::vec3(1.0f);
+    float AO_tex_layer2 = (mat.AO_texture_layer2 >= 0) ? tex(mat.AO_texture_layer2).r : 1.0f;
+
+    glm::vec3 base_color_layer2 = glm::vec3(mat.base_color_factor_layer2) * glm::vec3(base_color_sample_layer2);
+    float alpha_layer2 = mat.base_color_factor_layer2.a * base_color_sample_layer2.a;
+    float metallic_layer2 = mat.metallic_factor_layer2 * metallic_roughness_sample_layer2.b;
+    float roughness_layer2 = std::max(0.1f, mat.roughness_factor_layer2 * metallic_roughness_sample_layer2.g);
+    glm::vec3 emission_layer2 = mat.emissive_factor_layer2 * emissive_tex_layer2;
+    float AO_layer2 = 1.0f + (AO_tex_layer2 - 1.0f) * mat.AO_strength_layer2;
+
+    // Normal: interpolated when the mesh has usable normals, geometric otherwise
+    glm::vec3 normal(0.0f);
+    glm::vec3 n0(0.0f), n1(0.0f), n2(0.0f);
+    if (inst.normals) {
+        n0 = inst.normals[index0];
+        n1 = inst.normals[index1];
+        n2 = inst.normals[index2];
+    }
+    if (glm::length(n0) < 0.001f || glm::length(n1) < 0.001f || glm::length(n2) < 0.001f) {
+        normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+    } else {
+        normal = glm::normalize(n0 * bary.x + n1 * bary.y + n2 * bary.z);
+    }
+
+    glm::vec3 world_normal = glm::normalize(transform_vector(inst.object_to_world, normal));
+    glm::vec3 geometric_normal = world_normal;
+
+    payload.front_face = true;
+    if (glm::dot(world_normal, ray.direction) > 0.0f) {
+        world_normal = -world_normal;
+        geometric_normal = -geometric_normal;
+        payload.front_face = false;
+    }
+
+    if (mat.normal_texture >= 0) {
+        glm::vec3 t0(1.0f, 0.0f, 0.0f), t1(1.0f, 0.0f, 0.0f), t2(1.0f, 0.0f, 0.0f);
+        if (inst.tangents) {
+            t0 = inst.tangents[index0];
+            t1 = inst.tangents[index1];
+            t2 = inst.tangents[index2];
+        }
+        glm::vec3 tangent = t0 * bary.x + t1 * bary.y + t2 * bary.z;
+        glm::vec3 world_tangent = transform_vector(inst.object_to_world, tangent);
+        world_tangent = world_tangent - glm::dot(world_tangent, world_normal) * world_normal;
+        // Zero tangents, or the default +X one lying along the normal, take any tangent-plane direction
+        if (glm::dot(world_tangent, world_tangent) < 1e-12f) {
+            glm::vec3 up = std::abs(world_normal.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+            world_tangent = glm::cross(up, world_normal);
+        }
+        world_tangent = glm::normalize(world_tangent);
+        float tangent_sign = inst.tangent_signs ? inst.tangent_signs[index0] : 1.0f;
+        glm::vec3 world_bitangent = glm::normalize(glm::cross(world_normal, world_tangent)) * tangent_sign;
+
+        glm::vec3 normal_map_sample = glm::vec3(tex(mat.normal_texture)) * 2.0f - 1.0f;
+        normal_map_sample.x *= mat.normal_scale;
+        normal_map_sample.y *= mat.normal_scale;
+
+        world_normal = glm::normalize(normal_map_sample.x * world_tangent + normal_map_sample.y * world_bitangent +
+                                      normal_map_sample.z * world_normal);
+    }
+
+    payload.position = ray.origin + ray.direction * hit.t;
+    payload.normal = world_normal;
+    payload.geometric_normal = geometric_normal;
+    payload.albedo = base_color;
+    payload.roughness = roughness;
+    payload.metallic = metallic;
+    payload.emission = emission;
+    payload.ao = AO;
+    payload.clearcoat = mat.clearcoat_factor;
+    payload.clearcoat_roughness = mat.clearcoat_roughness_factor;
+    payload.transmission = mat.transmission;
+    payload.ior = mat.ior;
+    payload.dispersion = mat.dispersion;
+    payload.new_eps = hit.t * 1e-4f + kEps;
+    payload.alpha_mode = mat.alpha_mode;
+    payload.alpha = alpha;
+
+    payload.albedo_layer2 = base_color_layer2;
+    payload.roughness_layer2 = roughness_layer2;
+    payload.metallic_layer2 = metallic_layer2;
+    payload.emission_layer2 = emission_layer2;
+    payload.ao_layer2 = AO_layer2;
+    payload.clearcoat_layer2 = mat.clearcoat_factor_layer2;
+    payload.clearcoat_roughness_layer2 = mat.clearcoat_roughness_factor_layer2;
+    payload.transmission_layer2 = mat.transmission_layer2;
+    payload.ior_layer2 = mat.ior_layer2;
+    payload.dispersion_layer2 = mat.dispersion_layer2;
+    payload.alpha_mode_layer2 = mat.alpha_mode_layer2;
+    payload.alpha_layer2 = alpha_layer2;
+
+    payload.thin = mat.thin;
+    payload.blend_factor = mat.blend_factor;
+    payload.layer_thickness = mat.layer_thickness;
+
+    payload.direct_light = glm::vec3(0.0f);
+    glm::vec3 view_dir = -glm::normalize(ray.direction);
+
+    // Cartoon outline from geometric and shading normals
+    if (settings.cartoon_enabled == 1) {
+        float edge_factor = 1.0f - std::abs(glm::dot(payload.geometric_normal, view_dir));
+        float interp_edge_factor = 1.0f - std::abs(glm::dot(payload.normal, view_dir));
+        edge_factor = std::max(edge_factor, interp_edge_factor * 0.7f);
+
+        float effective_threshold = glm::clamp(settings.outline_threshold, 0.5f, 0.95f);
+        float effective_width = glm::clamp(settings.outline_width, 0.01f, 0.1f);
+        float outline = smoothstep(effective_threshold - effective_width * 0.5f,
+                                   effective_threshold + effective_width * 0.5f, edge_factor);
+        payload.outline_factor = std::pow(outline, 0.7f);
+    } else {
+        payload.outline_factor = 0.0f;
+    }
+
+    LayerParams layer1{ payload.albedo, payload.roughness, payload.metallic, payload.ao,
+                        payload.clearcoat, payload.clearcoat_roughness };
+    MultiLayerParams multi{ layer1,
+                            { payload.albedo_layer2, payload.roughness_layer2, payload.metallic_layer2, payload.ao_layer2,
+                              payload.clearcoat_layer2, payload.clearcoat_roughness_layer2 },
+                            payload.thin, payload.blend_factor, payload.layer_thickness, payload.alpha_layer2 };
+    const MultiLayerParams* multi_ptr = payload.blend_factor > 0.0f ? &multi : nullptr;
+    for (const Light& light : *ctx.lights) {
+        payload.direct_light += EvaluateLightImpl(ctx, light, payload.position, payload.normal, payload.geometric_normal,
+                                                  view_dir, layer1, multi_ptr, payload.rng_state, ray_count);
+    }
+}
+
+// Runs the closest-hit or miss shader for the result of an intersection query
+void ShadeRay(const TraceContext& ctx, const CpuRay& ray, bool found, const CpuHit& hit, Payload& payload, uint64_t& ray_count) {
+    if (found) {
+        ClosestHitMain(ctx, ray, hit, payload, ray_count);
+    } else {
+        MissMain(ctx, ray, payload);
+    }
+}
+
+void TraceRay(const TraceContext& ctx, const CpuRay& ray, Payload& payload, uint64_t& ray_count) {
+    ++ray_count;
+    CpuHit hit;
+    bool found = IntersectScene(ctx, ray, &hit);
+    ShadeRay(ctx, ray, found, hit, payload, ray_count);
+}
+
+// ---------------------------------------------------------------------------
+// volume.hlsl
+// ---------------------------------------------------------------------------
+
+bool IntersectVolumeAabb(const CpuRay& ray, const glm::vec3& min_p, const glm::vec3& max_p, float& t_enter, float& t_exit) {
+    glm::vec3 inv_d(ray.direction.x != 0.0f ? 1.0f / ray.direction.x : 1e6f,
+                    ray.direction.y != 0.0f ? 1.0f / ray.direction.y : 1e6f,
+                    ray.direction.z != 0.0f ? 1.0f / ray.direction.z : 1e6f);
+    glm::vec3 t0 = (min_p - ray.origin) * inv_d;
+    glm::vec3 t1 = (max_p - ray.origin) * inv_d;
+    glm::vec3 t_small = glm::min(t0, t1);
+    glm::vec3 t_big = glm::max(t0, t1);
+    t_enter = std::max(std::max(t_small.x, t_small.y), t_small.z);
+    t_exit = std::min(std::min(t_big.x, t_big.y), t_big.z);
+    return (t_enter <= t_exit) && (t_exit > ray.t_min);
+}
+
+float Noise3(glm::vec3 p) {
+    p += glm::vec3(17.0f, 59.4f, 15.0f);
+    float n = glm::dot(p, glm::vec3(12.9898f, 78.233f, 37.719f));
+    return frac(std::sin(n) * 43758.5453f);
+}
+
+glm::vec3 sample_HG(const glm::vec3& w, float g, float u1, float u2) {
+    float cos_theta;
+    if (std::abs(g) < 1e-3f) {
+        cos_theta = 1.0f - 2.0f * u1;
+    } else {
+        float sqr_term = (1.0f - g * g) / (1.0f - g + 2.0f * g * u1);
+        cos_theta = (1.0f + g * g - sqr_term * sqr_term) / (2.0f * g);
+    }
+    float sin_theta = std::sqrt(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+    float phi = 2.0f * kPi * u2;
+
+    glm::vec3 b1 = std::abs(w.x) > 0.1f ? glm::normalize(glm::cross(glm::vec3(0, 1, 0), w))
+                                        : glm::normalize(glm::cross(glm::vec3(1, 0, 0), w));
+    glm::vec3 b2 = glm::cross(w, b1);
+    return sin_theta * std::cos(phi) * b1 + sin_theta * std::sin(phi) * b2 + cos_theta * w;
+}
+
+float phase_HG(float cos_theta, float g) {
+    float gg = g * g;
+    float denom = std::pow(std::max(1.0f + gg - 2.0f * g * cos_theta, 1e-6f), 1.5f);
+    return (1.0f - gg) / (4.0f * kPi * denom);
+}
+
+glm::vec3 EvaluateVolumeDirectLighting(const TraceContext& ctx, const glm::vec3& position, const glm::vec3& wo, float g,
+                                       uint32_t& rng_state, uint64_t& ray_count) {
+    glm::vec3 Ld(0.0f);
+    for (const Light& light : *ctx.lights) {
+        glm::vec3 light_dir(0.0f);
+        glm::vec3 radiance_light(0.0f);
+        float inv_pdf = 1.0f;
+        float pdf = 1.0f;
+        float max_distance = 1e9f;
+        glm::vec3 sampled_point(0.0f);
+
+        if (light.type == LIGHT_POINT) {
+            radiance_light = SamplePointLight(light, position, light_dir, inv_pdf);
+            pdf = 1.0f;
+            max_distance = glm::length(light.position - position);
+        } else if (light.type == LIGHT_SUN) {
+            radiance_light = SampleSunLight(light, light_dir, inv_pdf, rng_state);
+            pdf = 1.0f / std::max(inv_pdf, kEps);
+            max_distance = 1e9f;
+        } else if (light.type == LIGHT_AREA) {
+            radiance_light = SampleAreaLight(light, position, light_dir, inv_pdf, sampled_point, rng_state);
+            pdf = 1.0f / std::max(inv_pdf, kEps);
+            max_distance = glm::length(sampled_point - position);
+        }
+
+        if (pdf <= 0.0f) {
+            continue;
+        }
+
+        if (!CastShadowRay(ctx, position + light_dir * 1e-3f, light_dir, max_distance - 2e-3f, rng_state, ray_count)) {
+            float phase = phase_HG(glm::dot(light_dir, -wo), g);
+            Ld += radiance_light * phase / pdf;
+        }
+    }
+    return Ld;
+}
+
+float DensityAtPoint(const glm::vec3& p, const VolumeRegion& vol) {
+    glm::vec3 size = glm::max(vol.max_p - vol.min_p, glm::vec3(1e-3f));
+    glm::vec3 local = saturate((p - vol.min_p) / size);
+    float base = glm::mix(0.01f, 0.1f, 1.0f - local.z);
+    float noise = 0.8f + 0.4f * Noise3(p * 2.0f);
+    return saturate(base * noise);
+}
+
+bool SampleHomogeneousVolume(const TraceContext& ctx, CpuRay& ray, glm::vec3& throughput, uint32_t& rng_state,
+                             const VolumeRegion& vol, float hit_dist, glm::vec3& radiance, uint64_t& ray_count) {
+    if (vol.sigma_t <= 0.0f) {
+        return false;
+    }
+
+    float t_enter, t_exit;
+    if (!IntersectVolumeAabb(ray, vol.min_p, vol.max_p, t_enter, t_exit)) {
+        return false;
+    }
+    t_enter = std::max(t_enter, ray.t_min);
+    t_exit = std::min(t_exit, hit_dist);
+    if (t_enter >= t_exit) {
+        return false;
+    }
+
+    float segment_length = t_exit - t_enter;
+    float u = std::max(1e-6f, 1.0f - rand(rng_state));
+    float dist_sample = -std::log(u) / vol.sigma_t;
+
+    glm::vec3 albedo = vol.sigma_s / std::max(vol.sigma_t, 1e-6f);
+
+    float emission_length = dist_sample < segment_length ? dist_sample : segment_length;
+    if (vol.sigma_t > kEps) {
+        float transmittance_factor = 1.0f - std::exp(-vol.sigma_t * emission_length);
+        radiance += throughput * vol.emission * transmittance_factor / vol.sigma_t;
+    } else {
+        radiance += throughput * vol.emission * emission_length;
+    }
+
+    if (dist_sample < segment_length) {
+        throughput *= albedo;
+        glm::vec3 scatter_point = ray.origin + ray.direction * (t_enter + dist_sample);
+        glm::vec3 Ld = EvaluateVolumeDirectLighting(ctx, scatter_point, -ray.direction, vol.g, rng_state, ray_count);
+        radiance += throughput * Ld;
+        ray.origin = scatter_point;
+        float u1 = rand(rng_state);
+        float u2 = rand(rng_state);
+        ray.direction = sample_HG(ray.direction, vol.g, u1, u2);
+        ray.t_min = 1e-3f;
+        return true;
+    }
+    return false;
+}
+
+bool SampleInhomogeneousVolume(const TraceContext& ctx, CpuRay& ray, glm::vec3& throughput, uint32_t& rng_state,
+                               const VolumeRegion& vol, float hit_dist, glm::vec3& radiance, uint64_t& ray_count) {
+    float sigma_t_max = vol.sigma_t;
+    if (sigma_t_max <= 0.0f) {
+        return false;
+    }
+
+    float t_enter, t_exit;
+    if (!IntersectVolumeAabb(ray, vol.min_p, vol.max_p, t_enter, t_exit)) {
+        return false;
+    }
+    t_enter = std::max(t_enter, ray.t_min);
+    t_exit = std::min(t_exit, hit_dist);
+    if (t_enter >= t_exit) {
+        return false;
+    }
+
+    glm::vec3 albedo = vol.sigma_s / std::max(vol.sigma_t, 1e-6f);
+    float t = t_enter;
+    const int max_steps = 1024;
+
+    for (int step_index = 0; step_index < max_steps; ++step_index) {
+        float u = std::max(1e-6f, 1.0f - rand(rng_state));
+        float dist = -std::log(u) / sigma_t_max;
+        t += dist;
+
+        if (t >= t_exit) {
+            float t_mid = (t - dist + t_exit) * 0.5f;
+            float density_mid = DensityAtPoint(ray.origin + ray.direction * t_mid, vol);
+            float remaining_dist = t_exit - (t - dist);
+            radiance += throughput * vol.emission * density_mid * remaining_dist;
+            return false;
+        }
+
+        glm::vec3 pos = ray.origin + ray.direction * t;
+        float density = DensityAtPoint(pos, vol);
+        float sigma_t_local = density * sigma_t_max;
+
+        radiance += throughput * vol.emission * density * dist;
+
+        if (rand(rng_state) < (sigma_t_local / sigma_t_max)) {
+            throughput *= albedo;
+            glm::vec3 Ld = EvaluateVolumeDirectLighting(ctx, pos, -ray.direction, vol.g, rng_state, ray_count);
+            radiance += throughput * Ld;
+            ray.origin = pos;
+            float u1 = rand(rng_state);
+            float u2 = rand(rng_state);
+            ray.direction = sample_HG(ray.direction, vol.g, u1, u2);
+            ray.t_min = 1e-3f;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// shader.hlsl
+// ---------------------------------------------------------------------------
+
+glm::vec3 rgb_to_hsv(const glm::vec3& rgb) {
+    glm::vec4 K(0.0f, -1.0f / 3.0f, 2.0f / 3.0f, -1.0f);
+    glm::vec4 p = glm::mix(glm::vec4(rgb.b, rgb.g, K.w, K.z), glm::vec4(rgb.g, rgb.b, K.x, K.y), step(rgb.b, rgb.g));
+    glm::vec4 q = glm::mix(glm::vec4(p.x, p.y, p.w, rgb.r), glm::vec4(rgb.r, p.y, p.z, p.x), step(p.x, rgb.r));
+    float d = q.x - std::min(q.w, q.y);
+    float e = 1.0e-10f;
+    return glm::vec3(std::abs(q.z + (q.w - q.y) / (6.0f * d + e)), d / (q.x + e), q.x);
+}
+
+glm::vec3 hsv_to_rgb(const glm::vec3& hsv) {
+    glm::vec4 K(1.0f, 2.0f / 3.0f, 1.0f / 3.0f, 3.0f);
+    glm::vec3 p(std::abs(frac(hsv.x + K.x) * 6.0f - K.w),
+                std::abs(frac(hsv.x + K.y) * 6.0f - K.w),
+                std::abs(frac(hsv.x + K.z) * 6.0f - K.w));
+    return hsv.z * glm::mix(glm::vec3(K.x), glm::clamp(p - glm::vec3(K.x), 0.0f, 1.0f), hsv.y);
+}
+
+// First half of RayGenMain: seeds the RNG of pixel (x, y) and builds its camera ray.
+// frame_count is the pixel's accumulated sample count.
+CpuRay GeneratePrimaryRay(const TraceContext& ctx, int x, int y, int width, int height, int frame_count,
+                          uint32_t& rng_state_out) {
+    const CameraObject& camera = ctx.params->camera;
+
+    uint32_t rng_state = wang_hash(static_cast<uint32_t>(x + y * width) * 666u + 1919810u) ^
+                         wang_hash(static_cast<uint32_t>(frame_count) * 233u + 114514u);
+
+    float jitter_x = rand(rng_state);
+    float jitter_y = rand(rng_state);
+    glm::vec2 uv((x + jitter_x) / static_cast<float>(width), (y + jitter_y) / static_cast<float>(height));
+    uv.y = 1.0f - uv.y;
+    glm::vec2 d = uv * 2.0f - 1.0f;
+
+    glm::mat4 cam_to_world = camera.camera_to_world;
+    if (camera.enable_motion_blur) {
+        float t = rand(rng_state);
+        float time_factor = t * camera.shutter_speed;
+        cam_to_world = (1.0f - time_factor) * camera.camera_to_world + time_factor * camera.prev_camera_to_world;
+    }
+
+    glm::vec3 origin = glm::vec3(cam_to_world * glm::vec4(0, 0, 0, 1));
+    glm::vec4 target = camera.screen_to_camera * glm::vec4(d, 1, 1);
+    glm::vec3 direction = transform_vector(cam_to_world, glm::vec3(target));
+
+    glm::vec3 cam_forward = glm::normalize(transform_vector(cam_to_world, glm::vec3(0, 0, -1)));
+    glm::vec3 cam_right = glm::normalize(transform_vector(cam_to_world, glm::vec3(1, 0, 0)));
+    glm::vec3 cam_up = glm::normalize(transform_vector(cam_to_world, glm::vec3(0, 1, 0)));
+
+    glm::vec3 primary_dir = glm::normalize(direction);
+    glm::vec3 ray_origin = origin;
+
+    if (camera.aperture > 0.0f && camera.focus_distance > 0.0f) {
+        float u1 = rand(rng_state);
+        float u2 = rand(rng_state);
+        glm::vec2 lens = sample_concentric_disk(u1, u2) * camera.aperture;
+        float focus_t = camera.focus_distance / std::max(glm::dot(primary_dir, cam_forward), 1e-4f);
+        glm::vec3 focus_point = ray_origin + primary_dir * focus_t;
+        ray_origin += cam_right * lens.x + cam_up * lens.y;
+        primary_dir = glm::normalize(focus_point - ray_origin);
+    }
+
+    rng_state_out = rng_state;
+    return CpuRay{ ray_origin, kEps, primary_dir, 1e4f };
+}
+
+// Intersection of a primary ray traced ahead of time as part of a RayPacket8
+struct PrimaryHit {
+    bool found = false;
+    CpuHit hit;
+};
+
+// Rest of RayGenMain: follows the path started by the camera ray. When primary is given it
+// replaces the intersection query of the first bounce.
+glm::vec3 RayGenMain(const TraceContext& ctx, CpuRay ray, uint32_t rng_state, const PrimaryHit* primary,
+                     int32_t* entity_id, uint64_t& ray_count) {
+    const RenderSettings& settings = ctx.params->settings;
+
+    Payload payload;
+    glm::vec3 throughput(1.0f);
+    glm::vec3 radiance(0.0f);
+    payload.rng_state = rng_state;
+    payload.outline_factor = 0.0f;
+    payload.cone_width = 0.0f;
+    payload.cone_spread = ctx.cone_spread;
+    float first_hit_outline_factor = 0.0f;
+
+    int depth = 0;
+    int max_depth = std::max(settings.max_bounces, 1);
+
+    while (depth < max_depth) {
+        payload.hit = false;
+        if (depth == 0 && primary) {
+            ++ray_count;
+            ShadeRay(ctx, ray, primary->found, primary->hit, payload, ray_count);
+        } else {
+            TraceRay(ctx, ray, payload, ray_count);
+        }
+        rng_state = payload.rng_state;
+
+        if (depth == 0) {
+            *entity_id = payload.hit ? static_cast<int32_t>(payload.instance_id) : -1;
+            if (payload.hit) {
+                first_hit_outline_factor = payload.outline_factor;
+            }
+        }
+
+        float hit_dist = payload.hit ? glm::distance(ray.origin, payload.position) : 1e10f;
+        const VolumeRegion& vol = ctx.params->volume;
+
+        if (SampleInhomogeneousVolume(ctx, ray, throughput, rng_state, vol, hit_dist, radiance, ray_count)) {
+            depth++;
+            payload.rng_state = rng_state;
+            continue;
+        }
+        if (SampleHomogeneousVolume(ctx, ray, throughput, rng_state, vol, hit_dist, radiance, ray_count)) {
+            depth++;
+            payload.rng_state = rng_state;
+            continue;
+        }
+
+        if (!payload.hit) {
+            radiance += throughput * payload.emission;
+            break;
+        }
+
+        radiance += throughput * payload.emission;
+
+        glm::vec3 bounce_light = payload.direct_light;
+        if (depth > 0) {
+            bounce_light = glm::min(bounce_light, glm::vec3(10.0f));
+        }
+        radiance += throughput * bounce_light;
+
+        // Transmission
+        if (payload.transmission > 0.0f) {
+            if (rand(rng_state) < payload.transmission) {
+                glm::vec3 N = payload.normal;
+                glm::vec3 V = -glm::normalize(ray.direction);
+
+                float eta = payload.front_face ? (1.0f / payload.ior) : payload.ior;
+                float F0 = (1.0f - payload.ior) / (1.0f + payload.ior);
+                F0 = F0 * F0;
+                float F = F0 + (1.0f - F0) * std::pow(1.0f - glm::dot(N, V), 5.0f);
+
+                glm::vec3 I = ray.direction;
+                if (glm::length(refract(I, N, eta)) < 0.001f) {
+                    F = 1.0f;
+                }
+
+                if (rand(rng_state) < F) {
+                    ray.origin = payload.position + N * kEps;
+                    ray.direction = glm::normalize(reflect(I, N));
+                } else {
+                    float ior_to_use = payload.ior;
+                    glm::vec3 color_mask(1.0f);
+                    float weight_correction = 1.0f;
+
+                    if (payload.dispersion > 0.0f) {
+                        float r_channel = rand(rng_state);
+                        if (r_channel < 1.0f / 3.0f) {
+                            ior_to_use = payload.ior + payload.dispersion * 0.02f;
+                            color_mask = glm::vec3(1.0f, 0.0f, 0.0f);
+                        } else if (r_channel < 2.0f / 3.0f) {
+                            ior_to_use = payload.ior;
+                            color_mask = glm::vec3(0.0f, 1.0f, 0.0f);
+                        } else {
+                            ior_to_use = payload.ior - payload.dispersion * 0.02f;
+                            color_mask = glm::vec3(0.0f, 0.0f, 1.0f);
+                        }
+                        weight_correction = 3.0f;
+                    }
+                    float eta_disp = payload.front_face ? (1.0f / ior_to_use) : ior_to_use;
+                    glm::vec3 refract_dir = refract(I, N, eta_disp);
+                    if (glm::length(refract_dir) < 0.001f) {
+                        ray.origin = payload.position + N * kEps;
+                        ray.direction = glm::normalize(reflect(I, N));
+                    } else {
+                        ray.origin = payload.position - N * kEps;
+                        ray.direction = glm::normalize(refract_dir);
+                    }
+                    throughput *= payload.albedo;
+                    throughput *= color_mask * weight_correction;
+                }
+
+                throughput /= payload.transmission;
+
+                float p = saturate(std::max(throughput.x, std::max(throughput.y, throughput.z)));
+                p = glm::clamp(p, 0.05f, 0.95f);
+                if (rand(rng_state) > p) break;
+                throughput /= p;
+                depth += 1;
+                payload.rng_state = rng_state;
+                continue;
+            } else {
+                throughput /= (1.0f - payload.transmission);
+            }
+        }
+
+        // Alpha modes; like the shader, the payload RNG state is left untouched here
+        if (payload.alpha_mode == 2) {
+            if (rand(rng_state) > payload.alpha) {
+                ray.origin = payload.position + ray.direction * payload.new_eps;
+                depth += 1;
+                continue;
+            }
+        } else if (payload.alpha_mode == 1) {
+            if (payload.alpha < 0.5f) {
+                ray.origin = payload.position + ray.direction * payload.new_eps;
+                depth += 1;
+                continue;
+            }
+        }
+
+        glm::vec3 N = payload.normal;
+
+        float roughness_floor = (depth > 0) ? 0.1f : 0.0f;
+        float eff_roughness = std::max(payload.roughness, roughness_floor);
+        float eff_clearcoat_roughness = std::max(payload.clearcoat_roughness, roughness_floor);
+        float eff_roughness_layer2 = std::max(payload.roughness_layer2, roughness_floor);
+        float eff_clearcoat_roughness_layer2 = std::max(payload.clearcoat_roughness_layer2, roughness_floor);
+
+        float r1 = rand(rng_state);
+        float r2 = rand(rng_state);
+        float r3 = rand(rng_state);
+
+        glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+        glm::vec3 tangent = glm::normalize(glm::cross(up, N));
+        glm::vec3 bitangent = glm::cross(N, tangent);
+
+        glm::vec3 V = -glm::normalize(ray.direction);
+
+        glm::vec3 F0 = glm::mix(glm::vec3(0.04f), payload.albedo, payload.metallic);
+        glm::vec3 F = F_Schlick(F0, glm::dot(N, V));
+        float luminance = glm::dot(F, kLuminance);
+
+        float q_spec_base = glm::clamp(saturate(luminance), 0.05f, 0.95f);
+        float q_diff_base = 1.0f - q_spec_base;
+
+        float p_clearcoat = 0.0f;
+        if (payload.clearcoat > 0.0f) {
+            p_clearcoat = glm::clamp(payload.clearcoat * 0.5f, 0.0f, 0.5f);
+        }
+        float p_base = 1.0f - p_clearcoat;
+
+        glm::vec3 local_diff = sample_cosine_hemisphere(r1, r2);
+        glm::vec3 L_diff = glm::normalize(local_diff.x * tangent + local_diff.y * bitangent + local_diff.z * N);
+
+        float r4 = rand(rng_state);
+        float r5 = rand(rng_state);
+        glm::vec3 h_local = sample_GGX_half(r4, r5, eff_roughness);
+        glm::vec3 H_base = glm::normalize(h_local.x * tangent + h_local.y * bitangent + h_local.z * N);
+        glm::vec3 L_spec_base = glm::normalize(reflect(-V, H_base));
+
+        float r6 = rand(rng_state);
+        float r7 = rand(rng_state);
+        glm::vec3 h_local_cc = sample_GGX_half(r6, r7, eff_clearcoat_roughness);
+        glm::vec3 H_cc = glm::normalize(h_local_cc.x * tangent + h_local_cc.y * bitangent + h_local_cc.z * N);
+        glm::vec3 L_spec_cc = glm::normalize(reflect(-V, H_cc));
+
+        glm::vec3 next_dir;
+        if (r3 < p_clearcoat) {
+            next_dir = L_spec_cc;
+        } else {
+            float r3_base = (r3 - p_clearcoat) / std::max(kEps, p_base);
+            next_dir = r3_base < q_spec_base ? L_spec_base : L_diff;
+        }
+
+        float pdf_diff = std::max(glm::dot(N, next_dir), 0.0f) / kPi;
+        float pdf_spec_base = pdf_GGX_for_direction(N, V, next_dir, eff_roughness);
+        float pdf_spec_cc = 0.0f;
+        if (payload.clearcoat > 0.0f) {
+            pdf_spec_cc = pdf_GGX_for_direction(N, V, next_dir, eff_clearcoat_roughness);
+        }
+        float pdf_total = p_clearcoat * pdf_spec_cc + p_base * (q_spec_base * pdf_spec_base + q_diff_base * pdf_diff);
+
+        float cos_theta = glm::dot(N, next_dir);
+        if (cos_theta <= 0.0f) break;
+
+        glm::vec3 brdf;
+        if (payload.blend_factor > 0.0f) {
+            MultiLayerParams m{ { payload.albedo, eff_roughness, payload.metallic, payload.ao, payload.clearcoat, eff_clearcoat_roughness },
+                                { payload.albedo_layer2, eff_roughness_layer2, payload.metallic_layer2, payload.ao_layer2,
+                                  payload.clearcoat_layer2, eff_clearcoat_roughness_layer2 },
+                                payload.thin, payload.blend_factor, payload.layer_thickness, payload.alpha_layer2 };
+            brdf = eval_brdf_multi_layer(settings, N, next_dir, V, m);
+        } else {
+            brdf = eval_brdf(settings, N, next_dir, V, payload.albedo, eff_roughness, payload.metallic, payload.ao,
+                             payload.clearcoat, eff_clearcoat_roughness);
+        }
+
+        throughput *= brdf * cos_theta / std::max(kEps, pdf_total);
+
+        glm::vec3 offset_dir = glm::dot(next_dir, payload.geometric_normal) > 0 ? payload.geometric_normal : -payload.geometric_normal;
+        ray.origin = payload.position + offset_dir * 1e-4f;
+        ray.direction = next_dir;
+
+        float p = saturate(std::max(throughput.x, std::max(throughput.y, throughput.z)));
+        p = glm::clamp(p, 0.10f, 0.99f);
+
+        if (throughput.x > 1e4f || throughput.y > 1e4f || throughput.z > 1e4f) {
+            break;
+        }
+
+        if (rand(rng_state) > p) break;
+        throughput /= p;
+        depth += 1;
+
+        payload.rng_state = rng_state;
+    }
+
+    // Cartoon outline and saturation boost are applied before accumulation, as on the GPU
+    if (settings.cartoon_enabled == 1) {
+        if (first_hit_outline_factor > 0.0f) {
+            radiance = glm::mix(radiance, glm::vec3(0.0f), first_hit_outline_factor);
+        }
+        float luminance = glm::dot(radiance, kLuminance);
+        float brightness_factor = smoothstep(0.1f, 0.5f, luminance * settings.exposure);
+        float boost_factor = glm::mix(settings.saturation_boost_shadow, settings.saturation_boost_light, brightness_factor);
+        glm::vec3 hsv = rgb_to_hsv(radiance);
+        hsv.y = std::min(hsv.y * boost_factor, 1.0f);
+        radiance = hsv_to_rgb(hsv);
+    }
+
+    return radiance;
+}
+
+} // namespace
+
+void HostFilm::Resize(int new_width, int new_height) {
+    width = new_width;
+    height = new_height;
+    size_t pixel_count = static_cast<size_t>(width) * height;
+    accumulated_color.assign(pixel_count * 4, 0.0f);
+    accumulated_samples.assign(pixel_count, 0);
+    entity_ids.assign(pixel_count, -1);
+    sample_count = 0;
+}
+
+void HostFilm::Reset() {
+    std::fill(accumulated_color.begin(), accumulated_color.end(), 0.0f);
+    std::fill(accumulated_samples.begin(), accumulated_samples.end(), 0);
+    std::fill(entity_ids.begin(), entity_ids.end(), -1);
+    sample_count = 0;
+}
+
+CpuRenderer::CpuRenderer(const Scene* scene)
+    : scene_(scene) {
+    ray_counters_.resize(ThreadPool::Instance().GetWorkerCount());
+}
+
+CpuRenderStats CpuRenderer::Render(const CpuFrameParams& params, int passes, HostFilm* film) {
+    CpuRenderStats stats;
+    if (!film || film->width <= 0 || film->height <= 0 || passes <= 0) {
+        return stats;
+    }
+    const SceneBvh* bvh = scene_->GetCpuBvh();
+    if (!bvh) {
+        grassland::LogError("CPU renderer: scene has no CPU BVH, call Scene::BuildCpuAccelerationStructures() first");
+        return stats;
+    }
+
+    TraceContext ctx;
+    ctx.bvh = bvh;
+    ctx.lights = &scene_->GetLights();
+    ctx.textures = &scene_->GetHostTextures();
+    ctx.texture_mips = &scene_->GetTextureMipRanges();
+    ctx.skybox = &scene_->GetSkyboxHostTexture();
+    ctx.params = &params;
+    // Ray cone spread as in RayGenMain: the angle between vertically adjacent pixel rays
+    glm::vec3 center_dir = glm::normalize(glm::vec3(params.camera.screen_to_camera * glm::vec4(0, 0, 1, 1)));
+    glm::vec3 next_dir = glm::normalize(
+        glm::vec3(params.camera.screen_to_camera * glm::vec4(0, 2.0f / static_cast<float>(film->height), 1, 1)));
+    ctx.cone_spread = glm::length(glm::cross(center_dir, next_dir));
+
+    ThreadPool& pool = ThreadPool::Instance();
+    ray_counters_.resize(pool.GetWorkerCount());
+    for (RayCounter& counter : ray_counters_) {
+        counter.rays = 0;
+    }
+
+    const int width = film->width;
+    const int height = film->height;
+    const int tiles_x = (width + kTileSize - 1) / kTileSize;
+    const int tiles_y = (height + kTileSize - 1) / kTileSize;
+
+    auto start = std::chrono::steady_clock::now();
+    // Every pass of a pixel depends only on its own accumulated sample count, so a tile can run
+    // all passes back to back; tiles are balanced by the pool's work stealing.
+    pool.Run(static_cast<size_t>(tiles_x) * tiles_y, [&](size_t tile, unsigned worker) {
+        int x0 = static_cast<int>(tile % tiles_x) * kTileSize;
+        int y0 = static_cast<int>(tile / tiles_x) * kTileSize;
+        int x1 = std::min(x0 + kTileSize, width);
+        int y1 = std::min(y0 + kTileSize, height);
+        uint64_t ray_count = 0;
+        auto accumulate = [&](size_t pixel, const glm::vec3& radiance) {
+            float* color = &film->accumulated_color[pixel * 4];
+            color[0] += radiance.r;
+            color[1] += radiance.g;
+            color[2] += radiance.b;
+            color[3] += 1.0f;
+            film->accumulated_samples[pixel] += 1;
+        };
+        for (int pass = 0; pass < passes; ++pass) {
+            if (!packet_tracing_) {
+                for (int y = y0; y < y1; ++y) {
+                    for (int x = x0; x < x1; ++x) {
+                        size_t pixel = static_cast<size_t>(y) * width + x;
+                        uint32_t rng_state;
+                        CpuRay ray = GeneratePrimaryRay(ctx, x, y, width, height, film->accumulated_samples[pixel], rng_state);
+                        accumulate(pixel, RayGenMain(ctx, ray, rng_state, nullptr, &film->entity_ids[pixel], ray_count));
+                    }
+                }
+                continue;
+            }
+
+            // Camera rays of a 4x2 pixel block are coherent: trace them as one packet, then
+            // continue every path on its own
+            for (int by = y0; by < y1; by += kPacketHeight) {
+                for (int bx = x0; bx < x1; bx += kPacketWidth) {
+                    RayPacket8 packet;
+                    uint32_t rng_states[RayPacket8::kSize];
+                    size_t pixels[RayPacket8::kSize];
+                    for (int lane = 0; lane < RayPacket8::kSize; ++lane) {
+                        int x = bx + lane % kPacketWidth;
+                        int y = by + lane / kPacketWidth;
+                        if (x >= x1 || y >= y1) continue;
+                        pixels[lane] = static_cast<size_t>(y) * width + x;
+                        packet.SetRay(lane, GeneratePrimaryRay(ctx, x, y, width, height,
+                                                               film->accumulated_samples[pixels[lane]], rng_states[lane]));
+                    }
+                    CpuHit hits[RayPacket8::kSize];
+                    int hit_mask = ctx.bvh->IntersectClosest(packet, hits);
+                    for (int mask = packet.active_mask; mask; mask &= mask - 1) {
+                        int lane = simd::FirstLane(mask);
+                        PrimaryHit primary;
+                        primary.found = (hit_mask >> lane) & 1;
+                        primary.hit = hits[lane];
+                        accumulate(pixels[lane], RayGenMain(ctx, packet.GetRay(lane), rng_states[lane], &primary,
+                                                            &film->entity_ids[pixels[lane]], ray_count));
+                    }
+                }
+            }
+        }
+        ray_counters_[worker].rays += ray_count;
+    });
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const RayCounter& counter : ray_counters_) {
+        stats.rays += counter.rays;
+    }
+    film->sample_count += passes;
+
+    grassland::LogInfo("CPU renderer: {} pass(es) at {}x{} in {:.2f} s ({:.2f} Mrays/s)",
+                       passes, width, height, stats.seconds, stats.MegaRaysPerSecond());
+    return stats;
+}
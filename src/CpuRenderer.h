@@ -0,0 +1,67 @@
+#pragma once
+#include "long_march.h"
+#include "Scene.h"
+#include "RenderTypes.h"
+#include <cstdint>
+#include <vector>
+
+// Host-side accumulation buffers with the same layout as Film's images:
+// RGBA32F running radiance sum, R32_SINT per-pixel sample count and R32_SINT entity IDs.
+// The buffers can be handed to Film::UploadAccumulation / Film::DevelopPixels as-is.
+struct HostFilm {
+    int width = 0;
+    int height = 0;
+    int sample_count = 0; // Number of accumulated passes
+    std::vector<float> accumulated_color;
+    std::vector<int32_t> accumulated_samples;
+    std::vector<int32_t> entity_ids;
+
+    void Resize(int new_width, int new_height);
+    void Reset();
+};
+
+// Everything a pass needs besides the scene; mirrors the constant buffers bound to RayGenMain
+struct CpuFrameParams {
+    CameraObject camera;
+    RenderSettings settings;
+    SkyInfo sky;
+    VolumeRegion volume;
+};
+
+struct CpuRenderStats {
+    uint64_t rays = 0; // Closest-hit and shadow rays traced
+    double seconds = 0.0;
+
+    double MegaRaysPerSecond() const { return seconds > 0.0 ? static_cast<double>(rays) / seconds * 1e-6 : 0.0; }
+};
+
+// Multithreaded CPU reference path tracer.
+// Each pass is a line-by-line port of RayGenMain / ClosestHitMain / MissMain / AnyHitMain, so
+// images converge to the GPU result; the frame is split into tiles distributed over the
+// ThreadPool. Useful as a ground truth for shader changes and on machines without ray tracing.
+// Rays are traced against the scene's CPU BVH (Scene::BuildCpuAccelerationStructures).
+class CpuRenderer {
+public:
+    static constexpr int kTileSize = 16;
+    // Pixel block traced as one RayPacket8 in packet mode
+    static constexpr int kPacketWidth = 4;
+    static constexpr int kPacketHeight = 2;
+
+    explicit CpuRenderer(const Scene* scene);
+
+    // Accumulate `passes` samples per pixel into film (one pass == one DispatchRays of RayGenMain)
+    CpuRenderStats Render(const CpuFrameParams& params, int passes, HostFilm* film);
+
+    // Trace camera rays as 4x2 packets (on by default); the image is the same either way
+    void SetPacketTracing(bool enabled) { packet_tracing_ = enabled; }
+    bool GetPacketTracing() const { return packet_tracing_; }
+
+private:
+    struct alignas(64) RayCounter {
+        uint64_t rays = 0;
+    };
+
+    const Scene* scene_;
+    bool packet_tracing_ = true;
+    std::vector<RayCounter> ray_counters_;
+};
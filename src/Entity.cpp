@@ -1,11 +1,25 @@
 #include "Entity.h"
 
+std::vector<ShadingVertex> MakeShadingVertices(const grassland::Mesh<float>& mesh, const float* tangent_signs) {
+    std::vector<ShadingVertex> vertices(mesh.NumVertices());
+    const auto* normals = reinterpret_cast<const glm::vec3*>(mesh.Normals());
+    const auto* tangents = reinterpret_cast<const glm::vec3*>(mesh.Tangents());
+    const auto* texcoords = reinterpret_cast<const glm::vec2*>(mesh.TexCoords());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        vertices[i].normal = normals ? normals[i] : glm::vec3(0.0f, 0.0f, 0.0f);
+        vertices[i].tangent = tangents ? tangents[i] : glm::vec3(1.0f, 0.0f, 0.0f);
+        vertices[i].texcoord = texcoords ? texcoords[i] : glm::vec2(0.0f);
+        vertices[i].tangent_sign = tangent_signs ? tangent_signs[i] : 1.0f;
+    }
+    return vertices;
+}
+
 Entity::Entity(const std::string& obj_file_path, 
                const Material& material,
                const glm::mat4& transform)
-    : material_(material)
-    , transform_(transform)
-    , mesh_loaded_(false) {
+    : geometry_(std::make_shared<Geometry>())
+    , material_(material)
+    , transform_(transform) {
     
     LoadMesh(obj_file_path);
 }
@@ -13,101 +27,179 @@ Entity::Entity(const std::string& obj_file_path,
 Entity::Entity(const grassland::Mesh<float>& mesh,
                const Material& material,
                const glm::mat4& transform)
-    : mesh_(mesh)
+    : geometry_(std::make_shared<Geometry>())
+    , material_(material)
+    , transform_(transform) {
+    geometry_->mesh = mesh;
+    geometry_->loaded = true;
+}
+
+Entity::Entity(grassland::Mesh<float>&& mesh,
+               const Material& material,
+               const glm::mat4& transform)
+    : geometry_(std::make_shared<Geometry>())
     , material_(material)
-    , transform_(transform)
-    , mesh_loaded_(true) {
+    , transform_(transform) {
+    geometry_->mesh = std::move(mesh);
+    geometry_->loaded = true;
 }
 
-Entity::~Entity() {
-    blas_.reset();
-    index_buffer_.reset();
-    vertex_buffer_.reset();
-    normal_buffer_.reset();
-    tangent_buffer_.reset();
-    texcoord_buffer_.reset();
+Entity::Entity(std::shared_ptr<Geometry> geometry, const Material& material, const glm::mat4& transform)
+    : geometry_(std::move(geometry))
+    , material_(material)
+    , transform_(transform) {
+}
+
+Entity::~Entity() = default;
+
+std::shared_ptr<Entity> Entity::Instantiate(const Material& material, const glm::mat4& transform) const {
+    // make_shared cannot reach the private constructor
+    return std::shared_ptr<Entity>(new Entity(geometry_, material, transform));
 }
 
 bool Entity::LoadMesh(const std::string& obj_file_path) {
     // Try to load the OBJ file
     std::string full_path = grassland::FindAssetFile(obj_file_path);
     
-    if (mesh_.LoadObjFile(full_path) != 0) {
+    if (geometry_->mesh.LoadObjFile(full_path) != 0) {
         grassland::LogError("Failed to load mesh from: {}", obj_file_path);
-        mesh_loaded_ = false;
+        geometry_->loaded = false;
         return false;
     }
 
     grassland::LogInfo("Successfully loaded mesh: {} ({} vertices, {} indices)", 
-                       obj_file_path, mesh_.NumVertices(), mesh_.NumIndices());
+                       obj_file_path, geometry_->mesh.NumVertices(), geometry_->mesh.NumIndices());
     
-    mesh_loaded_ = true;
+    geometry_->loaded = true;
     return true;
 }
 
-void Entity::BuildBLAS(grassland::graphics::Core* core) {
-    if (!mesh_loaded_) {
+void Entity::BuildLods(size_t level_count) {
+    if (!geometry_->loaded || !geometry_->lods.empty()) {
+        return;
+    }
+    const float* tangent_signs = geometry_->tangent_signs.empty() ? nullptr : geometry_->tangent_signs.data();
+    std::vector<std::vector<float>> level_signs;
+    std::vector<grassland::Mesh<float>> levels = BuildLodChain(geometry_->mesh, level_count, tangent_signs, &level_signs);
+    for (size_t i = 0; i < levels.size(); ++i) {
+        auto level = std::make_shared<Geometry>();
+        level->mesh = std::move(levels[i]);
+        level->tangent_signs = std::move(level_signs[i]);
+        level->loaded = true;
+        geometry_->lods.push_back(std::move(level));
+    }
+}
+
+void Entity::BuildBLAS(grassland::graphics::Core* core, VertexLayout layout) {
+    if (!geometry_->loaded) {
         grassland::LogError("Cannot build BLAS: mesh not loaded");
         return;
     }
+    Geometry& geometry = Active();
+    if (geometry.blas) {
+        return; // Shared mesh, built for another instance
+    }
+    geometry.layout = layout;
 
     // Create vertex buffer
-    size_t vertex_buffer_size = mesh_.NumVertices() * sizeof(glm::vec3);
+    size_t vertex_buffer_size = geometry.mesh.NumVertices() * sizeof(glm::vec3);
     core->CreateBuffer(vertex_buffer_size, 
                       grassland::graphics::BUFFER_TYPE_DYNAMIC, 
-                      &vertex_buffer_);
-    vertex_buffer_->UploadData(mesh_.Positions(), vertex_buffer_size);
+                      &geometry.vertex_buffer);
+    geometry.vertex_buffer->UploadData(geometry.mesh.Positions(), vertex_buffer_size);
 
     // Create index buffer
-    size_t index_buffer_size = mesh_.NumIndices() * sizeof(uint32_t);
+    size_t index_buffer_size = geometry.mesh.NumIndices() * sizeof(uint32_t);
     core->CreateBuffer(index_buffer_size, 
                       grassland::graphics::BUFFER_TYPE_DYNAMIC, 
-                      &index_buffer_);
-    index_buffer_->UploadData(mesh_.Indices(), index_buffer_size);
+                      &geometry.index_buffer);
+    geometry.index_buffer->UploadData(geometry.mesh.Indices(), index_buffer_size);
 
-    // Create normal buffer
-    size_t normal_buffer_size = mesh_.NumVertices() * sizeof(glm::vec3);
-    core->CreateBuffer(normal_buffer_size, 
-                      grassland::graphics::BUFFER_TYPE_DYNAMIC, 
-                      &normal_buffer_);
-    if (mesh_.Normals()) {
-        normal_buffer_->UploadData(mesh_.Normals(), normal_buffer_size);
-    } else {
-        std::vector<glm::vec3> default_normals(mesh_.NumVertices(), glm::vec3(0.0f, 0.0f, 0.0f));
-        normal_buffer_->UploadData(default_normals.data(), normal_buffer_size);
-    }
+    geometry.format = VertexFormat();
+    geometry.format.stream_mask = GetVertexStreamMask(geometry.mesh);
 
-    // Create tangent buffer
-    size_t tangent_buffer_size = mesh_.NumVertices() * sizeof(glm::vec3);
-    core->CreateBuffer(tangent_buffer_size, 
-                      grassland::graphics::BUFFER_TYPE_DYNAMIC, 
-                      &tangent_buffer_);
-    if (mesh_.Tangents()) {
-        tangent_buffer_->UploadData(mesh_.Tangents(), tangent_buffer_size);
-    } else {
-        std::vector<glm::vec3> default_tangents(mesh_.NumVertices(), glm::vec3(1.0f, 0.0f, 0.0f));
-        tangent_buffer_->UploadData(default_tangents.data(), tangent_buffer_size);
+    // Absent streams are not uploaded: the shaders read VertexFormat::stream_mask and Scene binds
+    // its shared dummy buffer in their place. skipped_stream_bytes is what uploading defaults cost.
+    const size_t vertex_count = geometry.mesh.NumVertices();
+    const float* tangent_signs = geometry.tangent_signs.size() == vertex_count ? geometry.tangent_signs.data() : nullptr;
+    const uint32_t absent = ~geometry.format.stream_mask & (VERTEX_STREAM_NORMAL | VERTEX_STREAM_TANGENT | VERTEX_STREAM_TEXCOORD);
+    geometry.skipped_stream_count = 0;
+    geometry.skipped_stream_bytes = 0;
+    for (uint32_t stream = VERTEX_STREAM_NORMAL; stream <= VERTEX_STREAM_TEXCOORD; stream <<= 1) {
+        if (absent & stream) {
+            ++geometry.skipped_stream_count;
+            size_t bytes = stream == VERTEX_STREAM_TEXCOORD ? sizeof(glm::vec2)
+                         : stream == VERTEX_STREAM_TANGENT  ? sizeof(glm::vec4)
+                                                            : sizeof(glm::vec3);
+            geometry.skipped_stream_bytes += vertex_count * bytes;
+        }
     }
 
-    // Create texcoord buffer
-    size_t texcoord_buffer_size = mesh_.NumVertices() * sizeof(glm::vec2);
-    core->CreateBuffer(texcoord_buffer_size, 
-                      grassland::graphics::BUFFER_TYPE_DYNAMIC, 
-                      &texcoord_buffer_);
-    
-    if (mesh_.TexCoords()) {
-        texcoord_buffer_->UploadData(mesh_.TexCoords(), texcoord_buffer_size);
+    if (layout == VertexLayout::kQuantized) {
+        // Create packed attribute buffer; absent streams take no space
+        std::vector<uint32_t> packed = PackVertexStreams(geometry.mesh, tangent_signs, &geometry.format);
+        if (!packed.empty()) {
+            size_t packed_buffer_size = packed.size() * sizeof(uint32_t);
+            core->CreateBuffer(packed_buffer_size,
+                              grassland::graphics::BUFFER_TYPE_DYNAMIC,
+                              &geometry.packed_buffer);
+            geometry.packed_buffer->UploadData(packed.data(), packed_buffer_size);
+        }
+    } else if (layout == VertexLayout::kInterleaved) {
+        // Create interleaved attribute buffer; absent streams are default-filled inside the
+        // records, so only meshes with none of the streams go without it
+        if (geometry.format.stream_mask != 0) {
+            std::vector<ShadingVertex> attributes = MakeShadingVertices(geometry.mesh, tangent_signs);
+            size_t attribute_buffer_size = attributes.size() * sizeof(ShadingVertex);
+            core->CreateBuffer(attribute_buffer_size,
+                              grassland::graphics::BUFFER_TYPE_DYNAMIC,
+                              &geometry.attribute_buffer);
+            geometry.attribute_buffer->UploadData(attributes.data(), attribute_buffer_size);
+            geometry.skipped_stream_count = 0;
+            geometry.skipped_stream_bytes = 0;
+        } else {
+            geometry.skipped_stream_bytes = vertex_count * sizeof(ShadingVertex);
+        }
     } else {
-        std::vector<glm::vec2> default_uvs(mesh_.NumVertices(), glm::vec2(0.0f));
-        texcoord_buffer_->UploadData(default_uvs.data(), texcoord_buffer_size);
+        // Create normal buffer
+        if (geometry.mesh.Normals()) {
+            size_t normal_buffer_size = vertex_count * sizeof(glm::vec3);
+            core->CreateBuffer(normal_buffer_size,
+                              grassland::graphics::BUFFER_TYPE_DYNAMIC,
+                              &geometry.normal_buffer);
+            geometry.normal_buffer->UploadData(geometry.mesh.Normals(), normal_buffer_size);
+        }
+
+        // Create tangent buffer (xyz and the handedness in w, like glTF TANGENT)
+        if (geometry.mesh.Tangents()) {
+            const auto* tangents = reinterpret_cast<const glm::vec3*>(geometry.mesh.Tangents());
+            std::vector<glm::vec4> tangents_with_sign(vertex_count);
+            for (size_t i = 0; i < vertex_count; ++i) {
+                tangents_with_sign[i] = glm::vec4(tangents[i], tangent_signs ? tangent_signs[i] : 1.0f);
+            }
+            size_t tangent_buffer_size = vertex_count * sizeof(glm::vec4);
+            core->CreateBuffer(tangent_buffer_size,
+                              grassland::graphics::BUFFER_TYPE_DYNAMIC,
+                              &geometry.tangent_buffer);
+            geometry.tangent_buffer->UploadData(tangents_with_sign.data(), tangent_buffer_size);
+        }
+
+        // Create texcoord buffer
+        if (geometry.mesh.TexCoords()) {
+            size_t texcoord_buffer_size = vertex_count * sizeof(glm::vec2);
+            core->CreateBuffer(texcoord_buffer_size,
+                              grassland::graphics::BUFFER_TYPE_DYNAMIC,
+                              &geometry.texcoord_buffer);
+            geometry.texcoord_buffer->UploadData(geometry.mesh.TexCoords(), texcoord_buffer_size);
+        }
     }
 
     // Build BLAS
     core->CreateBottomLevelAccelerationStructure(
-        vertex_buffer_.get(), 
-        index_buffer_.get(), 
+        geometry.vertex_buffer.get(), 
+        geometry.index_buffer.get(), 
         sizeof(glm::vec3), 
-        &blas_);
+        &geometry.blas);
 
     grassland::LogInfo("Built BLAS for entity");
 }
@@ -1,6 +1,37 @@
 #pragma once
 #include "long_march.h"
 #include "Material.h"
+#include "MeshClusters.h"
+#include "MeshSimplification.h"
+#include "VertexQuantization.h"
+#include <algorithm>
+
+// GPU layout of an entity's vertex attributes
+enum class VertexLayout {
+    kSeparate,    // One buffer each for positions, normals, tangents and texcoords
+    kInterleaved, // Positions alone (BLAS input), normal/tangent/texcoord interleaved per vertex
+    kQuantized,   // Positions alone, the present streams encoded (VertexQuantization.h) and interleaved
+};
+
+// One vertex of the interleaved attribute buffer (ShadingVertex in common.hlsl); 36 bytes, so a
+// hit reads one record per corner instead of three streams
+struct ShadingVertex {
+    glm::vec3 normal;
+    glm::vec3 tangent;
+    glm::vec2 texcoord;
+    float tangent_sign; // Bitangent handedness
+};
+
+// Interleaves a mesh's normals, tangents (with tangent_signs, null when all +1) and texcoords,
+// filling missing streams with the defaults the shaders use for absent streams
+std::vector<ShadingVertex> MakeShadingVertices(const grassland::Mesh<float>& mesh, const float* tangent_signs = nullptr);
+
+// Receives transform changes of entities added to a Scene
+class TransformListener {
+public:
+    virtual ~TransformListener() = default;
+    virtual void OnTransformChanged(uint32_t instance_index) = 0;
+};
 
 // Entity represents a mesh instance with a material and transform
 class Entity {
@@ -13,43 +44,113 @@ public:
            const Material& material = Material(),
            const glm::mat4& transform = glm::mat4(1.0f));
 
+    // Takes over the mesh storage instead of copying it (scene loading builds meshes once)
+    Entity(grassland::Mesh<float>&& mesh,
+           const Material& material = Material(),
+           const glm::mat4& transform = glm::mat4(1.0f));
+
     ~Entity();
 
+    // New entity drawing this entity's mesh with its own material and transform. The mesh, its
+    // GPU buffers and its BLAS are shared, not copied (used for glTF nodes that reuse a mesh).
+    std::shared_ptr<Entity> Instantiate(const Material& material, const glm::mat4& transform) const;
+
     // Load mesh from OBJ file
     bool LoadMesh(const std::string& obj_file_path);
 
-    // Getters
-    grassland::graphics::Buffer* GetVertexBuffer() const { return vertex_buffer_.get(); }
-    grassland::graphics::Buffer* GetIndexBuffer() const { return index_buffer_.get(); }
-    grassland::graphics::Buffer* GetNormalBuffer() const { return normal_buffer_.get(); }
-    grassland::graphics::Buffer* GetTexcoordBuffer() const { return texcoord_buffer_.get(); }
-    grassland::graphics::Buffer* GetTangentBuffer() const { return tangent_buffer_.get(); }
+    // Getters (entities sharing a mesh return the same mesh, buffers and BLAS); they describe the
+    // selected LOD
+    grassland::graphics::Buffer* GetVertexBuffer() const { return Active().vertex_buffer.get(); }
+    grassland::graphics::Buffer* GetIndexBuffer() const { return Active().index_buffer.get(); }
+    grassland::graphics::Buffer* GetNormalBuffer() const { return Active().normal_buffer.get(); }
+    grassland::graphics::Buffer* GetTexcoordBuffer() const { return Active().texcoord_buffer.get(); }
+    grassland::graphics::Buffer* GetTangentBuffer() const { return Active().tangent_buffer.get(); }
+    grassland::graphics::Buffer* GetAttributeBuffer() const { return Active().attribute_buffer.get(); }
+    grassland::graphics::Buffer* GetPackedVertexBuffer() const { return Active().packed_buffer.get(); }
+    VertexLayout GetVertexLayout() const { return Active().layout; }
+    const VertexFormat& GetVertexFormat() const { return Active().format; }
+
+    // Absent attribute streams BuildBLAS did not upload, and the bytes default-filling them would
+    // have taken in the chosen layout
+    size_t GetSkippedStreamCount() const { return Active().skipped_stream_count; }
+    size_t GetSkippedStreamBytes() const { return Active().skipped_stream_bytes; }
     const Material& GetMaterial() const { return material_; }
     const glm::mat4& GetTransform() const { return transform_; }
-    grassland::graphics::AccelerationStructure* GetBLAS() const { return blas_.get(); }
+    grassland::graphics::AccelerationStructure* GetBLAS() const { return Active().blas.get(); }
+    const grassland::Mesh<float>& GetMesh() const { return Active().mesh; }
+
+    // Bitangent handedness (+1 or -1) per vertex of GetMesh(), empty when every sign is +1
+    // (grassland::Mesh keeps tangents as xyz). Set with the mesh, before BuildLods and BuildBLAS.
+    const std::vector<float>& GetTangentSigns() const { return Active().tangent_signs; }
+    void SetTangentSigns(std::vector<float> signs) { geometry_->tangent_signs = std::move(signs); }
+
+    // Clusters of the full-detail mesh, shared like the mesh; empty until BuildClusters
+    const MeshClusters& GetClusters() const { return geometry_->clusters; }
+    void BuildClusters(size_t max_triangles = kClusterTriangles) { geometry_->clusters = BuildMeshClusters(geometry_->mesh, max_triangles); }
+
+    // Simplified levels of the mesh (MeshSimplification.h), shared like the mesh. BuildLods is a
+    // no-op once the levels exist; level 0 is the mesh itself. SelectLod clamps to the levels
+    // built, and the getters above and BuildBLAS then use the selected level.
+    void BuildLods(size_t level_count);
+    size_t GetLodCount() const { return geometry_->lods.size() + 1; }
+    void SelectLod(size_t level) { lod_ = std::min(level, geometry_->lods.size()); }
+    size_t GetLod() const { return lod_; }
 
     // Setters
     void SetMaterial(const Material& material) { material_ = material; }
-    void SetTransform(const glm::mat4& transform) { transform_ = transform; }
+    void SetTransform(const glm::mat4& transform) {
+        transform_ = transform;
+        if (transform_listener_) transform_listener_->OnTransformChanged(instance_index_);
+    }
+
+    // Set by Scene::AddEntity so transform changes only update this entity's instance
+    void SetTransformListener(TransformListener* listener, uint32_t instance_index) {
+        transform_listener_ = listener;
+        instance_index_ = instance_index;
+    }
 
-    // Create BLAS for this entity's mesh
-    void BuildBLAS(grassland::graphics::Core* core);
+    // Create buffers and BLAS for this entity's mesh (no-op if an entity sharing the mesh already
+    // did). Buffers are only created for streams the mesh has: with VertexLayout::kSeparate one per
+    // present stream, with kInterleaved one attribute buffer and with kQuantized one packed buffer
+    // when any stream is present.
+    void BuildBLAS(grassland::graphics::Core* core, VertexLayout layout = VertexLayout::kSeparate);
 
     // Check if mesh is loaded
-    bool IsValid() const { return mesh_loaded_; }
+    bool IsValid() const { return geometry_->loaded; }
 
 private:
-    grassland::Mesh<float> mesh_;
+    // Mesh plus its GPU resources; shared by the entities Instantiate() creates
+    struct Geometry {
+        grassland::Mesh<float> mesh;
+        std::vector<float> tangent_signs;
+        bool loaded = false;
+        VertexLayout layout = VertexLayout::kSeparate;
+        VertexFormat format; // Stream mask is set for every layout, the packed fields for kQuantized
+        size_t skipped_stream_count = 0;
+        size_t skipped_stream_bytes = 0;
+        MeshClusters clusters;
+        std::vector<std::shared_ptr<Geometry>> lods; // Levels 1.., coarser each; on the level-0 geometry
+
+        std::unique_ptr<grassland::graphics::Buffer> vertex_buffer;
+        std::unique_ptr<grassland::graphics::Buffer> index_buffer;
+        std::unique_ptr<grassland::graphics::Buffer> normal_buffer;
+        std::unique_ptr<grassland::graphics::Buffer> tangent_buffer;
+        std::unique_ptr<grassland::graphics::Buffer> texcoord_buffer;
+        std::unique_ptr<grassland::graphics::Buffer> attribute_buffer; // VertexLayout::kInterleaved
+        std::unique_ptr<grassland::graphics::Buffer> packed_buffer;    // VertexLayout::kQuantized
+        std::unique_ptr<grassland::graphics::AccelerationStructure> blas; // Released before the buffers
+    };
+
+    Entity(std::shared_ptr<Geometry> geometry, const Material& material, const glm::mat4& transform);
+
+    Geometry& Active() const { return lod_ == 0 ? *geometry_ : *geometry_->lods[lod_ - 1]; }
+
+    std::shared_ptr<Geometry> geometry_;
+    size_t lod_ = 0;
     Material material_;
     glm::mat4 transform_;
 
-    std::unique_ptr<grassland::graphics::Buffer> vertex_buffer_;
-    std::unique_ptr<grassland::graphics::Buffer> index_buffer_;
-    std::unique_ptr<grassland::graphics::Buffer> normal_buffer_;
-    std::unique_ptr<grassland::graphics::Buffer> tangent_buffer_;
-    std::unique_ptr<grassland::graphics::Buffer> texcoord_buffer_;
-    std::unique_ptr<grassland::graphics::AccelerationStructure> blas_;
-
-    bool mesh_loaded_;
+    TransformListener* transform_listener_ = nullptr;
+    uint32_t instance_index_ = 0;
 };
 
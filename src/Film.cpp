@@ -1,4 +1,46 @@
 #include "Film.h"
+#include "AllocationCounter.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+namespace {
+// Deinterleave up to 8 RGBA pixels into per-channel registers (missing pixels read as black)
+void LoadPixels8(const float* rgba, int count, simd::Float8* r, simd::Float8* g, simd::Float8* b) {
+    alignas(32) float lanes[3][8] = {};
+    for (int i = 0; i < count; ++i) {
+        lanes[0][i] = rgba[i * 4 + 0];
+        lanes[1][i] = rgba[i * 4 + 1];
+        lanes[2][i] = rgba[i * 4 + 2];
+    }
+    *r = simd::Load(lanes[0]);
+    *g = simd::Load(lanes[1]);
+    *b = simd::Load(lanes[2]);
+}
+
+void StorePixels8(float* rgba, int count, simd::Float8 r, simd::Float8 g, simd::Float8 b) {
+    alignas(32) float lanes[3][8];
+    simd::Store(lanes[0], r);
+    simd::Store(lanes[1], g);
+    simd::Store(lanes[2], b);
+    for (int i = 0; i < count; ++i) {
+        rgba[i * 4 + 0] = lanes[0][i];
+        rgba[i * 4 + 1] = lanes[1][i];
+        rgba[i * 4 + 2] = lanes[2][i];
+        rgba[i * 4 + 3] = 1.0f;
+    }
+}
+
+// ACES filmic curve followed by the 1/2.2 display gamma
+simd::Float8 ToneMap(simd::Float8 x) {
+    using namespace simd;
+    const Float8 a = Broadcast(2.51f), b = Broadcast(0.03f), c = Broadcast(2.43f), d = Broadcast(0.59f), e = Broadcast(0.14f);
+    Float8 mapped = (x * (a * x + b)) / (x * (c * x + d) + e);
+    mapped = Min(Max(mapped, Broadcast(0.0f)), Broadcast(1.0f));
+    // pow(0, 1/2.2) is 0; Log2 is only valid for positive inputs
+    Float8 gamma = Exp2(Log2(mapped) * Broadcast(1.0f / 2.2f));
+    return Select(CmpLt(Broadcast(0.0f), mapped), gamma, Broadcast(0.0f));
+}
+} // namespace
 
 Film::Film(grassland::graphics::Core* core, int width, int height)
     : core_(core)
@@ -11,6 +53,7 @@ Film::Film(grassland::graphics::Core* core, int width, int height)
 }
 
 Film::~Film() {
+    reset_context_.reset();
     accumulated_color_image_.reset();
     accumulated_samples_image_.reset();
     output_image_.reset();
@@ -31,90 +74,114 @@ void Film::CreateImages() {
     core_->CreateImage(width_, height_, 
                       grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT,
                       &output_image_);
+
+    // Host staging for DevelopToOutput is sized with the images, so developing never allocates
+    accumulated_colors_.resize(static_cast<size_t>(width_) * height_ * 4);
+    output_colors_.resize(accumulated_colors_.size());
+
+    // Record the clears once per set of images; Reset runs on every camera move
+    reset_context_.reset();
+    core_->CreateCommandContext(&reset_context_);
+    reset_context_->CmdClearImage(accumulated_color_image_.get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
+    reset_context_->CmdClearImage(accumulated_samples_image_.get(), { {0, 0, 0, 0} });
+    reset_context_->CmdClearImage(output_image_.get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
 }
 
 void Film::Reset() {
     // Clear accumulated color to black
-    std::unique_ptr<grassland::graphics::CommandContext> cmd_context;
-    core_->CreateCommandContext(&cmd_context);
-    cmd_context->CmdClearImage(accumulated_color_image_.get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
-    cmd_context->CmdClearImage(accumulated_samples_image_.get(), { {0, 0, 0, 0} });
-    cmd_context->CmdClearImage(output_image_.get(), { {0.0f, 0.0f, 0.0f, 0.0f} });
-    core_->SubmitCommandContext(cmd_context.get());
+    core_->SubmitCommandContext(reset_context_.get());
     
     sample_count_ = 0;
     grassland::LogInfo("Film accumulation reset");
 }
 
 void Film::DevelopToOutput() {
-    // This would ideally be done in a compute shader for efficiency
-    // For now, we'll do it on the CPU (simple but potentially slow)
-    
     if (sample_count_ == 0) {
         return;
     }
 
-    // Download accumulated color and samples
-    size_t color_size = width_ * height_ * sizeof(float) * 4;
-    std::vector<float> accumulated_colors(width_ * height_ * 4);
-    accumulated_color_image_->DownloadData(accumulated_colors.data());
-
-    // Calculate average color and luminance for auto-exposure
-    std::vector<glm::vec3> linear_colors(width_ * height_);
-    float log_luminance_sum = 0.0f;
-    int valid_pixels = 0;
-
-    for (int i = 0; i < width_ * height_; i++) {
-        float r = accumulated_colors[i * 4 + 0] / static_cast<float>(sample_count_);
-        float g = accumulated_colors[i * 4 + 1] / static_cast<float>(sample_count_);
-        float b = accumulated_colors[i * 4 + 2] / static_cast<float>(sample_count_);
-        
-        linear_colors[i] = glm::vec3(r, g, b);
-        
-        float lum = 0.2126f * r + 0.7152f * g + 0.0722f * b;
-        if (lum > 0.0001f) {
-            log_luminance_sum += std::log(lum);
-            valid_pixels++;
+    allocation_counter::StagingScope staging;
+    accumulated_color_image_->DownloadData(accumulated_colors_.data());
+    DevelopPixels(accumulated_colors_.data(), width_ * height_, sample_count_, output_colors_.data());
+    output_image_->UploadData(output_colors_.data());
+}
+
+void Film::DevelopPixels(const float* accumulated_colors, int pixel_count, int sample_count, float* output_colors) {
+    if (sample_count <= 0 || pixel_count <= 0) {
+        return;
+    }
+    using namespace simd;
+    const float inv_samples = 1.0f / static_cast<float>(sample_count);
+
+    // Chunks are multiples of 8 pixels and capped in number so the partial sums fit on the stack
+    constexpr size_t kMaxChunks = 256;
+    constexpr size_t kMinChunkPixels = 4096;
+    size_t pixels = static_cast<size_t>(pixel_count);
+    size_t grain = std::max(kMinChunkPixels, ((pixels + kMaxChunks - 1) / kMaxChunks + 7) / 8 * 8);
+    size_t chunk_count = (pixels + grain - 1) / grain;
+
+    // Pass 1: log-average luminance for auto-exposure
+    double log2_sums[kMaxChunks];
+    double valid_counts[kMaxChunks];
+    ThreadPool::Instance().Run(chunk_count, [&](size_t chunk, unsigned) {
+        size_t begin = chunk * grain;
+        size_t end = std::min(pixels, begin + grain);
+        Float8 log2_sum = Broadcast(0.0f);
+        Float8 valid = Broadcast(0.0f);
+        for (size_t i = begin; i < end; i += 8) {
+            Float8 r, g, b;
+            LoadPixels8(accumulated_colors + i * 4, static_cast<int>(std::min<size_t>(8, end - i)), &r, &g, &b);
+            Float8 lum = (r * Broadcast(0.2126f) + g * Broadcast(0.7152f) + b * Broadcast(0.0722f)) * Broadcast(inv_samples);
+            Float8 mask = CmpLt(Broadcast(0.0001f), lum);
+            log2_sum = log2_sum + Select(mask, Log2(lum), Broadcast(0.0f));
+            valid = valid + Select(mask, Broadcast(1.0f), Broadcast(0.0f));
+        }
+        alignas(32) float sum_lanes[8], valid_lanes[8];
+        Store(sum_lanes, log2_sum);
+        Store(valid_lanes, valid);
+        log2_sums[chunk] = 0.0;
+        valid_counts[chunk] = 0.0;
+        for (int lane = 0; lane < 8; ++lane) {
+            log2_sums[chunk] += sum_lanes[lane];
+            valid_counts[chunk] += valid_lanes[lane];
         }
+    });
+
+    double log2_sum = 0.0, valid_pixels = 0.0;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        log2_sum += log2_sums[chunk];
+        valid_pixels += valid_counts[chunk];
     }
-    
+
     // Geometric mean of luminance
     float avg_luminance = 0.5f; // Default fallback
-    if (valid_pixels > 0) {
-        avg_luminance = std::exp(log_luminance_sum / valid_pixels);
+    if (valid_pixels > 0.0) {
+        avg_luminance = static_cast<float>(std::exp2(log2_sum / valid_pixels));
     }
-    
+
     // Target luminance (key value)
     float key_value = 0.18f;
     float exposure = key_value / std::max(avg_luminance, 0.0001f);
     exposure = glm::clamp(exposure, 0.1f, 2.0f);
 
-    // Apply tone mapping
-    std::vector<float> output_colors(width_ * height_ * 4);
-    for (int i = 0; i < width_ * height_; i++) {
-        glm::vec3 color = linear_colors[i] * exposure;
-        
-        // ACES Tone Mapping
-        float a = 2.51f;
-        float b = 0.03f;
-        float c = 2.43f;
-        float d = 0.59f;
-        float e = 0.14f;
-        color = glm::clamp((color * (a * color + b)) / (color * (c * color + d) + e), 0.0f, 1.0f);
-
-        // Gamma to sRGB-ish for display/export consistency
-        color.r = pow(color.r, 1.0f / 2.2f);
-        color.g = pow(color.g, 1.0f / 2.2f);
-        color.b = pow(color.b, 1.0f / 2.2f);
-        
-        output_colors[i * 4 + 0] = color.r;
-        output_colors[i * 4 + 1] = color.g;
-        output_colors[i * 4 + 2] = color.b;
-        output_colors[i * 4 + 3] = 1.0f;
-    }
+    // Pass 2: average, expose, ACES tone map and gamma in one sweep
+    const Float8 scale = Broadcast(inv_samples * exposure);
+    ThreadPool::Instance().Run(chunk_count, [&](size_t chunk, unsigned) {
+        size_t begin = chunk * grain;
+        size_t end = std::min(pixels, begin + grain);
+        for (size_t i = begin; i < end; i += 8) {
+            int count = static_cast<int>(std::min<size_t>(8, end - i));
+            Float8 r, g, b;
+            LoadPixels8(accumulated_colors + i * 4, count, &r, &g, &b);
+            StorePixels8(output_colors + i * 4, count, ToneMap(r * scale), ToneMap(g * scale), ToneMap(b * scale));
+        }
+    });
+}
 
-    // Upload to output image
-    output_image_->UploadData(output_colors.data());
+void Film::UploadAccumulation(const float* accumulated_colors, const int32_t* accumulated_samples, int sample_count) {
+    accumulated_color_image_->UploadData(accumulated_colors);
+    accumulated_samples_image_->UploadData(accumulated_samples);
+    sample_count_ = sample_count;
 }
 
 void Film::Resize(int width, int height) {
@@ -126,6 +193,7 @@ void Film::Resize(int width, int height) {
     height_ = height;
 
     // Recreate images with new dimensions
+    reset_context_.reset();
     accumulated_color_image_.reset();
     accumulated_samples_image_.reset();
     output_image_.reset();
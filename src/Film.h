@@ -29,6 +29,15 @@ public:
     // Convert accumulated data to final output image (divide by sample count)
     void DevelopToOutput();
 
+    // Tone map accumulated RGBA sums (sample_count samples per pixel) into display-ready RGBA.
+    // Shared by DevelopToOutput and the CPU renderer so both produce identical images.
+    // Runs on the ThreadPool with 8-wide SIMD: a log-luminance reduction, then one fused
+    // average/exposure/ACES/gamma pass. Does not allocate.
+    static void DevelopPixels(const float* accumulated_colors, int pixel_count, int sample_count, float* output_colors);
+
+    // Replace the accumulation images with host data (e.g. produced by the CPU renderer)
+    void UploadAccumulation(const float* accumulated_colors, const int32_t* accumulated_samples, int sample_count);
+
     // Resize the film (call when window resizes)
     void Resize(int width, int height);
 
@@ -50,6 +59,13 @@ private:
     // Final output image (accumulated_color / accumulated_samples)
     std::unique_ptr<grassland::graphics::Image> output_image_;
 
+    // Host staging for DevelopToOutput, sized with the images in CreateImages
+    std::vector<float> accumulated_colors_;
+    std::vector<float> output_colors_;
+
+    // Clears of the three images, recorded in CreateImages and replayed by Reset
+    std::unique_ptr<grassland::graphics::CommandContext> reset_context_;
+
     void CreateImages();
 };
 
@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+#include "long_march.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::string& path) {
+    Close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        grassland::LogError("Failed to open {} (error {})", path, GetLastError());
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        grassland::LogError("Cannot map empty or unreadable file {}", path);
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        grassland::LogError("Failed to map {} (error {})", path, GetLastError());
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    file_handle_ = file;
+    mapping_handle_ = mapping;
+    data_ = static_cast<const uint8_t*>(view);
+    size_ = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_handle_) CloseHandle(mapping_handle_);
+    if (file_handle_) CloseHandle(file_handle_);
+    data_ = nullptr;
+    size_ = 0;
+    mapping_handle_ = nullptr;
+    file_handle_ = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        grassland::LogError("Failed to open {}", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        grassland::LogError("Cannot map empty or unreadable file {}", path);
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (view == MAP_FAILED) {
+        grassland::LogError("Failed to map {}", path);
+        return false;
+    }
+    madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t*>(view);
+    size_ = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file (CreateFileMapping on Windows, mmap elsewhere).
+// Pages are faulted in from the page cache on first touch, so parsing a large file through
+// the mapping does not keep a second heap copy of it.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps the file, replacing any previous mapping. Returns false (and logs) on failure.
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return data_ != nullptr; }
+    const uint8_t* GetData() const { return data_; }
+    size_t GetSize() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#if defined(_WIN32)
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+};
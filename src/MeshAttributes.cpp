@@ -0,0 +1,137 @@
+#include "MeshAttributes.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+constexpr size_t kTriangleGrain = 4096;
+constexpr size_t kVertexGrain = 4096;
+
+bool ValidTriangle(const uint32_t* tri, size_t vertex_count) {
+    return tri[0] < vertex_count && tri[1] < vertex_count && tri[2] < vertex_count;
+}
+
+// Corners of the triangles around each vertex (CSR): corners[offsets[v], offsets[v + 1]) are
+// positions in the index buffer, ascending. Triangles with out-of-range indices are left out.
+struct VertexCorners {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> corners;
+};
+
+VertexCorners BuildVertexCorners(size_t vertex_count, const uint32_t* indices, size_t triangle_count) {
+    VertexCorners adjacency;
+    adjacency.offsets.assign(vertex_count + 1, 0);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        const uint32_t* tri = indices + t * 3;
+        if (!ValidTriangle(tri, vertex_count)) continue;
+        for (int k = 0; k < 3; ++k) ++adjacency.offsets[tri[k] + 1];
+    }
+    for (size_t v = 0; v < vertex_count; ++v) adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+    adjacency.corners.resize(adjacency.offsets[vertex_count]);
+    std::vector<uint32_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        const uint32_t* tri = indices + t * 3;
+        if (!ValidTriangle(tri, vertex_count)) continue;
+        for (int k = 0; k < 3; ++k) adjacency.corners[cursor[tri[k]]++] = static_cast<uint32_t>(t * 3 + k);
+    }
+    return adjacency;
+}
+
+glm::vec3 NormalizeOrZero(const glm::vec3& v) {
+    float length = glm::length(v);
+    return length > 1e-20f ? v / length : glm::vec3(0.0f);
+}
+
+// Angle between the edges leaving a corner
+float CornerAngle(const glm::vec3& corner, const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 ea = NormalizeOrZero(a - corner);
+    glm::vec3 eb = NormalizeOrZero(b - corner);
+    return std::acos(std::min(std::max(glm::dot(ea, eb), -1.0f), 1.0f));
+}
+
+// Some unit vector perpendicular to n (Duff et al. orthonormal basis)
+glm::vec3 AnyPerpendicular(const glm::vec3& n) {
+    float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+    float a = -1.0f / (sign + n.z);
+    return glm::vec3(1.0f + sign * n.x * n.x * a, sign * n.x * n.y * a, -sign * n.x);
+}
+} // namespace
+
+void GenerateSmoothNormals(size_t vertex_count, const uint32_t* indices, size_t index_count,
+                           const glm::vec3* positions, glm::vec3* normals) {
+    const size_t triangle_count = index_count / 3;
+    // The cross product's length is twice the triangle's area, so summing it weights by area
+    std::vector<glm::vec3> face_normals(triangle_count, glm::vec3(0.0f));
+    ParallelFor(0, triangle_count, kTriangleGrain, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const uint32_t* tri = indices + t * 3;
+            if (!ValidTriangle(tri, vertex_count)) continue;
+            const glm::vec3& p0 = positions[tri[0]];
+            face_normals[t] = glm::cross(positions[tri[1]] - p0, positions[tri[2]] - p0);
+        }
+    });
+
+    VertexCorners adjacency = BuildVertexCorners(vertex_count, indices, triangle_count);
+    ParallelFor(0, vertex_count, kVertexGrain, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            glm::vec3 sum(0.0f);
+            for (uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i) {
+                sum += face_normals[adjacency.corners[i] / 3];
+            }
+            normals[v] = NormalizeOrZero(sum);
+        }
+    });
+}
+
+void GenerateTangents(size_t vertex_count, const uint32_t* indices, size_t index_count,
+                      const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* texcoords,
+                      glm::vec3* tangents, float* signs) {
+    const size_t triangle_count = index_count / 3;
+    // Angle-weighted tangent and bitangent of every corner, in the corner normal's tangent plane
+    std::vector<glm::vec3> corner_tangents(triangle_count * 3, glm::vec3(0.0f));
+    std::vector<glm::vec3> corner_bitangents(triangle_count * 3, glm::vec3(0.0f));
+    ParallelFor(0, triangle_count, kTriangleGrain, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const uint32_t* tri = indices + t * 3;
+            if (!ValidTriangle(tri, vertex_count)) continue;
+            const glm::vec3 p[3] = { positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+            const glm::vec3 e1 = p[1] - p[0], e2 = p[2] - p[0];
+            const glm::vec2 d1 = texcoords[tri[1]] - texcoords[tri[0]];
+            const glm::vec2 d2 = texcoords[tri[2]] - texcoords[tri[0]];
+            // Twice the signed UV area; triangles without a UV gradient leave their corners zero
+            const float uv_area = d1.x * d2.y - d2.x * d1.y;
+            if (!(std::abs(uv_area) > 1e-20f)) continue;
+            const float orientation = uv_area > 0.0f ? 1.0f : -1.0f;
+            const glm::vec3 s = (e1 * d2.y - e2 * d1.y) * orientation;
+            const glm::vec3 b = (e2 * d1.x - e1 * d2.x) * orientation;
+            for (int k = 0; k < 3; ++k) {
+                const glm::vec3& n = normals[tri[k]];
+                float angle = CornerAngle(p[k], p[(k + 1) % 3], p[(k + 2) % 3]);
+                corner_tangents[t * 3 + k] = NormalizeOrZero(s - n * glm::dot(n, s)) * angle;
+                corner_bitangents[t * 3 + k] = NormalizeOrZero(b - n * glm::dot(n, b)) * angle;
+            }
+        }
+    });
+
+    VertexCorners adjacency = BuildVertexCorners(vertex_count, indices, triangle_count);
+    ParallelFor(0, vertex_count, kVertexGrain, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            glm::vec3 tangent_sum(0.0f), bitangent_sum(0.0f);
+            for (uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i) {
+                tangent_sum += corner_tangents[adjacency.corners[i]];
+                bitangent_sum += corner_bitangents[adjacency.corners[i]];
+            }
+            // Gram-Schmidt against the normal; vertices without a UV gradient get any tangent
+            // perpendicular to it so normal mapping stays well-defined
+            const glm::vec3& n = normals[v];
+            glm::vec3 tangent = NormalizeOrZero(tangent_sum - n * glm::dot(n, tangent_sum));
+            if (tangent == glm::vec3(0.0f)) {
+                tangent = glm::length(n) > 0.0f ? AnyPerpendicular(glm::normalize(n)) : glm::vec3(1.0f, 0.0f, 0.0f);
+            }
+            tangents[v] = tangent;
+            if (signs) signs[v] = glm::dot(glm::cross(n, tangent), bitangent_sum) < 0.0f ? -1.0f : 1.0f;
+        }
+    });
+}
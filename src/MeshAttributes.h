@@ -0,0 +1,24 @@
+#pragma once
+#include "long_march.h"
+#include <cstddef>
+#include <cstdint>
+
+// Load-time generation of the vertex attributes a mesh lacks. Each pass runs on the ThreadPool,
+// first per triangle and then per vertex. Called from inside a pool task it runs serially, so
+// callers can also spread many small meshes over the pool. Results do not depend on the thread
+// count: every vertex sums its triangles in index buffer order.
+
+// Area-weighted smooth normals: the normalized sum of the face normals of a vertex's triangles,
+// each weighted by the triangle's area. Vertices without a non-degenerate triangle get a zero
+// normal, which the shaders replace with the geometric normal.
+void GenerateSmoothNormals(size_t vertex_count, const uint32_t* indices, size_t index_count,
+                           const glm::vec3* positions, glm::vec3* normals);
+
+// MikkTSpace-style tangents: per triangle, the texcoord-gradient tangent is projected into the
+// tangent plane of each corner's normal and weighted by the corner angle. The weighted corners
+// are summed per vertex and orthonormalized against the vertex normal. Unlike MikkTSpace,
+// vertices are not split where their triangles disagree (e.g. on mirrored UV seams).
+// signs (optional) receives the bitangent handedness of each vertex.
+void GenerateTangents(size_t vertex_count, const uint32_t* indices, size_t index_count,
+                      const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* texcoords,
+                      glm::vec3* tangents, float* signs = nullptr);
@@ -0,0 +1,151 @@
+#include "MeshClusters.h"
+#include "Bvh.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr size_t kGrain = 4096;
+
+struct Range {
+    uint32_t begin;
+    uint32_t end;
+};
+
+class ClusterBuilder {
+public:
+    ClusterBuilder(const std::vector<glm::vec3>& centroids, std::vector<uint32_t>* triangles, size_t max_triangles)
+        : centroids_(centroids), triangles_(*triangles), max_triangles_(max_triangles) {}
+
+    bool IsLeaf(const Range& range) const { return range.end - range.begin <= max_triangles_; }
+
+    // Splits so that the left side holds half of the range's clusters, all of them full
+    void Split(const Range& range, Range* left, Range* right) {
+        Aabb bounds;
+        for (uint32_t i = range.begin; i < range.end; ++i) bounds.Grow(centroids_[triangles_[i]]);
+        glm::vec3 extent = bounds.max_p - bounds.min_p;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+        size_t cluster_count = (range.end - range.begin + max_triangles_ - 1) / max_triangles_;
+        uint32_t mid = range.begin + static_cast<uint32_t>(cluster_count / 2 * max_triangles_);
+        std::nth_element(triangles_.begin() + range.begin, triangles_.begin() + mid, triangles_.begin() + range.end,
+                         [&](uint32_t a, uint32_t b) { return centroids_[a][axis] < centroids_[b][axis]; });
+        *left = { range.begin, mid };
+        *right = { mid, range.end };
+    }
+
+    // Leaves under range, in triangle order
+    void SplitToLeaves(const Range& range, std::vector<Range>* leaves) {
+        if (IsLeaf(range)) {
+            leaves->push_back(range);
+            return;
+        }
+        Range left, right;
+        Split(range, &left, &right);
+        SplitToLeaves(left, leaves);
+        SplitToLeaves(right, leaves);
+    }
+
+private:
+    const std::vector<glm::vec3>& centroids_;
+    std::vector<uint32_t>& triangles_;
+    size_t max_triangles_;
+};
+} // namespace
+
+MeshClusters BuildMeshClusters(const grassland::Mesh<float>& mesh, size_t max_triangles) {
+    MeshClusters result;
+    max_triangles = std::max<size_t>(max_triangles, 1);
+    const auto* positions = reinterpret_cast<const glm::vec3*>(mesh.Positions());
+    const uint32_t* indices = mesh.Indices();
+    const size_t vertex_count = mesh.NumVertices();
+    const size_t triangle_count = mesh.NumIndices() / 3;
+
+    // Centroids and unit face normals; triangles with out-of-range indices are left out
+    std::vector<glm::vec3> centroids(triangle_count), normals(triangle_count);
+    std::vector<uint8_t> valid(triangle_count);
+    ParallelFor(0, triangle_count, kGrain, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const uint32_t* tri = indices + t * 3;
+            valid[t] = tri[0] < vertex_count && tri[1] < vertex_count && tri[2] < vertex_count;
+            if (!valid[t]) continue;
+            const glm::vec3 &p0 = positions[tri[0]], &p1 = positions[tri[1]], &p2 = positions[tri[2]];
+            centroids[t] = (p0 + p1 + p2) * (1.0f / 3.0f);
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(n);
+            normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+        }
+    });
+    result.triangles.reserve(triangle_count);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        if (valid[t]) result.triangles.push_back(static_cast<uint32_t>(t));
+    }
+    if (result.triangles.empty()) return result;
+
+    // Split serially until there is enough independent work, then finish the subtrees in parallel
+    ClusterBuilder builder(centroids, &result.triangles, max_triangles);
+    std::vector<Range> tops = { { 0, static_cast<uint32_t>(result.triangles.size()) } };
+    const size_t parallel_ranges = size_t(ThreadPool::Instance().GetWorkerCount()) * 4;
+    while (tops.size() < parallel_ranges) {
+        std::vector<Range> next;
+        bool split = false;
+        for (const Range& range : tops) {
+            if (builder.IsLeaf(range)) {
+                next.push_back(range);
+                continue;
+            }
+            Range left, right;
+            builder.Split(range, &left, &right);
+            next.push_back(left);
+            next.push_back(right);
+            split = true;
+        }
+        tops.swap(next);
+        if (!split) break;
+    }
+    std::vector<std::vector<Range>> leaves(tops.size());
+    ThreadPool::Instance().Run(tops.size(), [&](size_t i, unsigned) { builder.SplitToLeaves(tops[i], &leaves[i]); });
+
+    std::vector<Range> ranges;
+    for (const auto& list : leaves) ranges.insert(ranges.end(), list.begin(), list.end());
+    result.clusters.resize(ranges.size());
+    ParallelFor(0, ranges.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            MeshCluster& cluster = result.clusters[c];
+            const Range& range = ranges[c];
+            cluster.first_triangle = range.begin;
+            cluster.triangle_count = range.end - range.begin;
+
+            Aabb bounds;
+            glm::vec3 normal_sum(0.0f);
+            for (uint32_t i = range.begin; i < range.end; ++i) {
+                uint32_t t = result.triangles[i];
+                for (int k = 0; k < 3; ++k) bounds.Grow(positions[indices[t * 3 + k]]);
+                normal_sum += normals[t];
+            }
+            cluster.bounds_min = bounds.min_p;
+            cluster.bounds_max = bounds.max_p;
+            cluster.center = bounds.Center();
+            float radius_sq = 0.0f;
+            for (uint32_t i = range.begin; i < range.end; ++i) {
+                uint32_t t = result.triangles[i];
+                for (int k = 0; k < 3; ++k) {
+                    glm::vec3 d = positions[indices[t * 3 + k]] - cluster.center;
+                    radius_sq = std::max(radius_sq, glm::dot(d, d));
+                }
+            }
+            cluster.radius = std::sqrt(radius_sq);
+
+            // The cone holds every non-degenerate normal; past 90 degrees it can never cull
+            float axis_length = glm::length(normal_sum);
+            cluster.cone_axis = axis_length > 0.0f ? normal_sum / axis_length : glm::vec3(0.0f, 0.0f, 1.0f);
+            float min_dot = axis_length > 0.0f ? 1.0f : -1.0f;
+            for (uint32_t i = range.begin; i < range.end; ++i) {
+                const glm::vec3& n = normals[result.triangles[i]];
+                if (n != glm::vec3(0.0f)) min_dot = std::min(min_dot, glm::dot(n, cluster.cone_axis));
+            }
+            cluster.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(std::max(0.0f, 1.0f - min_dot * min_dot));
+        }
+    });
+    return result;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "long_march.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Spatially coherent clusters of about kClusterTriangles triangles (meshlets), so culling, LOD
+// selection and paging can work below mesh granularity. Everything is in object space.
+constexpr size_t kClusterTriangles = 128;
+
+// 64 bytes, laid out for a structured buffer
+struct MeshCluster {
+    glm::vec3 bounds_min;
+    uint32_t first_triangle; // Into MeshClusters::triangles
+    glm::vec3 bounds_max;
+    uint32_t triangle_count;
+    glm::vec3 center;        // Bounding sphere
+    float radius;
+    glm::vec3 cone_axis;     // Normal cone: average triangle normal
+    float cone_cutoff;       // Sine of the cone's half angle; 1 when the normals span a half space or more
+};
+
+struct MeshClusters {
+    std::vector<MeshCluster> clusters;
+    std::vector<uint32_t> triangles; // Triangle indices of the mesh, grouped by cluster
+
+    bool IsEmpty() const { return clusters.empty(); }
+};
+
+// Splits the mesh's triangles at the median of the longest axis of their centroids until every
+// cluster has at most max_triangles, keeping all but the last cluster of each split full. The
+// top of the split runs serially, the subtrees and the cluster bounds on the ThreadPool.
+MeshClusters BuildMeshClusters(const grassland::Mesh<float>& mesh, size_t max_triangles = kClusterTriangles);
+
+// True when every triangle of the cluster faces away from view_point (normal cone test)
+inline bool IsClusterBackfacing(const MeshCluster& cluster, const glm::vec3& view_point) {
+    glm::vec3 to_center = cluster.center - view_point;
+    return glm::dot(to_center, cluster.cone_axis) >= cluster.cone_cutoff * glm::length(to_center) + cluster.radius;
+}
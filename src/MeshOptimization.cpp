@@ -0,0 +1,165 @@
+#include "MeshOptimization.h"
+#include "Bvh.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+constexpr size_t kGrain = 4096;
+constexpr uint32_t kNone = ~0u;
+
+// Bit patterns of every stream of a vertex. Adding 0.0f turns -0.0f into +0.0f so the two weld.
+struct VertexKey {
+    uint32_t bits[12] = {};
+};
+
+void StoreBits(float value, uint32_t* bits) {
+    value += 0.0f;
+    std::memcpy(bits, &value, sizeof(value));
+}
+
+uint64_t HashKey(const VertexKey& key) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t word : key.bits) {
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash ^ (hash >> 29);
+}
+
+// Spreads the low 10 bits of v so that two zero bits separate each of them
+uint32_t ExpandBits(uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// 30-bit Morton code of a point inside bounds
+uint32_t MortonCode(const glm::vec3& p, const Aabb& bounds) {
+    glm::vec3 extent = bounds.max_p - bounds.min_p;
+    uint32_t code = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t = extent[axis] > 0.0f ? (p[axis] - bounds.min_p[axis]) / extent[axis] : 0.0f;
+        uint32_t cell = static_cast<uint32_t>(std::min(std::max(t * 1024.0f, 0.0f), 1023.0f));
+        code |= ExpandBits(cell) << (2 - axis);
+    }
+    return code;
+}
+} // namespace
+
+grassland::Mesh<float> OptimizeMeshLocality(size_t vertex_count, const uint32_t* indices, size_t index_count,
+                                            const glm::vec3* positions, const glm::vec3* normals,
+                                            const glm::vec2* texcoords, const glm::vec3* tangents,
+                                            MeshOptimizationStats* stats, const float* tangent_signs,
+                                            std::vector<float>* out_tangent_signs) {
+    // 1. Weld: an open-addressing table keeps the first vertex of every distinct key
+    std::vector<VertexKey> keys(vertex_count);
+    std::vector<uint64_t> hashes(vertex_count);
+    ParallelFor(0, vertex_count, kGrain, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t* bits = keys[v].bits;
+            for (int c = 0; c < 3; ++c) StoreBits(positions[v][c], bits + c);
+            if (normals) for (int c = 0; c < 3; ++c) StoreBits(normals[v][c], bits + 3 + c);
+            if (tangents) for (int c = 0; c < 3; ++c) StoreBits(tangents[v][c], bits + 6 + c);
+            if (texcoords) for (int c = 0; c < 2; ++c) StoreBits(texcoords[v][c], bits + 9 + c);
+            if (tangent_signs) StoreBits(tangent_signs[v], bits + 11);
+            hashes[v] = HashKey(keys[v]);
+        }
+    });
+    size_t capacity = 16;
+    while (capacity < vertex_count * 2) capacity <<= 1;
+    std::vector<uint32_t> table(capacity, kNone);
+    std::vector<uint32_t> weld(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        size_t slot = hashes[v] & (capacity - 1);
+        while (table[slot] != kNone &&
+               (hashes[table[slot]] != hashes[v] || std::memcmp(&keys[table[slot]], &keys[v], sizeof(VertexKey)) != 0)) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == kNone) table[slot] = static_cast<uint32_t>(v);
+        weld[v] = table[slot];
+    }
+    std::vector<VertexKey>().swap(keys);
+
+    // 2. Remap the triangles, dropping the degenerate and out-of-range ones
+    std::vector<uint32_t> welded;
+    welded.reserve(index_count - index_count % 3);
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
+        if (indices[i] >= vertex_count || indices[i + 1] >= vertex_count || indices[i + 2] >= vertex_count) continue;
+        uint32_t a = weld[indices[i]], b = weld[indices[i + 1]], c = weld[indices[i + 2]];
+        if (a == b || b == c || a == c) continue;
+        welded.push_back(a);
+        welded.push_back(b);
+        welded.push_back(c);
+    }
+    const size_t triangle_count = welded.size() / 3;
+
+    // 3. Sort the triangles by the Morton code of their centroids
+    Aabb bounds;
+    for (size_t v = 0; v < vertex_count; ++v) bounds.Grow(positions[v]);
+    std::vector<uint64_t> order(triangle_count);
+    ParallelFor(0, triangle_count, kGrain, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const uint32_t* tri = welded.data() + t * 3;
+            glm::vec3 centroid = (positions[tri[0]] + positions[tri[1]] + positions[tri[2]]) * (1.0f / 3.0f);
+            order[t] = (uint64_t(MortonCode(centroid, bounds)) << 32) | t;
+        }
+    });
+    std::sort(order.begin(), order.end());
+
+    // 4. Number the vertices in order of first use
+    std::vector<uint32_t> new_index(vertex_count, kNone);
+    std::vector<uint32_t> source_vertex;
+    std::vector<uint32_t> out_indices(triangle_count * 3);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        const uint32_t* tri = welded.data() + (order[t] & 0xFFFFFFFFu) * 3;
+        for (int k = 0; k < 3; ++k) {
+            if (new_index[tri[k]] == kNone) {
+                new_index[tri[k]] = static_cast<uint32_t>(source_vertex.size());
+                source_vertex.push_back(tri[k]);
+            }
+            out_indices[t * 3 + k] = new_index[tri[k]];
+        }
+    }
+
+    const size_t out_count = source_vertex.size();
+    std::vector<grassland::Vector3<float>> out_positions(out_count), out_normals(normals ? out_count : 0),
+        out_tangents(tangents ? out_count : 0);
+    std::vector<grassland::Vector2<float>> out_texcoords(texcoords ? out_count : 0);
+    ParallelFor(0, out_count, kGrain, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t src = source_vertex[v];
+            std::memcpy(static_cast<void*>(&out_positions[v]), &positions[src], sizeof(glm::vec3));
+            if (normals) std::memcpy(static_cast<void*>(&out_normals[v]), &normals[src], sizeof(glm::vec3));
+            if (tangents) std::memcpy(static_cast<void*>(&out_tangents[v]), &tangents[src], sizeof(glm::vec3));
+            if (texcoords) std::memcpy(static_cast<void*>(&out_texcoords[v]), &texcoords[src], sizeof(glm::vec2));
+        }
+    });
+
+    if (out_tangent_signs) {
+        out_tangent_signs->clear();
+        if (tangent_signs) {
+            out_tangent_signs->resize(out_count);
+            for (size_t v = 0; v < out_count; ++v) (*out_tangent_signs)[v] = tangent_signs[source_vertex[v]];
+        }
+    }
+    if (stats) {
+        stats->vertices_before = vertex_count;
+        stats->vertices_after = out_count;
+        stats->triangles_before = index_count / 3;
+        stats->triangles_after = triangle_count;
+    }
+    return grassland::Mesh<float>(out_count, out_indices.size(), out_indices.data(), out_positions.data(),
+                                  normals ? out_normals.data() : nullptr, texcoords ? out_texcoords.data() : nullptr,
+                                  tangents ? out_tangents.data() : nullptr);
+}
+
+grassland::Mesh<float> OptimizeMeshLocality(const grassland::Mesh<float>& mesh, MeshOptimizationStats* stats) {
+    return OptimizeMeshLocality(mesh.NumVertices(), mesh.Indices(), mesh.NumIndices(),
+                                reinterpret_cast<const glm::vec3*>(mesh.Positions()),
+                                reinterpret_cast<const glm::vec3*>(mesh.Normals()),
+                                reinterpret_cast<const glm::vec2*>(mesh.TexCoords()),
+                                reinterpret_cast<const glm::vec3*>(mesh.Tangents()), stats);
+}
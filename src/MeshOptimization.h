@@ -0,0 +1,31 @@
+#pragma once
+#include "long_march.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Locality pass over a mesh, for meshes whose index order is whatever the exporter wrote:
+//   1. welds vertices whose position, normal, texcoord, tangent and tangent sign are all identical;
+//   2. drops triangles that welding made degenerate;
+//   3. orders triangles along the Morton curve of their centroids;
+//   4. renumbers vertices in order of first use, dropping unused ones.
+// Neighbouring triangles then share cache lines in the index and vertex arrays, for both ray
+// hits and BVH builds.
+struct MeshOptimizationStats {
+    size_t vertices_before = 0;
+    size_t vertices_after = 0;
+    size_t triangles_before = 0;
+    size_t triangles_after = 0;
+};
+
+// Stream views of a mesh; normals, texcoords and tangents may be null and stay absent.
+// tangent_signs (the bitangent handedness per vertex, null when all +1) follows the vertices into
+// *out_tangent_signs.
+grassland::Mesh<float> OptimizeMeshLocality(size_t vertex_count, const uint32_t* indices, size_t index_count,
+                                            const glm::vec3* positions, const glm::vec3* normals,
+                                            const glm::vec2* texcoords, const glm::vec3* tangents,
+                                            MeshOptimizationStats* stats = nullptr,
+                                            const float* tangent_signs = nullptr,
+                                            std::vector<float>* out_tangent_signs = nullptr);
+
+grassland::Mesh<float> OptimizeMeshLocality(const grassland::Mesh<float>& mesh, MeshOptimizationStats* stats = nullptr);
@@ -0,0 +1,370 @@
+#include "MeshSimplification.h"
+#include "MeshClusters.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+
+namespace {
+constexpr size_t kChunkTriangles = 32768; // Smallest chunk worth its own task
+constexpr uint32_t kNone = ~0u;
+
+// Symmetric 4x4 quadric, upper triangle: xx xy xz xw yy yz yw zz zw ww
+struct Quadric {
+    double a[10] = {};
+
+    // weight * (dot(n, p) + d)^2
+    void AddPlane(const glm::vec3& n, double d, double weight) {
+        double x = n.x, y = n.y, z = n.z;
+        a[0] += weight * x * x; a[1] += weight * x * y; a[2] += weight * x * z; a[3] += weight * x * d;
+        a[4] += weight * y * y; a[5] += weight * y * z; a[6] += weight * y * d;
+        a[7] += weight * z * z; a[8] += weight * z * d;
+        a[9] += weight * d * d;
+    }
+
+    void Add(const Quadric& other) {
+        for (int i = 0; i < 10; ++i) a[i] += other.a[i];
+    }
+
+    double Error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x +
+                   a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y +
+                   a[7] * z * z + 2.0 * a[8] * z + a[9];
+        return std::max(e, 0.0);
+    }
+};
+
+// Vertices that must not move: open-border and non-manifold edges, and attribute seams. Both are
+// found on the position-welded topology, so vertices split for their attributes count as one.
+std::vector<uint8_t> FindLockedVertices(const glm::vec3* positions, size_t vertex_count, const uint32_t* indices,
+                                        size_t triangle_count) {
+    // Position group of every vertex (open addressing over the position bits, -0 == +0)
+    auto bits_of = [&](uint32_t v, uint32_t* bits) {
+        for (int c = 0; c < 3; ++c) {
+            float value = positions[v][c] + 0.0f;
+            std::memcpy(&bits[c], &value, sizeof(float));
+        }
+    };
+    size_t capacity = 16;
+    while (capacity < vertex_count * 2) capacity <<= 1;
+    std::vector<uint32_t> table(capacity, kNone);
+    std::vector<uint32_t> group(vertex_count);
+    std::vector<uint32_t> group_size(vertex_count, 0);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        uint32_t bits[3], other[3];
+        bits_of(static_cast<uint32_t>(v), bits);
+        uint64_t hash = (uint64_t(bits[0]) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(bits[1]) * 0xC2B2AE3D27D4EB4Full) ^
+                        (uint64_t(bits[2]) * 0x165667B19E3779F9ull);
+        size_t slot = (hash ^ (hash >> 31)) & (capacity - 1);
+        while (table[slot] != kNone) {
+            bits_of(table[slot], other);
+            if (std::memcmp(bits, other, sizeof(bits)) == 0) break;
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == kNone) table[slot] = static_cast<uint32_t>(v);
+        group[v] = table[slot];
+        ++group_size[group[v]];
+    }
+
+    // Edges used by exactly two triangles are interior; everything else is a border
+    std::vector<uint64_t> edges;
+    edges.reserve(triangle_count * 3);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        const uint32_t* tri = indices + t * 3;
+        if (tri[0] >= vertex_count || tri[1] >= vertex_count || tri[2] >= vertex_count) continue;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t a = group[tri[k]], b = group[tri[(k + 1) % 3]];
+            if (a != b) edges.push_back((uint64_t(std::min(a, b)) << 32) | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    std::vector<uint8_t> border_group(vertex_count, 0);
+    for (size_t i = 0; i < edges.size();) {
+        size_t run = i + 1;
+        while (run < edges.size() && edges[run] == edges[i]) ++run;
+        if (run - i != 2) {
+            border_group[edges[i] >> 32] = 1;
+            border_group[edges[i] & 0xFFFFFFFFu] = 1;
+        }
+        i = run;
+    }
+
+    std::vector<uint8_t> locked(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        locked[v] = group_size[group[v]] > 1 || border_group[group[v]];
+    }
+    return locked;
+}
+
+// Collapses edges of the triangles in *indices (global vertex indices) until about target
+// triangles remain. Only unlocked vertices move. Returns the largest collapse error.
+float CollapseEdges(const glm::vec3* positions, const std::vector<uint8_t>& locked, std::vector<uint32_t>* indices,
+                    size_t target) {
+    // Local numbering of the chunk's vertices
+    std::vector<uint32_t> vertices(indices->begin(), indices->end());
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+    const size_t n = vertices.size();
+    const size_t triangle_count = indices->size() / 3;
+    std::vector<uint32_t> tris(indices->size());
+    for (size_t i = 0; i < tris.size(); ++i) {
+        tris[i] = static_cast<uint32_t>(std::lower_bound(vertices.begin(), vertices.end(), (*indices)[i]) - vertices.begin());
+    }
+    std::vector<glm::vec3> p(n);
+    std::vector<uint8_t> fixed(n);
+    for (size_t v = 0; v < n; ++v) {
+        p[v] = positions[vertices[v]];
+        fixed[v] = locked[vertices[v]];
+    }
+
+    // Area-weighted plane quadrics and the triangles around every vertex
+    std::vector<Quadric> quadrics(n);
+    std::vector<std::vector<uint32_t>> vertex_tris(n);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        const uint32_t* tri = tris.data() + t * 3;
+        glm::vec3 normal = glm::cross(p[tri[1]] - p[tri[0]], p[tri[2]] - p[tri[0]]);
+        float length = glm::length(normal);
+        for (int k = 0; k < 3; ++k) {
+            if (length > 0.0f) {
+                glm::vec3 unit = normal / length;
+                quadrics[tri[k]].AddPlane(unit, -glm::dot(unit, p[tri[0]]), 0.5 * length);
+            }
+            vertex_tris[tri[k]].push_back(static_cast<uint32_t>(t));
+        }
+    }
+
+    struct Candidate {
+        double cost;
+        uint32_t from, to; // from moves onto to
+        uint32_t from_version, to_version;
+        bool operator>(const Candidate& other) const { return cost > other.cost; }
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+    std::vector<uint32_t> version(n, 0);
+    std::vector<uint8_t> dead(n, 0);
+    std::vector<uint8_t> removed(triangle_count, 0);
+
+    auto push_edge = [&](uint32_t a, uint32_t b) {
+        Quadric q = quadrics[a];
+        q.Add(quadrics[b]);
+        if (!fixed[a]) heap.push({ q.Error(p[b]), a, b, version[a], version[b] });
+        if (!fixed[b]) heap.push({ q.Error(p[a]), b, a, version[b], version[a] });
+    };
+    auto neighbours = [&](uint32_t v, std::vector<uint32_t>* out) {
+        out->clear();
+        for (uint32_t t : vertex_tris[v]) {
+            if (removed[t]) continue;
+            for (int k = 0; k < 3; ++k) {
+                if (tris[t * 3 + k] != v) out->push_back(tris[t * 3 + k]);
+            }
+        }
+        std::sort(out->begin(), out->end());
+        out->erase(std::unique(out->begin(), out->end()), out->end());
+    };
+
+    for (size_t t = 0; t < triangle_count; ++t) {
+        for (int k = 0; k < 3; ++k) {
+            uint32_t a = tris[t * 3 + k], b = tris[t * 3 + (k + 1) % 3];
+            if (a < b) push_edge(a, b);
+        }
+    }
+
+    // A collapse must keep the surface a manifold (a and b share at most the two vertices of the
+    // triangles on their edge) and must not flip or squash the triangles that move
+    std::vector<uint32_t> around_from, around_to;
+    auto can_collapse = [&](uint32_t from, uint32_t to) {
+        neighbours(from, &around_from);
+        neighbours(to, &around_to);
+        size_t shared = 0;
+        for (size_t i = 0, j = 0; i < around_from.size() && j < around_to.size();) {
+            if (around_from[i] == around_to[j]) {
+                ++shared;
+                ++i;
+                ++j;
+            } else if (around_from[i] < around_to[j]) {
+                ++i;
+            } else {
+                ++j;
+            }
+        }
+        if (shared > 2) return false;
+        for (uint32_t t : vertex_tris[from]) {
+            if (removed[t]) continue;
+            const uint32_t* tri = tris.data() + t * 3;
+            if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+            glm::vec3 q[3] = { p[tri[0]], p[tri[1]], p[tri[2]] };
+            glm::vec3 before = glm::cross(q[1] - q[0], q[2] - q[0]);
+            for (int k = 0; k < 3; ++k) {
+                if (tri[k] == from) q[k] = p[to];
+            }
+            glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <= 0.1f * glm::length(before) * glm::length(after)) return false;
+        }
+        return true;
+    };
+
+    size_t live = triangle_count;
+    double max_error = 0.0;
+    while (live > target && !heap.empty()) {
+        Candidate candidate = heap.top();
+        heap.pop();
+        uint32_t from = candidate.from, to = candidate.to;
+        if (dead[from] || dead[to] || version[from] != candidate.from_version || version[to] != candidate.to_version) {
+            continue;
+        }
+        if (!can_collapse(from, to)) continue;
+
+        for (uint32_t t : vertex_tris[from]) {
+            if (removed[t]) continue;
+            uint32_t* tri = tris.data() + t * 3;
+            if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                removed[t] = 1;
+                --live;
+                continue;
+            }
+            for (int k = 0; k < 3; ++k) {
+                if (tri[k] == from) tri[k] = to;
+            }
+            vertex_tris[to].push_back(t);
+        }
+        std::vector<uint32_t>().swap(vertex_tris[from]);
+        quadrics[to].Add(quadrics[from]);
+        dead[from] = 1;
+        ++version[to];
+        max_error = std::max(max_error, candidate.cost);
+
+        // Only edges at `to` changed cost; stale entries are skipped by their version
+        auto& list = vertex_tris[to];
+        list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) { return removed[t] != 0; }), list.end());
+        neighbours(to, &around_to);
+        for (uint32_t w : around_to) push_edge(to, w);
+    }
+
+    indices->clear();
+    for (size_t t = 0; t < triangle_count; ++t) {
+        if (removed[t]) continue;
+        for (int k = 0; k < 3; ++k) indices->push_back(vertices[tris[t * 3 + k]]);
+    }
+    return static_cast<float>(max_error);
+}
+
+// Mesh over the given triangles with the vertices they use, in order of first use; the tangent
+// signs of those vertices go to *out_tangent_signs
+grassland::Mesh<float> CompactMesh(const grassland::Mesh<float>& mesh, const std::vector<uint32_t>& indices,
+                                   const float* tangent_signs, std::vector<float>* out_tangent_signs) {
+    const auto* positions = reinterpret_cast<const glm::vec3*>(mesh.Positions());
+    const auto* normals = reinterpret_cast<const glm::vec3*>(mesh.Normals());
+    const auto* texcoords = reinterpret_cast<const glm::vec2*>(mesh.TexCoords());
+    const auto* tangents = reinterpret_cast<const glm::vec3*>(mesh.Tangents());
+    std::vector<uint32_t> new_index(mesh.NumVertices(), kNone);
+    std::vector<uint32_t> out_indices(indices.size());
+    std::vector<glm::vec3> out_positions, out_normals, out_tangents;
+    std::vector<glm::vec2> out_texcoords;
+    std::vector<float> out_signs;
+    for (size_t i = 0; i < indices.size(); ++i) {
+        uint32_t v = indices[i];
+        if (new_index[v] == kNone) {
+            new_index[v] = static_cast<uint32_t>(out_positions.size());
+            out_positions.push_back(positions[v]);
+            if (normals) out_normals.push_back(normals[v]);
+            if (texcoords) out_texcoords.push_back(texcoords[v]);
+            if (tangents) out_tangents.push_back(tangents[v]);
+            if (tangent_signs) out_signs.push_back(tangent_signs[v]);
+        }
+        out_indices[i] = new_index[v];
+    }
+    if (out_tangent_signs) *out_tangent_signs = std::move(out_signs);
+    using V3 = grassland::Vector3<float>;
+    using V2 = grassland::Vector2<float>;
+    return grassland::Mesh<float>(out_positions.size(), out_indices.size(), out_indices.data(),
+                                  reinterpret_cast<const V3*>(out_positions.data()),
+                                  normals ? reinterpret_cast<const V3*>(out_normals.data()) : nullptr,
+                                  texcoords ? reinterpret_cast<const V2*>(out_texcoords.data()) : nullptr,
+                                  tangents ? reinterpret_cast<const V3*>(out_tangents.data()) : nullptr);
+}
+} // namespace
+
+grassland::Mesh<float> SimplifyMesh(const grassland::Mesh<float>& mesh, size_t target_triangles,
+                                    SimplificationStats* stats, const float* tangent_signs,
+                                    std::vector<float>* out_tangent_signs) {
+    const auto* positions = reinterpret_cast<const glm::vec3*>(mesh.Positions());
+    const uint32_t* indices = mesh.Indices();
+    const size_t vertex_count = mesh.NumVertices();
+    const size_t triangle_count = mesh.NumIndices() / 3;
+    std::vector<uint8_t> locked = FindLockedVertices(positions, vertex_count, indices, triangle_count);
+
+    // Spatial chunks, simplified independently; vertices used by two chunks stay in place
+    size_t chunk_count = std::min<size_t>(triangle_count / kChunkTriangles, size_t(ThreadPool::Instance().GetWorkerCount()) * 4);
+    std::vector<std::vector<uint32_t>> chunks;
+    if (chunk_count > 1) {
+        MeshClusters parts = BuildMeshClusters(mesh, (triangle_count + chunk_count - 1) / chunk_count);
+        chunks.resize(parts.clusters.size());
+        std::vector<uint32_t> owner(vertex_count, kNone);
+        for (size_t c = 0; c < parts.clusters.size(); ++c) {
+            const MeshCluster& cluster = parts.clusters[c];
+            chunks[c].reserve(size_t(cluster.triangle_count) * 3);
+            for (uint32_t i = 0; i < cluster.triangle_count; ++i) {
+                const uint32_t* tri = indices + size_t(parts.triangles[cluster.first_triangle + i]) * 3;
+                for (int k = 0; k < 3; ++k) {
+                    chunks[c].push_back(tri[k]);
+                    if (owner[tri[k]] == kNone) {
+                        owner[tri[k]] = static_cast<uint32_t>(c);
+                    } else if (owner[tri[k]] != c) {
+                        locked[tri[k]] = 1;
+                    }
+                }
+            }
+        }
+    } else {
+        chunks.resize(1);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            const uint32_t* tri = indices + t * 3;
+            if (tri[0] < vertex_count && tri[1] < vertex_count && tri[2] < vertex_count) {
+                chunks[0].insert(chunks[0].end(), tri, tri + 3);
+            }
+        }
+    }
+
+    const double keep = triangle_count ? double(target_triangles) / triangle_count : 1.0;
+    std::vector<float> chunk_errors(chunks.size(), 0.0f);
+    ThreadPool::Instance().Run(chunks.size(), [&](size_t c, unsigned) {
+        size_t target = static_cast<size_t>(std::ceil(chunks[c].size() / 3 * keep));
+        chunk_errors[c] = CollapseEdges(positions, locked, &chunks[c], target);
+    });
+
+    std::vector<uint32_t> merged;
+    for (const auto& chunk : chunks) merged.insert(merged.end(), chunk.begin(), chunk.end());
+    if (stats) {
+        stats->triangles_before = triangle_count;
+        stats->triangles_after = merged.size() / 3;
+        stats->max_error = chunk_errors.empty() ? 0.0f : *std::max_element(chunk_errors.begin(), chunk_errors.end());
+    }
+    return CompactMesh(mesh, merged, tangent_signs, out_tangent_signs);
+}
+
+std::vector<grassland::Mesh<float>> BuildLodChain(const grassland::Mesh<float>& mesh, size_t level_count,
+                                                  const float* tangent_signs,
+                                                  std::vector<std::vector<float>>* level_tangent_signs, float ratio,
+                                                  size_t min_triangles) {
+    std::vector<grassland::Mesh<float>> levels;
+    std::vector<std::vector<float>> signs;
+    levels.reserve(level_count);
+    const grassland::Mesh<float>* source = &mesh;
+    const float* source_signs = tangent_signs;
+    for (size_t level = 0; level < level_count; ++level) {
+        size_t triangles = source->NumIndices() / 3;
+        size_t target = static_cast<size_t>(triangles * ratio);
+        if (target < min_triangles) break;
+        std::vector<float> simplified_signs;
+        grassland::Mesh<float> simplified = SimplifyMesh(*source, target, nullptr, source_signs, &simplified_signs);
+        if (simplified.NumIndices() / 3 > triangles * 9 / 10) break;
+        levels.push_back(std::move(simplified));
+        signs.push_back(std::move(simplified_signs));
+        source = &levels.back();
+        source_signs = tangent_signs ? signs.back().data() : nullptr;
+    }
+    if (level_tangent_signs) *level_tangent_signs = std::move(signs);
+    return levels;
+}
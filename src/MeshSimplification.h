@@ -0,0 +1,33 @@
+#pragma once
+#include "long_march.h"
+#include <cstddef>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert) by half-edge collapse: every collapse
+// moves a vertex onto one of its neighbours, so the vertices that remain keep their attributes
+// exactly. Vertices on open borders and attribute seams (several vertices at one position) never
+// move, which keeps the surface closed and the texture layout intact.
+//
+// Large meshes are cut into spatial chunks (MeshClusters.h) that are simplified in parallel on
+// the ThreadPool with the vertices between chunks held in place; successive levels cut
+// differently, so those vertices move in the next level.
+struct SimplificationStats {
+    size_t triangles_before = 0;
+    size_t triangles_after = 0;
+    float max_error = 0.0f; // Largest quadric error of a collapse (area-weighted squared distance)
+};
+
+// tangent_signs (the bitangent handedness per vertex, null when all +1) follows the remaining
+// vertices into *out_tangent_signs
+grassland::Mesh<float> SimplifyMesh(const grassland::Mesh<float>& mesh, size_t target_triangles,
+                                    SimplificationStats* stats = nullptr, const float* tangent_signs = nullptr,
+                                    std::vector<float>* out_tangent_signs = nullptr);
+
+// Up to level_count levels, level i simplified from level i - 1 to about ratio of its triangles.
+// The chain ends early when a level cannot get below 90% of the previous one or would drop
+// under min_triangles. *level_tangent_signs receives the tangent signs of every level (empty
+// vectors when tangent_signs is null).
+std::vector<grassland::Mesh<float>> BuildLodChain(const grassland::Mesh<float>& mesh, size_t level_count,
+                                                  const float* tangent_signs,
+                                                  std::vector<std::vector<float>>* level_tangent_signs,
+                                                  float ratio = 0.4f, size_t min_triangles = 64);
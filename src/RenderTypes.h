@@ -0,0 +1,52 @@
+#pragma once
+#include "long_march.h"
+
+// Host-side mirrors of the constant buffers declared in shaders/common.hlsl.
+// Layouts must stay in sync with the HLSL structs.
+
+struct CameraObject {
+    glm::mat4 screen_to_camera;
+    glm::mat4 camera_to_world;
+    glm::mat4 prev_camera_to_world;
+    float aperture;
+    float focus_distance;
+    float shutter_speed;
+    int enable_motion_blur;
+};
+
+struct VolumeRegion {
+    glm::vec3 min_p;
+    float pad0;
+    glm::vec3 max_p;
+    float sigma_t;
+    glm::vec3 sigma_s;
+    float pad_align;
+    glm::vec3 emission;  // Volumetric emission (Le)
+    float g; // Henyey-Greenstein anisotropy parameter
+};
+
+struct SkyInfo {
+    int use_skybox;
+    float env_intensity;
+    float bg_intensity;
+    float pad_sky;
+};
+
+struct RenderSettings {
+    int max_bounces;
+    float exposure;
+    int cartoon_enabled;
+    float diffuse_bands;
+    float specular_hardness;
+    float outline_width;
+    float outline_threshold;
+    // Flat cartoon style parameters
+    float binary_threshold;
+    float shadow_ignore_threshold;
+    float highlight_threshold;
+    // Saturation boost parameters
+    float saturation_boost_light;
+    float saturation_boost_shadow;
+    // VertexLayout of the scene's attribute buffers, selects the arrays the hit shaders read
+    int vertex_layout;
+};
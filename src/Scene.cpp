@@ -1,7 +1,576 @@
 #include "Scene.h"
+#include "MappedFile.h"
+#include "MeshAttributes.h"
+#include "MeshOptimization.h"
+#include "SceneCache.h"
+#include "ThreadPool.h"
 #include "tiny_gltf.cc"
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
+namespace {
+// 8-bit pixels of one glTF image: 1 (grey), 2 (grey, alpha) or 4 (RGBA) channels
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    int channels = 4;
+    std::vector<uint8_t> pixels;
+};
+
+// tinygltf image callback that decodes nothing. Images stored in a bufferView are read from the
+// buffer later, so only URI images keep a copy of their encoded bytes; DecodeImage does the work.
+bool DeferImageDecode(tinygltf::Image* image, const int, std::string*, std::string*,
+                      int, int, const unsigned char* bytes, int size, void*) {
+    image->width = image->height = image->component = -1;
+    if (image->bufferView < 0) {
+        image->image.assign(bytes, bytes + size);
+    }
+    return true;
+}
+
+// Decode with stb_image to 8 bits per channel (8 or 16 bit sources). Grey and grey + alpha images
+// keep their 1 or 2 channels; RGB is padded to RGBA.
+void DecodeImage(const unsigned char* bytes, size_t size, const std::string& name, DecodedImage* out) {
+    int w = 0, h = 0, comp = 0;
+    int channels = 4;
+    if (stbi_info_from_memory(bytes, static_cast<int>(size), &w, &h, &comp) && comp <= 2) channels = comp;
+    unsigned char* pixels = stbi_load_from_memory(bytes, static_cast<int>(size), &w, &h, &comp, channels);
+    if (!pixels) {
+        grassland::LogWarning("Failed to decode image '{}': {}", name, stbi_failure_reason());
+        return;
+    }
+    out->width = w;
+    out->height = h;
+    out->channels = channels;
+    out->pixels.assign(pixels, pixels + static_cast<size_t>(w) * h * channels);
+    stbi_image_free(pixels);
+}
+
+// A GLB file mapped into memory. When `bin` is set, buffer 0 is the BIN chunk read in place
+// and model.buffers only holds a one-byte stand-in for it.
+struct GlbSource {
+    MappedFile file;
+    const uint8_t* bin = nullptr;
+    size_t bin_size = 0;
+};
+
+uint32_t ReadU32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Finds the chunks of the mapped GLB and builds a copy of it without the BIN payload for tinygltf:
+// the embedded buffer shrinks to one byte and images in bufferViews point at a one-byte stand-in
+// view (their real views are returned in image_views). Returns false when the file is not a GLB
+// whose only buffer is its BIN chunk.
+bool BuildGlbStub(GlbSource* glb, std::vector<uint8_t>* stub, std::vector<int>* image_views) {
+    const uint8_t* data = glb->file.GetData();
+    size_t size = glb->file.GetSize();
+    if (size < 20 || ReadU32(data) != 0x46546C67u /* glTF */ || ReadU32(data + 4) != 2 ||
+        ReadU32(data + 16) != 0x4E4F534Au /* JSON */) {
+        return false;
+    }
+    size_t json_length = ReadU32(data + 12);
+    if (20 + json_length > size) return false;
+    size_t bin_header = 20 + ((json_length + 3) & ~size_t(3));
+    if (bin_header + 8 <= size && ReadU32(data + bin_header + 4) == 0x004E4942u /* BIN */) {
+        size_t bin_length = ReadU32(data + bin_header);
+        if (bin_header + 8 + bin_length > size) return false;
+        glb->bin = data + bin_header + 8;
+        glb->bin_size = bin_length;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(data + 20, data + 20 + json_length, nullptr, false);
+    if (json.is_discarded() || !json.is_object()) return false;
+    auto buffers = json.find("buffers");
+    bool has_buffer = buffers != json.end() && buffers->is_array() && !buffers->empty();
+    if (has_buffer) {
+        nlohmann::json& buffer = (*buffers)[0];
+        if (buffers->size() > 1 || !buffer.is_object() || buffer.contains("uri") || !glb->bin) return false;
+        buffer["byteLength"] = 1;
+    }
+
+    image_views->clear();
+    auto images = json.find("images");
+    if (images != json.end() && images->is_array()) {
+        size_t stand_in = 0;
+        for (nlohmann::json& image : *images) {
+            auto view = image.is_object() ? image.find("bufferView") : image.end();
+            if (image.is_object() && view != image.end() && view->is_number_integer()) {
+                nlohmann::json& views = json["bufferViews"];
+                if (!has_buffer || !views.is_array()) return false;
+                if (stand_in == 0) {
+                    stand_in = views.size();
+                    views.push_back({ { "buffer", 0 }, { "byteLength", 1 } });
+                }
+                image_views->push_back(view->get<int>());
+                *view = stand_in;
+            } else {
+                image_views->push_back(-1);
+            }
+        }
+    }
+
+    std::string json_text = json.dump();
+    json_text.resize((json_text.size() + 3) & ~size_t(3), ' ');
+    uint32_t words[5] = { 0x46546C67u, 2, static_cast<uint32_t>(12 + 8 + json_text.size() + 8 + 4),
+                          static_cast<uint32_t>(json_text.size()), 0x4E4F534Au };
+    uint32_t bin_words[3] = { 4, 0x004E4942u, 0 };
+    stub->resize(words[2]);
+    std::memcpy(stub->data(), words, sizeof(words));
+    std::memcpy(stub->data() + sizeof(words), json_text.data(), json_text.size());
+    std::memcpy(stub->data() + sizeof(words) + json_text.size(), bin_words, sizeof(bin_words));
+    return true;
+}
+
+// Parses the GLB through a memory mapping (glb->file, mapped here unless already open) so its
+// BIN chunk is never copied; files that keep buffers outside the BIN chunk go through
+// tinygltf's own loader
+bool LoadGlb(tinygltf::TinyGLTF& loader, const std::string& path, GlbSource* glb,
+             tinygltf::Model* model, std::string* err, std::string* warn) {
+    std::vector<uint8_t> stub;
+    std::vector<int> image_views;
+    if ((glb->file.IsOpen() || glb->file.Open(path)) && BuildGlbStub(glb, &stub, &image_views)) {
+        if (!loader.LoadBinaryFromMemory(model, err, warn, stub.data(), static_cast<unsigned int>(stub.size()),
+                                         tinygltf::GetBaseDir(path))) {
+            return false;
+        }
+        bool stand_in_view = false;
+        for (size_t i = 0; i < image_views.size() && i < model->images.size(); ++i) {
+            stand_in_view |= image_views[i] >= 0;
+            model->images[i].bufferView = image_views[i];
+        }
+        if (stand_in_view) model->bufferViews.pop_back();
+        return true;
+    }
+    glb->file.Close();
+    glb->bin = nullptr;
+    glb->bin_size = 0;
+    return loader.LoadBinaryFromFile(model, err, warn, path);
+}
+
+// Component c of element i of an accessor as float; integer data is read as normalized
+float ReadAccessorFloat(const uint8_t* data, size_t stride, int component_type, size_t i, int c) {
+    const uint8_t* element = data + i * stride;
+    switch (component_type) {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+        float value;
+        std::memcpy(&value, element + c * sizeof(float), sizeof(value));
+        return value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+        return std::max(static_cast<int8_t>(element[c]) / 127.0f, -1.0f);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        return element[c] / 255.0f;
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+        int16_t value;
+        std::memcpy(&value, element + c * sizeof(value), sizeof(value));
+        return std::max(value / 32767.0f, -1.0f);
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+        uint16_t value;
+        std::memcpy(&value, element + c * sizeof(value), sizeof(value));
+        return value / 65535.0f;
+    }
+    default:
+        return 0.0f;
+    }
+}
+
+// EXT_mesh_gpu_instancing: per-instance TRANSLATION/ROTATION/SCALE accessors composed with the
+// node transform into 3x4 object-to-world matrices. Returns false on malformed data.
+template <class BufferDataFn>
+bool ReadGpuInstances(const tinygltf::Model& model, const tinygltf::Value& extension, BufferDataFn&& buffer_data,
+                      const glm::mat4& node_transform, std::vector<glm::mat4x3>* instances) {
+    struct Stream {
+        const uint8_t* data = nullptr;
+        size_t stride = 0;
+        int component_type = 0;
+    };
+    const tinygltf::Value& attributes = extension.Get("attributes");
+    if (!attributes.IsObject()) return false;
+    size_t count = 0;
+    bool any = false;
+    auto read_stream = [&](const char* name, int type, Stream* stream) {
+        if (!attributes.Has(name)) return true;
+        int index = attributes.Get(name).GetNumberAsInt();
+        if (index < 0 || index >= static_cast<int>(model.accessors.size())) return false;
+        const tinygltf::Accessor& accessor = model.accessors[index];
+        if (accessor.type != type || accessor.bufferView < 0 || accessor.sparse.isSparse) return false;
+        const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+        int stride = accessor.ByteStride(view);
+        if (stride <= 0) return false;
+        stream->data = buffer_data(view.buffer) + view.byteOffset + accessor.byteOffset;
+        stream->stride = static_cast<size_t>(stride);
+        stream->component_type = accessor.componentType;
+        count = any ? std::min(count, accessor.count) : accessor.count;
+        any = true;
+        return true;
+    };
+    Stream translation, rotation, scale;
+    if (!read_stream("TRANSLATION", TINYGLTF_TYPE_VEC3, &translation) ||
+        !read_stream("ROTATION", TINYGLTF_TYPE_VEC4, &rotation) ||
+        !read_stream("SCALE", TINYGLTF_TYPE_VEC3, &scale) || !any) {
+        return false;
+    }
+
+    instances->resize(count);
+    ParallelFor(0, count, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::mat4 local(1.0f);
+            if (translation.data) {
+                local = glm::translate(local, glm::vec3(ReadAccessorFloat(translation.data, translation.stride, translation.component_type, i, 0),
+                                                        ReadAccessorFloat(translation.data, translation.stride, translation.component_type, i, 1),
+                                                        ReadAccessorFloat(translation.data, translation.stride, translation.component_type, i, 2)));
+            }
+            if (rotation.data) {
+                glm::quat r(ReadAccessorFloat(rotation.data, rotation.stride, rotation.component_type, i, 3),
+                            ReadAccessorFloat(rotation.data, rotation.stride, rotation.component_type, i, 0),
+                            ReadAccessorFloat(rotation.data, rotation.stride, rotation.component_type, i, 1),
+                            ReadAccessorFloat(rotation.data, rotation.stride, rotation.component_type, i, 2));
+                local = local * glm::mat4_cast(glm::normalize(r));
+            }
+            if (scale.data) {
+                local = glm::scale(local, glm::vec3(ReadAccessorFloat(scale.data, scale.stride, scale.component_type, i, 0),
+                                                    ReadAccessorFloat(scale.data, scale.stride, scale.component_type, i, 1),
+                                                    ReadAccessorFloat(scale.data, scale.stride, scale.component_type, i, 2)));
+            }
+            (*instances)[i] = glm::mat4x3(node_transform * local);
+        }
+    });
+    return true;
+}
+
+// Accessor data laid out as a tightly packed T array: a pointer into the buffer when the data
+// already has that layout, otherwise a copy in scratch (zero-filled past `count`, all zeros
+// without data)
+template <class T>
+const T* PackedAttribute(const uint8_t* data, size_t stride, size_t count, size_t vertex_count,
+                         std::vector<T>* scratch) {
+    if (data && stride == sizeof(T) && count >= vertex_count) {
+        return reinterpret_cast<const T*>(data);
+    }
+    scratch->resize(vertex_count);
+    std::memset(static_cast<void*>(scratch->data()), 0, vertex_count * sizeof(T));
+    size_t n = data ? std::min(count, vertex_count) : 0;
+    for (size_t i = 0; i < n; ++i) {
+        std::memcpy(static_cast<void*>(&(*scratch)[i]), data + i * stride, sizeof(T));
+    }
+    return scratch->data();
+}
+
+// Vertex streams and indices of one glTF primitive as tightly packed arrays: views into the
+// buffers, the scratch copies or the optimized mesh. Absent normals, and absent tangents of
+// primitives with texcoords, are zero-filled scratch until GenerateAttributes fills them in; the
+// other absent streams stay null, so the mesh goes without them.
+struct PrimitiveGeometry {
+    bool valid = false;
+    size_t vertex_count = 0;
+    size_t index_count = 0;
+    const uint32_t* indices = nullptr;
+    const grassland::Vector3<float>* positions = nullptr;
+    const grassland::Vector3<float>* normals = nullptr;
+    const grassland::Vector2<float>* texcoords = nullptr;
+    const grassland::Vector3<float>* tangents = nullptr;
+    const float* tangent_signs = nullptr; // Bitangent handedness; null when every sign is +1
+    bool generate_normals = false;
+    bool generate_tangents = false;
+    std::vector<grassland::Vector3<float>> position_scratch, normal_scratch, tangent_scratch;
+    std::vector<grassland::Vector2<float>> texcoord_scratch;
+    std::vector<float> sign_scratch;
+    std::vector<uint32_t> index_scratch;
+    std::unique_ptr<grassland::Mesh<float>> optimized; // Set by OptimizePrimitive
+    MeshOptimizationStats optimization;
+};
+
+// Reads the POSITION, TEXCOORD_0, NORMAL and TANGENT accessors and the indices of a primitive.
+// Returns false (and logs why) for primitives that cannot be drawn.
+template <class BufferDataFn>
+bool ReadPrimitive(const tinygltf::Model& model, const tinygltf::Primitive& prim, const std::string& mesh_name,
+                   BufferDataFn&& buffer_data, PrimitiveGeometry* geometry) {
+    /*
+     * mesh理论上有 5 种东西。
+     * pos 存储的是这个 mesh 的本地的所有顶点的位置。
+     * uv 存储的是这个 mesh 的本地的所有顶点的纹理坐标。
+     * indices 存储的是组成这个 mesh 的三角形的顶点索引，也是本地的。
+     * 还有一直被我忘掉的法线。
+     * 还有我都没见过的 tangent, tkpl
+     */
+
+    // 1 : position, a vec3
+    auto posIt = prim.attributes.find("POSITION");
+    if (posIt == prim.attributes.end()) {
+        grassland::LogWarning("Primitive missing POSITION attribute, skipping");
+        return false;
+    }
+
+    const auto &posAccessor = model.accessors[posIt->second];
+    const auto &posView = model.bufferViews[posAccessor.bufferView];
+    const uint8_t *posData = buffer_data(posView.buffer) + posView.byteOffset + posAccessor.byteOffset;
+    size_t posStride = posAccessor.ByteStride(posView);
+    if (posStride <= 0) {
+        grassland::LogWarning("Invalid POSITION accessor byte stride, use default");
+        posStride = sizeof(float) * 3;
+    }
+
+    // 2 : uv textcoordinate, a vec2
+    auto uvIt = prim.attributes.find("TEXCOORD_0");
+    const uint8_t *uvData = nullptr;
+    size_t uvStride = 0;
+    size_t uvCount = 0;
+    if (uvIt == prim.attributes.end()) {
+        grassland::LogWarning("Primitive missing TEXCOORD_0 attribute, use default");
+    } else {
+        const auto &uvAccessor = model.accessors[uvIt->second];
+        const auto &uvView = model.bufferViews[uvAccessor.bufferView];
+        uvData = buffer_data(uvView.buffer) + uvView.byteOffset + uvAccessor.byteOffset;
+        uvStride = uvAccessor.ByteStride(uvView);
+        if (uvStride <= 0) {
+            grassland::LogWarning("Invalid TEXCOORD_0 accessor byte stride, use default");
+            uvStride = sizeof(float) * 2;
+        }
+        uvCount = uvAccessor.count;
+    }
+
+    // 3 : indices
+    if (prim.indices < 0) {
+        grassland::LogWarning("Primitive without indices not supported, skipping");
+        return false;
+    }
+
+    const auto &idxAccessor = model.accessors[prim.indices];
+    const auto &idxView = model.bufferViews[idxAccessor.bufferView];
+    const uint8_t *idxData = buffer_data(idxView.buffer) + idxView.byteOffset + idxAccessor.byteOffset;
+
+    // 4 : normals
+
+    auto normalIt = prim.attributes.find("NORMAL");
+    const uint8_t *normalData = nullptr;
+    size_t normalStride = 0;
+    size_t normalCount = 0;
+    if (normalIt == prim.attributes.end()) {
+        grassland::LogWarning("Primitive missing NORMAL attribute, generating smooth normals");
+    } else {
+        grassland::LogInfo("Found NORMAL attribute for mesh {}", mesh_name);
+        const auto &normalAccessor = model.accessors[normalIt->second];
+        const auto &normalView = model.bufferViews[normalAccessor.bufferView];
+        normalData = buffer_data(normalView.buffer) + normalView.byteOffset + normalAccessor.byteOffset;
+        normalStride = normalAccessor.ByteStride(normalView);
+        if (normalStride <= 0) {
+            grassland::LogWarning("Invalid NORMAL accessor byte stride, use default");
+            normalStride = sizeof(float) * 3;
+        }
+        normalCount = normalAccessor.count;
+    }
+
+    // 5 : tangent 
+
+    auto tangentIt = prim.attributes.find("TANGENT");
+    const uint8_t *tangentData = nullptr;
+    size_t tangentStride = 0;
+    size_t tangentCount = 0;
+    if (tangentIt == prim.attributes.end()) {
+        grassland::LogWarning(uvData ? "Primitive missing TANGENT attribute, generating tangents"
+                                     : "Primitive missing TANGENT attribute and TEXCOORD_0, use default");
+    } else {
+        grassland::LogInfo("Found TANGENT attribute for mesh {}", mesh_name);
+        const auto &tangentAccessor = model.accessors[tangentIt->second];
+        const auto &tangentView = model.bufferViews[tangentAccessor.bufferView];
+        tangentData = buffer_data(tangentView.buffer) + tangentView.byteOffset + tangentAccessor.byteOffset;
+        tangentStride = tangentAccessor.ByteStride(tangentView);
+        if (tangentStride <= 0) {
+            grassland::LogWarning("Invalid TANGENT accessor byte stride, use default");
+            tangentStride = sizeof(float) * 4;
+        }
+        tangentCount = tangentAccessor.count;
+    }
+
+    // 5 个 data 的位置准备好了。Tightly packed float data is handed to the Mesh straight from
+    // the buffer; anything else is converted once into scratch arrays.
+    const size_t vertex_count = posAccessor.count;
+    geometry->positions =
+        PackedAttribute(posData, posStride, vertex_count, vertex_count, &geometry->position_scratch);
+    geometry->texcoords =
+        uvData ? PackedAttribute(uvData, uvStride, uvCount, vertex_count, &geometry->texcoord_scratch) : nullptr;
+    geometry->normals =
+        PackedAttribute(normalData, normalStride, normalCount, vertex_count, &geometry->normal_scratch);
+    // glTF tangents are vec4 (w = handedness); the mesh keeps xyz and the handedness goes to
+    // tangent_signs. Without texcoords there is nothing to generate them from, and the shaders'
+    // default applies.
+    geometry->tangents = tangentData || uvData
+        ? PackedAttribute(tangentData, tangentStride, tangentCount, vertex_count, &geometry->tangent_scratch)
+        : nullptr;
+    if (tangentData) {
+        size_t flipped = 0;
+        geometry->sign_scratch.assign(vertex_count, 1.0f);
+        for (size_t i = 0; i < std::min(tangentCount, vertex_count); ++i) {
+            float w;
+            std::memcpy(&w, tangentData + i * tangentStride + 3 * sizeof(float), sizeof(w));
+            if (w < 0.0f) {
+                geometry->sign_scratch[i] = -1.0f;
+                ++flipped;
+            }
+        }
+        if (flipped) {
+            grassland::LogInfo("Mesh {} has {} vertices with mirrored tangents (w = -1)", mesh_name, flipped);
+            geometry->tangent_signs = geometry->sign_scratch.data();
+        } else {
+            geometry->sign_scratch = {};
+        }
+    }
+
+    if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+        geometry->indices = reinterpret_cast<const uint32_t *>(idxData);
+    } else if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+        const uint16_t *src = reinterpret_cast<const uint16_t *>(idxData);
+        geometry->index_scratch.assign(src, src + idxAccessor.count);
+        geometry->indices = geometry->index_scratch.data();
+    } else if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(idxData);
+        geometry->index_scratch.assign(src, src + idxAccessor.count);
+        geometry->indices = geometry->index_scratch.data();
+    } else {
+        grassland::LogError("Unsupported index type in glTF");
+        return false;
+    }
+
+    geometry->vertex_count = vertex_count;
+    geometry->index_count = idxAccessor.count;
+    geometry->generate_normals = !normalData;
+    geometry->generate_tangents = !tangentData && uvData;
+    geometry->valid = true;
+    return true;
+}
+
+void GenerateAttributes(PrimitiveGeometry* geometry) {
+    const auto *positions = reinterpret_cast<const glm::vec3 *>(geometry->positions);
+    if (geometry->generate_normals) {
+        GenerateSmoothNormals(geometry->vertex_count, geometry->indices, geometry->index_count, positions,
+                              reinterpret_cast<glm::vec3 *>(geometry->normal_scratch.data()));
+    }
+    if (geometry->generate_tangents) {
+        // Mirrored UVs give negative signs; meshes without them keep no sign array
+        geometry->sign_scratch.resize(geometry->vertex_count);
+        GenerateTangents(geometry->vertex_count, geometry->indices, geometry->index_count, positions,
+                         reinterpret_cast<const glm::vec3 *>(geometry->normals),
+                         reinterpret_cast<const glm::vec2 *>(geometry->texcoords),
+                         reinterpret_cast<glm::vec3 *>(geometry->tangent_scratch.data()), geometry->sign_scratch.data());
+        if (std::any_of(geometry->sign_scratch.begin(), geometry->sign_scratch.end(), [](float s) { return s < 0.0f; })) {
+            geometry->tangent_signs = geometry->sign_scratch.data();
+        } else {
+            geometry->sign_scratch = {};
+        }
+    }
+}
+
+// Runs fn(geometry) for every primitive. Large primitives get the whole pool one at a time
+// (fn's own ParallelFor calls spread their triangles); the small ones are spread over the pool
+// one primitive per task, in the same job as side_count tasks of side_fn(i).
+template <class Fn, class SideFn>
+void RunPerPrimitive(const std::vector<PrimitiveGeometry*>& primitives, Fn&& fn, size_t side_count, SideFn&& side_fn) {
+    constexpr size_t kLargeIndexCount = size_t(3) << 16;
+    std::vector<PrimitiveGeometry*> small;
+    for (PrimitiveGeometry *geometry : primitives) {
+        if (geometry->index_count >= kLargeIndexCount) {
+            fn(geometry);
+        } else {
+            small.push_back(geometry);
+        }
+    }
+    ThreadPool::Instance().Run(side_count + small.size(), [&](size_t i, unsigned) {
+        if (i < side_count) {
+            side_fn(i);
+        } else {
+            fn(small[i - side_count]);
+        }
+    });
+}
+
+// Replaces the primitive's streams with those of OptimizeMeshLocality's mesh
+void OptimizePrimitive(PrimitiveGeometry* geometry) {
+    std::vector<float> signs;
+    geometry->optimized = std::make_unique<grassland::Mesh<float>>(OptimizeMeshLocality(
+        geometry->vertex_count, geometry->indices, geometry->index_count,
+        reinterpret_cast<const glm::vec3 *>(geometry->positions), reinterpret_cast<const glm::vec3 *>(geometry->normals),
+        reinterpret_cast<const glm::vec2 *>(geometry->texcoords), reinterpret_cast<const glm::vec3 *>(geometry->tangents),
+        &geometry->optimization, geometry->tangent_signs, &signs));
+    const grassland::Mesh<float> &mesh = *geometry->optimized;
+    geometry->vertex_count = mesh.NumVertices();
+    geometry->index_count = mesh.NumIndices();
+    geometry->indices = mesh.Indices();
+    geometry->positions = mesh.Positions();
+    geometry->normals = mesh.Normals();
+    geometry->texcoords = mesh.TexCoords();
+    geometry->tangents = mesh.Tangents();
+    geometry->sign_scratch = std::move(signs);
+    geometry->tangent_signs = geometry->sign_scratch.empty() ? nullptr : geometry->sign_scratch.data();
+    geometry->position_scratch = {};
+    geometry->normal_scratch = {};
+    geometry->tangent_scratch = {};
+    geometry->texcoord_scratch = {};
+    geometry->index_scratch = {};
+}
+
+size_t TextureBytes(const CachedTexture& texture) {
+    return size_t(texture.width) * texture.height * texture.channels;
+}
+
+// RGBA8 view of a texture for the consumers that need four channels (GPU upload, mips, BC
+// compression). Grey and grey + alpha textures are expanded into scratch.
+CachedTexture ExpandedTexture(const CachedTexture& texture, std::vector<uint8_t>* scratch) {
+    if (!texture.rgba8 || texture.channels == 4) return texture;
+    size_t count = size_t(texture.width) * texture.height;
+    scratch->resize(count * 4);
+    ExpandToRgba8(texture.rgba8, texture.channels, count, scratch->data());
+    return { texture.width, texture.height, scratch->data(), 4 };
+}
+
+// For every texture, the first texture with the same size, channels and pixels (itself when unique
+// or null). Pixels are hashed in parallel and compared byte for byte when the hashes match.
+std::vector<size_t> FindIdenticalTextures(const std::vector<CachedTexture>& textures) {
+    std::vector<uint64_t> hashes(textures.size(), 0);
+    ThreadPool::Instance().Run(textures.size(), [&](size_t i, unsigned) {
+        const CachedTexture &texture = textures[i];
+        if (texture.rgba8) hashes[i] = SceneCache::HashBytes(texture.rgba8, TextureBytes(texture));
+    });
+    std::vector<size_t> owners(textures.size());
+    std::unordered_map<uint64_t, std::vector<size_t>> candidates;
+    for (size_t i = 0; i < textures.size(); ++i) {
+        owners[i] = i;
+        const CachedTexture &texture = textures[i];
+        if (!texture.rgba8) continue;
+        std::vector<size_t> &same_hash = candidates[hashes[i]];
+        for (size_t other : same_hash) {
+            const CachedTexture &candidate = textures[other];
+            if (candidate.width == texture.width && candidate.height == texture.height &&
+                candidate.channels == texture.channels &&
+                std::memcmp(candidate.rgba8, texture.rgba8, TextureBytes(texture)) == 0) {
+                owners[i] = other;
+                break;
+            }
+        }
+        if (owners[i] == i) same_hash.push_back(i);
+    }
+    return owners;
+}
+
+// Maps every texture index of a material through slots; indices without a slot become -1
+void RemapTextures(Material* material, const std::vector<int>& slots) {
+    int *indices[] = { &material->base_color_tex, &material->metallic_roughness_tex, &material->emissive_texture,
+                       &material->AO_texture, &material->normal_texture, &material->base_color_tex_layer2,
+                       &material->metallic_roughness_tex_layer2, &material->emissive_texture_layer2,
+                       &material->AO_texture_layer2, &material->normal_texture_layer2 };
+    for (int *index : indices) {
+        if (*index >= 0) *index = *index < static_cast<int>(slots.size()) ? slots[*index] : -1;
+    }
+}
+} // namespace
 
 Scene::Scene(grassland::graphics::Core* core)
     : core_(core) {
@@ -17,17 +586,59 @@ void Scene::AddEntity(std::shared_ptr<Entity> entity) {
         return;
     }
 
-    // Build BLAS for the entity
-    entity->BuildBLAS(core_);
-    
+    // Build BLAS for the entity (CPU-only scenes keep the mesh on the host)
+    entity->SelectLod(lod_level_);
+    if (core_) {
+        if (!entity->GetBLAS()) {
+            entity->BuildBLAS(core_, vertex_layout_);
+            skipped_stream_count_ += entity->GetSkippedStreamCount();
+            skipped_stream_bytes_ += entity->GetSkippedStreamBytes();
+        }
+        if (entity->GetVertexLayout() != vertex_layout_) {
+            grassland::LogWarning("Entity mesh was uploaded with another vertex layout; it will not shade correctly");
+        }
+    }
+
+    entity->SetTransformListener(this, static_cast<uint32_t>(entities_.size()));
     entities_.push_back(entity);
-    vertex_buffers_.push_back(entity->GetVertexBuffer());
-    index_buffers_.push_back(entity->GetIndexBuffer());
-    normal_buffers_.push_back(entity->GetNormalBuffer());
-    tangent_buffers_.push_back(entity->GetTangentBuffer());
-    texcoord_buffers_.push_back(entity->GetTexcoordBuffer());
+    instance_dirty_.push_back(0);
+    // Streams the entity does not have, and arrays its layout does not use, get the shared dummy
+    // buffer so every binding is valid
+    if (core_ && !dummy_buffer_) {
+        const uint8_t zeros[sizeof(ShadingVertex)] = {};
+        core_->CreateBuffer(sizeof(zeros), grassland::graphics::BUFFER_TYPE_DYNAMIC, &dummy_buffer_);
+        dummy_buffer_->UploadData(zeros, sizeof(zeros));
+    }
+    for (auto* buffers : { &vertex_buffers_, &index_buffers_, &normal_buffers_, &tangent_buffers_, &texcoord_buffers_,
+                           &attribute_buffers_, &packed_vertex_buffers_ }) {
+        buffers->push_back(nullptr);
+    }
+    SetEntityBuffers(entities_.size() - 1);
     grassland::LogInfo("Added entity to scene (total: {})", entities_.size());
 }
+
+void Scene::SetEntityBuffers(size_t index) {
+    const Entity& entity = *entities_[index];
+    grassland::graphics::Buffer* placeholder = dummy_buffer_.get();
+    auto or_placeholder = [placeholder](grassland::graphics::Buffer* buffer) { return buffer ? buffer : placeholder; };
+    vertex_buffers_[index] = entity.GetVertexBuffer();
+    index_buffers_[index] = entity.GetIndexBuffer();
+    normal_buffers_[index] = or_placeholder(entity.GetNormalBuffer());
+    tangent_buffers_[index] = or_placeholder(entity.GetTangentBuffer());
+    texcoord_buffers_[index] = or_placeholder(entity.GetTexcoordBuffer());
+    attribute_buffers_[index] = or_placeholder(entity.GetAttributeBuffer());
+    packed_vertex_buffers_[index] = or_placeholder(entity.GetPackedVertexBuffer());
+}
+
+void Scene::AddInstances(uint32_t entity_index, const glm::mat4x3* transforms, size_t count) {
+    if (entity_index >= entities_.size()) {
+        grassland::LogError("Cannot instance entity {} (total entities: {})", entity_index, entities_.size());
+        return;
+    }
+    instance_array_.transforms.insert(instance_array_.transforms.end(), transforms, transforms + count);
+    instance_array_.entity_indices.insert(instance_array_.entity_indices.end(), count, entity_index);
+}
+
 void Scene::AddLight(const Light& light) {
     Light l = light; // Make a local copy so we can sanitize defaults.
 
@@ -48,9 +659,209 @@ int Scene::AddTexture(std::unique_ptr<grassland::graphics::Image> texture) {
     if (!texture) return -1;
     base_color_srvs_.push_back(texture.get());
     texture_storage_.push_back(std::move(texture));
+    host_textures_.resize(base_color_srvs_.size()); // Keep host indices aligned
+    texture_mips_.resize(base_color_srvs_.size());
     return static_cast<int>(base_color_srvs_.size() - 1);
 }
 
+int Scene::AddTexture(int width, int height, const uint8_t* rgba8, bool srgb) {
+    if (!rgba8 || width <= 0 || height <= 0) return -1;
+    HostTexture host;
+    if (KeepsHostTextures()) {
+        host.width = width;
+        host.height = height;
+        host.rgba8.assign(rgba8, rgba8 + size_t(width) * height * 4);
+    }
+    int index = 0;
+    if (core_) {
+        std::unique_ptr<grassland::graphics::Image> image;
+        core_->CreateImage(width, height, grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM, &image);
+        image->UploadData(rgba8);
+        index = AddTexture(std::move(image));
+        host_textures_[index] = std::move(host);
+    } else {
+        index = AddHostTexture(std::move(host));
+    }
+    AddMipLevels(index, GenerateMipChain(rgba8, width, height, srgb));
+    return index;
+}
+
+int Scene::AddOrmTexture(const ChannelSource &occlusion, const ChannelSource &roughness, const ChannelSource &metallic) {
+    auto start = std::chrono::steady_clock::now();
+    int width = 0, height = 0;
+    size_t map_count = 0, map_bytes = 0;
+    for (const ChannelSource *source : { &occlusion, &roughness, &metallic }) {
+        if (!source->rgba8 || source->width <= 0 || source->height <= 0) continue;
+        width = std::max(width, source->width);
+        height = std::max(height, source->height);
+        ++map_count;
+        map_bytes += size_t(source->width) * source->height * 4;
+    }
+    if (map_count == 0) return -1;
+    std::vector<uint8_t> packed = PackOrmTexture(width, height, occlusion, roughness, metallic);
+    double pack_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    int index = AddTexture(width, height, packed.data(), false);
+    grassland::LogInfo("Packed {} maps into ORM texture {} ({}x{}) in {:.2f} ms: {:.2f} MB -> {:.2f} MB of RGBA8",
+                       map_count, index, width, height, pack_ms, map_bytes / (1024.0 * 1024.0),
+                       packed.size() / (1024.0 * 1024.0));
+    return index;
+}
+
+int Scene::AddHostTexture(HostTexture texture) {
+    if (!texture.IsValid()) return -1;
+    base_color_srvs_.push_back(nullptr);
+    host_textures_.resize(base_color_srvs_.size() - 1);
+    host_textures_.push_back(std::move(texture));
+    texture_mips_.resize(base_color_srvs_.size());
+    return static_cast<int>(base_color_srvs_.size() - 1);
+}
+
+void Scene::AddMipLevels(size_t texture, std::vector<MipLevel> levels) {
+    if (levels.empty()) return;
+    texture_mips_[texture].first_level = static_cast<int32_t>(base_color_srvs_.size());
+    texture_mips_[texture].level_count = static_cast<int32_t>(levels.size() + 1);
+    const bool keep_host = KeepsHostTextures();
+    for (MipLevel &level : levels) {
+        grassland::graphics::Image *srv = nullptr;
+        if (core_) {
+            std::unique_ptr<grassland::graphics::Image> image;
+            core_->CreateImage(level.width, level.height, grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM, &image);
+            image->UploadData(level.rgba8.data());
+            srv = image.get();
+            texture_storage_.push_back(std::move(image));
+        }
+        base_color_srvs_.push_back(srv);
+        // The CPU renderer samples the same levels as the shaders
+        host_textures_.resize(base_color_srvs_.size());
+        if (keep_host) {
+            HostTexture &host = host_textures_.back();
+            host.width = level.width;
+            host.height = level.height;
+            host.rgba8 = std::move(level.rgba8);
+        }
+    }
+    texture_mips_.resize(base_color_srvs_.size());
+}
+
+void Scene::BuildTextureMips(size_t first_texture, const std::vector<CachedTexture> &textures) {
+    if (textures.empty()) return;
+    auto start = std::chrono::steady_clock::now();
+    // Base colour and emissive textures hold sRGB colour; everything else is data
+    std::vector<uint8_t> srgb(textures.size(), 0);
+    auto mark = [&](int texture) {
+        if (texture >= static_cast<int>(first_texture) && texture < static_cast<int>(first_texture + textures.size())) {
+            srgb[texture - first_texture] = 1;
+        }
+    };
+    for (const auto &entity : entities_) {
+        const Material &material = entity->GetMaterial();
+        mark(material.base_color_tex);
+        mark(material.emissive_texture);
+        mark(material.base_color_tex_layer2);
+        mark(material.emissive_texture_layer2);
+    }
+
+    std::vector<MipSource> sources(textures.size());
+    for (size_t i = 0; i < textures.size(); ++i) {
+        sources[i] = { textures[i].width, textures[i].height, textures[i].rgba8, srgb[i] != 0 };
+    }
+    std::vector<std::vector<MipLevel>> chains = GenerateMipChains(sources);
+    size_t level_count = 0;
+    for (size_t i = 0; i < chains.size(); ++i) {
+        level_count += chains[i].size();
+        AddMipLevels(first_texture + i, std::move(chains[i]));
+    }
+    grassland::LogInfo("Generated {} mip levels for {} textures in {:.1f} ms", level_count, textures.size(),
+                       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+void Scene::CompressTextures(size_t first_texture, const std::vector<CachedTexture> &textures,
+                             const std::string &cache_dir) {
+    if (!compress_textures_ || textures.empty()) return;
+    auto start = std::chrono::steady_clock::now();
+    // Roles in increasing priority, so a texture shared by several takes the widest format
+    constexpr int kUnused = 0, kOcclusion = 1, kNormal = 2, kEmissive = 3, kMetallicRoughness = 4, kBaseColor = 5;
+    std::vector<int> roles(textures.size(), kUnused);
+    auto mark = [&](int texture, int role) {
+        if (texture >= static_cast<int>(first_texture) && texture < static_cast<int>(first_texture + textures.size())) {
+            int &current = roles[texture - first_texture];
+            current = std::max(current, role);
+        }
+    };
+    for (const auto &entity : entities_) {
+        const Material &material = entity->GetMaterial();
+        mark(material.base_color_tex, kBaseColor);
+        mark(material.base_color_tex_layer2, kBaseColor);
+        mark(material.metallic_roughness_tex, kMetallicRoughness);
+        mark(material.metallic_roughness_tex_layer2, kMetallicRoughness);
+        mark(material.emissive_texture, kEmissive);
+        mark(material.emissive_texture_layer2, kEmissive);
+        mark(material.normal_texture, kNormal);
+        mark(material.normal_texture_layer2, kNormal);
+        mark(material.AO_texture, kOcclusion);
+        mark(material.AO_texture_layer2, kOcclusion);
+    }
+    auto format_of = [](int role) {
+        switch (role) {
+            case kOcclusion: return BcFormat::kBC4;
+            case kNormal: return BcFormat::kBC5;
+            case kEmissive: return BcFormat::kBC1;
+            default: return BcFormat::kBC7;
+        }
+    };
+
+    // Only the sizes are kept: the blocks go to the disk cache and are dropped here until the
+    // graphics layer can upload block-compressed images
+    struct Encoded {
+        BcFormat format = BcFormat::kBC7;
+        size_t rgba8_bytes = 0;
+        size_t block_bytes = 0;
+        bool hit = false;
+    };
+    std::vector<Encoded> encoded(textures.size());
+    auto compress = [&](size_t i) {
+        const CachedTexture &texture = textures[i];
+        bool hit = false;
+        CompressedTexture compressed = CompressTextureCached(cache_dir, texture.rgba8, texture.width, texture.height,
+                                                             format_of(roles[i]), texture_quality_, &hit);
+        if (!compressed.IsValid()) return;
+        encoded[i] = { compressed.format, size_t(compressed.width) * compressed.height * 4, compressed.blocks.size(),
+                       hit };
+    };
+    // Large textures take the pool one at a time (rows in parallel), small ones one per task
+    std::vector<size_t> small;
+    for (size_t i = 0; i < textures.size(); ++i) {
+        if (!textures[i].rgba8) continue;
+        if (size_t(textures[i].width) * textures[i].height >= size_t(1024) * 1024) {
+            compress(i);
+        } else {
+            small.push_back(i);
+        }
+    }
+    ThreadPool::Instance().Run(small.size(), [&](size_t k, unsigned) { compress(small[k]); });
+
+    size_t count = 0, hit_count = 0, rgba8_bytes = 0, block_bytes = 0;
+    size_t format_counts[4] = {};
+    for (const Encoded &texture : encoded) {
+        if (texture.block_bytes == 0) continue;
+        ++count;
+        hit_count += texture.hit;
+        rgba8_bytes += texture.rgba8_bytes;
+        block_bytes += texture.block_bytes;
+        ++format_counts[static_cast<size_t>(texture.format)];
+    }
+    grassland::LogInfo("Compressed {} textures ({} from {}) at {} quality in {:.1f} ms: {:.2f} MB RGBA8 -> {:.2f} MB "
+                       "({} BC1, {} BC4, {} BC5, {} BC7)",
+                       count, hit_count, cache_dir, BcQualityName(texture_quality_),
+                       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                       rgba8_bytes / (1024.0 * 1024.0), block_bytes / (1024.0 * 1024.0), format_counts[0],
+                       format_counts[1], format_counts[2], format_counts[3]);
+}
+
+void Scene::ShareTextureLevels(size_t texture, size_t owner) {
+    texture_mips_[texture] = texture_mips_[owner];
+}
+
 void Scene::SetSkyboxTexture(std::unique_ptr<grassland::graphics::Image> texture) {
     skybox_texture_ = std::move(texture);
 }
@@ -60,7 +871,11 @@ void Scene::ClearLights() {
     lights_buffer_.reset();
 }
 void Scene::Clear() {
+    for (auto& entity : entities_) {
+        entity->SetTransformListener(nullptr, 0); // Entities may outlive the scene
+    }
     entities_.clear();
+    instance_array_.Clear();
     lights_.clear();
     tlas_.reset();
     materials_buffer_.reset();
@@ -70,9 +885,104 @@ void Scene::Clear() {
     normal_buffers_.clear();
     tangent_buffers_.clear();
     texcoord_buffers_.clear();
+    attribute_buffers_.clear();
+    packed_vertex_buffers_.clear();
+    vertex_formats_buffer_.reset();
+    dummy_buffer_.reset();
     base_color_srvs_.clear();
     texture_storage_.clear();
+    texture_mips_.clear();
+    texture_mips_buffer_.reset();
+    host_textures_.clear();
+    host_skybox_ = HostTexture();
     linear_wrap_sampler_ = nullptr;
+    tlas_instances_.clear();
+    tlas_slots_.clear();
+    dirty_instances_.clear();
+    instance_dirty_.clear();
+    cpu_bvh_.reset();
+    cluster_refs_.clear();
+}
+
+void Scene::OnTransformChanged(uint32_t instance_index) {
+    if (instance_index < instance_dirty_.size() && !instance_dirty_[instance_index]) {
+        instance_dirty_[instance_index] = 1;
+        dirty_instances_.push_back(instance_index);
+    }
+}
+
+void Scene::ClearDirtyInstances() {
+    for (uint32_t index : dirty_instances_) {
+        instance_dirty_[index] = 0;
+    }
+    dirty_instances_.clear();
+}
+
+grassland::graphics::RayTracingInstance Scene::MakeInstance(size_t entity_index) const {
+    // instanceCustomIndex is used to index into materials buffer
+    // Convert mat4 to mat4x3 (drop the last row which is always [0,0,0,1] for affine transforms)
+    const auto& entity = entities_[entity_index];
+    glm::mat4x3 transform_3x4 = glm::mat4x3(entity->GetTransform());
+    return entity->GetBLAS()->MakeInstance(
+        transform_3x4,
+        static_cast<uint32_t>(entity_index),  // instanceCustomIndex for material lookup
+        0xFF,                                 // instanceMask
+        0,                                    // instanceShaderBindingTableRecordOffset
+        grassland::graphics::RAYTRACING_INSTANCE_FLAG_NONE
+    );
+}
+
+void Scene::BuildCpuAccelerationStructures() {
+    if (!cpu_bvh_) {
+        cpu_bvh_ = std::make_unique<SceneBvh>();
+        cpu_bvh_->BuildMeshes(CollectLevelMeshes()); // LOD switches then only rebuild the top level
+    }
+    cpu_bvh_->Build(entities_, instance_array_);
+}
+
+std::vector<const grassland::Mesh<float> *> Scene::CollectLevelMeshes() {
+    std::unordered_set<const grassland::Mesh<float> *> seen;
+    std::vector<const grassland::Mesh<float> *> meshes;
+    for (const auto &entity : entities_) {
+        size_t lod = entity->GetLod();
+        for (size_t level = 1; level < entity->GetLodCount(); ++level) {
+            entity->SelectLod(level);
+            if (seen.insert(&entity->GetMesh()).second) meshes.push_back(&entity->GetMesh());
+        }
+        entity->SelectLod(lod);
+    }
+    return meshes;
+}
+
+void Scene::BuildMeshClusters(size_t max_triangles) {
+    auto start = std::chrono::steady_clock::now();
+    // Entities sharing a mesh share its clusters; split each mesh once. Large meshes take the
+    // pool one at a time, small ones one per task.
+    constexpr size_t kLargeIndexCount = size_t(3) << 16;
+    std::unordered_set<const grassland::Mesh<float> *> seen;
+    std::vector<Entity *> small;
+    size_t split_meshes = 0;
+    for (const auto &entity : entities_) {
+        if (!entity->GetClusters().IsEmpty() || !seen.insert(&entity->GetMesh()).second) continue;
+        ++split_meshes;
+        if (entity->GetMesh().NumIndices() >= kLargeIndexCount) {
+            entity->BuildClusters(max_triangles);
+        } else {
+            small.push_back(entity.get());
+        }
+    }
+    ThreadPool::Instance().Run(small.size(), [&](size_t i, unsigned) { small[i]->BuildClusters(max_triangles); });
+
+    cluster_refs_.clear();
+    for (size_t e = 0; e < entities_.size(); ++e) {
+        size_t count = entities_[e]->GetClusters().clusters.size();
+        for (size_t c = 0; c < count; ++c) {
+            cluster_refs_.push_back({ static_cast<uint32_t>(e), static_cast<uint32_t>(c) });
+        }
+    }
+    grassland::LogInfo("Split {} meshes into clusters in {:.1f} ms: {} clusters over {} entities",
+                       split_meshes, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                       cluster_refs_.size(), entities_.size());
 }
 
 void Scene::BuildAccelerationStructures() {
@@ -80,70 +990,157 @@ void Scene::BuildAccelerationStructures() {
         grassland::LogWarning("No entities to build acceleration structures");
         return;
     }
-
-    // Create TLAS instances from all entities
-    std::vector<grassland::graphics::RayTracingInstance> instances;
-    instances.reserve(entities_.size());
-
-    for (size_t i = 0; i < entities_.size(); ++i) {
-        auto& entity = entities_[i];
-        if (entity->GetBLAS()) {
-            // Create instance with entity's transform
-            // instanceCustomIndex is used to index into materials buffer
-            // Convert mat4 to mat4x3 (drop the last row which is always [0,0,0,1] for affine transforms)
-            glm::mat4x3 transform_3x4 = glm::mat4x3(entity->GetTransform());
-            
-            auto instance = entity->GetBLAS()->MakeInstance(
-                transform_3x4,
-                static_cast<uint32_t>(i),  // instanceCustomIndex for material lookup
-                0xFF,                       // instanceMask
-                0,                          // instanceShaderBindingTableRecordOffset
-                grassland::graphics::RAYTRACING_INSTANCE_FLAG_NONE
-            );
-            instances.push_back(instance);
-        }
+    ClearDirtyInstances(); // Everything below reads the current transforms
+    if (!core_) {
+        BuildCpuAccelerationStructures(); // CPU-only scene
+        return;
     }
+    if (cpu_bvh_) {
+        cpu_bvh_->Build(entities_, instance_array_);
+    }
+
+    FillTlasInstances();
 
     // Build TLAS
-    core_->CreateTopLevelAccelerationStructure(instances, &tlas_);
-    grassland::LogInfo("Built TLAS with {} instances", instances.size());
+    core_->CreateTopLevelAccelerationStructure(tlas_instances_, &tlas_);
+    grassland::LogInfo("Built TLAS with {} instances", tlas_instances_.size());
 
     // Update materials buffer
     UpdateMaterialsBuffer();
+    UpdateVertexFormatsBuffer();
+    UpdateTextureMipsBuffer();
 }
 
-void Scene::UpdateInstances() {
-    if (!tlas_ || entities_.empty()) {
-        return;
+void Scene::FillTlasInstances() {
+    // TLAS instances from all entities, then the array instances
+    tlas_instances_.clear();
+    tlas_instances_.reserve(entities_.size() + instance_array_.GetCount());
+    tlas_slots_.assign(entities_.size(), -1);
+
+    for (size_t i = 0; i < entities_.size(); ++i) {
+        if (entities_[i]->GetBLAS()) {
+            tlas_slots_[i] = static_cast<int>(tlas_instances_.size());
+            tlas_instances_.push_back(MakeInstance(i));
+        }
     }
+    for (size_t k = 0; k < instance_array_.GetCount(); ++k) {
+        uint32_t entity_index = instance_array_.entity_indices[k];
+        grassland::graphics::AccelerationStructure* blas = entities_[entity_index]->GetBLAS();
+        if (blas) {
+            // Same custom index as the entity, so materials and vertex streams are shared
+            tlas_instances_.push_back(blas->MakeInstance(instance_array_.transforms[k], entity_index, 0xFF, 0,
+                                                         grassland::graphics::RAYTRACING_INSTANCE_FLAG_NONE));
+        }
+    }
+}
 
-    // Recreate instances with updated transforms
-    std::vector<grassland::graphics::RayTracingInstance> instances;
-    instances.reserve(entities_.size());
+void Scene::BuildLods(size_t level_count) {
+    auto start = std::chrono::steady_clock::now();
+    // Entities sharing a mesh share its levels; simplify each mesh once. Large meshes take the
+    // pool one at a time (SimplifyMesh splits them into parallel chunks), small ones one per task.
+    constexpr size_t kLargeIndexCount = size_t(3) << 16;
+    std::unordered_set<const grassland::Mesh<float> *> seen;
+    std::vector<Entity *> meshes, small;
+    for (const auto &entity : entities_) {
+        if (entity->GetLodCount() > 1 || !seen.insert(&entity->GetMesh()).second) continue;
+        meshes.push_back(entity.get());
+        if (entity->GetMesh().NumIndices() >= kLargeIndexCount) {
+            entity->BuildLods(level_count);
+        } else {
+            small.push_back(entity.get());
+        }
+    }
+    ThreadPool::Instance().Run(small.size(), [&](size_t i, unsigned) { small[i]->BuildLods(level_count); });
 
+    // Triangles per level over the simplified meshes; meshes with fewer levels count their coarsest.
+    // Every level gets its buffers and BLAS (and CPU bottom level) now, so SelectLod only swaps
+    // instances instead of building them when camera navigation starts.
+    std::vector<size_t> triangles(level_count + 1, 0);
+    for (Entity *entity : meshes) {
+        size_t lod = entity->GetLod();
+        for (size_t level = 0; level <= level_count; ++level) {
+            entity->SelectLod(level);
+            triangles[level] += entity->GetMesh().NumIndices() / 3;
+            if (core_ && !entity->GetBLAS()) {
+                entity->BuildBLAS(core_, vertex_layout_);
+            }
+        }
+        entity->SelectLod(lod);
+    }
+    if (cpu_bvh_) {
+        cpu_bvh_->BuildMeshes(CollectLevelMeshes());
+    }
+    std::string levels;
+    for (size_t level = 0; level <= level_count; ++level) {
+        levels += (level ? " -> " : "") + std::to_string(triangles[level]);
+    }
+    grassland::LogInfo("Built LODs for {} meshes in {:.1f} ms: {} triangles", meshes.size(),
+                       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), levels);
+
+    if (lod_level_ != 0) {
+        SelectLod(lod_level_); // Entities added earlier clamped to level 0
+    }
+}
+
+void Scene::SelectLod(size_t level) {
+    lod_level_ = level;
+    bool changed = false;
     for (size_t i = 0; i < entities_.size(); ++i) {
-        auto& entity = entities_[i];
-        if (entity->GetBLAS()) {
-            // Convert mat4 to mat4x3
-            glm::mat4x3 transform_3x4 = glm::mat4x3(entity->GetTransform());
-            
-            auto instance = entity->GetBLAS()->MakeInstance(
-                transform_3x4,
-                static_cast<uint32_t>(i),
-                0xFF,
-                0,
-                grassland::graphics::RAYTRACING_INSTANCE_FLAG_NONE
-            );
-            instances.push_back(instance);
+        Entity &entity = *entities_[i];
+        size_t previous = entity.GetLod();
+        entity.SelectLod(level);
+        if (entity.GetLod() == previous) continue;
+        changed = true;
+        if (core_ && !entity.GetBLAS()) {
+            entity.BuildBLAS(core_, vertex_layout_); // Only levels built outside Scene::BuildLods
         }
+        SetEntityBuffers(i);
+    }
+    if (!changed || (!tlas_ && !cpu_bvh_)) {
+        return;
+    }
+
+    // Same instances with other BLASes: the TLAS is updated in place unless an instance appeared
+    // or vanished
+    ClearDirtyInstances();
+    if (core_ && tlas_) {
+        size_t previous_count = tlas_instances_.size();
+        FillTlasInstances();
+        if (tlas_instances_.size() == previous_count) {
+            tlas_->UpdateInstances(tlas_instances_);
+        } else {
+            core_->CreateTopLevelAccelerationStructure(tlas_instances_, &tlas_);
+        }
+        UpdateVertexFormatsBuffer();
+    }
+    if (cpu_bvh_) {
+        cpu_bvh_->Build(entities_, instance_array_); // Bottom levels exist; only the top level is rebuilt
+    }
+    grassland::LogInfo("Selected LOD {}", level);
+}
+
+void Scene::UpdateInstances() {
+    if (dirty_instances_.empty()) {
+        return;
     }
 
-    // Update TLAS
-    tlas_->UpdateInstances(instances);
+    // Only the instances of moved entities are rewritten
+    if (core_ && tlas_) {
+        for (uint32_t index : dirty_instances_) {
+            if (index < tlas_slots_.size() && tlas_slots_[index] >= 0) {
+                tlas_instances_[tlas_slots_[index]] = MakeInstance(index);
+            }
+        }
+        tlas_->UpdateInstances(tlas_instances_);
+    }
+    if (cpu_bvh_ && cpu_bvh_->IsBuilt()) {
+        cpu_bvh_->Refit(dirty_instances_);
+    }
+    ClearDirtyInstances();
 }
 
 void Scene::UpdateLightsBuffer() {
-    if (lights_.empty()) {
+    if (!core_ || lights_.empty()) {
         lights_buffer_.reset();
         return;
     }
@@ -163,7 +1160,7 @@ void Scene::UpdateLightsBuffer() {
 
 
 void Scene::UpdateMaterialsBuffer() {
-    if (entities_.empty()) {
+    if (!core_ || entities_.empty()) {
         return;
     }
 
@@ -188,8 +1185,46 @@ void Scene::UpdateMaterialsBuffer() {
     grassland::LogInfo("Updated materials buffer with {} materials", materials.size());
 }
 
+void Scene::UpdateVertexFormatsBuffer() {
+    if (!core_ || entities_.empty()) {
+        return;
+    }
+
+    std::vector<VertexFormat> formats;
+    formats.reserve(entities_.size());
+    for (const auto& entity : entities_) {
+        formats.push_back(entity->GetVertexFormat());
+    }
+
+    size_t buffer_size = formats.size() * sizeof(VertexFormat);
+    if (!vertex_formats_buffer_) {
+        core_->CreateBuffer(buffer_size,
+                          grassland::graphics::BUFFER_TYPE_DYNAMIC,
+                          &vertex_formats_buffer_);
+    }
+    vertex_formats_buffer_->UploadData(formats.data(), buffer_size);
+}
+
+void Scene::UpdateTextureMipsBuffer() {
+    if (!core_) {
+        return;
+    }
+
+    // One entry at least, so the binding is valid in scenes without textures
+    std::vector<TextureMipRange> ranges = texture_mips_;
+    if (ranges.empty()) {
+        ranges.emplace_back();
+    }
+    // Recreated each time: textures may have been added since the last upload
+    size_t buffer_size = ranges.size() * sizeof(TextureMipRange);
+    core_->CreateBuffer(buffer_size,
+                      grassland::graphics::BUFFER_TYPE_DYNAMIC,
+                      &texture_mips_buffer_);
+    texture_mips_buffer_->UploadData(ranges.data(), buffer_size);
+}
+
 void Scene::BuildSampler() {
-    if (!linear_wrap_sampler_) {
+    if (core_ && !linear_wrap_sampler_) {
         grassland::graphics::SamplerInfo info{};
         info.min_filter = grassland::graphics::FILTER_MODE_LINEAR;
         info.mag_filter = grassland::graphics::FILTER_MODE_LINEAR;
@@ -203,66 +1238,134 @@ void Scene::BuildSampler() {
 }
 
 void Scene::LoadFromGLB(const std::string& gltf_path) {
+    using Clock = std::chrono::steady_clock;
+    auto Ms = [](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+    auto load_start = Clock::now();
+    const size_t skipped_streams_before = skipped_stream_count_;
+    const size_t skipped_bytes_before = skipped_stream_bytes_;
+    auto log_skipped_streams = [&]() {
+        if (skipped_stream_count_ > skipped_streams_before) {
+            grassland::LogInfo("Skipped {} absent vertex attribute streams, saving {:.2f} MB of default-filled buffers",
+                               skipped_stream_count_ - skipped_streams_before,
+                               (skipped_stream_bytes_ - skipped_bytes_before) / (1024.0 * 1024.0));
+        }
+    };
+
+    // A cache written from the same file contents skips parsing and image decode altogether
+    GlbSource glb;
+    uint64_t source_hash = 0;
+    std::string cache_path = SceneCache::GetCachePath(gltf_path);
+    std::string texture_cache_dir = gltf_path + ".bccache";
+    bool use_cache = use_scene_cache_ && glb.file.Open(gltf_path);
+    if (use_cache) {
+        source_hash = SceneCache::HashFile(glb.file);
+        // Optimized and as-exported geometry are different caches of the same file
+        if (optimize_meshes_) source_hash = ~source_hash;
+        auto hash_end = Clock::now();
+        SceneCache cache;
+        if (cache.Open(cache_path, source_hash)) {
+            LoadFromCache(cache, texture_cache_dir);
+            grassland::LogInfo("Scene load {:.1f} ms from cache {} (hash {:.1f} ms): {} entities of {} meshes, {} textures",
+                               Ms(load_start, Clock::now()), cache_path, Ms(load_start, hash_end),
+                               cache.GetEntities().size(), cache.GetMeshes().size(), cache.GetTextures().size());
+            log_skipped_streams();
+            return;
+        }
+    }
+
     tinygltf::Model model;
     tinygltf::TinyGLTF loader;
+    // Images are decoded below on the ThreadPool instead of serially inside the parser
+    loader.SetImageLoader(DeferImageDecode, nullptr);
     std::string err, warn;
-    bool ok = loader.LoadBinaryFromFile(&model, &err, &warn, gltf_path);
+    bool ok = LoadGlb(loader, gltf_path, &glb, &model, &err, &warn);
 
     if (!warn.empty()) {
         grassland::LogWarning("glTF warn: {}", warn);
     }
 
     if (!ok) {
-        grassland::LogError("Failed to load {}", gltf_path, err);
+        grassland::LogError("Failed to load {}: {}", gltf_path, err);
         return ;
     }
+    auto parse_end = Clock::now();
 
-    grassland::LogInfo("Loaded glTF: scenes={}, meshes={}, materials={}, textures={}",
-                        model.scenes.size(), model.meshes.size(), model.materials.size(), model.textures.size());
-    
-    // Step 1 : Load textures to GPU and create Shader Resource Views
-    std::vector<grassland::graphics::Image*> baseColorSRVs;
-    baseColorSRVs.reserve(model.textures.size()); // Total textures
-    
-    for (size_t ti = 0; ti < model.textures.size(); ++ti) {
-        // 首先 texture 会有一个连到对应 image 的 source 索引，我们把它对应的 image 找到
-        const auto &tex = model.textures[ti];
-        if (tex.source < 0 || tex.source >= (int)model.images.size()) {
-            baseColorSRVs.push_back(nullptr); // Don't forget we need to keep the index consistent
-            grassland::LogWarning("Texture {} has invalid source {}", (int)ti, tex.source);
-            continue;
-        }
-        const auto &img = model.images[tex.source];
-
-        // 接着，transform image to a R8G8B8A8_UNORM format
-        int w = img.width;
-        int h = img.height;
-        int comp = img.component;
-        if (comp != 4) {
-            grassland::LogWarning("Texture {} has {} components; expected RGBA4. Will pad.", (int)ti, comp);
-        }
-        std::vector<uint8_t> rgba;
-        rgba.resize(w * h * 4, 255);
-        // Copy/pad channels
-        for (int y = 0; y < h; ++y) {
-            for (int x = 0; x < w; ++x) {
-                int dst = (y * w + x) * 4;
-                int src = (y * w + x) * comp;
-                for (int c = 0; c < comp && c < 4; ++c) rgba[dst + c] = img.image[src + c];
-                if (comp < 4) rgba[dst + 3] = 255;
+    grassland::LogInfo("Loaded glTF: scenes={}, meshes={}, materials={}, textures={} ({})",
+                        model.scenes.size(), model.meshes.size(), model.materials.size(), model.textures.size(),
+                        glb.bin ? "mapped BIN chunk" : "copied buffers");
+
+    // Start of a buffer's bytes: the mapped BIN chunk, or the copy tinygltf made
+    auto buffer_data = [&](int buffer) -> const uint8_t * {
+        return glb.bin ? glb.bin : model.buffers[buffer].data.data();
+    };
+
+    // Step 1 : Read the primitives the nodes draw
+    std::vector<std::vector<PrimitiveGeometry>> geometries(model.meshes.size());
+    std::vector<PrimitiveGeometry *> to_prepare;
+    size_t generated_normals = 0, generated_tangents = 0, generated_triangles = 0;
+    for (const auto &node : model.nodes) {
+        if (node.mesh < 0 || !geometries[node.mesh].empty()) continue;
+        const auto &mesh = model.meshes[node.mesh];
+        geometries[node.mesh].resize(mesh.primitives.size());
+        for (size_t pi = 0; pi < mesh.primitives.size(); ++pi) {
+            PrimitiveGeometry &geometry = geometries[node.mesh][pi];
+            if (!ReadPrimitive(model, mesh.primitives[pi], mesh.name, buffer_data, &geometry)) continue;
+            if (geometry.generate_normals || geometry.generate_tangents) {
+                generated_normals += geometry.generate_normals;
+                generated_tangents += geometry.generate_tangents;
+                generated_triangles += geometry.index_count / 3;
+            } else if (!optimize_meshes_) {
+                continue;
             }
+            to_prepare.push_back(&geometry);
         }
+    }
+    auto read_end = Clock::now();
 
-        // 把这个图读进去
-        grassland::graphics::Image *gpuImage = nullptr;
-        core_->CreateImage(w, h, grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM, &gpuImage);
-        gpuImage->UploadData(rgba.data()); // .data() 返回指针
-        baseColorSRVs.push_back(gpuImage);
-
-        // grassland::LogInfo("Created GPU texture {} ({}x{}, comp={})", (int)ti, w, h, comp);
+    // Step 2 : Generate the normals and tangents the primitives lack, optimize them and decode every
+    // image, as one job on the shared pool: the images are tasks next to the small primitives, so the
+    // decode neither waits for the pool nor competes with a second pool for the same cores
+    std::vector<DecodedImage> decoded_images(model.images.size());
+    RunPerPrimitive(to_prepare, [&](PrimitiveGeometry *geometry) {
+        if (geometry->generate_normals || geometry->generate_tangents) GenerateAttributes(geometry);
+        if (optimize_meshes_) OptimizePrimitive(geometry);
+    }, model.images.size(), [&](size_t i) {
+        tinygltf::Image &image = model.images[i];
+        if (image.bufferView >= 0) {
+            const auto &view = model.bufferViews[image.bufferView];
+            DecodeImage(buffer_data(view.buffer) + view.byteOffset, view.byteLength, image.name, &decoded_images[i]);
+        } else {
+            DecodeImage(image.image.data(), image.image.size(), image.name, &decoded_images[i]);
+            std::vector<unsigned char>().swap(image.image);
+        }
+    });
+    auto prepare_end = Clock::now();
+    if (generated_normals + generated_tangents > 0) {
+        grassland::LogInfo("Generated normals for {} and tangents for {} primitives ({} triangles)",
+                           generated_normals, generated_tangents, generated_triangles);
+    }
+    if (optimize_meshes_) {
+        MeshOptimizationStats total;
+        for (const PrimitiveGeometry *geometry : to_prepare) {
+            total.vertices_before += geometry->optimization.vertices_before;
+            total.vertices_after += geometry->optimization.vertices_after;
+            total.triangles_before += geometry->optimization.triangles_before;
+            total.triangles_after += geometry->optimization.triangles_after;
+        }
+        grassland::LogInfo("Optimized {} primitives for locality: {} -> {} vertices, {} degenerate triangles dropped",
+                           to_prepare.size(), total.vertices_before, total.vertices_after,
+                           total.triangles_before - total.triangles_after);
     }
 
     // Convert glTF meshes to Entities
+    const size_t first_entity = entities_.size();
+    const size_t first_instance = instance_array_.GetCount();
+    // Entity created for each (mesh, primitive); further nodes using it become instances of it
+    std::map<std::pair<int, size_t>, std::shared_ptr<Entity>> primitive_entities;
+    size_t instanced_primitives = 0;
+    size_t gpu_array_instances = 0;
     for (const auto &node : model.nodes) {
         if (node.mesh < 0) {
             grassland::LogWarning("Node {} has no mesh, skipping", node.name);
@@ -283,161 +1386,42 @@ void Scene::LoadFromGLB(const std::string& gltf_path) {
             if (!node.rotation.empty()) r = glm::quat((float)node.rotation[3], (float)node.rotation[0], (float)node.rotation[1], (float)node.rotation[2]);
             transform = glm::translate(glm::mat4(1.0f), t) * glm::mat4_cast(r) * glm::scale(glm::mat4(1.0f), s);
         }
-        
-        // Process each primitive in the mesh
-        for (const auto &prim : mesh.primitives) {
-
-            /*
-             * mesh理论上有 5 种东西。
-             * pos 存储的是这个 mesh 的本地的所有顶点的位置。
-             * uv 存储的是这个 mesh 的本地的所有顶点的纹理坐标。
-             * indices 存储的是组成这个 mesh 的三角形的顶点索引，也是本地的。  
-             * 还有一直被我忘掉的法线。
-             * 还有我都没见过的 tangent, tkpl
-             */
-
-            // 1 : position, a vec3
-            auto posIt = prim.attributes.find("POSITION");
-            if (posIt == prim.attributes.end()) {
-                grassland::LogWarning("Primitive missing POSITION attribute, skipping");
-                continue;
-            }
-            
-            const auto &posAccessor = model.accessors[posIt->second];
-            const auto &posView = model.bufferViews[posAccessor.bufferView];
-            const auto &posBuf = model.buffers[posView.buffer];
-            const uint8_t *posData = posBuf.data.data() + posView.byteOffset + posAccessor.byteOffset;
-            size_t posStride = posAccessor.ByteStride(posView);
-            if (posStride <= 0) {
-                grassland::LogWarning("Invalid POSITION accessor byte stride, use default");
-                posStride = sizeof(float) * 3;
-            }
-
-            // 2 : uv textcoordinate, a vec2
-            auto uvIt = prim.attributes.find("TEXCOORD_0");
-            const uint8_t *uvData = nullptr;
-            size_t uvStride = 0;
-            size_t uvCount = 0;
-            if (uvIt == prim.attributes.end()) {
-                grassland::LogWarning("Primitive missing TEXCOORD_0 attribute, use default");
-            } else {
-                const auto &uvAccessor = model.accessors[uvIt->second];
-                const auto &uvView = model.bufferViews[uvAccessor.bufferView];
-                const auto &uvBuf = model.buffers[uvView.buffer];
-                uvData = uvBuf.data.data() + uvView.byteOffset + uvAccessor.byteOffset;
-                uvStride = uvAccessor.ByteStride(uvView);
-                if (uvStride <= 0) {
-                    grassland::LogWarning("Invalid TEXCOORD_0 accessor byte stride, use default");
-                    uvStride = sizeof(float) * 2;
-                }
-                uvCount = uvAccessor.count;
-            }
 
-            // 3 : indices
-            if (prim.indices < 0) {
-                grassland::LogWarning("Primitive without indices not supported, skipping");
+        // EXT_mesh_gpu_instancing: the mesh is drawn once per instance. The first instance is the
+        // entity itself, the others only add a transform to the scene's instance array.
+        std::vector<glm::mat4x3> gpu_instances;
+        auto instancing = node.extensions.find("EXT_mesh_gpu_instancing");
+        if (instancing != node.extensions.end()) {
+            if (!ReadGpuInstances(model, instancing->second, buffer_data, transform, &gpu_instances)) {
+                grassland::LogWarning("Node {} has invalid EXT_mesh_gpu_instancing data, drawing it once", node.name);
+            } else if (gpu_instances.empty()) {
                 continue;
-            }
-
-            const auto &idxAccessor = model.accessors[prim.indices];
-            const auto &idxView = model.bufferViews[idxAccessor.bufferView];
-            const auto &idxBuf = model.buffers[idxView.buffer];
-            const uint8_t *idxData = idxBuf.data.data() + idxView.byteOffset + idxAccessor.byteOffset;
-
-            // 4 : normals
-
-            auto normalIt = prim.attributes.find("NORMAL");
-            const uint8_t *normalData = nullptr;
-            size_t normalStride = 0;
-            size_t normalCount = 0;
-            if (normalIt == prim.attributes.end()) {
-                grassland::LogWarning("Primitive missing NORMAL attribute, use default");
             } else {
-                grassland::LogInfo("Found NORMAL attribute for node {}", node.name);
-                const auto &normalAccessor = model.accessors[normalIt->second];
-                const auto &normalView = model.bufferViews[normalAccessor.bufferView];
-                const auto &normalBuf = model.buffers[normalView.buffer];
-                normalData = normalBuf.data.data() + normalView.byteOffset + normalAccessor.byteOffset;
-                normalStride = normalAccessor.ByteStride(normalView);
-                if (normalStride <= 0) {
-                    grassland::LogWarning("Invalid NORMAL accessor byte stride, use default");
-                    normalStride = sizeof(float) * 3;
-                }
-                normalCount = normalAccessor.count;
+                transform = glm::mat4(gpu_instances[0]);
+                gpu_array_instances += (gpu_instances.size() - 1) * mesh.primitives.size();
             }
-
-            // 5 : tangent 
-
-            auto tangentIt = prim.attributes.find("TANGENT");
-            const uint8_t *tangentData = nullptr;
-            size_t tangentStride = 0;
-            size_t tangentCount = 0;
-            if (tangentIt == prim.attributes.end()) {
-                grassland::LogWarning("Primitive missing TANGENT attribute, use default");
-            } else {
-                grassland::LogInfo("Found TANGENT attribute for node {}", node.name);
-                const auto &tangentAccessor = model.accessors[tangentIt->second];
-                const auto &tangentView = model.bufferViews[tangentAccessor.bufferView];
-                const auto &tangentBuf = model.buffers[tangentView.buffer];
-                tangentData = tangentBuf.data.data() + tangentView.byteOffset + tangentAccessor.byteOffset;
-                tangentStride = tangentAccessor.ByteStride(tangentView);
-                if (tangentStride <= 0) {
-                    grassland::LogWarning("Invalid TANGENT accessor byte stride, use default");
-                    tangentStride = sizeof(float) * 4;
-                }
-                tangentCount = tangentAccessor.count;
-            }
-
-            // 5 个 data 的位置准备好了，开始一个一个读取。
-            const size_t vertex_count = posAccessor.count;
-            std::vector<grassland::Vector3<float>> positions(vertex_count);
-            std::vector<grassland::Vector2<float>> texcoords;
-            std::vector<glm::vec2> upload_uvs;
-            std::vector<grassland::Vector3<float>> normals(vertex_count);
-            std::vector<grassland::Vector3<float>> tangents(vertex_count);
-
-            if (uvData) {
-                texcoords.resize(vertex_count, grassland::Vector2<float>(0.0f, 0.0f));
-                upload_uvs.resize(vertex_count, glm::vec2(0.0f));
-            } else {
-                upload_uvs.resize(vertex_count, glm::vec2(0.0f));
-            }
-
-            for (size_t i = 0; i < vertex_count; ++i) {
-                const float *p = reinterpret_cast<const float *>(posData + i * posStride);
-                positions[i] = grassland::Vector3<float>(p[0], p[1], p[2]);
-                if (uvData && i < uvCount) {
-                    const float *q = reinterpret_cast<const float *>(uvData + i * uvStride);
-                    texcoords[i] = grassland::Vector2<float>(q[0], q[1]);
-                    upload_uvs[i] = glm::vec2(q[0], q[1]);
-                }
-                if (normalData && i < normalCount) {
-                    const float *n = reinterpret_cast<const float *>(normalData + i * normalStride);
-                    normals[i] = grassland::Vector3<float>(n[0], n[1], n[2]);
-                }
-                if (tangentData && i < tangentCount) {
-                    const float *t = reinterpret_cast<const float *>(tangentData + i * tangentStride);
-                    if (t[3] != 1.0f)
-                        grassland::LogWarning("Tangent w component is not 1.0f");
-                    tangents[i] = grassland::Vector3<float>(t[0], t[1], t[2]);
-                }
+        }
+        auto add_node_entity = [&](const std::shared_ptr<Entity> &entity) {
+            AddEntity(entity);
+            if (gpu_instances.size() > 1 && !entities_.empty() && entities_.back() == entity) {
+                AddInstances(static_cast<uint32_t>(entities_.size() - 1), gpu_instances.data() + 1, gpu_instances.size() - 1);
             }
-
-            std::vector<uint32_t> indices(idxAccessor.count);
-            if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-                const uint16_t *src = reinterpret_cast<const uint16_t *>(idxData);
-                for (size_t i = 0; i < idxAccessor.count; ++i) indices[i] = static_cast<uint32_t>(src[i]);
-            } else if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
-                const uint32_t *src = reinterpret_cast<const uint32_t *>(idxData);
-                for (size_t i = 0; i < idxAccessor.count; ++i) indices[i] = src[i];
-            } else if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-                const uint8_t *src = reinterpret_cast<const uint8_t *>(idxData);
-                for (size_t i = 0; i < idxAccessor.count; ++i) indices[i] = static_cast<uint32_t>(src[i]);
-            } else {
-                grassland::LogError("Unsupported index type in glTF");
+        };
+        
+        // Process each primitive in the mesh
+        for (size_t pi = 0; pi < mesh.primitives.size(); ++pi) {
+            const auto &prim = mesh.primitives[pi];
+            auto shared = primitive_entities.find({ node.mesh, pi });
+            if (shared != primitive_entities.end()) {
+                // Same geometry and material, only the transform differs
+                add_node_entity(shared->second->Instantiate(shared->second->GetMaterial(), transform));
+                ++instanced_primitives;
                 continue;
             }
 
+            PrimitiveGeometry &geometry = geometries[node.mesh][pi];
+            if (!geometry.valid) continue;
+
             // 最后, the material
             Material mat(glm::vec4(1.0f), 0.5f, 0.0f);
             if (prim.material < 0 || prim.material >= static_cast<int>(model.materials.size())) {
@@ -493,25 +1477,264 @@ void Scene::LoadFromGLB(const std::string& gltf_path) {
                 );
             }
 
-            const grassland::Vector2<float> *texcoord_ptr = texcoords.empty() ? nullptr : texcoords.data();
-            const grassland::Vector3<float> *normal_ptr = normals.empty() ? nullptr : normals.data();
-            const grassland::Vector3<float> *tangent_ptr = tangents.empty() ? nullptr : tangents.data();
-            grassland::Mesh<float> mesh_asset(
-                vertex_count,
-                indices.size(),
-                indices.data(),
-                positions.data(),
-                normal_ptr,
-                texcoord_ptr,
-                tangent_ptr);
-
-            auto entity = std::make_shared<Entity>(mesh_asset, mat, transform);
-            AddEntity(entity);
+            grassland::Mesh<float> mesh_asset = geometry.optimized ? std::move(*geometry.optimized) : grassland::Mesh<float>(
+                geometry.vertex_count,
+                geometry.index_count,
+                geometry.indices,
+                geometry.positions,
+                geometry.normals,
+                geometry.texcoords,
+                geometry.tangents);
+
+            auto entity = std::make_shared<Entity>(std::move(mesh_asset), mat, transform);
+            if (geometry.tangent_signs) {
+                entity->SetTangentSigns(std::vector<float>(geometry.tangent_signs, geometry.tangent_signs + geometry.vertex_count));
+            }
+            add_node_entity(entity);
+            primitive_entities[{ node.mesh, pi }] = entity;
+            // The mesh holds its own copy now; later nodes drawing the primitive instance the entity
+            geometries[node.mesh][pi] = PrimitiveGeometry();
+        }
+    }
+    auto meshes_end = Clock::now();
+    if (instanced_primitives > 0) {
+        grassland::LogInfo("Shared geometry: {} primitives drawn as {} entities",
+                           primitive_entities.size(), primitive_entities.size() + instanced_primitives);
+    }
+    if (gpu_array_instances > 0) {
+        grassland::LogInfo("EXT_mesh_gpu_instancing: {} array instances", gpu_array_instances);
+    }
+
+    // Step 3 : Upload the decoded images to GPU and create Shader Resource Views. Textures with the
+    // same pixels (the same image referenced twice, or identical images embedded twice) and the same
+    // sampler share one slot, and the materials are remapped to the slots. Slots that differ only by
+    // sampler share the GPU image.
+    std::vector<CachedTexture> images(model.images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        const DecodedImage &img = decoded_images[i];
+        if (!img.pixels.empty()) images[i] = { img.width, img.height, img.pixels.data(), img.channels };
+    }
+    std::vector<size_t> image_owners = FindIdenticalTextures(images);
+
+    std::vector<int> texture_slots(model.textures.size(), -1);
+    std::vector<size_t> slot_images;
+    std::map<std::pair<size_t, int>, int> slot_keys;
+    size_t referenced_bytes = 0;
+    for (size_t ti = 0; ti < model.textures.size(); ++ti) {
+        // 首先 texture 会有一个连到对应 image 的 source 索引，我们把它对应的 image 找到
+        const auto &tex = model.textures[ti];
+        if (tex.source < 0 || tex.source >= (int)model.images.size()) {
+            grassland::LogWarning("Texture {} has invalid source {}", (int)ti, tex.source);
+            continue;
+        }
+        if (!images[tex.source].rgba8) {
+            grassland::LogWarning("Texture {} uses image {} that failed to decode", (int)ti, tex.source);
+            continue;
+        }
+        size_t image = image_owners[tex.source];
+        referenced_bytes += size_t(images[image].width) * images[image].height * 4;
+        auto slot = slot_keys.emplace(std::make_pair(image, tex.sampler), static_cast<int>(slot_images.size()));
+        if (slot.second) slot_images.push_back(image);
+        texture_slots[ti] = slot.first->second;
+    }
+    for (size_t i = first_entity; i < entities_.size(); ++i) {
+        Material material = entities_[i]->GetMaterial();
+        RemapTextures(&material, texture_slots);
+        entities_[i]->SetMaterial(material);
+    }
+
+    const size_t slot_count = slot_images.size();
+    std::vector<grassland::graphics::Image*> baseColorSRVs(slot_count, nullptr);
+    std::vector<HostTexture> hostTextures(KeepsHostTextures() ? slot_count : 0);
+    // Pixels stay valid until the cache is written: they live in decoded_images or the host textures they move to
+    std::vector<CachedTexture> cached_textures(slot_count);
+    std::vector<CachedTexture> level_sources(slot_count); // Null for slots sharing an earlier slot's image
+    std::vector<int> image_slots(model.images.size(), -1);
+    // Several slots may share one image; the last of them takes the pixels without a copy
+    std::vector<int> image_users(model.images.size(), 0);
+    for (size_t image : slot_images) ++image_users[image];
+    // Grey and grey + alpha images stay narrow on the host and in the cache; the GPU, mips and BC
+    // compression get an RGBA8 expansion that lives until they are built
+    std::vector<std::vector<uint8_t>> expanded(slot_count);
+    size_t uploaded_images = 0, uploaded_bytes = 0;
+    size_t narrow_images = 0, narrow_bytes = 0, narrow_rgba8_bytes = 0;
+    double expand_ms = 0.0;
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        size_t image = slot_images[slot];
+        DecodedImage &img = decoded_images[image];
+        --image_users[image];
+        cached_textures[slot] = images[image];
+        if (image_slots[image] >= 0) {
+            baseColorSRVs[slot] = baseColorSRVs[image_slots[image]];
+        } else {
+            image_slots[image] = static_cast<int>(slot);
+            ++uploaded_images;
+            uploaded_bytes += size_t(img.width) * img.height * 4;
+            if (img.channels != 4) {
+                ++narrow_images;
+                narrow_bytes += img.pixels.size();
+                narrow_rgba8_bytes += size_t(img.width) * img.height * 4;
+            }
+            auto expand_start = Clock::now();
+            level_sources[slot] = ExpandedTexture(images[image], &expanded[slot]);
+            expand_ms += Ms(expand_start, Clock::now());
+            // 把这个图读进去 (R8G8B8A8_UNORM; narrow images were expanded above)
+            if (core_) {
+                core_->CreateImage(img.width, img.height, grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM, &baseColorSRVs[slot]);
+                baseColorSRVs[slot]->UploadData(level_sources[slot].rgba8); // 指向 RGBA8 像素
+            }
         }
+
+        if (!hostTextures.empty()) {
+            hostTextures[slot].width = img.width;
+            hostTextures[slot].height = img.height;
+            hostTextures[slot].channels = img.channels;
+            hostTextures[slot].rgba8 = image_users[image] == 0 ? std::move(img.pixels) : img.pixels;
+        }
+    }
+    if (narrow_images > 0) {
+        grassland::LogInfo("Narrow textures: {} grey or grey + alpha images keep {:.2f} MB on the host instead of "
+                           "{:.2f} MB of RGBA8, {:.1f} ms expanding them for upload",
+                           narrow_images, narrow_bytes / (1024.0 * 1024.0), narrow_rgba8_bytes / (1024.0 * 1024.0), expand_ms);
+    }
+    if (slot_count < model.textures.size() || uploaded_bytes < referenced_bytes) {
+        grassland::LogInfo("Texture dedup: {} textures -> {} slots, {} images uploaded, saved {:.2f} MB of level 0 "
+                           "RGBA8 uploads and their mip chains",
+                           model.textures.size(), slot_count, uploaded_images,
+                           (referenced_bytes - uploaded_bytes) / (1024.0 * 1024.0));
     }
 
-    // Register texture SRVs array to scene for binding
+    // Register texture SRVs array to scene for binding; the smaller levels follow the textures
     SetBaseColorTextures(baseColorSRVs);
+    host_textures_ = std::move(hostTextures); // Before the mips, which append their host levels
+    BuildTextureMips(0, level_sources);
+    CompressTextures(0, level_sources, texture_cache_dir);
+    for (size_t slot = 0; slot < slot_count; ++slot) {
+        if (!level_sources[slot].rgba8) ShareTextureLevels(slot, image_slots[slot_images[slot]]);
+    }
+    expanded = {};
+    host_textures_.resize(base_color_srvs_.size());
+    auto load_end = Clock::now();
+
+    grassland::LogInfo("Scene load {:.1f} ms: parse {:.1f} ms, read primitives {:.1f} ms, attribute generation, "
+                       "optimization and image decode {:.1f} ms ({} primitives, {} images, {} threads), "
+                       "entities {:.1f} ms, texture upload {:.1f} ms",
+                       Ms(load_start, load_end), Ms(load_start, parse_end), Ms(parse_end, read_end),
+                       Ms(read_end, prepare_end), to_prepare.size(), model.images.size(),
+                       ThreadPool::Instance().GetWorkerCount(), Ms(prepare_end, meshes_end), Ms(meshes_end, load_end));
+    log_skipped_streams();
+
+    if (use_cache) {
+        // Shared meshes are stored once; entities refer to them by index
+        std::vector<CachedMesh> cached_meshes;
+        std::vector<CachedEntity> cached_entities(entities_.size() - first_entity);
+        std::unordered_map<const grassland::Mesh<float> *, uint32_t> mesh_indices;
+        for (size_t i = 0; i < cached_entities.size(); ++i) {
+            const Entity &entity = *entities_[first_entity + i];
+            const grassland::Mesh<float> &mesh = entity.GetMesh();
+            auto inserted = mesh_indices.emplace(&mesh, static_cast<uint32_t>(cached_meshes.size()));
+            if (inserted.second) {
+                CachedMesh cached;
+                cached.vertex_count = static_cast<uint32_t>(mesh.NumVertices());
+                cached.index_count = static_cast<uint32_t>(mesh.NumIndices());
+                cached.indices = mesh.Indices();
+                cached.positions = mesh.Positions();
+                cached.normals = mesh.Normals();
+                cached.tangents = mesh.Tangents();
+                cached.texcoords = mesh.TexCoords();
+                cached.tangent_signs = entity.GetTangentSigns().empty() ? nullptr : entity.GetTangentSigns().data();
+                cached_meshes.push_back(cached);
+            }
+            CachedEntity &cached = cached_entities[i];
+            cached.transform = entity.GetTransform();
+            cached.material = entity.GetMaterial();
+            cached.mesh = inserted.first->second;
+        }
+        // Array instances added by this load, with entity indices relative to its first entity
+        std::vector<uint32_t> instance_entities(instance_array_.GetCount() - first_instance);
+        for (size_t k = 0; k < instance_entities.size(); ++k) {
+            instance_entities[k] = instance_array_.entity_indices[first_instance + k] - static_cast<uint32_t>(first_entity);
+        }
+        CachedInstances cached_instances;
+        cached_instances.count = instance_entities.size();
+        cached_instances.transforms = instance_array_.transforms.data() + first_instance;
+        cached_instances.entities = instance_entities.data();
+        auto write_start = Clock::now();
+        if (SceneCache::Write(cache_path, source_hash, cached_meshes, cached_entities, cached_instances, cached_textures)) {
+            grassland::LogInfo("Wrote scene cache {} in {:.1f} ms", cache_path, Ms(write_start, Clock::now()));
+        }
+    }
+}
+
+void Scene::LoadFromCache(const SceneCache& cache, const std::string& texture_cache_dir) {
+    const uint32_t first_entity = static_cast<uint32_t>(entities_.size());
+    // The first entity of each mesh owns it, later ones are instances
+    std::vector<std::shared_ptr<Entity>> mesh_owners(cache.GetMeshes().size());
+    for (const CachedEntity &cached : cache.GetEntities()) {
+        std::shared_ptr<Entity> &owner = mesh_owners[cached.mesh];
+        if (owner) {
+            AddEntity(owner->Instantiate(cached.material, cached.transform));
+            continue;
+        }
+        const CachedMesh &mesh = cache.GetMeshes()[cached.mesh];
+        grassland::Mesh<float> mesh_asset(
+            mesh.vertex_count,
+            mesh.index_count,
+            mesh.indices,
+            mesh.positions,
+            mesh.normals,
+            mesh.texcoords,
+            mesh.tangents);
+        owner = std::make_shared<Entity>(std::move(mesh_asset), cached.material, cached.transform);
+        if (mesh.tangent_signs) {
+            owner->SetTangentSigns(std::vector<float>(mesh.tangent_signs, mesh.tangent_signs + mesh.vertex_count));
+        }
+        AddEntity(owner);
+    }
+    const CachedInstances &instances = cache.GetInstances();
+    for (size_t k = 0; k < instances.count;) {
+        // Runs of instances of the same entity go in with one call
+        size_t run_end = k + 1;
+        while (run_end < instances.count && instances.entities[run_end] == instances.entities[k]) ++run_end;
+        AddInstances(first_entity + instances.entities[k], instances.transforms + k, run_end - k);
+        k = run_end;
+    }
+
+    // Slots are deduplicated when the cache is written; those differing only by sampler share the GPU image
+    const std::vector<CachedTexture> &textures = cache.GetTextures();
+    std::vector<size_t> owners = FindIdenticalTextures(textures);
+    std::vector<CachedTexture> level_sources(textures.size());
+    std::vector<grassland::graphics::Image*> srvs(textures.size(), nullptr);
+    std::vector<HostTexture> hostTextures(KeepsHostTextures() ? textures.size() : 0);
+    // Grey and grey + alpha textures are cached narrow and expanded for the GPU, mips and BC compression
+    std::vector<std::vector<uint8_t>> expanded(textures.size());
+    for (size_t ti = 0; ti < textures.size(); ++ti) {
+        const CachedTexture &texture = textures[ti];
+        if (!texture.rgba8) continue;
+        if (owners[ti] != ti) {
+            srvs[ti] = srvs[owners[ti]];
+        } else {
+            level_sources[ti] = ExpandedTexture(texture, &expanded[ti]);
+            if (core_) {
+                core_->CreateImage(texture.width, texture.height, grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM, &srvs[ti]);
+                srvs[ti]->UploadData(level_sources[ti].rgba8);
+            }
+        }
+        if (!hostTextures.empty()) {
+            hostTextures[ti].width = texture.width;
+            hostTextures[ti].height = texture.height;
+            hostTextures[ti].channels = texture.channels;
+            hostTextures[ti].rgba8.assign(texture.rgba8, texture.rgba8 + TextureBytes(texture));
+        }
+    }
+    SetBaseColorTextures(srvs);
+    host_textures_ = std::move(hostTextures); // Before the mips, which append their host levels
+    BuildTextureMips(0, level_sources);
+    CompressTextures(0, level_sources, texture_cache_dir);
+    for (size_t ti = 0; ti < textures.size(); ++ti) {
+        if (textures[ti].rgba8 && owners[ti] != ti) ShareTextureLevels(ti, owners[ti]);
+    }
+    host_textures_.resize(base_color_srvs_.size());
 }
 
 // ============================================================================
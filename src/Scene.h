@@ -2,9 +2,16 @@
 #include "long_march.h"
 #include "Entity.h"
 #include "Material.h"
+#include "SceneBvh.h"
+#include "TextureCompression.h"
+#include "TextureMips.h"
+#include "TexturePacking.h"
 #include <vector>
 #include <memory>
 
+class SceneCache;
+struct CachedTexture;
+
 enum LightType {
     LIGHT_POINT = 0,
     LIGHT_AREA = 1,
@@ -32,8 +39,29 @@ struct LightTriangle {
     glm::vec3 emission; float pad3;
 };
 
-// Scene manages a collection of entities and builds the TLAS
-class Scene {
+// One cluster of one entity
+struct ClusterRef {
+    uint32_t entity;
+    uint32_t cluster; // Index into the entity's MeshClusters::clusters
+};
+
+// CPU copy of a texture, used by the CPU renderer and offline tools.
+// LDR textures are stored as RGBA8, HDR ones (skybox) as RGBA32F.
+struct HostTexture {
+    int width = 0;
+    int height = 0;
+    int channels = 4; // Bytes per texel of rgba8: 1 grey, 2 grey + alpha, 4 RGBA
+    std::vector<uint8_t> rgba8;
+    std::vector<float> rgba32f;
+
+    bool IsValid() const { return width > 0 && height > 0 && (!rgba8.empty() || !rgba32f.empty()); }
+};
+
+// Scene manages a collection of entities and builds the TLAS.
+// A Scene created with a null core is CPU-only: no GPU resources are created and
+// textures are kept as HostTextures for the CPU renderer.
+// Entity::SetTransform marks the entity's instance dirty; UpdateInstances() only rewrites dirty instances.
+class Scene : private TransformListener {
 public:
     Scene(grassland::graphics::Core* core);
     ~Scene();
@@ -47,12 +75,51 @@ public:
     // Build/rebuild the TLAS from all entities
     void BuildAccelerationStructures();
 
-    // Update TLAS instances (e.g., for animation)
+    // Update TLAS instances (e.g., for animation); only entities moved since the last update are touched
     void UpdateInstances();
 
-    // Build from .glb file
+    // Build the two-level CPU BVH (done by BuildAccelerationStructures for CPU-only scenes)
+    void BuildCpuAccelerationStructures();
+
+    // CPU BVH over all entities, refit by UpdateInstances; null until built
+    const SceneBvh* GetCpuBvh() const { return cpu_bvh_.get(); }
+
+    // Split the entity meshes that have no clusters yet (MeshClusters.h); meshes shared by several
+    // entities are split once. Cluster refs then address every cluster of every entity, with the
+    // geometry in Entity::GetClusters() (object space; array instances reuse their entity's).
+    void BuildMeshClusters(size_t max_triangles = kClusterTriangles);
+    const std::vector<ClusterRef>& GetClusterRefs() const { return cluster_refs_; }
+
+    // Build up to level_count simplified levels (MeshSimplification.h) of the entity meshes that
+    // have none yet; meshes shared by several entities are simplified once. Every level gets its
+    // buffers and BLAS here, and its CPU bottom level when a CPU BVH exists.
+    void BuildLods(size_t level_count = 3);
+
+    // Render every entity at the given LOD (clamped per mesh to the levels built); 0 is full
+    // detail. The levels' BLASes exist since BuildLods, so this only updates the TLAS instances in
+    // place (and rebuilds the CPU top level). Entities added later start at this level.
+    void SelectLod(size_t level);
+    size_t GetLod() const { return lod_level_; }
+
+    // Build from .glb file. Uses (and refreshes) the binary scene cache next to the file unless disabled.
     void LoadFromGLB(const std::string& glb_file_path);
 
+    // Whether LoadFromGLB reads and writes the binary scene cache (SceneCache.h); on by default
+    void SetUseSceneCache(bool use) { use_scene_cache_ = use; }
+
+    // Whether LoadFromGLB runs OptimizeMeshLocality (MeshOptimization.h) over every primitive; off by default
+    void SetOptimizeMeshes(bool optimize) { optimize_meshes_ = optimize; }
+
+    // Whether LoadFromGLB block-compresses the loaded textures (TextureCompression.h) by material
+    // role: BC7 for base colour and metallic-roughness, BC1 for emissive, BC5 for normal maps (red and
+    // green only), BC4 for occlusion. Encoded blocks are only written to <file>.bccache/: the graphics
+    // layer has no block-compressed image formats, so the device images stay RGBA8 and the blocks are
+    // not kept in memory. Off by default.
+    void SetTextureCompression(bool enabled, BcQuality quality = BcQuality::kBalanced) {
+        compress_textures_ = enabled;
+        texture_quality_ = quality;
+    }
+
     // Get the TLAS for rendering
     grassland::graphics::AccelerationStructure* GetTLAS() const { return tlas_.get(); }
 
@@ -62,6 +129,14 @@ public:
     // Get all entities
     const std::vector<std::shared_ptr<Entity>>& GetEntities() const { return entities_; }
 
+    // Add instances that draw an entity's geometry and material without an Entity each
+    // (EXT_mesh_gpu_instancing); transforms are object-to-world 3x4 matrices. Included by the
+    // next BuildAccelerationStructures(); they are static afterwards.
+    void AddInstances(uint32_t entity_index, const glm::mat4x3* transforms, size_t count);
+
+    // Instances added with AddInstances; they follow the entities in the TLAS and CPU BVH
+    const InstanceArray& GetInstanceArray() const { return instance_array_; }
+
     // Add a light to the scene
     void AddLight(const Light& light);
 
@@ -80,34 +155,68 @@ public:
     grassland::graphics::Buffer* GetLightsBuffer() const { return lights_buffer_.get(); }
 
     // Get all vertex buffers
-    std::vector<grassland::graphics::Buffer*> GetVertexBuffers() const { return vertex_buffers_; }
+    const std::vector<grassland::graphics::Buffer*>& GetVertexBuffers() const { return vertex_buffers_; }
 
     // Get all index buffers
-    std::vector<grassland::graphics::Buffer*> GetIndexBuffers() const { return index_buffers_; }
+    const std::vector<grassland::graphics::Buffer*>& GetIndexBuffers() const { return index_buffers_; }
 
     // Get all normal buffers
-    std::vector<grassland::graphics::Buffer*> GetNormalBuffers() const { return normal_buffers_; }
+    const std::vector<grassland::graphics::Buffer*>& GetNormalBuffers() const { return normal_buffers_; }
 
     // Get all texcoord buffers
-    std::vector<grassland::graphics::Buffer*> GetTexcoordBuffers() const { return texcoord_buffers_; }
+    const std::vector<grassland::graphics::Buffer*>& GetTexcoordBuffers() const { return texcoord_buffers_; }
 
     // Get all tangent buffers
-    std::vector<grassland::graphics::Buffer*> GetTangentBuffers() const { return tangent_buffers_; }
+    const std::vector<grassland::graphics::Buffer*>& GetTangentBuffers() const { return tangent_buffers_; }
+
+    // Get all interleaved attribute buffers (VertexLayout::kInterleaved)
+    const std::vector<grassland::graphics::Buffer*>& GetAttributeBuffers() const { return attribute_buffers_; }
+
+    // Get all packed (quantized) attribute buffers (VertexLayout::kQuantized)
+    const std::vector<grassland::graphics::Buffer*>& GetPackedVertexBuffers() const { return packed_vertex_buffers_; }
+
+    // Per-entity VertexFormat (stream mask and packed layout), indexed like the materials
+    grassland::graphics::Buffer* GetVertexFormatsBuffer() const { return vertex_formats_buffer_.get(); }
+
+    // Vertex layout of the GPU buffers of entities added from now on. Every buffer array above is
+    // filled for every entity either way: absent streams and the arrays the layout does not use
+    // hold a shared one-element dummy buffer, so all shader bindings stay valid
+    // (RenderSettings::vertex_layout and VertexFormat::stream_mask tell the shaders what to read).
+    void SetVertexLayout(VertexLayout layout) { vertex_layout_ = layout; }
+    VertexLayout GetVertexLayout() const { return vertex_layout_; }
 
     // Get base color texture count
     size_t GetBaseColorTextureCount() const { return base_color_srvs_.size(); }
 
     // Add a texture to the scene (takes ownership)
     int AddTexture(std::unique_ptr<grassland::graphics::Image> texture);
+
+    // Add an RGBA8 texture with its full mip chain (TextureMips.h); srgb marks colour textures
+    // (base colour, emissive) so their levels are filtered in linear light. Scenes keeping host
+    // textures keep every level as one, for the CPU renderer.
+    int AddTexture(int width, int height, const uint8_t* rgba8, bool srgb);
+
+    // Packs separate occlusion, roughness and metallic maps into one ORM texture (TexturePacking.h)
+    // sized like the largest map, for metallic_roughness_tex and AO_texture; missing maps are
+    // constants. Added like AddTexture above; returns -1 when every source is a constant.
+    int AddOrmTexture(const ChannelSource& occlusion, const ChannelSource& roughness, const ChannelSource& metallic);
+
+    // Mip range of every entry of GetBaseColorTextureSRVs() (TextureMipRange), indexed like it: the
+    // buffer bound to the shaders and its host copy
+    grassland::graphics::Buffer* GetTextureMipsBuffer() const { return texture_mips_buffer_.get(); }
+    const std::vector<TextureMipRange>& GetTextureMipRanges() const { return texture_mips_; }
     
     // Follow the order of entity, create and attach texcoord buffer
     //void CreateAndAttachTexcoordBuffer(const std::vector<glm::vec2>& uvs);
 
     // Get base color texture SRV array
-    std::vector<grassland::graphics::Image*> GetBaseColorTextureSRVs() const { return base_color_srvs_; }
+    const std::vector<grassland::graphics::Image*>& GetBaseColorTextureSRVs() const { return base_color_srvs_; }
 
     // Base color textures SRV array setter
-    void SetBaseColorTextures(const std::vector<grassland::graphics::Image*>& srvs) { base_color_srvs_ = srvs; }
+    void SetBaseColorTextures(const std::vector<grassland::graphics::Image*>& srvs) {
+        base_color_srvs_ = srvs;
+        texture_mips_.assign(srvs.size(), TextureMipRange());
+    }
 
     // Get linear wrap sampler
     grassland::graphics::Sampler* GetLinearWrapSampler() const { return linear_wrap_sampler_; }
@@ -125,8 +234,22 @@ public:
         return entities_[index];
     }
     
-    // Get core pointer (for texture loading)
+    // Get core pointer (for texture loading); null for CPU-only scenes
     grassland::graphics::Core* GetCore() const { return core_; }
+
+    // Whether GPU resources are created for this scene
+    bool HasDevice() const { return core_ != nullptr; }
+
+    // Keep CPU copies of loaded textures even when a device is present (always on for CPU-only scenes)
+    void SetKeepHostTextures(bool keep) { keep_host_textures_ = keep; }
+    bool KeepsHostTextures() const { return keep_host_textures_ || !core_; }
+
+    // CPU copies of the textures and their mip levels, indexed like GetBaseColorTextureSRVs(); invalid
+    // where no copy was kept
+    const std::vector<HostTexture>& GetHostTextures() const { return host_textures_; }
+
+    // Add a CPU-only texture (CPU-only scenes); returns its texture index
+    int AddHostTexture(HostTexture texture);
     
     // Apply multi-layer material to an entity
     void ApplyMultiLayerMaterial(size_t entity_index,
@@ -141,8 +264,30 @@ public:
     // Get skybox texture
     grassland::graphics::Image* GetSkyboxTexture() const { return skybox_texture_.get(); }
 
+    // CPU copy of the skybox (RGBA32F equirectangular map)
+    void SetSkyboxHostTexture(HostTexture texture) { host_skybox_ = std::move(texture); }
+    const HostTexture& GetSkyboxHostTexture() const { return host_skybox_; }
+
 private:
+    void OnTransformChanged(uint32_t instance_index) override;
+    void LoadFromCache(const SceneCache& cache, const std::string& texture_cache_dir);
+    grassland::graphics::RayTracingInstance MakeInstance(size_t entity_index) const;
+    void FillTlasInstances();
+    void SetEntityBuffers(size_t index); // Per-entity buffer arrays from the entity's selected LOD
+    void ClearDirtyInstances();
+    std::vector<const grassland::Mesh<float>*> CollectLevelMeshes(); // Distinct meshes of LOD levels 1..
+
     void UpdateMaterialsBuffer();
+    void UpdateVertexFormatsBuffer();
+    void UpdateTextureMipsBuffer();
+    // Uploads the smaller levels of textures[i] as texture first_texture + i; colour textures are
+    // found from the entity materials
+    void BuildTextureMips(size_t first_texture, const std::vector<CachedTexture>& textures);
+    void AddMipLevels(size_t texture, std::vector<MipLevel> levels);
+    // Block-compresses textures[i] (texture first_texture + i) into the cache in cache_dir
+    void CompressTextures(size_t first_texture, const std::vector<CachedTexture>& textures, const std::string& cache_dir);
+    // Gives a texture sharing owner's level 0 image the owner's mip range
+    void ShareTextureLevels(size_t texture, size_t owner);
     void UpdateLightsBuffer();
 
     grassland::graphics::Core* core_;
@@ -156,9 +301,36 @@ private:
     std::vector<grassland::graphics::Buffer*> normal_buffers_;
     std::vector<grassland::graphics::Buffer*> tangent_buffers_;
     std::vector<grassland::graphics::Buffer*> texcoord_buffers_;
+    std::vector<grassland::graphics::Buffer*> attribute_buffers_;
+    std::vector<grassland::graphics::Buffer*> packed_vertex_buffers_;
+    std::unique_ptr<grassland::graphics::Buffer> vertex_formats_buffer_;
+    std::unique_ptr<grassland::graphics::Buffer> dummy_buffer_; // Bound for absent streams
+    size_t skipped_stream_count_ = 0; // Default-filled streams not uploaded (load-time report)
+    size_t skipped_stream_bytes_ = 0;
+    VertexLayout vertex_layout_ = VertexLayout::kSeparate;
+    size_t lod_level_ = 0;
     std::vector<grassland::graphics::Image*> base_color_srvs_;
     std::vector<std::unique_ptr<grassland::graphics::Image>> texture_storage_; // Owns the textures
     std::unique_ptr<grassland::graphics::Image> skybox_texture_;
+    std::vector<TextureMipRange> texture_mips_; // Indexed like base_color_srvs_
+    std::unique_ptr<grassland::graphics::Buffer> texture_mips_buffer_;
     grassland::graphics::Sampler* linear_wrap_sampler_ = nullptr;
+
+    // Persistent TLAS instance list; tlas_slots_ maps entity index -> slot (-1 without BLAS)
+    std::vector<grassland::graphics::RayTracingInstance> tlas_instances_;
+    std::vector<int> tlas_slots_;
+    std::vector<uint32_t> dirty_instances_;
+    std::vector<uint8_t> instance_dirty_;
+    InstanceArray instance_array_;
+    std::unique_ptr<SceneBvh> cpu_bvh_;
+    std::vector<ClusterRef> cluster_refs_;
+
+    bool keep_host_textures_ = false;
+    bool use_scene_cache_ = true;
+    bool optimize_meshes_ = false;
+    bool compress_textures_ = false;
+    BcQuality texture_quality_ = BcQuality::kBalanced;
+    std::vector<HostTexture> host_textures_;
+    HostTexture host_skybox_;
 };
 
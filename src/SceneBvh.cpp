@@ -0,0 +1,294 @@
+#include "SceneBvh.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <unordered_map>
+
+namespace {
+constexpr uint32_t kNoLeaf = 0xFFFFFFFFu;
+
+Aabb NodeBounds(const BvhNode& node) {
+    Aabb box;
+    box.min_p = node.bounds_min;
+    box.max_p = node.bounds_max;
+    return box;
+}
+} // namespace
+
+void SceneBvh::BuildMeshes(const std::vector<const grassland::Mesh<float>*>& meshes) {
+    std::vector<CpuMeshBvh*> targets;
+    std::vector<const grassland::Mesh<float>*> sources;
+    for (const grassland::Mesh<float>* mesh : meshes) {
+        std::unique_ptr<CpuMeshBvh>& mesh_bvh = meshes_[mesh];
+        if (mesh_bvh) continue;
+        mesh_bvh = std::make_unique<CpuMeshBvh>();
+        targets.push_back(mesh_bvh.get());
+        sources.push_back(mesh);
+    }
+
+    // Large meshes parallelize their own build; small ones are built one per task
+    auto build_mesh = [&](size_t m) {
+        const grassland::Mesh<float>& mesh = *sources[m];
+        targets[m]->bvh.Build(reinterpret_cast<const glm::vec3*>(mesh.Positions()), mesh.NumVertices(),
+                              mesh.Indices(), mesh.NumIndices());
+        targets[m]->wide_bvh.Build(targets[m]->bvh);
+    };
+    for (size_t m = 0; m < targets.size(); ++m) {
+        if (sources[m]->NumIndices() / 3 >= MeshBvh::kParallelBuildThreshold) {
+            build_mesh(m);
+        }
+    }
+    ThreadPool::Instance().Run(targets.size(), [&](size_t m, unsigned) {
+        if (!targets[m]->bvh.IsBuilt()) {
+            build_mesh(m);
+        }
+    });
+}
+
+void SceneBvh::Build(const std::vector<std::shared_ptr<Entity>>& entities, const InstanceArray& instance_array) {
+    instances_.clear();
+    instances_.resize(entities.size() + instance_array.GetCount());
+
+    auto start = std::chrono::steady_clock::now();
+    // One bottom level per distinct mesh; instanced entities return the same Mesh object
+    std::vector<const grassland::Mesh<float>*> mesh_sources;
+    for (size_t i = 0; i < entities.size(); ++i) {
+        const Entity* entity = entities[i].get();
+        CpuInstance& inst = instances_[i];
+        inst.entity = entity;
+        inst.entity_index = static_cast<uint32_t>(i);
+        if (!entity || !entity->IsValid()) {
+            continue;
+        }
+        const grassland::Mesh<float>& mesh = entity->GetMesh();
+        // Eigen and glm vectors share the tightly packed float layout (the GPU upload relies on it too)
+        inst.positions = reinterpret_cast<const glm::vec3*>(mesh.Positions());
+        inst.normals = reinterpret_cast<const glm::vec3*>(mesh.Normals());
+        inst.tangents = reinterpret_cast<const glm::vec3*>(mesh.Tangents());
+        inst.tangent_signs = entity->GetTangentSigns().empty() ? nullptr : entity->GetTangentSigns().data();
+        inst.texcoords = reinterpret_cast<const glm::vec2*>(mesh.TexCoords());
+        inst.indices = mesh.Indices();
+        mesh_sources.push_back(&mesh);
+    }
+    BuildMeshes(mesh_sources);
+    std::unordered_map<const grassland::Mesh<float>*, const CpuMeshBvh*> used_meshes;
+    for (size_t i = 0; i < entities.size(); ++i) {
+        const Entity* entity = instances_[i].entity;
+        if (!entity || !entity->IsValid()) continue;
+        const grassland::Mesh<float>* mesh = &entity->GetMesh();
+        instances_[i].mesh_bvh = meshes_[mesh].get();
+        used_meshes.emplace(mesh, instances_[i].mesh_bvh);
+    }
+
+    // Array instances reuse the streams and bottom level of the entity they draw
+    for (size_t k = 0; k < instance_array.GetCount(); ++k) {
+        uint32_t entity_index = instance_array.entity_indices[k];
+        if (entity_index < entities.size()) {
+            instances_[entities.size() + k] = instances_[entity_index];
+            instances_[entities.size() + k].entity_index = entity_index;
+        }
+    }
+    ParallelFor(0, instances_.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            CpuInstance& inst = instances_[i];
+            if (!inst.entity) continue;
+            UpdateTransform(inst, i < entities.size() ? inst.entity->GetTransform()
+                                                      : glm::mat4(instance_array.transforms[i - entities.size()]));
+        }
+    });
+
+    // Top level over the world bounds of every instance that has geometry
+    std::vector<uint32_t> members;
+    std::vector<Aabb> member_bounds;
+    for (uint32_t i = 0; i < instances_.size(); ++i) {
+        if (instances_[i].mesh_bvh && instances_[i].mesh_bvh->bvh.IsBuilt()) {
+            members.push_back(i);
+            member_bounds.push_back(instances_[i].world_bounds);
+        }
+    }
+    std::vector<uint32_t> prim_indices;
+    BuildBvh(member_bounds, &nodes_, &prim_indices);
+    leaf_instances_.resize(prim_indices.size());
+    for (size_t k = 0; k < prim_indices.size(); ++k) {
+        leaf_instances_[k] = members[prim_indices[k]];
+    }
+
+    parents_.assign(nodes_.size(), 0);
+    instance_leaf_.assign(instances_.size(), kNoLeaf);
+    for (uint32_t n = 0; n < nodes_.size(); ++n) {
+        const BvhNode& node = nodes_[n];
+        if (node.IsLeaf()) {
+            for (uint32_t i = 0; i < node.prim_count; ++i) {
+                instance_leaf_[leaf_instances_[node.left_first + i]] = n;
+            }
+        } else {
+            parents_[node.left_first] = n;
+            parents_[node.left_first + 1] = n;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t triangle_count = 0;
+    for (const auto& used : used_meshes) {
+        triangle_count += used.second->bvh.GetTriangleCount();
+    }
+    grassland::LogInfo("Built CPU BVH: {} instances of {} meshes ({} triangles, {} top-level nodes) in {:.1f} ms",
+                       instances_.size(), used_meshes.size(), triangle_count, nodes_.size(), seconds * 1000.0);
+}
+
+void SceneBvh::UpdateTransform(CpuInstance& instance, const glm::mat4& object_to_world) {
+    instance.world_bounds = Aabb();
+    instance.object_to_world = object_to_world;
+    instance.world_to_object = glm::inverse(instance.object_to_world);
+    if (!instance.mesh_bvh || !instance.mesh_bvh->bvh.IsBuilt()) return;
+    const Aabb& local = instance.mesh_bvh->bvh.GetBounds();
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 p((corner & 1) ? local.max_p.x : local.min_p.x,
+                    (corner & 2) ? local.max_p.y : local.min_p.y,
+                    (corner & 4) ? local.max_p.z : local.min_p.z);
+        instance.world_bounds.Grow(glm::vec3(instance.object_to_world * glm::vec4(p, 1.0f)));
+    }
+}
+
+void SceneBvh::RefitLeaf(uint32_t node_index) {
+    BvhNode& leaf = nodes_[node_index];
+    Aabb box;
+    for (uint32_t i = 0; i < leaf.prim_count; ++i) {
+        box.Grow(instances_[leaf_instances_[leaf.left_first + i]].world_bounds);
+    }
+    leaf.bounds_min = box.min_p;
+    leaf.bounds_max = box.max_p;
+
+    // Walk up until an ancestor's bounds do not change; everything above it is still valid
+    uint32_t node = node_index;
+    while (node != 0) {
+        node = parents_[node];
+        BvhNode& parent = nodes_[node];
+        Aabb merged = NodeBounds(nodes_[parent.left_first]);
+        merged.Grow(NodeBounds(nodes_[parent.left_first + 1]));
+        if (merged.min_p == parent.bounds_min && merged.max_p == parent.bounds_max) {
+            break;
+        }
+        parent.bounds_min = merged.min_p;
+        parent.bounds_max = merged.max_p;
+    }
+}
+
+void SceneBvh::Refit(const std::vector<uint32_t>& dirty_instances) {
+    for (uint32_t index : dirty_instances) {
+        if (index >= instances_.size()) continue;
+        if (!instances_[index].entity) continue;
+        UpdateTransform(instances_[index], instances_[index].entity->GetTransform());
+        if (instance_leaf_[index] != kNoLeaf) {
+            RefitLeaf(instance_leaf_[index]);
+        }
+    }
+}
+
+bool SceneBvh::IntersectClosest(const CpuRay& ray, CpuHit* hit) const {
+    if (nodes_.empty()) return false;
+    glm::vec3 inv_dir = SafeInverse(ray.direction);
+    float t_max = ray.t_max;
+    bool found = false;
+
+    uint32_t stack[MeshBvh::kMaxDepth * 2];
+    int stack_size = 0;
+    if (IntersectAabb(nodes_[0].bounds_min, nodes_[0].bounds_max, ray.origin, inv_dir, ray.t_min, t_max) ==
+        std::numeric_limits<float>::infinity()) {
+        return false;
+    }
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const BvhNode& node = nodes_[stack[--stack_size]];
+        if (node.IsLeaf()) {
+            for (uint32_t i = 0; i < node.prim_count; ++i) {
+                uint32_t instance_index = leaf_instances_[node.left_first + i];
+                const CpuInstance& instance = instances_[instance_index];
+                CpuRay local = ToObjectSpace(instance, ray);
+                local.t_max = t_max;
+                CpuHit local_hit;
+                if (instance.mesh_bvh->wide_bvh.IntersectClosest(local, &local_hit)) {
+                    t_max = local_hit.t;
+                    *hit = local_hit;
+                    hit->instance = instance_index;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        const BvhNode& a = nodes_[node.left_first];
+        const BvhNode& b = nodes_[node.left_first + 1];
+        float ta = IntersectAabb(a.bounds_min, a.bounds_max, ray.origin, inv_dir, ray.t_min, t_max);
+        float tb = IntersectAabb(b.bounds_min, b.bounds_max, ray.origin, inv_dir, ray.t_min, t_max);
+        uint32_t near_index = node.left_first, far_index = node.left_first + 1;
+        if (tb < ta) {
+            std::swap(ta, tb);
+            std::swap(near_index, far_index);
+        }
+        if (tb != std::numeric_limits<float>::infinity()) stack[stack_size++] = far_index;
+        if (ta != std::numeric_limits<float>::infinity()) stack[stack_size++] = near_index;
+    }
+    return found;
+}
+
+int SceneBvh::IntersectClosest(const RayPacket8& packet, CpuHit* hits) const {
+    if (nodes_.empty() || !packet.active_mask) return 0;
+    PacketRays rays(packet);
+    alignas(32) float t_max[RayPacket8::kSize];
+    simd::Store(t_max, PacketRays::LoadTMax(packet));
+    int hit_mask = 0;
+
+    uint32_t stack[MeshBvh::kMaxDepth * 2];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const BvhNode& node = nodes_[stack[--stack_size]];
+        alignas(32) float t_enter[RayPacket8::kSize];
+        int mask = rays.IntersectBox(node.bounds_min.x, node.bounds_min.y, node.bounds_min.z,
+                                     node.bounds_max.x, node.bounds_max.y, node.bounds_max.z,
+                                     simd::Load(t_max), t_enter);
+        if (!mask) continue;
+
+        if (node.IsLeaf()) {
+            for (uint32_t i = 0; i < node.prim_count; ++i) {
+                uint32_t instance_index = leaf_instances_[node.left_first + i];
+                const CpuInstance& instance = instances_[instance_index];
+                // Only the rays that reached this leaf are transformed and traced
+                RayPacket8 local;
+                for (int m = mask; m; m &= m - 1) {
+                    int lane = simd::FirstLane(m);
+                    CpuRay ray = packet.GetRay(lane);
+                    ray.t_max = t_max[lane];
+                    local.SetRay(lane, ToObjectSpace(instance, ray));
+                }
+                CpuHit local_hits[RayPacket8::kSize];
+                for (int m = instance.mesh_bvh->wide_bvh.IntersectClosest(local, local_hits); m; m &= m - 1) {
+                    int lane = simd::FirstLane(m);
+                    hits[lane] = local_hits[lane];
+                    hits[lane].instance = instance_index;
+                    t_max[lane] = local_hits[lane].t;
+                    hit_mask |= 1 << lane;
+                }
+            }
+            continue;
+        }
+
+        // Both children are tested on pop; the one whose center lies nearer along the first
+        // active ray is pushed last so it is visited first
+        int lane = simd::FirstLane(mask);
+        glm::vec3 origin(packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane]);
+        glm::vec3 direction(packet.dir_x[lane], packet.dir_y[lane], packet.dir_z[lane]);
+        const BvhNode& a = nodes_[node.left_first];
+        const BvhNode& b = nodes_[node.left_first + 1];
+        float da = glm::dot((a.bounds_min + a.bounds_max) * 0.5f - origin, direction);
+        float db = glm::dot((b.bounds_min + b.bounds_max) * 0.5f - origin, direction);
+        uint32_t near_index = node.left_first, far_index = node.left_first + 1;
+        if (db < da) {
+            std::swap(near_index, far_index);
+        }
+        stack[stack_size++] = far_index;
+        stack[stack_size++] = near_index;
+    }
+    return hit_mask;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "long_march.h"
+#include "Entity.h"
+#include "Bvh.h"
+#include "WideBvh.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Bottom level of one mesh, shared by all entities instancing it
+struct CpuMeshBvh {
+    MeshBvh bvh;
+    WideBvh wide_bvh; // 8-wide copy of bvh used by the ray queries
+};
+
+// Instances that have no Entity of their own (EXT_mesh_gpu_instancing), as flat arrays: per
+// instance a 3x4 object-to-world matrix and the index of the entity whose geometry and material
+// it draws
+struct InstanceArray {
+    std::vector<glm::mat4x3> transforms;
+    std::vector<uint32_t> entity_indices;
+
+    size_t GetCount() const { return entity_indices.size(); }
+    void Clear() {
+        transforms.clear();
+        entity_indices.clear();
+    }
+};
+
+// Geometry of one scene instance as seen by the CPU tracer
+struct CpuInstance {
+    const Entity* entity = nullptr;
+    uint32_t entity_index = 0; // Differs from the instance index for InstanceArray entries
+    const CpuMeshBvh* mesh_bvh = nullptr; // Null for entities without geometry
+    glm::mat4 object_to_world{ 1.0f };
+    glm::mat4 world_to_object{ 1.0f };
+    Aabb world_bounds;
+
+    // Vertex streams (point into the entity's mesh; null when the mesh has none)
+    const glm::vec3* positions = nullptr;
+    const glm::vec3* normals = nullptr;
+    const glm::vec3* tangents = nullptr;
+    const float* tangent_signs = nullptr; // Null when every sign is +1
+    const glm::vec2* texcoords = nullptr;
+    const uint32_t* indices = nullptr;
+};
+
+// Two-level CPU acceleration structure: one MeshBvh per distinct mesh (bottom level, shared by
+// entities created with Entity::Instantiate) and a BVH over the instances' world bounds (top level).
+// Instances are the entities (same indices as in the Scene) followed by the InstanceArray entries;
+// CpuInstance::entity_index plays the role of InstanceID() on the GPU. Transform changes are
+// applied with Refit(), which only touches the given instances and their ancestors. Bottom levels
+// are kept across Build() calls, so rebuilding for another LOD only rebuilds the top level.
+class SceneBvh {
+public:
+    // Build both levels for the given entities and array instances (the entities must outlive the SceneBvh)
+    void Build(const std::vector<std::shared_ptr<Entity>>& entities, const InstanceArray& instance_array);
+
+    // Build the bottom levels of the given meshes that have none yet (e.g. every LOD at load), for
+    // later Build() calls to pick up. The meshes must outlive the SceneBvh.
+    void BuildMeshes(const std::vector<const grassland::Mesh<float>*>& meshes);
+
+    // Re-read the transforms of the listed entities and refit the top level above them
+    void Refit(const std::vector<uint32_t>& dirty_instances);
+
+    bool IsBuilt() const { return !instances_.empty(); }
+
+    // Closest hit in world space; hit->instance is the entity index
+    bool IntersectClosest(const CpuRay& ray, CpuHit* hit) const;
+
+    // Any hit in world space. accept(instance, primitive, u, v) can reject candidates (alpha testing).
+    template <class AcceptFn>
+    bool IntersectAny(const CpuRay& ray, AcceptFn&& accept) const;
+
+    // Closest hits of a packet of coherent rays (e.g. primary rays); returns the mask of lanes that hit
+    int IntersectClosest(const RayPacket8& packet, CpuHit* hits) const;
+
+    const std::vector<CpuInstance>& GetInstances() const { return instances_; }
+    const std::vector<BvhNode>& GetNodes() const { return nodes_; }
+
+private:
+    static void UpdateTransform(CpuInstance& instance, const glm::mat4& object_to_world);
+    void RefitLeaf(uint32_t node_index);
+    static CpuRay ToObjectSpace(const CpuInstance& instance, const CpuRay& ray);
+
+    std::unordered_map<const grassland::Mesh<float>*, std::unique_ptr<CpuMeshBvh>> meshes_;
+    std::vector<CpuInstance> instances_;
+    std::vector<BvhNode> nodes_;
+    std::vector<uint32_t> leaf_instances_;  // Leaf entries -> instance index
+    std::vector<uint32_t> parents_;         // Parent of every node (root points to itself)
+    std::vector<uint32_t> instance_leaf_;   // Instance -> leaf node holding it
+};
+
+inline CpuRay SceneBvh::ToObjectSpace(const CpuInstance& instance, const CpuRay& ray) {
+    // The direction is not renormalized so t stays a world-space distance
+    return CpuRay{ glm::vec3(instance.world_to_object * glm::vec4(ray.origin, 1.0f)), ray.t_min,
+                   glm::vec3(instance.world_to_object * glm::vec4(ray.direction, 0.0f)), ray.t_max };
+}
+
+template <class AcceptFn>
+bool SceneBvh::IntersectAny(const CpuRay& ray, AcceptFn&& accept) const {
+    if (nodes_.empty()) return false;
+    glm::vec3 inv_dir = SafeInverse(ray.direction);
+    uint32_t stack[MeshBvh::kMaxDepth * 2];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const BvhNode& node = nodes_[stack[--stack_size]];
+        if (IntersectAabb(node.bounds_min, node.bounds_max, ray.origin, inv_dir, ray.t_min, ray.t_max) ==
+            std::numeric_limits<float>::infinity()) {
+            continue;
+        }
+        if (node.IsLeaf()) {
+            for (uint32_t i = 0; i < node.prim_count; ++i) {
+                uint32_t instance_index = leaf_instances_[node.left_first + i];
+                const CpuInstance& instance = instances_[instance_index];
+                bool blocked = instance.mesh_bvh->wide_bvh.IntersectAny(ToObjectSpace(instance, ray), [&](uint32_t primitive, float u, float v) {
+                    return accept(instance_index, primitive, u, v);
+                });
+                if (blocked) {
+                    return true;
+                }
+            }
+        } else {
+            stack[stack_size++] = node.left_first;
+            stack[stack_size++] = node.left_first + 1;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,336 @@
+#include "SceneCache.h"
+#include "ThreadPool.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+constexpr uint32_t kMagic = 0x4353534Du; // "MSSC"
+constexpr size_t kAlignment = 16;
+constexpr size_t kHashChunkSize = size_t(4) << 20;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t mesh_count;
+    uint32_t entity_count;
+    uint32_t texture_count;
+    uint32_t material_size; // Catches Material layout changes that forgot the version bump
+    uint32_t instance_count;
+    uint32_t reserved;
+    uint64_t instance_transforms;
+    uint64_t instance_entities;
+};
+
+// Offsets are from the start of the file; 0 marks an absent stream
+struct MeshRecord {
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint64_t indices;
+    uint64_t positions;
+    uint64_t normals;
+    uint64_t tangents;
+    uint64_t texcoords;
+    uint64_t tangent_signs;
+};
+
+struct EntityRecord {
+    float transform[16];
+    Material material;
+    uint32_t mesh;
+};
+
+struct TextureRecord {
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    uint32_t reserved;
+    uint64_t rgba8;
+};
+
+uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Four independent multiply-xorshift lanes over 8-byte words, then the tail byte by byte
+uint64_t HashChunk(const uint8_t* data, size_t size) {
+    uint64_t lanes[4] = { 0x9E3779B97F4A7C15ull, 0xBF58476D1CE4E5B9ull, 0x94D049BB133111EBull, 0x2545F4914F6CDD1Dull };
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int l = 0; l < 4; ++l) {
+            uint64_t word;
+            std::memcpy(&word, data + i + l * 8, sizeof(word));
+            lanes[l] = (lanes[l] ^ word) * 0x9E3779B97F4A7C15ull;
+            lanes[l] ^= lanes[l] >> 29;
+        }
+    }
+    uint64_t h = size;
+    for (; i < size; ++i) {
+        h = (h ^ data[i]) * 0x100000001B3ull;
+    }
+    for (uint64_t lane : lanes) {
+        h = Mix(h ^ lane);
+    }
+    return h;
+}
+
+size_t AlignUp(size_t value) {
+    return (value + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Payload range check for the reader
+bool InFile(uint64_t offset, uint64_t bytes, size_t file_size) {
+    return offset != 0 && offset % kAlignment == 0 && offset <= file_size && bytes <= file_size - offset;
+}
+} // namespace
+
+uint64_t SceneCache::HashFile(const MappedFile& file) {
+    return HashBytes(file.GetData(), file.GetSize());
+}
+
+uint64_t SceneCache::HashBytes(const uint8_t* data, size_t size) {
+    size_t chunk_count = (size + kHashChunkSize - 1) / kHashChunkSize;
+    std::vector<uint64_t> chunk_hashes(chunk_count);
+    ThreadPool::Instance().Run(chunk_count, [&](size_t chunk, unsigned) {
+        size_t begin = chunk * kHashChunkSize;
+        chunk_hashes[chunk] = HashChunk(data + begin, std::min(kHashChunkSize, size - begin));
+    });
+    uint64_t h = Mix(size);
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        h = Mix(h ^ (chunk_hashes[chunk] + chunk));
+    }
+    return h;
+}
+
+std::string SceneCache::GetCachePath(const std::string& source_path) {
+    return source_path + ".smcache";
+}
+
+bool SceneCache::Open(const std::string& cache_path, uint64_t source_hash) {
+    meshes_.clear();
+    entities_.clear();
+    textures_.clear();
+    instances_ = CachedInstances();
+    file_.Close();
+    std::error_code ec;
+    if (!std::filesystem::exists(cache_path, ec) || !file_.Open(cache_path)) {
+        return false;
+    }
+
+    const uint8_t* data = file_.GetData();
+    size_t size = file_.GetSize();
+    FileHeader header;
+    if (size < sizeof(header)) {
+        file_.Close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != kMagic || header.version != kVersion || header.material_size != sizeof(Material)) {
+        grassland::LogInfo("Scene cache {} is from another version, ignoring it", cache_path);
+        file_.Close();
+        return false;
+    }
+    if (header.source_hash != source_hash) {
+        grassland::LogInfo("Scene cache {} is out of date, ignoring it", cache_path);
+        file_.Close();
+        return false;
+    }
+
+    size_t mesh_table = AlignUp(sizeof(FileHeader));
+    size_t entity_table = AlignUp(mesh_table + sizeof(MeshRecord) * size_t(header.mesh_count));
+    size_t texture_table = AlignUp(entity_table + sizeof(EntityRecord) * size_t(header.entity_count));
+    if (texture_table + sizeof(TextureRecord) * size_t(header.texture_count) > size) {
+        grassland::LogWarning("Scene cache {} is truncated, ignoring it", cache_path);
+        file_.Close();
+        return false;
+    }
+
+    bool valid = true;
+    meshes_.resize(header.mesh_count);
+    for (uint32_t i = 0; i < header.mesh_count && valid; ++i) {
+        MeshRecord record;
+        std::memcpy(&record, data + mesh_table + i * sizeof(MeshRecord), sizeof(record));
+        CachedMesh& mesh = meshes_[i];
+        mesh.vertex_count = record.vertex_count;
+        mesh.index_count = record.index_count;
+        uint64_t vec3_bytes = uint64_t(record.vertex_count) * sizeof(grassland::Vector3<float>);
+        valid = InFile(record.indices, uint64_t(record.index_count) * sizeof(uint32_t), size) &&
+                InFile(record.positions, vec3_bytes, size) &&
+                (record.normals == 0 || InFile(record.normals, vec3_bytes, size)) &&
+                (record.tangents == 0 || InFile(record.tangents, vec3_bytes, size)) &&
+                (record.texcoords == 0 ||
+                 InFile(record.texcoords, uint64_t(record.vertex_count) * sizeof(grassland::Vector2<float>), size)) &&
+                (record.tangent_signs == 0 || InFile(record.tangent_signs, uint64_t(record.vertex_count) * sizeof(float), size));
+        if (!valid) break;
+        mesh.indices = reinterpret_cast<const uint32_t*>(data + record.indices);
+        mesh.positions = reinterpret_cast<const grassland::Vector3<float>*>(data + record.positions);
+        mesh.normals = record.normals ? reinterpret_cast<const grassland::Vector3<float>*>(data + record.normals) : nullptr;
+        mesh.tangents = record.tangents ? reinterpret_cast<const grassland::Vector3<float>*>(data + record.tangents) : nullptr;
+        mesh.texcoords = record.texcoords ? reinterpret_cast<const grassland::Vector2<float>*>(data + record.texcoords) : nullptr;
+        mesh.tangent_signs = record.tangent_signs ? reinterpret_cast<const float*>(data + record.tangent_signs) : nullptr;
+    }
+    entities_.resize(header.entity_count);
+    for (uint32_t i = 0; i < header.entity_count && valid; ++i) {
+        EntityRecord record;
+        std::memcpy(static_cast<void*>(&record), data + entity_table + i * sizeof(EntityRecord), sizeof(record));
+        CachedEntity& entity = entities_[i];
+        std::memcpy(&entity.transform, record.transform, sizeof(record.transform));
+        entity.material = record.material;
+        entity.mesh = record.mesh;
+        valid = record.mesh < header.mesh_count;
+    }
+    textures_.resize(header.texture_count);
+    for (uint32_t i = 0; i < header.texture_count && valid; ++i) {
+        TextureRecord record;
+        std::memcpy(&record, data + texture_table + i * sizeof(TextureRecord), sizeof(record));
+        CachedTexture& texture = textures_[i];
+        if (record.rgba8 == 0) continue;
+        valid = record.width > 0 && record.height > 0 &&
+                (record.channels == 1 || record.channels == 2 || record.channels == 4) &&
+                InFile(record.rgba8, uint64_t(record.width) * uint64_t(record.height) * record.channels, size);
+        texture.width = record.width;
+        texture.height = record.height;
+        texture.channels = record.channels;
+        texture.rgba8 = data + record.rgba8;
+    }
+    if (valid && header.instance_count > 0) {
+        valid = InFile(header.instance_transforms, uint64_t(header.instance_count) * sizeof(glm::mat4x3), size) &&
+                InFile(header.instance_entities, uint64_t(header.instance_count) * sizeof(uint32_t), size);
+        if (valid) {
+            instances_.count = header.instance_count;
+            instances_.transforms = reinterpret_cast<const glm::mat4x3*>(data + header.instance_transforms);
+            instances_.entities = reinterpret_cast<const uint32_t*>(data + header.instance_entities);
+            for (size_t i = 0; i < instances_.count && valid; ++i) {
+                valid = instances_.entities[i] < header.entity_count;
+            }
+        }
+    }
+    if (!valid) {
+        grassland::LogWarning("Scene cache {} is corrupt, ignoring it", cache_path);
+        meshes_.clear();
+        entities_.clear();
+        textures_.clear();
+        instances_ = CachedInstances();
+        file_.Close();
+        return false;
+    }
+    return true;
+}
+
+bool SceneCache::Write(const std::string& cache_path, uint64_t source_hash, const std::vector<CachedMesh>& meshes,
+                       const std::vector<CachedEntity>& entities, const CachedInstances& instances,
+                       const std::vector<CachedTexture>& textures) {
+    // Lay out the tables first, then every payload at a 16-byte aligned offset
+    size_t mesh_table = AlignUp(sizeof(FileHeader));
+    size_t entity_table = AlignUp(mesh_table + sizeof(MeshRecord) * meshes.size());
+    size_t texture_table = AlignUp(entity_table + sizeof(EntityRecord) * entities.size());
+    size_t payload_start = AlignUp(texture_table + sizeof(TextureRecord) * textures.size());
+    size_t offset = payload_start;
+    struct Payload {
+        const void* data;
+        size_t bytes;
+    };
+    std::vector<Payload> payloads;
+    auto place = [&](const void* data, size_t bytes) -> uint64_t {
+        if (!data) return 0;
+        uint64_t at = offset;
+        payloads.push_back({ data, bytes });
+        offset = AlignUp(offset + bytes);
+        return at;
+    };
+
+    std::vector<MeshRecord> mesh_records(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const CachedMesh& mesh = meshes[i];
+        MeshRecord& record = mesh_records[i];
+        record.vertex_count = mesh.vertex_count;
+        record.index_count = mesh.index_count;
+        size_t vec3_bytes = size_t(mesh.vertex_count) * sizeof(grassland::Vector3<float>);
+        record.indices = place(mesh.indices, size_t(mesh.index_count) * sizeof(uint32_t));
+        record.positions = place(mesh.positions, vec3_bytes);
+        record.normals = place(mesh.normals, vec3_bytes);
+        record.tangents = place(mesh.tangents, vec3_bytes);
+        record.texcoords = place(mesh.texcoords, size_t(mesh.vertex_count) * sizeof(grassland::Vector2<float>));
+        record.tangent_signs = place(mesh.tangent_signs, size_t(mesh.vertex_count) * sizeof(float));
+        if (!record.indices || !record.positions) {
+            grassland::LogWarning("Mesh {} is missing vertex streams, not writing scene cache", i);
+            return false;
+        }
+    }
+    std::vector<EntityRecord> entity_records(entities.size());
+    for (size_t i = 0; i < entities.size(); ++i) {
+        EntityRecord& record = entity_records[i];
+        std::memset(static_cast<void*>(&record), 0, sizeof(record));
+        std::memcpy(record.transform, &entities[i].transform, sizeof(record.transform));
+        record.material = entities[i].material;
+        record.mesh = entities[i].mesh;
+    }
+    std::vector<TextureRecord> texture_records(textures.size());
+    for (size_t i = 0; i < textures.size(); ++i) {
+        const CachedTexture& texture = textures[i];
+        texture_records[i] = { texture.width, texture.height, texture.channels, 0, 0 };
+        texture_records[i].rgba8 = place(texture.rgba8, size_t(texture.width) * texture.height * texture.channels);
+    }
+
+    uint64_t instance_transforms = 0, instance_entities = 0;
+    if (instances.count > 0) {
+        instance_transforms = place(instances.transforms, instances.count * sizeof(glm::mat4x3));
+        instance_entities = place(instances.entities, instances.count * sizeof(uint32_t));
+    }
+
+    FileHeader header = { kMagic, kVersion, source_hash, static_cast<uint32_t>(meshes.size()),
+                          static_cast<uint32_t>(entities.size()), static_cast<uint32_t>(textures.size()),
+                          static_cast<uint32_t>(sizeof(Material)), static_cast<uint32_t>(instances.count), 0,
+                          instance_transforms, instance_entities };
+    std::string temp_path = cache_path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            grassland::LogWarning("Cannot write scene cache {}", temp_path);
+            return false;
+        }
+        size_t written = 0;
+        const char zeros[kAlignment] = {};
+        auto write = [&](size_t at, const void* data, size_t bytes) {
+            out.write(zeros, static_cast<std::streamsize>(at - written));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            written = at + bytes;
+        };
+        write(0, &header, sizeof(header));
+        write(mesh_table, mesh_records.data(), sizeof(MeshRecord) * mesh_records.size());
+        write(entity_table, entity_records.data(), sizeof(EntityRecord) * entity_records.size());
+        write(texture_table, texture_records.data(), sizeof(TextureRecord) * texture_records.size());
+        size_t at = payload_start;
+        for (const Payload& payload : payloads) {
+            write(at, payload.data, payload.bytes);
+            at = AlignUp(at + payload.bytes);
+        }
+        if (!out) {
+            grassland::LogWarning("Failed writing scene cache {}", temp_path);
+            out.close();
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, cache_path, ec);
+    if (ec) {
+        // Windows refuses to rename over an existing file
+        std::filesystem::remove(cache_path, ec);
+        std::filesystem::rename(temp_path, cache_path, ec);
+    }
+    if (ec) {
+        grassland::LogWarning("Cannot replace scene cache {}: {}", cache_path, ec.message());
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "long_march.h"
+#include "Material.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+// One mesh of a cached scene. Arrays point into the cache mapping when read, or at the data
+// being written; normals, tangents and texcoords are null when the mesh lacks them, tangent_signs
+// (bitangent handedness per vertex) when every sign is +1.
+struct CachedMesh {
+    uint32_t vertex_count = 0;
+    uint32_t index_count = 0;
+    const uint32_t* indices = nullptr;
+    const grassland::Vector3<float>* positions = nullptr;
+    const grassland::Vector3<float>* normals = nullptr;
+    const grassland::Vector3<float>* tangents = nullptr;
+    const grassland::Vector2<float>* texcoords = nullptr;
+    const float* tangent_signs = nullptr;
+};
+
+// One entity of a cached scene; entities instancing the same mesh share its index
+struct CachedEntity {
+    glm::mat4 transform;
+    Material material;
+    uint32_t mesh = 0;
+};
+
+// One 8-bit texture of a cached scene with `channels` bytes per texel (1 grey, 2 grey + alpha,
+// 4 RGBA); rgba8 is null for texture slots that failed to load
+struct CachedTexture {
+    int width = 0;
+    int height = 0;
+    const uint8_t* rgba8 = nullptr;
+    int channels = 4;
+};
+
+// Array instances of cached entities (EXT_mesh_gpu_instancing); entity indices are into the
+// cached entity list
+struct CachedInstances {
+    size_t count = 0;
+    const glm::mat4x3* transforms = nullptr;
+    const uint32_t* entities = nullptr;
+};
+
+// Binary cache of what Scene::LoadFromGLB builds from a glTF file: vertex streams and indices in
+// upload layout (once per shared mesh), the entity transforms and Material table, the array
+// instances and decoded textures (grey images stay narrow). A cache file is keyed by a hash
+// of the source file and by kVersion (bump it whenever the cached layout or the loader's
+// post-processing changes), and is read through a memory mapping.
+class SceneCache {
+public:
+    static constexpr uint32_t kVersion = 10;
+
+    // Hash of a file's contents, computed in parallel chunks on the ThreadPool
+    static uint64_t HashFile(const MappedFile& file);
+    static uint64_t HashBytes(const uint8_t* data, size_t size);
+
+    // Cache file stored next to the source scene
+    static std::string GetCachePath(const std::string& source_path);
+
+    // Maps a cache file. Fails (quietly if the file is missing) when it was written by another
+    // version or for a different source.
+    bool Open(const std::string& cache_path, uint64_t source_hash);
+
+    const std::vector<CachedMesh>& GetMeshes() const { return meshes_; }
+    const std::vector<CachedEntity>& GetEntities() const { return entities_; }
+    const std::vector<CachedTexture>& GetTextures() const { return textures_; }
+    const CachedInstances& GetInstances() const { return instances_; }
+
+    // Writes a cache file (through a temporary file, so a partial write is never picked up)
+    static bool Write(const std::string& cache_path, uint64_t source_hash, const std::vector<CachedMesh>& meshes,
+                      const std::vector<CachedEntity>& entities, const CachedInstances& instances,
+                      const std::vector<CachedTexture>& textures);
+
+private:
+    MappedFile file_;
+    std::vector<CachedMesh> meshes_;
+    std::vector<CachedEntity> entities_;
+    std::vector<CachedTexture> textures_;
+    CachedInstances instances_;
+};
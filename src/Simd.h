@@ -0,0 +1,345 @@
+#pragma once
+#include <cstdint>
+
+// 8-wide float vector for the CPU ray tracing kernels.
+// AVX2 when the compiler targets it (SHORTMARCH_AVX2 in CMake), two SSE registers on other
+// x86 builds and a plain array elsewhere. Comparisons return lane masks (all bits set or
+// clear) that can be combined with And/Or and turned into a bit mask with MoveMask.
+// Int8 holds eight 32-bit integer lanes for byte-level texture work (one RGBA8 texel per lane).
+// Define SHORTMARCH_NO_SIMD to force the portable path.
+
+#if defined(__AVX2__) && !defined(SHORTMARCH_NO_SIMD)
+#define SHORTMARCH_SIMD_AVX2 1
+#include <immintrin.h>
+#elif (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(SHORTMARCH_NO_SIMD)
+#define SHORTMARCH_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define SHORTMARCH_SIMD_SCALAR 1
+#include <cmath>
+#include <cstring>
+#endif
+
+namespace simd {
+
+#if defined(SHORTMARCH_SIMD_AVX2)
+
+struct Float8 {
+    __m256 v;
+};
+
+inline Float8 Broadcast(float x) { return { _mm256_set1_ps(x) }; }
+inline Float8 Load(const float* p) { return { _mm256_load_ps(p) }; } // 32-byte aligned
+inline void Store(float* p, Float8 a) { _mm256_store_ps(p, a.v); }
+inline Float8 LoadUnaligned(const float* p) { return { _mm256_loadu_ps(p) }; }
+inline void StoreUnaligned(float* p, Float8 a) { _mm256_storeu_ps(p, a.v); }
+inline Float8 operator+(Float8 a, Float8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Float8 operator-(Float8 a, Float8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Float8 operator*(Float8 a, Float8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Float8 operator/(Float8 a, Float8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline Float8 Min(Float8 a, Float8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Float8 Max(Float8 a, Float8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline Float8 Abs(Float8 a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+inline Float8 CmpLt(Float8 a, Float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline Float8 CmpLe(Float8 a, Float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline Float8 CmpGe(Float8 a, Float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline Float8 CmpNe(Float8 a, Float8 b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_OQ) }; }
+inline Float8 And(Float8 a, Float8 b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline Float8 Or(Float8 a, Float8 b) { return { _mm256_or_ps(a.v, b.v) }; }
+inline Float8 Select(Float8 mask, Float8 a, Float8 b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+inline int MoveMask(Float8 mask) { return _mm256_movemask_ps(mask.v); }
+inline Float8 Floor(Float8 a) { return { _mm256_floor_ps(a.v) }; }
+
+namespace detail {
+// Unbiased exponent and [1, 2) mantissa of positive normal floats
+inline Float8 Exponent(Float8 a) {
+    __m256i biased = _mm256_srli_epi32(_mm256_castps_si256(a.v), 23);
+    return { _mm256_cvtepi32_ps(_mm256_sub_epi32(biased, _mm256_set1_epi32(127))) };
+}
+inline Float8 Mantissa(Float8 a) {
+    __m256i bits = _mm256_and_si256(_mm256_castps_si256(a.v), _mm256_set1_epi32(0x007FFFFF));
+    return { _mm256_castsi256_ps(_mm256_or_si256(bits, _mm256_set1_epi32(0x3F800000))) };
+}
+// 2^n for integral n in [-126, 127]
+inline Float8 Pow2Int(Float8 n) {
+    __m256i biased = _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+    return { _mm256_castsi256_ps(_mm256_slli_epi32(biased, 23)) };
+}
+} // namespace detail
+
+struct Int8 {
+    __m256i v;
+};
+
+inline Int8 BroadcastInt(uint32_t x) { return { _mm256_set1_epi32(static_cast<int>(x)) }; }
+inline Int8 LoadUnaligned(const uint32_t* p) { return { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)) }; }
+inline void StoreUnaligned(uint32_t* p, Int8 a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a.v); }
+inline Int8 operator&(Int8 a, Int8 b) { return { _mm256_and_si256(a.v, b.v) }; }
+inline Int8 operator|(Int8 a, Int8 b) { return { _mm256_or_si256(a.v, b.v) }; }
+inline Int8 ShiftLeft(Int8 a, int bits) { return { _mm256_sll_epi32(a.v, _mm_cvtsi32_si128(bits)) }; }
+inline Int8 ShiftRight(Int8 a, int bits) { return { _mm256_srl_epi32(a.v, _mm_cvtsi32_si128(bits)) }; } // Logical
+// Eight bytes or halfwords zero-extended to the lanes
+inline Int8 LoadWiden(const uint8_t* p) { return { _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))) }; }
+inline Int8 LoadWiden(const uint16_t* p) { return { _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) }; }
+
+#elif defined(SHORTMARCH_SIMD_SSE)
+
+struct Float8 {
+    __m128 lo, hi;
+};
+
+inline Float8 Broadcast(float x) { return { _mm_set1_ps(x), _mm_set1_ps(x) }; }
+inline Float8 Load(const float* p) { return { _mm_load_ps(p), _mm_load_ps(p + 4) }; }
+inline void Store(float* p, Float8 a) { _mm_store_ps(p, a.lo); _mm_store_ps(p + 4, a.hi); }
+inline Float8 LoadUnaligned(const float* p) { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+inline void StoreUnaligned(float* p, Float8 a) { _mm_storeu_ps(p, a.lo); _mm_storeu_ps(p + 4, a.hi); }
+inline Float8 operator+(Float8 a, Float8 b) { return { _mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi) }; }
+inline Float8 operator-(Float8 a, Float8 b) { return { _mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi) }; }
+inline Float8 operator*(Float8 a, Float8 b) { return { _mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi) }; }
+inline Float8 operator/(Float8 a, Float8 b) { return { _mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi) }; }
+inline Float8 Min(Float8 a, Float8 b) { return { _mm_min_ps(a.lo, b.lo), _mm_min_ps(a.hi, b.hi) }; }
+inline Float8 Max(Float8 a, Float8 b) { return { _mm_max_ps(a.lo, b.lo), _mm_max_ps(a.hi, b.hi) }; }
+inline Float8 Abs(Float8 a) {
+    __m128 sign = _mm_set1_ps(-0.0f);
+    return { _mm_andnot_ps(sign, a.lo), _mm_andnot_ps(sign, a.hi) };
+}
+inline Float8 CmpLt(Float8 a, Float8 b) { return { _mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi) }; }
+inline Float8 CmpLe(Float8 a, Float8 b) { return { _mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi) }; }
+inline Float8 CmpGe(Float8 a, Float8 b) { return { _mm_cmpge_ps(a.lo, b.lo), _mm_cmpge_ps(a.hi, b.hi) }; }
+inline Float8 CmpNe(Float8 a, Float8 b) { return { _mm_cmpneq_ps(a.lo, b.lo), _mm_cmpneq_ps(a.hi, b.hi) }; }
+inline Float8 And(Float8 a, Float8 b) { return { _mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi) }; }
+inline Float8 Or(Float8 a, Float8 b) { return { _mm_or_ps(a.lo, b.lo), _mm_or_ps(a.hi, b.hi) }; }
+inline Float8 Select(Float8 mask, Float8 a, Float8 b) {
+    // SSE2 has no blendv
+    return { _mm_or_ps(_mm_and_ps(mask.lo, a.lo), _mm_andnot_ps(mask.lo, b.lo)),
+             _mm_or_ps(_mm_and_ps(mask.hi, a.hi), _mm_andnot_ps(mask.hi, b.hi)) };
+}
+inline int MoveMask(Float8 mask) { return _mm_movemask_ps(mask.lo) | (_mm_movemask_ps(mask.hi) << 4); }
+
+namespace detail {
+inline __m128 Floor4(__m128 a) {
+    // SSE2 has no roundps: truncate, then step down where truncation rounded up (|a| < 2^31)
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+}
+inline __m128 Exponent4(__m128 a) {
+    __m128i biased = _mm_srli_epi32(_mm_castps_si128(a), 23);
+    return _mm_cvtepi32_ps(_mm_sub_epi32(biased, _mm_set1_epi32(127)));
+}
+inline __m128 Mantissa4(__m128 a) {
+    __m128i bits = _mm_and_si128(_mm_castps_si128(a), _mm_set1_epi32(0x007FFFFF));
+    return _mm_castsi128_ps(_mm_or_si128(bits, _mm_set1_epi32(0x3F800000)));
+}
+inline __m128 Pow2Int4(__m128 n) {
+    __m128i biased = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+    return _mm_castsi128_ps(_mm_slli_epi32(biased, 23));
+}
+inline Float8 Exponent(Float8 a) { return { Exponent4(a.lo), Exponent4(a.hi) }; }
+inline Float8 Mantissa(Float8 a) { return { Mantissa4(a.lo), Mantissa4(a.hi) }; }
+inline Float8 Pow2Int(Float8 n) { return { Pow2Int4(n.lo), Pow2Int4(n.hi) }; }
+} // namespace detail
+
+inline Float8 Floor(Float8 a) { return { detail::Floor4(a.lo), detail::Floor4(a.hi) }; }
+
+struct Int8 {
+    __m128i lo, hi;
+};
+
+inline Int8 BroadcastInt(uint32_t x) { return { _mm_set1_epi32(static_cast<int>(x)), _mm_set1_epi32(static_cast<int>(x)) }; }
+inline Int8 LoadUnaligned(const uint32_t* p) {
+    return { _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4)) };
+}
+inline void StoreUnaligned(uint32_t* p, Int8 a) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), a.lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 4), a.hi);
+}
+inline Int8 operator&(Int8 a, Int8 b) { return { _mm_and_si128(a.lo, b.lo), _mm_and_si128(a.hi, b.hi) }; }
+inline Int8 operator|(Int8 a, Int8 b) { return { _mm_or_si128(a.lo, b.lo), _mm_or_si128(a.hi, b.hi) }; }
+inline Int8 ShiftLeft(Int8 a, int bits) {
+    __m128i count = _mm_cvtsi32_si128(bits);
+    return { _mm_sll_epi32(a.lo, count), _mm_sll_epi32(a.hi, count) };
+}
+inline Int8 ShiftRight(Int8 a, int bits) { // Logical
+    __m128i count = _mm_cvtsi32_si128(bits);
+    return { _mm_srl_epi32(a.lo, count), _mm_srl_epi32(a.hi, count) };
+}
+// Eight bytes or halfwords zero-extended to the lanes
+inline Int8 LoadWiden(const uint8_t* p) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+    return { _mm_unpacklo_epi16(words, zero), _mm_unpackhi_epi16(words, zero) };
+}
+inline Int8 LoadWiden(const uint16_t* p) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return { _mm_unpacklo_epi16(words, zero), _mm_unpackhi_epi16(words, zero) };
+}
+
+#else
+
+struct Float8 {
+    float v[8];
+};
+
+namespace detail {
+inline float MaskValue(bool set) {
+    uint32_t bits = set ? 0xFFFFFFFFu : 0u;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+inline uint32_t Bits(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+inline float FromBits(uint32_t bits) {
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+template <class Fn>
+inline Float8 Map(Float8 a, Float8 b, Fn fn) {
+    Float8 r;
+    for (int i = 0; i < 8; ++i) r.v[i] = fn(a.v[i], b.v[i]);
+    return r;
+}
+inline Float8 Exponent(Float8 a) {
+    return Map(a, a, [](float x, float) { return static_cast<float>(static_cast<int>(Bits(x) >> 23) - 127); });
+}
+inline Float8 Mantissa(Float8 a) {
+    return Map(a, a, [](float x, float) { return FromBits((Bits(x) & 0x007FFFFFu) | 0x3F800000u); });
+}
+inline Float8 Pow2Int(Float8 n) {
+    return Map(n, n, [](float x, float) { return FromBits(static_cast<uint32_t>(static_cast<int>(x) + 127) << 23); });
+}
+} // namespace detail
+
+inline Float8 Broadcast(float x) {
+    Float8 r;
+    for (float& f : r.v) f = x;
+    return r;
+}
+inline Float8 Load(const float* p) {
+    Float8 r;
+    std::memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+inline void Store(float* p, Float8 a) { std::memcpy(p, a.v, sizeof(a.v)); }
+inline Float8 LoadUnaligned(const float* p) { return Load(p); }
+inline void StoreUnaligned(float* p, Float8 a) { Store(p, a); }
+inline Float8 operator+(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return x + y; }); }
+inline Float8 operator-(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return x - y; }); }
+inline Float8 operator*(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return x * y; }); }
+inline Float8 operator/(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return x / y; }); }
+// Same NaN behaviour as minps/maxps: the second operand is returned when either is NaN
+inline Float8 Min(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline Float8 Max(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+inline Float8 Abs(Float8 a) { return detail::Map(a, a, [](float x, float) { return x < 0.0f ? -x : x; }); }
+inline Float8 CmpLt(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return detail::MaskValue(x < y); }); }
+inline Float8 CmpLe(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return detail::MaskValue(x <= y); }); }
+inline Float8 CmpGe(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return detail::MaskValue(x >= y); }); }
+inline Float8 CmpNe(Float8 a, Float8 b) { return detail::Map(a, b, [](float x, float y) { return detail::MaskValue(x != y && x == x && y == y); }); }
+inline Float8 And(Float8 a, Float8 b) {
+    return detail::Map(a, b, [](float x, float y) { return detail::MaskValue((detail::Bits(x) & detail::Bits(y)) != 0); });
+}
+inline Float8 Or(Float8 a, Float8 b) {
+    return detail::Map(a, b, [](float x, float y) { return detail::MaskValue((detail::Bits(x) | detail::Bits(y)) != 0); });
+}
+inline Float8 Select(Float8 mask, Float8 a, Float8 b) {
+    Float8 r;
+    for (int i = 0; i < 8; ++i) r.v[i] = detail::Bits(mask.v[i]) ? a.v[i] : b.v[i];
+    return r;
+}
+inline int MoveMask(Float8 mask) {
+    int bits = 0;
+    for (int i = 0; i < 8; ++i) bits |= (detail::Bits(mask.v[i]) >> 31) << i;
+    return bits;
+}
+inline Float8 Floor(Float8 a) { return detail::Map(a, a, [](float x, float) { return std::floor(x); }); }
+
+struct Int8 {
+    uint32_t v[8];
+};
+
+inline Int8 BroadcastInt(uint32_t x) {
+    Int8 r;
+    for (uint32_t& i : r.v) i = x;
+    return r;
+}
+inline Int8 LoadUnaligned(const uint32_t* p) {
+    Int8 r;
+    std::memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+inline void StoreUnaligned(uint32_t* p, Int8 a) { std::memcpy(p, a.v, sizeof(a.v)); }
+inline Int8 operator&(Int8 a, Int8 b) {
+    for (int i = 0; i < 8; ++i) a.v[i] &= b.v[i];
+    return a;
+}
+inline Int8 operator|(Int8 a, Int8 b) {
+    for (int i = 0; i < 8; ++i) a.v[i] |= b.v[i];
+    return a;
+}
+inline Int8 ShiftLeft(Int8 a, int bits) {
+    for (uint32_t& i : a.v) i <<= bits;
+    return a;
+}
+inline Int8 ShiftRight(Int8 a, int bits) {
+    for (uint32_t& i : a.v) i >>= bits;
+    return a;
+}
+// Eight bytes or halfwords zero-extended to the lanes
+inline Int8 LoadWiden(const uint8_t* p) {
+    Int8 r;
+    for (int i = 0; i < 8; ++i) r.v[i] = p[i];
+    return r;
+}
+inline Int8 LoadWiden(const uint16_t* p) {
+    uint16_t halves[8];
+    std::memcpy(halves, p, sizeof(halves));
+    Int8 r;
+    for (int i = 0; i < 8; ++i) r.v[i] = halves[i];
+    return r;
+}
+
+#endif
+
+// Polynomial approximations for the film/tone mapping passes (not for the ray kernels).
+// Log2 is accurate to ~1e-5 for positive normal inputs; other lanes must be masked by the caller.
+inline Float8 Log2(Float8 a) {
+    Float8 t = detail::Mantissa(a) - Broadcast(1.0f);
+    Float8 p = Broadcast(-0.033822046f);
+    p = p * t + Broadcast(0.144471096f);
+    p = p * t + Broadcast(-0.30163801f);
+    p = p * t + Broadcast(0.468658879f);
+    p = p * t + Broadcast(-0.720358773f);
+    p = p * t + Broadcast(1.44268147f);
+    return detail::Exponent(a) + p * t;
+}
+
+// 2^a with ~1e-7 relative error; a is clamped to the normal float range
+inline Float8 Exp2(Float8 a) {
+    a = Min(Max(a, Broadcast(-126.0f)), Broadcast(126.0f));
+    Float8 n = Floor(a);
+    Float8 f = a - n;
+    Float8 p = Broadcast(0.00189375406f);
+    p = p * f + Broadcast(0.00894959042f);
+    p = p * f + Broadcast(0.0558603371f);
+    p = p * f + Broadcast(0.240141818f);
+    p = p * f + Broadcast(0.69315449f);
+    p = p * f + Broadcast(0.999999898f);
+    return p * detail::Pow2Int(n);
+}
+
+// Index of the lowest set bit of a non-zero lane mask
+inline int FirstLane(int mask) {
+    int lane = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++lane;
+    }
+    return lane;
+}
+
+} // namespace simd
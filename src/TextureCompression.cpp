@@ -0,0 +1,722 @@
+#include "TextureCompression.h"
+#include "SceneCache.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+constexpr uint32_t kCacheMagic = 0x43424D53u; // "SMBC"
+constexpr uint32_t kCacheVersion = 1;
+constexpr int kBc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t quality;
+    int32_t width;
+    int32_t height;
+    uint64_t block_bytes;
+};
+
+// 4x4 texels, channel values in [0, 255]
+struct Block {
+    float texels[16][4];
+};
+
+// Decoded colours of an endpoint pair. weights[i] places entry i on the segment between the stored
+// endpoints (0 at the first, 1 at the second); entries off the segment (BC4's 0 and 255) have -1.
+struct Palette {
+    int count = 0;
+    float colors[16][4];
+    float weights[16];
+};
+
+void LoadBlock(const uint8_t* rgba8, int width, int height, int bx, int by, Block* block) {
+    for (int y = 0; y < 4; ++y) {
+        int sy = std::min(by * 4 + y, height - 1);
+        for (int x = 0; x < 4; ++x) {
+            int sx = std::min(bx * 4 + x, width - 1);
+            const uint8_t* texel = rgba8 + (size_t(sy) * width + sx) * 4;
+            for (int c = 0; c < 4; ++c) block->texels[y * 4 + x][c] = texel[c];
+        }
+    }
+}
+
+// Nearest palette entry per texel over `channels` channels starting at `first`; returns the
+// summed squared error
+float AssignIndices(const Block& block, int first, int channels, const Palette& palette, uint8_t indices[16]) {
+    float total = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float best = 1e30f;
+        for (int k = 0; k < palette.count; ++k) {
+            float error = 0.0f;
+            for (int c = 0; c < channels; ++c) {
+                float d = block.texels[i][first + c] - palette.colors[k][c];
+                error += d * d;
+            }
+            if (error < best) {
+                best = error;
+                indices[i] = static_cast<uint8_t>(k);
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+// Endpoints minimizing the squared error for fixed indices; false when the system is singular
+bool RefineEndpoints(const Block& block, int first, int channels, const Palette& palette, const uint8_t indices[16],
+                     float e0[4], float e1[4]) {
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float x0[4] = {}, x1[4] = {};
+    for (int i = 0; i < 16; ++i) {
+        float w = palette.weights[indices[i]];
+        if (w < 0.0f) continue;
+        float v = 1.0f - w;
+        a += v * v;
+        b += v * w;
+        c += w * w;
+        for (int ch = 0; ch < channels; ++ch) {
+            x0[ch] += v * block.texels[i][first + ch];
+            x1[ch] += w * block.texels[i][first + ch];
+        }
+    }
+    float det = a * c - b * b;
+    if (std::abs(det) < 1e-6f) return false;
+    float inv = 1.0f / det;
+    for (int ch = 0; ch < channels; ++ch) {
+        e0[ch] = std::clamp((c * x0[ch] - b * x1[ch]) * inv, 0.0f, 255.0f);
+        e1[ch] = std::clamp((a * x1[ch] - b * x0[ch]) * inv, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+// Initial endpoints: the bounding box with each channel's direction following its correlation
+// with the widest channel (kFast), or the extent along the principal axis
+void InitialEndpoints(const Block& block, int first, int channels, BcQuality quality, float e0[4], float e1[4]) {
+    float mean[4] = {}, lo[4], hi[4];
+    for (int c = 0; c < channels; ++c) {
+        lo[c] = 255.0f;
+        hi[c] = 0.0f;
+    }
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            float v = block.texels[i][first + c];
+            mean[c] += v;
+            lo[c] = std::min(lo[c], v);
+            hi[c] = std::max(hi[c], v);
+        }
+    }
+    for (int c = 0; c < channels; ++c) mean[c] *= 1.0f / 16.0f;
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; ++i) {
+        for (int r = 0; r < channels; ++r) {
+            for (int c = 0; c < channels; ++c) {
+                covariance[r][c] += (block.texels[i][first + r] - mean[r]) * (block.texels[i][first + c] - mean[c]);
+            }
+        }
+    }
+
+    if (quality == BcQuality::kFast || channels == 1) {
+        int widest = 0;
+        for (int c = 1; c < channels; ++c) {
+            if (hi[c] - lo[c] > hi[widest] - lo[widest]) widest = c;
+        }
+        for (int c = 0; c < channels; ++c) {
+            bool flip = covariance[c][widest] < 0.0f;
+            e0[c] = flip ? hi[c] : lo[c];
+            e1[c] = flip ? lo[c] : hi[c];
+        }
+        return;
+    }
+
+    // Power iteration from the bounding box diagonal
+    float axis[4] = {};
+    for (int c = 0; c < channels; ++c) axis[c] = hi[c] - lo[c];
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int r = 0; r < channels; ++r) {
+            for (int c = 0; c < channels; ++c) next[r] += covariance[r][c] * axis[c];
+            length = std::max(length, std::abs(next[r]));
+        }
+        if (length < 1e-6f) break;
+        for (int c = 0; c < channels; ++c) axis[c] = next[c] / length;
+    }
+    float length2 = 0.0f;
+    for (int c = 0; c < channels; ++c) length2 += axis[c] * axis[c];
+    if (length2 < 1e-12f) {
+        for (int c = 0; c < channels; ++c) e0[c] = e1[c] = mean[c];
+        return;
+    }
+
+    float t_min = 1e30f, t_max = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; ++c) t += (block.texels[i][first + c] - mean[c]) * axis[c];
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+    for (int c = 0; c < channels; ++c) {
+        e0[c] = std::clamp(mean[c] + axis[c] * t_min / length2, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c] * t_max / length2, 0.0f, 255.0f);
+    }
+}
+
+int Refinements(BcQuality quality) {
+    switch (quality) {
+        case BcQuality::kFast: return 0;
+        case BcQuality::kBalanced: return 1;
+        default: return 4;
+    }
+}
+
+// --- BC1 ---
+
+uint16_t PackRgb565(const float color[4]) {
+    int r = static_cast<int>(color[0] * (31.0f / 255.0f) + 0.5f);
+    int g = static_cast<int>(color[1] * (63.0f / 255.0f) + 0.5f);
+    int b = static_cast<int>(color[2] * (31.0f / 255.0f) + 0.5f);
+    return static_cast<uint16_t>((std::clamp(r, 0, 31) << 11) | (std::clamp(g, 0, 63) << 5) | std::clamp(b, 0, 31));
+}
+
+void UnpackRgb565(uint16_t packed, int rgb[3]) {
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Decoder palette of a BC1 block; four entries when c0 > c1, else three plus transparent black
+void Bc1Palette(uint16_t c0, uint16_t c1, Palette* palette) {
+    int a[3], b[3];
+    UnpackRgb565(c0, a);
+    UnpackRgb565(c1, b);
+    for (int c = 0; c < 3; ++c) {
+        palette->colors[0][c] = float(a[c]);
+        palette->colors[1][c] = float(b[c]);
+        if (c0 > c1) {
+            palette->colors[2][c] = float((2 * a[c] + b[c]) / 3);
+            palette->colors[3][c] = float((a[c] + 2 * b[c]) / 3);
+        } else {
+            palette->colors[2][c] = float((a[c] + b[c]) / 2);
+            palette->colors[3][c] = 0.0f;
+        }
+    }
+    palette->colors[0][3] = palette->colors[1][3] = palette->colors[2][3] = 255.0f;
+    palette->colors[3][3] = c0 > c1 ? 255.0f : 0.0f;
+    palette->weights[0] = 0.0f;
+    palette->weights[1] = 1.0f;
+    palette->weights[2] = c0 > c1 ? 1.0f / 3.0f : 0.5f;
+    palette->weights[3] = c0 > c1 ? 2.0f / 3.0f : -1.0f;
+}
+
+// Four-colour mode only (c0 > c1); equal endpoints fall back to index 0 everywhere
+float Bc1Quantize(const Block& block, const float e0[4], const float e1[4], uint16_t* c0, uint16_t* c1,
+                  Palette* palette, uint8_t indices[16]) {
+    uint16_t p0 = PackRgb565(e0), p1 = PackRgb565(e1);
+    bool swapped = p0 < p1;
+    *c0 = swapped ? p1 : p0;
+    *c1 = swapped ? p0 : p1;
+    Bc1Palette(*c0, *c1, palette);
+    palette->count = *c0 == *c1 ? 1 : 4;
+    if (swapped) {
+        // Keep the weights relative to e0/e1 for the refinement
+        for (int k = 0; k < 4; ++k) palette->weights[k] = 1.0f - palette->weights[k];
+    }
+    return AssignIndices(block, 0, 3, *palette, indices);
+}
+
+void EncodeBc1(const Block& block, BcQuality quality, uint8_t* out) {
+    float e0[4], e1[4];
+    InitialEndpoints(block, 0, 3, quality, e0, e1);
+    uint16_t c0, c1;
+    Palette palette;
+    uint8_t indices[16];
+    float best = Bc1Quantize(block, e0, e1, &c0, &c1, &palette, indices);
+    for (int iteration = 0; iteration < Refinements(quality); ++iteration) {
+        float r0[4], r1[4];
+        if (!RefineEndpoints(block, 0, 3, palette, indices, r0, r1)) break;
+        uint16_t n0, n1;
+        Palette next_palette;
+        uint8_t next_indices[16];
+        float error = Bc1Quantize(block, r0, r1, &n0, &n1, &next_palette, next_indices);
+        if (error >= best) break;
+        best = error;
+        c0 = n0;
+        c1 = n1;
+        palette = next_palette;
+        std::memcpy(indices, next_indices, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i) bits |= uint32_t(indices[i]) << (2 * i);
+    std::memcpy(out, &c0, 2);
+    std::memcpy(out + 2, &c1, 2);
+    std::memcpy(out + 4, &bits, 4);
+}
+
+void DecodeBc1(const uint8_t* in, uint8_t texels[16][4]) {
+    uint16_t c0, c1;
+    uint32_t bits;
+    std::memcpy(&c0, in, 2);
+    std::memcpy(&c1, in + 2, 2);
+    std::memcpy(&bits, in + 4, 4);
+    Palette palette;
+    Bc1Palette(c0, c1, &palette);
+    for (int i = 0; i < 16; ++i) {
+        const float* color = palette.colors[(bits >> (2 * i)) & 3];
+        for (int c = 0; c < 4; ++c) texels[i][c] = static_cast<uint8_t>(color[c]);
+    }
+}
+
+// --- BC4 ---
+
+void Bc4Palette(int e0, int e1, Palette* palette) {
+    float* values[8];
+    for (int k = 0; k < 8; ++k) values[k] = &palette->colors[k][0];
+    *values[0] = float(e0);
+    *values[1] = float(e1);
+    palette->weights[0] = 0.0f;
+    palette->weights[1] = 1.0f;
+    if (e0 > e1) {
+        for (int k = 2; k < 8; ++k) {
+            *values[k] = float(((8 - k) * e0 + (k - 1) * e1 + 3) / 7);
+            palette->weights[k] = (k - 1) / 7.0f;
+        }
+    } else {
+        for (int k = 2; k < 6; ++k) {
+            *values[k] = float(((6 - k) * e0 + (k - 1) * e1 + 2) / 5);
+            palette->weights[k] = (k - 1) / 5.0f;
+        }
+        *values[6] = 0.0f;
+        *values[7] = 255.0f;
+        palette->weights[6] = palette->weights[7] = -1.0f;
+    }
+    palette->count = 8;
+}
+
+// six_value selects the e0 <= e1 mode with explicit 0 and 255 entries
+float Bc4Quantize(const Block& block, int channel, float e0, float e1, bool six_value, uint8_t* q0, uint8_t* q1,
+                  Palette* palette, uint8_t indices[16]) {
+    int a = std::clamp(static_cast<int>(e0 + 0.5f), 0, 255);
+    int b = std::clamp(static_cast<int>(e1 + 0.5f), 0, 255);
+    bool swapped = six_value ? a > b : a < b;
+    if (!six_value && a == b) {
+        // Equal endpoints decode in 6-value mode; index 0 still returns the endpoint
+        swapped = false;
+    }
+    *q0 = static_cast<uint8_t>(swapped ? b : a);
+    *q1 = static_cast<uint8_t>(swapped ? a : b);
+    Bc4Palette(*q0, *q1, palette);
+    if (swapped) {
+        for (int k = 0; k < 8; ++k) {
+            if (palette->weights[k] >= 0.0f) palette->weights[k] = 1.0f - palette->weights[k];
+        }
+    }
+    return AssignIndices(block, channel, 1, *palette, indices);
+}
+
+float EncodeBc4Mode(const Block& block, int channel, BcQuality quality, bool six_value, float e0, float e1,
+                    uint8_t* out) {
+    uint8_t q0, q1;
+    Palette palette;
+    uint8_t indices[16];
+    float best = Bc4Quantize(block, channel, e0, e1, six_value, &q0, &q1, &palette, indices);
+    for (int iteration = 0; iteration < Refinements(quality); ++iteration) {
+        float r0[4], r1[4];
+        if (!RefineEndpoints(block, channel, 1, palette, indices, r0, r1)) break;
+        uint8_t n0, n1;
+        Palette next_palette;
+        uint8_t next_indices[16];
+        float error = Bc4Quantize(block, channel, r0[0], r1[0], six_value, &n0, &n1, &next_palette, next_indices);
+        if (error >= best) break;
+        best = error;
+        q0 = n0;
+        q1 = n1;
+        palette = next_palette;
+        std::memcpy(indices, next_indices, sizeof(indices));
+    }
+
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i) bits |= uint64_t(indices[i]) << (3 * i);
+    out[0] = q0;
+    out[1] = q1;
+    for (int k = 0; k < 6; ++k) out[2 + k] = static_cast<uint8_t>(bits >> (8 * k));
+    return best;
+}
+
+void EncodeBc4(const Block& block, int channel, BcQuality quality, uint8_t* out) {
+    float lo = 255.0f, hi = 0.0f;
+    float inner_lo = 255.0f, inner_hi = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float v = block.texels[i][channel];
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+        if (v > 0.0f && v < 255.0f) {
+            inner_lo = std::min(inner_lo, v);
+            inner_hi = std::max(inner_hi, v);
+        }
+    }
+    float best = EncodeBc4Mode(block, channel, quality, false, hi, lo, out);
+    // Blocks touching 0 or 255 may do better spending the end entries on them
+    if (quality == BcQuality::kHigh && (lo == 0.0f || hi == 255.0f) && inner_lo <= inner_hi) {
+        uint8_t candidate[8];
+        if (EncodeBc4Mode(block, channel, quality, true, inner_lo, inner_hi, candidate) < best) {
+            std::memcpy(out, candidate, 8);
+        }
+    }
+}
+
+void DecodeBc4(const uint8_t* in, uint8_t values[16]) {
+    Palette palette;
+    Bc4Palette(in[0], in[1], &palette);
+    uint64_t bits = 0;
+    for (int k = 0; k < 6; ++k) bits |= uint64_t(in[2 + k]) << (8 * k);
+    for (int i = 0; i < 16; ++i) values[i] = static_cast<uint8_t>(palette.colors[(bits >> (3 * i)) & 7][0]);
+}
+
+// --- BC7 mode 6 ---
+
+struct Bc7Endpoints {
+    uint8_t q[2][4]; // 7-bit values
+    uint8_t p[2];
+};
+
+void Bc7Palette(const Bc7Endpoints& endpoints, Palette* palette) {
+    int e[2][4];
+    for (int k = 0; k < 2; ++k) {
+        for (int c = 0; c < 4; ++c) e[k][c] = (endpoints.q[k][c] << 1) | endpoints.p[k];
+    }
+    for (int k = 0; k < 16; ++k) {
+        int w = kBc7Weights[k];
+        for (int c = 0; c < 4; ++c) palette->colors[k][c] = float(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+        palette->weights[k] = w / 64.0f;
+    }
+    palette->count = 16;
+}
+
+// Nearest 7-bit value with the given p-bit, and its squared error summed over the channels
+float QuantizeBc7Endpoint(const float color[4], int p, uint8_t q[4]) {
+    float error = 0.0f;
+    for (int c = 0; c < 4; ++c) {
+        int value = std::clamp(static_cast<int>((color[c] - p) * 0.5f + 0.5f), 0, 127);
+        q[c] = static_cast<uint8_t>(value);
+        float d = color[c] - float((value << 1) | p);
+        error += d * d;
+    }
+    return error;
+}
+
+// Quantizes both endpoints, with each p-bit chosen per endpoint or forced by p0/p1 (when >= 0)
+float Bc7Quantize(const Block& block, const float e0[4], const float e1[4], int p0, int p1, Bc7Endpoints* endpoints,
+                  Palette* palette, uint8_t indices[16]) {
+    const float* colors[2] = { e0, e1 };
+    const int forced[2] = { p0, p1 };
+    for (int k = 0; k < 2; ++k) {
+        if (forced[k] >= 0) {
+            endpoints->p[k] = static_cast<uint8_t>(forced[k]);
+            QuantizeBc7Endpoint(colors[k], forced[k], endpoints->q[k]);
+            continue;
+        }
+        uint8_t q0[4], q1[4];
+        float error0 = QuantizeBc7Endpoint(colors[k], 0, q0);
+        float error1 = QuantizeBc7Endpoint(colors[k], 1, q1);
+        endpoints->p[k] = error1 < error0 ? 1 : 0;
+        std::memcpy(endpoints->q[k], error1 < error0 ? q1 : q0, 4);
+    }
+    Bc7Palette(*endpoints, palette);
+    return AssignIndices(block, 0, 4, *palette, indices);
+}
+
+struct BitWriter {
+    uint8_t* out;
+    int position = 0;
+
+    void Write(uint32_t value, int count) {
+        for (int i = 0; i < count; ++i, ++position) {
+            if ((value >> i) & 1u) out[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+        }
+    }
+};
+
+struct BitReader {
+    const uint8_t* in;
+    int position = 0;
+
+    uint32_t Read(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; ++i, ++position) value |= uint32_t((in[position >> 3] >> (position & 7)) & 1u) << i;
+        return value;
+    }
+};
+
+float EncodeBc7Candidate(const Block& block, BcQuality quality, const float e0[4], const float e1[4], int p0, int p1,
+                         Bc7Endpoints* endpoints, uint8_t indices[16]) {
+    Palette palette;
+    float best = Bc7Quantize(block, e0, e1, p0, p1, endpoints, &palette, indices);
+    for (int iteration = 0; iteration < Refinements(quality); ++iteration) {
+        float r0[4], r1[4];
+        if (!RefineEndpoints(block, 0, 4, palette, indices, r0, r1)) break;
+        Bc7Endpoints next;
+        Palette next_palette;
+        uint8_t next_indices[16];
+        float error = Bc7Quantize(block, r0, r1, p0, p1, &next, &next_palette, next_indices);
+        if (error >= best) break;
+        best = error;
+        *endpoints = next;
+        palette = next_palette;
+        std::memcpy(indices, next_indices, 16);
+    }
+    return best;
+}
+
+void EncodeBc7(const Block& block, BcQuality quality, uint8_t* out) {
+    float e0[4], e1[4];
+    InitialEndpoints(block, 0, 4, quality, e0, e1);
+    Bc7Endpoints endpoints;
+    uint8_t indices[16];
+    float best = EncodeBc7Candidate(block, quality, e0, e1, -1, -1, &endpoints, indices);
+    if (quality == BcQuality::kHigh) {
+        for (int p = 0; p < 4 && best > 0.0f; ++p) {
+            Bc7Endpoints candidate;
+            uint8_t candidate_indices[16];
+            float error = EncodeBc7Candidate(block, quality, e0, e1, p & 1, p >> 1, &candidate, candidate_indices);
+            if (error < best) {
+                best = error;
+                endpoints = candidate;
+                std::memcpy(indices, candidate_indices, 16);
+            }
+        }
+    }
+
+    // The anchor (texel 0) stores only three index bits, so its top bit must be clear
+    if (indices[0] & 8) {
+        std::swap(endpoints.q[0], endpoints.q[1]);
+        std::swap(endpoints.p[0], endpoints.p[1]);
+        for (int i = 0; i < 16; ++i) indices[i] = static_cast<uint8_t>(15 - indices[i]);
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter writer{ out };
+    writer.Write(1u << 6, 7);
+    for (int c = 0; c < 4; ++c) {
+        writer.Write(endpoints.q[0][c], 7);
+        writer.Write(endpoints.q[1][c], 7);
+    }
+    writer.Write(endpoints.p[0], 1);
+    writer.Write(endpoints.p[1], 1);
+    for (int i = 0; i < 16; ++i) writer.Write(indices[i], i == 0 ? 3 : 4);
+}
+
+// Decodes mode 6 blocks; other modes, which the encoder never writes, come back as zero
+void DecodeBc7(const uint8_t* in, uint8_t texels[16][4]) {
+    BitReader reader{ in };
+    if (reader.Read(7) != (1u << 6)) {
+        std::memset(texels, 0, 64);
+        return;
+    }
+    Bc7Endpoints endpoints;
+    for (int c = 0; c < 4; ++c) {
+        endpoints.q[0][c] = static_cast<uint8_t>(reader.Read(7));
+        endpoints.q[1][c] = static_cast<uint8_t>(reader.Read(7));
+    }
+    endpoints.p[0] = static_cast<uint8_t>(reader.Read(1));
+    endpoints.p[1] = static_cast<uint8_t>(reader.Read(1));
+    Palette palette;
+    Bc7Palette(endpoints, &palette);
+    for (int i = 0; i < 16; ++i) {
+        const float* color = palette.colors[reader.Read(i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; ++c) texels[i][c] = static_cast<uint8_t>(color[c]);
+    }
+}
+
+void EncodeBlock(const Block& block, BcFormat format, BcQuality quality, uint8_t* out) {
+    switch (format) {
+        case BcFormat::kBC1: EncodeBc1(block, quality, out); break;
+        case BcFormat::kBC4: EncodeBc4(block, 0, quality, out); break;
+        case BcFormat::kBC5:
+            EncodeBc4(block, 0, quality, out);
+            EncodeBc4(block, 1, quality, out + 8);
+            break;
+        case BcFormat::kBC7: EncodeBc7(block, quality, out); break;
+    }
+}
+
+void DecodeBlock(const uint8_t* in, BcFormat format, uint8_t texels[16][4]) {
+    uint8_t red[16], green[16];
+    switch (format) {
+        case BcFormat::kBC1: DecodeBc1(in, texels); break;
+        case BcFormat::kBC4:
+            DecodeBc4(in, red);
+            for (int i = 0; i < 16; ++i) {
+                texels[i][0] = red[i];
+                texels[i][1] = texels[i][2] = 0;
+                texels[i][3] = 255;
+            }
+            break;
+        case BcFormat::kBC5:
+            DecodeBc4(in, red);
+            DecodeBc4(in + 8, green);
+            for (int i = 0; i < 16; ++i) {
+                texels[i][0] = red[i];
+                texels[i][1] = green[i];
+                texels[i][2] = 0;
+                texels[i][3] = 255;
+            }
+            break;
+        case BcFormat::kBC7: DecodeBc7(in, texels); break;
+    }
+}
+} // namespace
+
+size_t BcBlockBytes(BcFormat format) {
+    return format == BcFormat::kBC1 || format == BcFormat::kBC4 ? 8 : 16;
+}
+
+const char* BcFormatName(BcFormat format) {
+    switch (format) {
+        case BcFormat::kBC1: return "BC1";
+        case BcFormat::kBC4: return "BC4";
+        case BcFormat::kBC5: return "BC5";
+        case BcFormat::kBC7: return "BC7";
+    }
+    return "?";
+}
+
+const char* BcQualityName(BcQuality quality) {
+    switch (quality) {
+        case BcQuality::kFast: return "fast";
+        case BcQuality::kBalanced: return "balanced";
+        case BcQuality::kHigh: return "high";
+    }
+    return "?";
+}
+
+int BcChannelCount(BcFormat format) {
+    switch (format) {
+        case BcFormat::kBC1: return 3;
+        case BcFormat::kBC4: return 1;
+        case BcFormat::kBC5: return 2;
+        case BcFormat::kBC7: return 4;
+    }
+    return 0;
+}
+
+CompressedTexture CompressTexture(const uint8_t* rgba8, int width, int height, BcFormat format, BcQuality quality) {
+    CompressedTexture texture;
+    if (!rgba8 || width <= 0 || height <= 0) return texture;
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    const int blocks_x = (width + 3) / 4;
+    const int blocks_y = (height + 3) / 4;
+    const size_t block_bytes = BcBlockBytes(format);
+    texture.blocks.resize(size_t(blocks_x) * blocks_y * block_bytes);
+    ParallelFor(0, blocks_y, 1, [&](size_t begin, size_t end) {
+        Block block;
+        for (size_t by = begin; by < end; ++by) {
+            uint8_t* out = texture.blocks.data() + by * blocks_x * block_bytes;
+            for (int bx = 0; bx < blocks_x; ++bx) {
+                LoadBlock(rgba8, width, height, bx, static_cast<int>(by), &block);
+                EncodeBlock(block, format, quality, out + bx * block_bytes);
+            }
+        }
+    });
+    return texture;
+}
+
+std::vector<uint8_t> DecompressTexture(const CompressedTexture& texture) {
+    std::vector<uint8_t> rgba8;
+    if (!texture.IsValid()) return rgba8;
+    rgba8.resize(size_t(texture.width) * texture.height * 4);
+    const int blocks_x = (texture.width + 3) / 4;
+    const int blocks_y = (texture.height + 3) / 4;
+    const size_t block_bytes = BcBlockBytes(texture.format);
+    ParallelFor(0, blocks_y, 4, [&](size_t begin, size_t end) {
+        uint8_t texels[16][4];
+        for (size_t by = begin; by < end; ++by) {
+            for (int bx = 0; bx < blocks_x; ++bx) {
+                DecodeBlock(texture.blocks.data() + (by * blocks_x + bx) * block_bytes, texture.format, texels);
+                for (int y = 0; y < 4; ++y) {
+                    size_t sy = by * 4 + y;
+                    if (sy >= size_t(texture.height)) break;
+                    for (int x = 0; x < 4 && bx * 4 + x < texture.width; ++x) {
+                        std::memcpy(rgba8.data() + (sy * texture.width + bx * 4 + x) * 4, texels[y * 4 + x], 4);
+                    }
+                }
+            }
+        }
+    });
+    return rgba8;
+}
+
+CompressedTexture CompressTextureCached(const std::string& cache_dir, const uint8_t* rgba8, int width, int height,
+                                        BcFormat format, BcQuality quality, bool* cache_hit) {
+    if (cache_hit) *cache_hit = false;
+    if (!rgba8 || width <= 0 || height <= 0) return CompressedTexture();
+
+    uint64_t hash = SceneCache::HashBytes(rgba8, size_t(width) * height * 4);
+    const uint64_t key[3] = { hash, (uint64_t(uint32_t(width)) << 32) | uint32_t(height),
+                              (uint64_t(format) << 32) | uint64_t(quality) };
+    hash = SceneCache::HashBytes(reinterpret_cast<const uint8_t*>(key), sizeof(key));
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bc", static_cast<unsigned long long>(hash));
+    const std::filesystem::path path = std::filesystem::path(cache_dir) / name;
+
+    const size_t block_bytes = size_t((width + 3) / 4) * ((height + 3) / 4) * BcBlockBytes(format);
+    std::ifstream in(path, std::ios::binary);
+    if (in) {
+        CacheHeader header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (in && header.magic == kCacheMagic && header.version == kCacheVersion &&
+            header.format == uint32_t(format) && header.quality == uint32_t(quality) && header.width == width &&
+            header.height == height && header.block_bytes == block_bytes) {
+            CompressedTexture texture;
+            texture.format = format;
+            texture.width = width;
+            texture.height = height;
+            texture.blocks.resize(block_bytes);
+            in.read(reinterpret_cast<char*>(texture.blocks.data()), static_cast<std::streamsize>(block_bytes));
+            if (in) {
+                if (cache_hit) *cache_hit = true;
+                return texture;
+            }
+        }
+        grassland::LogWarning("Ignoring stale texture cache entry {}", path.string());
+    }
+    in.close();
+
+    CompressedTexture texture = CompressTexture(rgba8, width, height, format, quality);
+    std::error_code ec;
+    std::filesystem::create_directories(cache_dir, ec);
+    const std::filesystem::path temp_path = path.string() + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            grassland::LogWarning("Could not write texture cache entry {}", path.string());
+            return texture;
+        }
+        CacheHeader header = { kCacheMagic, kCacheVersion, uint32_t(format), uint32_t(quality), width, height,
+                               block_bytes };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(texture.blocks.data()), static_cast<std::streamsize>(block_bytes));
+    }
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        // Windows refuses to rename over an existing file
+        std::filesystem::remove(path, ec);
+        std::filesystem::rename(temp_path, path, ec);
+    }
+    if (ec) {
+        grassland::LogWarning("Could not write texture cache entry {}: {}", path.string(), ec.message());
+        std::filesystem::remove(temp_path, ec);
+    }
+    return texture;
+}
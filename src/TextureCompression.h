@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU block compression of RGBA8 textures into 4x4-texel blocks:
+//   BC1 - RGB 5:6:5 endpoints, 2-bit indices (8 bytes/block), opaque colour
+//   BC4 - one channel (red), 8-bit endpoints, 3-bit indices (8 bytes/block), AO/roughness
+//   BC5 - two BC4 blocks for red and green (16 bytes/block), tangent-space normals
+//   BC7 - mode 6 only: RGBA 7-bit endpoints with p-bits, 4-bit indices (16 bytes/block)
+// Endpoints come from the block's bounding box (kFast) or its principal axis, refined by least
+// squares on the chosen indices (kBalanced once, kHigh until it stops improving, also trying every
+// p-bit pair and BC4's 6-value mode). Block rows are encoded in parallel on the ThreadPool.
+enum class BcFormat : uint32_t {
+    kBC1 = 0,
+    kBC4 = 1,
+    kBC5 = 2,
+    kBC7 = 3,
+};
+
+enum class BcQuality : uint32_t {
+    kFast = 0,
+    kBalanced = 1,
+    kHigh = 2,
+};
+
+struct CompressedTexture {
+    BcFormat format = BcFormat::kBC7;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> blocks; // Row-major blocks, partial edge blocks padded by clamping
+
+    bool IsValid() const { return width > 0 && height > 0 && !blocks.empty(); }
+};
+
+size_t BcBlockBytes(BcFormat format);
+const char* BcFormatName(BcFormat format);
+const char* BcQualityName(BcQuality quality);
+
+// Channels a format keeps, in RGBA order (3 for BC1, 1 for BC4, 2 for BC5, 4 for BC7)
+int BcChannelCount(BcFormat format);
+
+CompressedTexture CompressTexture(const uint8_t* rgba8, int width, int height, BcFormat format, BcQuality quality);
+
+// Back to RGBA8; channels the format does not keep come back as 0 (alpha as 255)
+std::vector<uint8_t> DecompressTexture(const CompressedTexture& texture);
+
+// CompressTexture through a disk cache: one file per texture in cache_dir, named by a hash of
+// the pixels, size, format and quality. Misses are encoded and written back.
+CompressedTexture CompressTextureCached(const std::string& cache_dir, const uint8_t* rgba8, int width, int height,
+                                        BcFormat format, BcQuality quality, bool* cache_hit = nullptr);
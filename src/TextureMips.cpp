@@ -0,0 +1,166 @@
+#include "TextureMips.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr size_t kRowGrain = 16;
+constexpr size_t kLargeTexels = size_t(1024) * 1024;
+
+struct SrgbTable {
+    float to_linear[256];
+    SrgbTable() {
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+    }
+};
+
+const SrgbTable& GetSrgbTable() {
+    static const SrgbTable table;
+    return table;
+}
+
+// Lanes 3 and 7 hold alpha when eight floats cover two RGBA texels
+simd::Float8 AlphaLanes() {
+    alignas(32) float mask[8];
+    for (int i = 0; i < 8; ++i) mask[i] = (i & 3) == 3 ? 1.0f : 0.0f;
+    return simd::CmpNe(simd::Load(mask), simd::Broadcast(0.0f));
+}
+
+// Linear [0, 1] to 8-bit, sRGB-encoding the colour lanes when srgb is set
+simd::Float8 Encode(simd::Float8 x, bool srgb, simd::Float8 alpha_lanes) {
+    x = simd::Min(simd::Max(x, simd::Broadcast(0.0f)), simd::Broadcast(1.0f));
+    if (srgb) {
+        simd::Float8 low = x * simd::Broadcast(12.92f);
+        simd::Float8 positive = simd::Max(x, simd::Broadcast(1e-6f));
+        simd::Float8 high = simd::Broadcast(1.055f) * simd::Exp2(simd::Log2(positive) * simd::Broadcast(1.0f / 2.4f)) -
+                            simd::Broadcast(0.055f);
+        simd::Float8 color = simd::Select(simd::CmpLe(x, simd::Broadcast(0.0031308f)), low, high);
+        x = simd::Select(alpha_lanes, x, color);
+    }
+    return x * simd::Broadcast(255.0f) + simd::Broadcast(0.5f);
+}
+
+void EncodeRow(const float* linear, size_t count, bool srgb, uint8_t* out) {
+    const simd::Float8 alpha_lanes = AlphaLanes();
+    alignas(32) float lanes[8];
+    for (size_t i = 0; i < count; i += 8) {
+        size_t n = std::min<size_t>(8, count - i);
+        if (n == 8) {
+            simd::Store(lanes, Encode(simd::LoadUnaligned(linear + i), srgb, alpha_lanes));
+        } else {
+            alignas(32) float tail[8] = {};
+            std::copy(linear + i, linear + i + n, tail);
+            simd::Store(lanes, Encode(simd::Load(tail), srgb, alpha_lanes));
+        }
+        for (size_t k = 0; k < n; ++k) out[i + k] = static_cast<uint8_t>(lanes[k]);
+    }
+}
+
+// One level down: vertical pair sums with SIMD, then horizontal pairs per texel
+void Downsample(const std::vector<float>& source, int width, int height, std::vector<float>* target, int out_width,
+                int out_height, bool parallel) {
+    const size_t row_floats = size_t(width) * 4;
+    target->resize(size_t(out_width) * out_height * 4);
+    auto filter_rows = [&](size_t begin, size_t end) {
+        std::vector<float> sum(row_floats);
+        for (size_t y = begin; y < end; ++y) {
+            const float* row0 = source.data() + std::min<size_t>(2 * y, height - 1) * row_floats;
+            const float* row1 = source.data() + std::min<size_t>(2 * y + 1, height - 1) * row_floats;
+            size_t i = 0;
+            for (; i + 8 <= row_floats; i += 8) {
+                simd::StoreUnaligned(sum.data() + i, simd::LoadUnaligned(row0 + i) + simd::LoadUnaligned(row1 + i));
+            }
+            for (; i < row_floats; ++i) sum[i] = row0[i] + row1[i];
+
+            float* out = target->data() + y * out_width * 4;
+            for (int x = 0; x < out_width; ++x) {
+                const float* a = sum.data() + size_t(std::min(2 * x, width - 1)) * 4;
+                const float* b = sum.data() + size_t(std::min(2 * x + 1, width - 1)) * 4;
+                for (int c = 0; c < 4; ++c) out[x * 4 + c] = (a[c] + b[c]) * 0.25f;
+            }
+        }
+    };
+    if (parallel) {
+        ParallelFor(0, out_height, kRowGrain, filter_rows);
+    } else {
+        filter_rows(0, out_height);
+    }
+}
+} // namespace
+
+int MipLevelCount(int width, int height) {
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        ++levels;
+    }
+    return levels;
+}
+
+std::vector<MipLevel> GenerateMipChain(const uint8_t* rgba8, int width, int height, bool srgb) {
+    std::vector<MipLevel> levels;
+    if (!rgba8 || width <= 0 || height <= 0) return levels;
+    levels.reserve(MipLevelCount(width, height) - 1);
+    const float* to_linear = GetSrgbTable().to_linear;
+
+    std::vector<float> current(size_t(width) * height * 4), next;
+    ParallelFor(0, current.size() / 4, kRowGrain * 256, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            for (int c = 0; c < 4; ++c) {
+                uint8_t value = rgba8[t * 4 + c];
+                current[t * 4 + c] = srgb && c < 3 ? to_linear[value] : value * (1.0f / 255.0f);
+            }
+        }
+    });
+
+    while (width > 1 || height > 1) {
+        int out_width = std::max(1, width / 2);
+        int out_height = std::max(1, height / 2);
+        bool parallel = size_t(out_width) * out_height >= kRowGrain * 256;
+        Downsample(current, width, height, &next, out_width, out_height, parallel);
+
+        MipLevel level;
+        level.width = out_width;
+        level.height = out_height;
+        level.rgba8.resize(next.size());
+        const size_t row_floats = size_t(out_width) * 4;
+        auto encode_rows = [&](size_t begin, size_t end) {
+            EncodeRow(next.data() + begin * row_floats, (end - begin) * row_floats, srgb, level.rgba8.data() + begin * row_floats);
+        };
+        if (parallel) {
+            ParallelFor(0, out_height, kRowGrain, encode_rows);
+        } else {
+            encode_rows(0, out_height);
+        }
+        levels.push_back(std::move(level));
+
+        current.swap(next);
+        width = out_width;
+        height = out_height;
+    }
+    return levels;
+}
+
+std::vector<std::vector<MipLevel>> GenerateMipChains(const std::vector<MipSource>& sources) {
+    std::vector<std::vector<MipLevel>> chains(sources.size());
+    std::vector<size_t> small;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const MipSource& source = sources[i];
+        if (!source.rgba8) continue;
+        if (size_t(source.width) * source.height >= kLargeTexels) {
+            chains[i] = GenerateMipChain(source.rgba8, source.width, source.height, source.srgb);
+        } else {
+            small.push_back(i);
+        }
+    }
+    ThreadPool::Instance().Run(small.size(), [&](size_t k, unsigned) {
+        const MipSource& source = sources[small[k]];
+        chains[small[k]] = GenerateMipChain(source.rgba8, source.width, source.height, source.srgb);
+    });
+    return chains;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU mip chains for RGBA8 textures. Every level halves the previous one (rounding down, at least
+// one texel) with a 2x2 box filter; the last row or column of an odd-sized level is dropped.
+// Filtering runs in float on simd::Float8: the colour channels of sRGB textures (base colour,
+// emissive) are averaged in linear light, alpha and data textures as stored. Levels are filtered
+// from the float result of the previous level, not from its 8-bit rounding.
+
+struct MipLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgba8;
+};
+
+// Where the shaders find a texture's smaller levels (TextureMipRange in common.hlsl): level i > 0
+// of texture t is Textures[first_level + i - 1]
+struct TextureMipRange {
+    int32_t first_level = -1;
+    int32_t level_count = 1; // Including level 0
+};
+
+// Levels in a full chain down to 1x1, level 0 included
+int MipLevelCount(int width, int height);
+
+// Levels 1.. of the chain (level 0 is the source). Rows of large levels are filtered in parallel
+// on the ThreadPool.
+std::vector<MipLevel> GenerateMipChain(const uint8_t* rgba8, int width, int height, bool srgb);
+
+// Chains for several textures at once: large textures take the pool one at a time, small ones one
+// per task. Null sources get no levels.
+struct MipSource {
+    int width = 0;
+    int height = 0;
+    const uint8_t* rgba8 = nullptr;
+    bool srgb = false;
+};
+std::vector<std::vector<MipLevel>> GenerateMipChains(const std::vector<MipSource>& sources);
@@ -0,0 +1,111 @@
+#include "TexturePacking.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr size_t kRowGrain = 16;
+
+uint32_t LoadTexel(const uint8_t* texel) {
+    uint32_t value;
+    std::memcpy(&value, texel, sizeof(value));
+    return value;
+}
+
+// Row y of a source as width RGBA8 texels: the image row itself when the sizes match, otherwise
+// a nearest-neighbour resample into scratch. Null for constant sources.
+const uint8_t* SourceRow(const ChannelSource& source, int width, int height, int y, std::vector<uint8_t>* scratch) {
+    if (!source.rgba8 || source.width <= 0 || source.height <= 0) return nullptr;
+    if (source.width == width && source.height == height) return source.rgba8 + size_t(y) * width * 4;
+    int sy = std::min(static_cast<int>((int64_t(y) * source.height) / height), source.height - 1);
+    scratch->resize(size_t(width) * 4);
+    for (int x = 0; x < width; ++x) {
+        int sx = std::min(static_cast<int>((int64_t(x) * source.width) / width), source.width - 1);
+        std::memcpy(scratch->data() + size_t(x) * 4, source.rgba8 + (size_t(sy) * source.width + sx) * 4, 4);
+    }
+    return scratch->data();
+}
+
+// The source's byte of texels x..x+7 moved to bit `shift` of every lane
+simd::Int8 ChannelLanes(const ChannelSource& source, const uint8_t* row, int x, int shift) {
+    if (!row) return simd::BroadcastInt(uint32_t(source.constant) << shift);
+    simd::Int8 texels = simd::LoadUnaligned(reinterpret_cast<const uint32_t*>(row + size_t(x) * 4));
+    return simd::ShiftLeft(simd::ShiftRight(texels, 8 * source.channel) & simd::BroadcastInt(0xFF), shift);
+}
+
+uint32_t ChannelByte(const ChannelSource& source, const uint8_t* row, int x, int shift) {
+    uint32_t value = row ? (LoadTexel(row + size_t(x) * 4) >> (8 * source.channel)) & 0xFF : source.constant;
+    return value << shift;
+}
+void ExpandRange(const uint8_t* pixels, int channels, size_t begin, size_t end, uint8_t* rgba8) {
+    size_t i = begin;
+    if (channels == 1) {
+        for (; i + 8 <= end; i += 8) {
+            simd::Int8 v = simd::LoadWiden(pixels + i);
+            simd::Int8 texels = v | simd::ShiftLeft(v, 8) | simd::ShiftLeft(v, 16) | simd::BroadcastInt(0xFF000000u);
+            simd::StoreUnaligned(reinterpret_cast<uint32_t*>(rgba8 + i * 4), texels);
+        }
+        for (; i < end; ++i) {
+            uint8_t v = pixels[i];
+            uint8_t texel[4] = { v, v, v, 255 };
+            std::memcpy(rgba8 + i * 4, texel, 4);
+        }
+    } else {
+        for (; i + 8 <= end; i += 8) {
+            // Little-endian pairs: grey in the low byte, alpha in the high byte
+            simd::Int8 pairs = simd::LoadWiden(reinterpret_cast<const uint16_t*>(pixels + i * 2));
+            simd::Int8 v = pairs & simd::BroadcastInt(0xFF);
+            simd::Int8 texels = v | simd::ShiftLeft(v, 8) | simd::ShiftLeft(v, 16) | simd::ShiftLeft(pairs & simd::BroadcastInt(0xFF00), 16);
+            simd::StoreUnaligned(reinterpret_cast<uint32_t*>(rgba8 + i * 4), texels);
+        }
+        for (; i < end; ++i) {
+            uint8_t v = pixels[i * 2];
+            uint8_t texel[4] = { v, v, v, pixels[i * 2 + 1] };
+            std::memcpy(rgba8 + i * 4, texel, 4);
+        }
+    }
+}
+} // namespace
+
+void ExpandToRgba8(const uint8_t* pixels, int channels, size_t count, uint8_t* rgba8) {
+    if (channels == 4) {
+        std::memcpy(rgba8, pixels, count * 4);
+        return;
+    }
+    constexpr size_t kTexelGrain = size_t(64) << 10;
+    if (count < 2 * kTexelGrain) {
+        ExpandRange(pixels, channels, 0, count, rgba8);
+        return;
+    }
+    ParallelFor(0, count, kTexelGrain, [&](size_t begin, size_t end) { ExpandRange(pixels, channels, begin, end, rgba8); });
+}
+
+std::vector<uint8_t> PackOrmTexture(int width, int height, const ChannelSource& occlusion,
+                                    const ChannelSource& roughness, const ChannelSource& metallic) {
+    std::vector<uint8_t> packed;
+    if (width <= 0 || height <= 0) return packed;
+    packed.resize(size_t(width) * height * 4);
+    const ChannelSource* sources[3] = { &occlusion, &roughness, &metallic };
+    ParallelFor(0, height, kRowGrain, [&](size_t begin, size_t end) {
+        std::vector<uint8_t> scratch[3];
+        for (size_t y = begin; y < end; ++y) {
+            const uint8_t* rows[3];
+            for (int s = 0; s < 3; ++s) rows[s] = SourceRow(*sources[s], width, height, static_cast<int>(y), &scratch[s]);
+            // Texels are little-endian RGBA8 words: red is the low byte
+            uint8_t* out = packed.data() + y * width * 4;
+            int x = 0;
+            for (; x + 8 <= width; x += 8) {
+                simd::Int8 texels = ChannelLanes(occlusion, rows[0], x, 0) | ChannelLanes(roughness, rows[1], x, 8) |
+                                    ChannelLanes(metallic, rows[2], x, 16) | simd::BroadcastInt(0xFF000000u);
+                simd::StoreUnaligned(reinterpret_cast<uint32_t*>(out + size_t(x) * 4), texels);
+            }
+            for (; x < width; ++x) {
+                uint32_t texel = ChannelByte(occlusion, rows[0], x, 0) | ChannelByte(roughness, rows[1], x, 8) |
+                                 ChannelByte(metallic, rows[2], x, 16) | 0xFF000000u;
+                std::memcpy(out + size_t(x) * 4, &texel, 4);
+            }
+        }
+    });
+    return packed;
+}
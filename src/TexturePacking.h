@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Channel layout kernels for 8-bit textures.
+// Packing of separate single-channel material maps into one glTF-style ORM texture: occlusion in
+// red, roughness in green, metallic in blue (what metallic_roughness_tex and AO_texture read), alpha
+// 255. One ORM texture replaces up to three RGBA8 textures for materials authored with split maps.
+// Expansion of narrow images (grey, grey + alpha) to RGBA8 for the consumers that need four channels.
+
+// One channel of the packed texture: `channel` of an RGBA8 image (greyscale files decode with equal
+// RGB), or `constant` everywhere when rgba8 is null
+struct ChannelSource {
+    const uint8_t* rgba8 = nullptr;
+    int width = 0;
+    int height = 0;
+    int channel = 0;
+    uint8_t constant = 255;
+};
+
+// Packs the three sources into a width x height RGBA8 texture. Sources of another size are sampled
+// nearest-neighbour. Rows run in parallel on the ThreadPool, eight texels at a time on simd::Int8.
+std::vector<uint8_t> PackOrmTexture(int width, int height, const ChannelSource& occlusion,
+                                    const ChannelSource& roughness, const ChannelSource& metallic);
+
+// Expands count texels of 1 (grey) or 2 (grey, alpha) channels to RGBA8 as (v, v, v, 255) or
+// (v, v, v, a), the way stb_image expands them; 4 channels are copied. Large images run in parallel
+// on the ThreadPool, eight texels at a time on simd::Int8.
+void ExpandToRgba8(const uint8_t* pixels, int channels, size_t count, uint8_t* rgba8);
@@ -0,0 +1,126 @@
+#include "ThreadPool.h"
+
+namespace {
+// Set on pool threads (and on the caller while it helps) so nested Run() calls execute inline
+thread_local bool t_inside_pool = false;
+}
+
+ThreadPool& ThreadPool::Instance() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+ThreadPool::ThreadPool(unsigned worker_count)
+    : slices_(std::max(1u, worker_count)) {
+    threads_.reserve(slices_.size() - 1);
+    for (unsigned i = 1; i < slices_.size(); ++i) {
+        threads_.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::Dispatch(size_t task_count, TaskFn fn, void* ctx) {
+    if (task_count == 0) {
+        return;
+    }
+
+    // Nested or trivially small jobs run on the calling thread
+    if (t_inside_pool || task_count == 1 || slices_.size() == 1) {
+        for (size_t task = 0; task < task_count; ++task) {
+            fn(ctx, task, 0);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+
+    // Hand every worker a contiguous slice of the task range
+    const size_t worker_count = slices_.size();
+    for (size_t w = 0; w < worker_count; ++w) {
+        std::lock_guard<std::mutex> lock(slices_[w].mutex);
+        slices_[w].begin = task_count * w / worker_count;
+        slices_[w].end = task_count * (w + 1) / worker_count;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        job_fn_ = fn;
+        job_ctx_ = ctx;
+        active_workers_ = static_cast<unsigned>(worker_count - 1);
+        ++generation_;
+    }
+    wake_cv_.notify_all();
+
+    // The caller works as worker 0
+    t_inside_pool = true;
+    Drain(0);
+    t_inside_pool = false;
+
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    done_cv_.wait(lock, [this]() { return active_workers_ == 0; });
+    job_fn_ = nullptr;
+    job_ctx_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop(unsigned worker) {
+    t_inside_pool = true;
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait(lock, [&]() { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+        }
+
+        Drain(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            --active_workers_;
+        }
+        done_cv_.notify_one();
+    }
+}
+
+void ThreadPool::Drain(unsigned worker) {
+    size_t task;
+    while (PopOwn(worker, &task) || Steal(worker, &task)) {
+        job_fn_(job_ctx_, task, worker);
+    }
+}
+
+bool ThreadPool::PopOwn(unsigned worker, size_t* task) {
+    Slice& slice = slices_[worker];
+    std::lock_guard<std::mutex> lock(slice.mutex);
+    if (slice.begin >= slice.end) {
+        return false;
+    }
+    *task = slice.begin++;
+    return true;
+}
+
+bool ThreadPool::Steal(unsigned thief, size_t* task) {
+    const size_t worker_count = slices_.size();
+    for (size_t offset = 1; offset < worker_count; ++offset) {
+        Slice& victim = slices_[(thief + offset) % worker_count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.begin < victim.end) {
+            *task = --victim.end;
+            return true;
+        }
+    }
+    return false;
+}
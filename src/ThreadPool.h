@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent worker pool for the CPU-side passes (CPU path tracer, BVH builds, film development...)
+// Run() splits a task range into one contiguous slice per worker; a worker that drains its own
+// slice steals tasks from the back of the other slices, so uneven tiles still balance out.
+// Dispatching a job does not allocate, which keeps per-frame passes heap-free.
+class ThreadPool {
+public:
+    // Shared pool sized to the hardware concurrency
+    static ThreadPool& Instance();
+
+    explicit ThreadPool(unsigned worker_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads executing tasks (including the thread calling Run)
+    unsigned GetWorkerCount() const { return static_cast<unsigned>(slices_.size()); }
+
+    // Execute fn(task_index, worker_index) for every task in [0, task_count) and wait for completion.
+    // Nested calls from inside a task run serially on the calling worker.
+    template <class Fn>
+    void Run(size_t task_count, Fn&& fn) {
+        using FnType = typename std::remove_reference<Fn>::type;
+        Dispatch(task_count, [](void* ctx, size_t task, unsigned worker) {
+            (*static_cast<FnType*>(ctx))(task, worker);
+        }, const_cast<void*>(static_cast<const void*>(&fn)));
+    }
+
+private:
+    using TaskFn = void (*)(void* ctx, size_t task, unsigned worker);
+
+    struct alignas(64) Slice {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    void Dispatch(size_t task_count, TaskFn fn, void* ctx);
+    void WorkerLoop(unsigned worker);
+    void Drain(unsigned worker);
+    bool PopOwn(unsigned worker, size_t* task);
+    bool Steal(unsigned thief, size_t* task);
+
+    std::vector<Slice> slices_;
+    std::vector<std::thread> threads_;
+
+    std::mutex run_mutex_;   // serializes concurrent Run() callers
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_ = 0;
+    unsigned active_workers_ = 0;
+    bool stopping_ = false;
+
+    TaskFn job_fn_ = nullptr;
+    void* job_ctx_ = nullptr;
+};
+
+// Run fn(begin, end) over [begin, end) in chunks of roughly `grain` items on the shared pool
+template <class Fn>
+void ParallelFor(size_t begin, size_t end, size_t grain, Fn&& fn) {
+    if (end <= begin) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    size_t chunk_count = (end - begin + grain - 1) / grain;
+    ThreadPool::Instance().Run(chunk_count, [&](size_t chunk, unsigned) {
+        size_t chunk_begin = begin + chunk * grain;
+        fn(chunk_begin, std::min(end, chunk_begin + grain));
+    });
+}
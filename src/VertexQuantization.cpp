@@ -0,0 +1,159 @@
+#include "VertexQuantization.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+// Octahedral projection of a direction onto [-1, 1]^2 (zero vectors map to +Z)
+glm::vec2 OctahedralProject(const glm::vec3& n) {
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (!(l1 > 0.0f)) return glm::vec2(0.0f);
+    glm::vec2 p(n.x / l1, n.y / l1);
+    if (n.z < 0.0f) {
+        glm::vec2 folded((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                         (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+        p = folded;
+    }
+    return p;
+}
+
+glm::vec3 OctahedralUnproject(glm::vec2 p) {
+    glm::vec3 n(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+int32_t ToSnorm(float v, int bits) {
+    float scale = float((1 << (bits - 1)) - 1);
+    return static_cast<int32_t>(std::lround(std::min(std::max(v, -1.0f), 1.0f) * scale));
+}
+
+float FromSnorm(int32_t v, int bits) {
+    float scale = float((1 << (bits - 1)) - 1);
+    return std::max(float(v) / scale, -1.0f);
+}
+
+// Sign-extends the bits-wide field at shift
+int32_t ExtractSigned(uint32_t packed, int shift, int bits) {
+    return static_cast<int32_t>(packed << (32 - shift - bits)) >> (32 - bits);
+}
+
+uint32_t Field(int32_t v, int shift, int bits) {
+    return (static_cast<uint32_t>(v) & ((1u << bits) - 1u)) << shift;
+}
+} // namespace
+
+uint32_t EncodeOctahedral(const glm::vec3& n) {
+    if (!(std::abs(n.x) + std::abs(n.y) + std::abs(n.z) > 0.0f)) return kOctahedralZero;
+    glm::vec2 p = OctahedralProject(n);
+    return Field(ToSnorm(p.x, 16), 0, 16) | Field(ToSnorm(p.y, 16), 16, 16);
+}
+
+glm::vec3 DecodeOctahedral(uint32_t packed) {
+    if (packed == kOctahedralZero) return glm::vec3(0.0f);
+    return OctahedralUnproject(glm::vec2(FromSnorm(ExtractSigned(packed, 0, 16), 16),
+                                         FromSnorm(ExtractSigned(packed, 16, 16), 16)));
+}
+
+uint32_t EncodeOctahedralTangent(const glm::vec3& t, float sign) {
+    glm::vec2 p = OctahedralProject(t);
+    return Field(ToSnorm(p.x, 15), 0, 15) | Field(ToSnorm(p.y, 15), 15, 15) | (sign < 0.0f ? 1u << 31 : 0u);
+}
+
+glm::vec3 DecodeOctahedralTangent(uint32_t packed, float* sign) {
+    if (sign) *sign = (packed >> 31) ? -1.0f : 1.0f;
+    return OctahedralUnproject(glm::vec2(FromSnorm(ExtractSigned(packed, 0, 15), 15),
+                                         FromSnorm(ExtractSigned(packed, 15, 15), 15)));
+}
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t abs_bits = bits & 0x7FFFFFFFu;
+    if (abs_bits >= 0x7F800000u) {
+        // Inf stays inf, NaN stays a (quiet) NaN
+        return static_cast<uint16_t>(sign | 0x7C00u | (abs_bits > 0x7F800000u ? 0x200u : 0u));
+    }
+    if (abs_bits >= 0x477FF000u) {
+        return static_cast<uint16_t>(sign | 0x7C00u); // Rounds past the largest half
+    }
+    if (abs_bits < 0x38800000u) {
+        // Subnormal half (or zero): shift the mantissa with its implicit bit, round to nearest even
+        if (abs_bits < 0x33000000u) return static_cast<uint16_t>(sign);
+        uint32_t exponent = abs_bits >> 23;
+        uint32_t mantissa = (abs_bits & 0x7FFFFFu) | 0x800000u;
+        uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1);
+        half += rest > halfway || (rest == halfway && (half & 1u));
+        return static_cast<uint16_t>(sign | half);
+    }
+    // Normal half: rebias the exponent, round the mantissa to nearest even
+    uint32_t half = (abs_bits - 0x38000000u) >> 13;
+    uint32_t rest = abs_bits & 0x1FFFu;
+    half += rest > 0x1000u || (rest == 0x1000u && (half & 1u));
+    return static_cast<uint16_t>(sign | half);
+}
+
+float HalfToFloat(uint16_t half) {
+    uint32_t sign = uint32_t(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+    uint32_t bits;
+    if (exponent == 0x1Fu) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        float value = std::ldexp(float(mantissa), -24);
+        std::memcpy(&bits, &value, sizeof(bits));
+        bits |= sign;
+    } else {
+        bits = sign;
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint32_t PackHalf2(const glm::vec2& v) {
+    return uint32_t(FloatToHalf(v.x)) | (uint32_t(FloatToHalf(v.y)) << 16);
+}
+
+glm::vec2 UnpackHalf2(uint32_t packed) {
+    return glm::vec2(HalfToFloat(static_cast<uint16_t>(packed & 0xFFFFu)), HalfToFloat(static_cast<uint16_t>(packed >> 16)));
+}
+
+uint32_t GetVertexStreamMask(const grassland::Mesh<float>& mesh) {
+    return (mesh.Normals() ? VERTEX_STREAM_NORMAL : 0u) | (mesh.Tangents() ? VERTEX_STREAM_TANGENT : 0u) |
+           (mesh.TexCoords() ? VERTEX_STREAM_TEXCOORD : 0u);
+}
+
+std::vector<uint32_t> PackVertexStreams(const grassland::Mesh<float>& mesh, const float* tangent_signs,
+                                        VertexFormat* format) {
+    const auto* normals = reinterpret_cast<const glm::vec3*>(mesh.Normals());
+    const auto* tangents = reinterpret_cast<const glm::vec3*>(mesh.Tangents());
+    const auto* texcoords = reinterpret_cast<const glm::vec2*>(mesh.TexCoords());
+
+    *format = VertexFormat();
+    format->stream_mask = GetVertexStreamMask(mesh);
+    uint32_t slot = 0;
+    uint32_t normal_slot = normals ? slot++ : 0;
+    uint32_t tangent_slot = tangents ? slot++ : 0;
+    uint32_t texcoord_slot = texcoords ? slot++ : 0;
+    format->packed_stride = slot;
+    format->packed_slots = normal_slot | (tangent_slot << 8) | (texcoord_slot << 16);
+
+    std::vector<uint32_t> packed(size_t(mesh.NumVertices()) * slot);
+    for (size_t i = 0; i < mesh.NumVertices(); ++i) {
+        uint32_t* vertex = packed.data() + i * slot;
+        if (normals) vertex[normal_slot] = EncodeOctahedral(normals[i]);
+        if (tangents) vertex[tangent_slot] = EncodeOctahedralTangent(tangents[i], tangent_signs ? tangent_signs[i] : 1.0f);
+        if (texcoords) vertex[texcoord_slot] = PackHalf2(texcoords[i]);
+    }
+    return packed;
+}
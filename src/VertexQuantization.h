@@ -0,0 +1,50 @@
+#pragma once
+#include "long_march.h"
+#include <cstdint>
+#include <vector>
+
+// Compact vertex attribute encodings for VertexLayout::kQuantized, mirrored by the decode
+// functions in shaders/common.hlsl:
+//   normal   32-bit octahedral, two 16-bit snorm components; kOctahedralZero marks a zero normal
+//   tangent  32-bit octahedral, two 15-bit snorm components and the bitangent sign in bit 31
+//   texcoord two IEEE half floats
+
+// Bits of VertexFormat::stream_mask
+enum VertexStream : uint32_t {
+    VERTEX_STREAM_NORMAL = 1u << 0,
+    VERTEX_STREAM_TANGENT = 1u << 1,
+    VERTEX_STREAM_TEXCOORD = 1u << 2,
+};
+
+// Vertex streams of one entity (VertexFormat in common.hlsl, one per entity like Material)
+struct VertexFormat {
+    uint32_t stream_mask = 0;   // VertexStream bits of the streams the mesh has
+    uint32_t packed_stride = 0; // 32-bit words per vertex in the packed buffer
+    uint32_t packed_slots = 0;  // Word of the normal | tangent << 8 | texcoord << 16 in a packed vertex
+    uint32_t pad = 0;
+};
+
+// Both components at -32768, which no direction encodes to: zero normals decode back to zero, so
+// the hit shaders' geometric-normal fallback still sees them
+constexpr uint32_t kOctahedralZero = 0x80008000u;
+
+uint32_t EncodeOctahedral(const glm::vec3& n);
+glm::vec3 DecodeOctahedral(uint32_t packed);
+
+// sign is the bitangent handedness (+1 or -1)
+uint32_t EncodeOctahedralTangent(const glm::vec3& t, float sign);
+glm::vec3 DecodeOctahedralTangent(uint32_t packed, float* sign = nullptr);
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+uint32_t PackHalf2(const glm::vec2& v);
+glm::vec2 UnpackHalf2(uint32_t packed);
+
+// VertexStream bits of the streams a mesh has
+uint32_t GetVertexStreamMask(const grassland::Mesh<float>& mesh);
+
+// Interleaves the encoded streams the mesh has (absent ones take no space) and describes them in
+// *format. tangent_signs holds the bitangent handedness per vertex (null when all +1). Returns an
+// empty vector for meshes without normals, tangents and texcoords.
+std::vector<uint32_t> PackVertexStreams(const grassland::Mesh<float>& mesh, const float* tangent_signs,
+                                        VertexFormat* format);
@@ -0,0 +1,297 @@
+#include "WideBvh.h"
+
+namespace {
+// Child of a node during traversal, ordered by entry distance
+struct ChildEntry {
+    uint32_t child;
+    uint32_t block_count;
+    float t;
+};
+
+// Sort the hit children far to near so the nearest one is popped first
+void SortFarToNear(ChildEntry* entries, int count) {
+    for (int i = 1; i < count; ++i) {
+        ChildEntry entry = entries[i];
+        int j = i;
+        while (j > 0 && entries[j - 1].t < entry.t) {
+            entries[j] = entries[j - 1];
+            --j;
+        }
+        entries[j] = entry;
+    }
+}
+
+float BoxArea(const BvhNode& node) {
+    Aabb box;
+    box.min_p = node.bounds_min;
+    box.max_p = node.bounds_max;
+    return box.SurfaceArea();
+}
+} // namespace
+
+void WideBvh::Build(const MeshBvh& bvh) {
+    nodes_.clear();
+    blocks_.clear();
+    const std::vector<BvhNode>& binary = bvh.GetNodes();
+    if (binary.empty()) {
+        return;
+    }
+
+    // Triangles below every binary node; children always follow their parent in the array
+    std::vector<uint32_t> subtree_triangles(binary.size());
+    for (size_t i = binary.size(); i-- > 0;) {
+        const BvhNode& node = binary[i];
+        subtree_triangles[i] = node.IsLeaf() ? node.prim_count
+                                             : subtree_triangles[node.left_first] + subtree_triangles[node.left_first + 1];
+    }
+
+    nodes_.reserve(binary.size() / (kWidth - 1) + 1);
+    blocks_.reserve(bvh.GetTriangleCount() / (kWidth / 2) + 1);
+    CollapseNode(bvh, subtree_triangles, 0);
+    nodes_.shrink_to_fit();
+    blocks_.shrink_to_fit();
+}
+
+uint32_t WideBvh::CollapseNode(const MeshBvh& bvh, const std::vector<uint32_t>& subtree_triangles, uint32_t binary_index) {
+    const std::vector<BvhNode>& binary = bvh.GetNodes();
+    // Subtrees that fit into one triangle block become leaves
+    auto is_leaf = [&](uint32_t index) { return binary[index].IsLeaf() || subtree_triangles[index] <= kWidth; };
+
+    uint32_t node_index = static_cast<uint32_t>(nodes_.size());
+    Node empty;
+    for (int c = 0; c < kWidth; ++c) {
+        empty.min_x[c] = empty.min_y[c] = empty.min_z[c] = std::numeric_limits<float>::infinity();
+        empty.max_x[c] = empty.max_y[c] = empty.max_z[c] = -std::numeric_limits<float>::infinity();
+        empty.child[c] = kInvalid;
+        empty.block_count[c] = 0;
+    }
+    nodes_.push_back(empty);
+
+    uint32_t children[kWidth];
+    int child_count = 0;
+    if (is_leaf(binary_index)) {
+        children[child_count++] = binary_index;
+    } else {
+        children[child_count++] = binary[binary_index].left_first;
+        children[child_count++] = binary[binary_index].left_first + 1;
+        // Open the interior child with the largest surface area until all slots are used
+        while (child_count < kWidth) {
+            int best = -1;
+            float best_area = -1.0f;
+            for (int c = 0; c < child_count; ++c) {
+                if (is_leaf(children[c])) continue;
+                float area = BoxArea(binary[children[c]]);
+                if (area > best_area) {
+                    best_area = area;
+                    best = c;
+                }
+            }
+            if (best < 0) break;
+            uint32_t opened = children[best];
+            children[best] = binary[opened].left_first;
+            children[child_count++] = binary[opened].left_first + 1;
+        }
+    }
+
+    for (int c = 0; c < child_count; ++c) {
+        uint32_t child, block_count = 0;
+        if (is_leaf(children[c])) {
+            child = static_cast<uint32_t>(blocks_.size());
+            AppendLeafBlocks(bvh, children[c]);
+            block_count = static_cast<uint32_t>(blocks_.size()) - child;
+        } else {
+            child = CollapseNode(bvh, subtree_triangles, children[c]);
+        }
+        const BvhNode& source = binary[children[c]];
+        Node& node = nodes_[node_index]; // The recursion may have reallocated nodes_
+        node.min_x[c] = source.bounds_min.x;
+        node.min_y[c] = source.bounds_min.y;
+        node.min_z[c] = source.bounds_min.z;
+        node.max_x[c] = source.bounds_max.x;
+        node.max_y[c] = source.bounds_max.y;
+        node.max_z[c] = source.bounds_max.z;
+        node.child[c] = child;
+        node.block_count[c] = block_count;
+    }
+    return node_index;
+}
+
+void WideBvh::AppendLeafBlocks(const MeshBvh& bvh, uint32_t binary_index) {
+    const std::vector<BvhNode>& binary = bvh.GetNodes();
+    const std::vector<uint32_t>& prim_indices = bvh.GetPrimitiveIndices();
+
+    // Gather the triangles of the whole subtree
+    std::vector<uint32_t> primitives;
+    uint32_t stack[MeshBvh::kMaxDepth * 2];
+    int stack_size = 0;
+    stack[stack_size++] = binary_index;
+    while (stack_size > 0) {
+        const BvhNode& node = binary[stack[--stack_size]];
+        if (node.IsLeaf()) {
+            primitives.insert(primitives.end(), prim_indices.begin() + node.left_first,
+                              prim_indices.begin() + node.left_first + node.prim_count);
+        } else {
+            stack[stack_size++] = node.left_first;
+            stack[stack_size++] = node.left_first + 1;
+        }
+    }
+
+    for (size_t first = 0; first < primitives.size(); first += kWidth) {
+        TriangleBlock block{}; // Padding lanes keep zero edges
+        for (int lane = 0; lane < kWidth; ++lane) {
+            if (first + lane >= primitives.size()) {
+                block.primitive[lane] = kInvalid;
+                continue;
+            }
+            uint32_t prim = primitives[first + lane];
+            glm::vec3 p0, p1, p2;
+            bvh.GetTriangle(prim, &p0, &p1, &p2);
+            glm::vec3 e1 = p1 - p0;
+            glm::vec3 e2 = p2 - p0;
+            block.v0_x[lane] = p0.x;
+            block.v0_y[lane] = p0.y;
+            block.v0_z[lane] = p0.z;
+            block.e1_x[lane] = e1.x;
+            block.e1_y[lane] = e1.y;
+            block.e1_z[lane] = e1.z;
+            block.e2_x[lane] = e2.x;
+            block.e2_y[lane] = e2.y;
+            block.e2_z[lane] = e2.z;
+            block.primitive[lane] = prim;
+        }
+        blocks_.push_back(block);
+    }
+}
+
+bool WideBvh::IntersectClosest(const CpuRay& ray, CpuHit* hit) const {
+    if (nodes_.empty()) return false;
+    SingleRay r(ray);
+    float t_max = ray.t_max;
+    bool found = false;
+
+    ChildEntry stack[kStackSize];
+    int stack_size = 0;
+    stack[stack_size++] = { 0, 0, ray.t_min };
+    while (stack_size > 0) {
+        ChildEntry entry = stack[--stack_size];
+        if (entry.t > t_max) {
+            continue; // A closer hit was found after this child was pushed
+        }
+
+        if (entry.block_count > 0) {
+            for (uint32_t b = entry.child; b < entry.child + entry.block_count; ++b) {
+                simd::Float8 t, u, v;
+                int mask = IntersectBlock(blocks_[b], r, t_max, &t, &u, &v);
+                if (!mask) continue;
+                alignas(32) float t_lanes[kWidth], u_lanes[kWidth], v_lanes[kWidth];
+                simd::Store(t_lanes, t);
+                simd::Store(u_lanes, u);
+                simd::Store(v_lanes, v);
+                int best = -1;
+                for (; mask; mask &= mask - 1) {
+                    int lane = simd::FirstLane(mask);
+                    if (best < 0 || t_lanes[lane] < t_lanes[best]) best = lane;
+                }
+                t_max = t_lanes[best];
+                hit->t = t_lanes[best];
+                hit->u = u_lanes[best];
+                hit->v = v_lanes[best];
+                hit->primitive = blocks_[b].primitive[best];
+                found = true;
+            }
+            continue;
+        }
+
+        const Node& node = nodes_[entry.child];
+        alignas(32) float t_enter[kWidth];
+        ChildEntry children[kWidth];
+        int child_count = 0;
+        for (int mask = IntersectChildren(node, r, t_max, t_enter); mask; mask &= mask - 1) {
+            int lane = simd::FirstLane(mask);
+            children[child_count++] = { node.child[lane], node.block_count[lane], t_enter[lane] };
+        }
+        SortFarToNear(children, child_count);
+        for (int c = 0; c < child_count; ++c) {
+            stack[stack_size++] = children[c];
+        }
+    }
+    return found;
+}
+
+int WideBvh::IntersectClosest(const RayPacket8& packet, CpuHit* hits) const {
+    if (nodes_.empty() || !packet.active_mask) return 0;
+    using namespace simd;
+    PacketRays rays(packet);
+    Float8 t_max = PacketRays::LoadTMax(packet);
+    Float8 best_u = Broadcast(0.0f), best_v = Broadcast(0.0f);
+    uint32_t best_primitive[RayPacket8::kSize];
+    int hit_mask = 0;
+
+    ChildEntry stack[kStackSize];
+    int stack_size = 0;
+    stack[stack_size++] = { 0, 0, 0.0f };
+    while (stack_size > 0) {
+        ChildEntry entry = stack[--stack_size];
+
+        if (entry.block_count > 0) {
+            for (uint32_t b = entry.child; b < entry.child + entry.block_count; ++b) {
+                const TriangleBlock& block = blocks_[b];
+                for (int j = 0; j < kWidth && block.primitive[j] != kInvalid; ++j) {
+                    Float8 t, u, v;
+                    Float8 hit = IntersectTriangles8(rays.origin_x, rays.origin_y, rays.origin_z,
+                                                     rays.dir_x, rays.dir_y, rays.dir_z,
+                                                     Broadcast(block.v0_x[j]), Broadcast(block.v0_y[j]), Broadcast(block.v0_z[j]),
+                                                     Broadcast(block.e1_x[j]), Broadcast(block.e1_y[j]), Broadcast(block.e1_z[j]),
+                                                     Broadcast(block.e2_x[j]), Broadcast(block.e2_y[j]), Broadcast(block.e2_z[j]),
+                                                     rays.t_min, t_max, &t, &u, &v);
+                    int mask = MoveMask(hit);
+                    if (!mask) continue;
+                    // Hits are already closer than each lane's t_max
+                    t_max = Select(hit, t, t_max);
+                    best_u = Select(hit, u, best_u);
+                    best_v = Select(hit, v, best_v);
+                    for (int m = mask; m; m &= m - 1) {
+                        best_primitive[FirstLane(m)] = block.primitive[j];
+                    }
+                    hit_mask |= mask;
+                }
+            }
+            continue;
+        }
+
+        // Children hit by at least one ray, visited in order of their nearest entry distance
+        const Node& node = nodes_[entry.child];
+        ChildEntry children[kWidth];
+        int child_count = 0;
+        for (int c = 0; c < kWidth && node.child[c] != kInvalid; ++c) {
+            alignas(32) float t_enter[RayPacket8::kSize];
+            int mask = rays.IntersectBox(node.min_x[c], node.min_y[c], node.min_z[c],
+                                         node.max_x[c], node.max_y[c], node.max_z[c], t_max, t_enter);
+            if (!mask) continue;
+            float nearest = std::numeric_limits<float>::infinity();
+            for (; mask; mask &= mask - 1) {
+                nearest = std::min(nearest, t_enter[FirstLane(mask)]);
+            }
+            children[child_count++] = { node.child[c], node.block_count[c], nearest };
+        }
+        SortFarToNear(children, child_count);
+        for (int c = 0; c < child_count; ++c) {
+            stack[stack_size++] = children[c];
+        }
+    }
+
+    if (hit_mask) {
+        alignas(32) float t_lanes[RayPacket8::kSize], u_lanes[RayPacket8::kSize], v_lanes[RayPacket8::kSize];
+        Store(t_lanes, t_max);
+        Store(u_lanes, best_u);
+        Store(v_lanes, best_v);
+        for (int m = hit_mask; m; m &= m - 1) {
+            int lane = FirstLane(m);
+            hits[lane].t = t_lanes[lane];
+            hits[lane].u = u_lanes[lane];
+            hits[lane].v = v_lanes[lane];
+            hits[lane].primitive = best_primitive[lane];
+        }
+    }
+    return hit_mask;
+}
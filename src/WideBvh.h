@@ -0,0 +1,277 @@
+#pragma once
+#include "Bvh.h"
+#include "Simd.h"
+
+// Eight rays in SoA layout, e.g. the primary rays of a 4x2 pixel block.
+// Lanes not set in active_mask are ignored by the packet queries.
+struct alignas(32) RayPacket8 {
+    static constexpr int kSize = 8;
+
+    float origin_x[kSize], origin_y[kSize], origin_z[kSize];
+    float dir_x[kSize], dir_y[kSize], dir_z[kSize];
+    float t_min[kSize], t_max[kSize];
+    int active_mask = 0;
+
+    void SetRay(int lane, const CpuRay& ray) {
+        origin_x[lane] = ray.origin.x;
+        origin_y[lane] = ray.origin.y;
+        origin_z[lane] = ray.origin.z;
+        dir_x[lane] = ray.direction.x;
+        dir_y[lane] = ray.direction.y;
+        dir_z[lane] = ray.direction.z;
+        t_min[lane] = ray.t_min;
+        t_max[lane] = ray.t_max;
+        active_mask |= 1 << lane;
+    }
+    CpuRay GetRay(int lane) const {
+        return CpuRay{ glm::vec3(origin_x[lane], origin_y[lane], origin_z[lane]), t_min[lane],
+                       glm::vec3(dir_x[lane], dir_y[lane], dir_z[lane]), t_max[lane] };
+    }
+};
+
+// A RayPacket8 loaded into registers. Inactive lanes get t_max = -inf so they miss everything.
+struct PacketRays {
+    simd::Float8 origin_x, origin_y, origin_z;
+    simd::Float8 dir_x, dir_y, dir_z;
+    simd::Float8 inv_x, inv_y, inv_z;
+    simd::Float8 t_min;
+
+    explicit PacketRays(const RayPacket8& packet);
+
+    // Per-lane t_max of the packet with inactive lanes disabled
+    static simd::Float8 LoadTMax(const RayPacket8& packet);
+
+    // Slab test of every ray against one box; returns the lane mask of hits and writes entry distances
+    int IntersectBox(float min_x, float min_y, float min_z, float max_x, float max_y, float max_z,
+                     simd::Float8 t_max, float* t_enter) const;
+};
+
+// 8-wide BVH collapsed from a binary MeshBvh for SIMD traversal.
+// A single ray tests all eight children of a node, or eight triangles of a leaf block, with one
+// kernel call; a RayPacket8 tests eight rays against one child or triangle at a time. Triangles
+// are copied into SoA blocks (vertex 0 and both edges), so the source mesh is only needed to
+// build. Intersections match MeshBvh's slab test and Moller-Trumbore.
+class WideBvh {
+public:
+    static constexpr int kWidth = 8;
+    static constexpr uint32_t kInvalid = 0xFFFFFFFFu;
+
+    struct alignas(32) Node {
+        float min_x[kWidth], min_y[kWidth], min_z[kWidth];
+        float max_x[kWidth], max_y[kWidth], max_z[kWidth];
+        uint32_t child[kWidth];       // Node index, or first triangle block of a leaf; kInvalid for unused slots
+        uint32_t block_count[kWidth]; // Triangle blocks of a leaf child, 0 for interior children
+    };
+
+    struct alignas(32) TriangleBlock {
+        float v0_x[kWidth], v0_y[kWidth], v0_z[kWidth];
+        float e1_x[kWidth], e1_y[kWidth], e1_z[kWidth];
+        float e2_x[kWidth], e2_y[kWidth], e2_z[kWidth];
+        uint32_t primitive[kWidth]; // kInvalid for padding lanes (degenerate, never hit)
+    };
+
+    void Build(const MeshBvh& bvh);
+
+    bool IsBuilt() const { return !nodes_.empty(); }
+
+    // Closest hit in object space; hit->t is only updated when a closer triangle is found
+    bool IntersectClosest(const CpuRay& ray, CpuHit* hit) const;
+
+    // Any hit in object space. accept(primitive, u, v) can reject candidates (alpha testing).
+    template <class AcceptFn>
+    bool IntersectAny(const CpuRay& ray, AcceptFn&& accept) const;
+
+    // Closest hits of the packet's active lanes; returns the mask of lanes that hit (only their hits are written)
+    int IntersectClosest(const RayPacket8& packet, CpuHit* hits) const;
+
+    const std::vector<Node>& GetNodes() const { return nodes_; }
+    const std::vector<TriangleBlock>& GetBlocks() const { return blocks_; }
+    size_t GetMemoryUsage() const { return nodes_.size() * sizeof(Node) + blocks_.size() * sizeof(TriangleBlock); }
+
+private:
+    // Traversal stack bound: every visited level pushes at most kWidth entries
+    static constexpr int kStackSize = MeshBvh::kMaxDepth * kWidth;
+
+    // One ray broadcast to all lanes
+    struct SingleRay {
+        simd::Float8 origin_x, origin_y, origin_z;
+        simd::Float8 dir_x, dir_y, dir_z;
+        simd::Float8 inv_x, inv_y, inv_z;
+        simd::Float8 t_min;
+        bool negative[3]; // Direction sign per axis, selects the near/far slab planes
+
+        explicit SingleRay(const CpuRay& ray);
+    };
+
+    uint32_t CollapseNode(const MeshBvh& bvh, const std::vector<uint32_t>& subtree_triangles, uint32_t binary_index);
+    void AppendLeafBlocks(const MeshBvh& bvh, uint32_t binary_index);
+
+    static int IntersectChildren(const Node& node, const SingleRay& ray, float t_max, float* t_enter);
+    static int IntersectBlock(const TriangleBlock& block, const SingleRay& ray, float t_max,
+                              simd::Float8* t, simd::Float8* u, simd::Float8* v);
+
+    std::vector<Node> nodes_;
+    std::vector<TriangleBlock> blocks_;
+};
+
+// Moller-Trumbore on eight ray/triangle pairs; returns the lane mask of hits inside [t_min, t_max]
+inline simd::Float8 IntersectTriangles8(simd::Float8 origin_x, simd::Float8 origin_y, simd::Float8 origin_z,
+                                        simd::Float8 dir_x, simd::Float8 dir_y, simd::Float8 dir_z,
+                                        simd::Float8 v0_x, simd::Float8 v0_y, simd::Float8 v0_z,
+                                        simd::Float8 e1_x, simd::Float8 e1_y, simd::Float8 e1_z,
+                                        simd::Float8 e2_x, simd::Float8 e2_y, simd::Float8 e2_z,
+                                        simd::Float8 t_min, simd::Float8 t_max,
+                                        simd::Float8* t, simd::Float8* u, simd::Float8* v) {
+    using namespace simd;
+    Float8 p_x = dir_y * e2_z - dir_z * e2_y;
+    Float8 p_y = dir_z * e2_x - dir_x * e2_z;
+    Float8 p_z = dir_x * e2_y - dir_y * e2_x;
+    Float8 det = e1_x * p_x + e1_y * p_y + e1_z * p_z;
+    Float8 inv_det = Broadcast(1.0f) / det;
+    Float8 s_x = origin_x - v0_x;
+    Float8 s_y = origin_y - v0_y;
+    Float8 s_z = origin_z - v0_z;
+    Float8 bu = (s_x * p_x + s_y * p_y + s_z * p_z) * inv_det;
+    Float8 q_x = s_y * e1_z - s_z * e1_y;
+    Float8 q_y = s_z * e1_x - s_x * e1_z;
+    Float8 q_z = s_x * e1_y - s_y * e1_x;
+    Float8 bv = (dir_x * q_x + dir_y * q_y + dir_z * q_z) * inv_det;
+    Float8 bt = (e2_x * q_x + e2_y * q_y + e2_z * q_z) * inv_det;
+
+    Float8 zero = Broadcast(0.0f);
+    Float8 one = Broadcast(1.0f);
+    Float8 mask = And(CmpGe(Abs(det), Broadcast(1e-12f)), CmpGe(bu, zero));
+    mask = And(mask, And(CmpLe(bu, one), CmpGe(bv, zero)));
+    mask = And(mask, And(CmpLe(bu + bv, one), CmpGe(bt, t_min)));
+    mask = And(mask, CmpLe(bt, t_max));
+    *t = bt;
+    *u = bu;
+    *v = bv;
+    return mask;
+}
+
+inline PacketRays::PacketRays(const RayPacket8& packet) {
+    using namespace simd;
+    origin_x = Load(packet.origin_x);
+    origin_y = Load(packet.origin_y);
+    origin_z = Load(packet.origin_z);
+    dir_x = Load(packet.dir_x);
+    dir_y = Load(packet.dir_y);
+    dir_z = Load(packet.dir_z);
+    // SafeInverse per lane
+    Float8 zero = Broadcast(0.0f);
+    Float8 one = Broadcast(1.0f);
+    Float8 big = Broadcast(1e30f);
+    inv_x = Select(CmpNe(dir_x, zero), one / dir_x, big);
+    inv_y = Select(CmpNe(dir_y, zero), one / dir_y, big);
+    inv_z = Select(CmpNe(dir_z, zero), one / dir_z, big);
+    t_min = Load(packet.t_min);
+}
+
+inline simd::Float8 PacketRays::LoadTMax(const RayPacket8& packet) {
+    alignas(32) float t_max[RayPacket8::kSize];
+    for (int lane = 0; lane < RayPacket8::kSize; ++lane) {
+        t_max[lane] = (packet.active_mask >> lane) & 1 ? packet.t_max[lane] : -std::numeric_limits<float>::infinity();
+    }
+    return simd::Load(t_max);
+}
+
+inline int PacketRays::IntersectBox(float min_x, float min_y, float min_z, float max_x, float max_y, float max_z,
+                                    simd::Float8 t_max, float* t_enter) const {
+    using namespace simd;
+    Float8 tx0 = (Broadcast(min_x) - origin_x) * inv_x;
+    Float8 tx1 = (Broadcast(max_x) - origin_x) * inv_x;
+    Float8 ty0 = (Broadcast(min_y) - origin_y) * inv_y;
+    Float8 ty1 = (Broadcast(max_y) - origin_y) * inv_y;
+    Float8 tz0 = (Broadcast(min_z) - origin_z) * inv_z;
+    Float8 tz1 = (Broadcast(max_z) - origin_z) * inv_z;
+    Float8 enter = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Max(Min(tz0, tz1), t_min));
+    Float8 exit = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Min(Max(tz0, tz1), t_max));
+    Store(t_enter, enter);
+    return MoveMask(CmpLe(enter, exit));
+}
+
+inline WideBvh::SingleRay::SingleRay(const CpuRay& ray) {
+    using namespace simd;
+    glm::vec3 inv_dir = SafeInverse(ray.direction);
+    origin_x = Broadcast(ray.origin.x);
+    origin_y = Broadcast(ray.origin.y);
+    origin_z = Broadcast(ray.origin.z);
+    dir_x = Broadcast(ray.direction.x);
+    dir_y = Broadcast(ray.direction.y);
+    dir_z = Broadcast(ray.direction.z);
+    inv_x = Broadcast(inv_dir.x);
+    inv_y = Broadcast(inv_dir.y);
+    inv_z = Broadcast(inv_dir.z);
+    t_min = Broadcast(ray.t_min);
+    negative[0] = inv_dir.x < 0.0f;
+    negative[1] = inv_dir.y < 0.0f;
+    negative[2] = inv_dir.z < 0.0f;
+}
+
+inline int WideBvh::IntersectChildren(const Node& node, const SingleRay& ray, float t_max, float* t_enter) {
+    using namespace simd;
+    // Picking the near/far plane by direction sign saves the min/max per axis; unused slots
+    // have inverted bounds (+inf/-inf), which this formulation always rejects.
+    Float8 tx0 = (Load(ray.negative[0] ? node.max_x : node.min_x) - ray.origin_x) * ray.inv_x;
+    Float8 tx1 = (Load(ray.negative[0] ? node.min_x : node.max_x) - ray.origin_x) * ray.inv_x;
+    Float8 ty0 = (Load(ray.negative[1] ? node.max_y : node.min_y) - ray.origin_y) * ray.inv_y;
+    Float8 ty1 = (Load(ray.negative[1] ? node.min_y : node.max_y) - ray.origin_y) * ray.inv_y;
+    Float8 tz0 = (Load(ray.negative[2] ? node.max_z : node.min_z) - ray.origin_z) * ray.inv_z;
+    Float8 tz1 = (Load(ray.negative[2] ? node.min_z : node.max_z) - ray.origin_z) * ray.inv_z;
+    Float8 enter = Max(Max(tx0, ty0), Max(tz0, ray.t_min));
+    Float8 exit = Min(Min(tx1, ty1), Min(tz1, Broadcast(t_max)));
+    Store(t_enter, enter);
+    return MoveMask(CmpLe(enter, exit));
+}
+
+inline int WideBvh::IntersectBlock(const TriangleBlock& block, const SingleRay& ray, float t_max,
+                                   simd::Float8* t, simd::Float8* u, simd::Float8* v) {
+    using namespace simd;
+    return simd::MoveMask(IntersectTriangles8(ray.origin_x, ray.origin_y, ray.origin_z, ray.dir_x, ray.dir_y, ray.dir_z,
+                                              Load(block.v0_x), Load(block.v0_y), Load(block.v0_z),
+                                              Load(block.e1_x), Load(block.e1_y), Load(block.e1_z),
+                                              Load(block.e2_x), Load(block.e2_y), Load(block.e2_z),
+                                              ray.t_min, Broadcast(t_max), t, u, v));
+}
+
+template <class AcceptFn>
+bool WideBvh::IntersectAny(const CpuRay& ray, AcceptFn&& accept) const {
+    if (nodes_.empty()) return false;
+    SingleRay r(ray);
+    uint32_t stack_child[kStackSize];
+    uint32_t stack_blocks[kStackSize];
+    int stack_size = 0;
+    stack_child[stack_size] = 0;
+    stack_blocks[stack_size++] = 0;
+    while (stack_size > 0) {
+        --stack_size;
+        uint32_t child = stack_child[stack_size];
+        uint32_t block_count = stack_blocks[stack_size];
+        if (block_count > 0) {
+            for (uint32_t b = child; b < child + block_count; ++b) {
+                simd::Float8 t, u, v;
+                int mask = IntersectBlock(blocks_[b], r, ray.t_max, &t, &u, &v);
+                if (!mask) continue;
+                alignas(32) float u_lanes[kWidth], v_lanes[kWidth];
+                simd::Store(u_lanes, u);
+                simd::Store(v_lanes, v);
+                for (; mask; mask &= mask - 1) {
+                    int lane = simd::FirstLane(mask);
+                    if (accept(blocks_[b].primitive[lane], u_lanes[lane], v_lanes[lane])) {
+                        return true;
+                    }
+                }
+            }
+            continue;
+        }
+        const Node& node = nodes_[child];
+        alignas(32) float t_enter[kWidth];
+        for (int mask = IntersectChildren(node, r, ray.t_max, t_enter); mask; mask &= mask - 1) {
+            int lane = simd::FirstLane(mask);
+            stack_child[stack_size] = node.child[lane];
+            stack_blocks[stack_size++] = node.block_count[lane];
+        }
+    }
+    return false;
+}
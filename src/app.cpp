@@ -1,6 +1,7 @@
 #include "app.h"
 #include "Material.h"
 #include "Entity.h"
+#include "AllocationCounter.h"
 
 #include "glm/gtc/matrix_transform.hpp"
 #include "imgui.h"
@@ -9,6 +10,7 @@
 #include "stb_image.h"
 #include "tiny_obj_loader.h"
 
+#include <cassert>
 #include <chrono>
 #include <cmath>
 #include <iomanip>
@@ -19,6 +21,26 @@
 
 namespace {
 #include "built_in_shaders.inl"
+
+// FNV-1a over the resource pointers bound by BindSceneResources
+void HashValue(uint64_t* hash, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        *hash ^= (value >> (i * 8)) & 0xff;
+        *hash *= 1099511628211ull;
+    }
+}
+
+void HashPointer(uint64_t* hash, const void* pointer) {
+    HashValue(hash, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer)));
+}
+
+template <typename T>
+void HashPointers(uint64_t* hash, const std::vector<T*>& pointers) {
+    HashValue(hash, pointers.size());
+    for (const T* pointer : pointers) {
+        HashPointer(hash, pointer);
+    }
+}
 }
 
 Application::Application(grassland::graphics::BackendAPI api) {
@@ -243,6 +265,10 @@ void Application::OnInit() {
 
     // Create scene
     scene_ = std::make_unique<Scene>(core_.get());
+    // Normal/tangent/texcoord interleaved per vertex: one fetch per hit corner instead of three
+    scene_->SetVertexLayout(VertexLayout::kInterleaved);
+    // Weld and reorder the exported meshes so neighbouring triangles share cache lines
+    scene_->SetOptimizeMeshes(true);
 
     // Call Load from glb function
     scene_->LoadFromGLB("new_scene.glb");
@@ -364,9 +390,9 @@ void Application::OnInit() {
         // Multi-Layer Material Cube: Green Iron Base + Rust Layer
         // ============================================================================
         
-        // Helper function to load texture from file
-        // Tries multiple possible paths to find the texture file
-        auto LoadTextureFromFile = [&](const std::string& filepath) -> int {
+        // Helper function to decode an image file to RGBA8 (empty on failure)
+        // Tries multiple possible paths to find the file
+        auto LoadImageFromFile = [&](const std::string& filepath, int* w, int* h) -> std::vector<uint8_t> {
             // Try multiple possible paths
             std::vector<std::string> possible_paths = {
                 filepath,                                    // Original path
@@ -396,24 +422,30 @@ void Application::OnInit() {
                         grassland::LogError("  - {}", path);
                     }
                 }
-                return -1;
+                return {};
             }
             
-            int w, h, comp;
-            unsigned char* data = stbi_load(full_path.c_str(), &w, &h, &comp, 4);
+            int comp;
+            unsigned char* data = stbi_load(full_path.c_str(), w, h, &comp, 4);
             if (!data) {
                 grassland::LogError("Failed to load texture: {} (full path: {})", filepath, full_path);
-                return -1;
+                return {};
             }
-            
-            std::unique_ptr<grassland::graphics::Image> texture;
-            core_->CreateImage(w, h, grassland::graphics::IMAGE_FORMAT_R8G8B8A8_UNORM, &texture);
-            texture->UploadData(data);
-            
-            int tex_index = scene_->AddTexture(std::move(texture));
+            std::vector<uint8_t> pixels(data, data + size_t(*w) * *h * 4);
             stbi_image_free(data);
+            grassland::LogInfo("Loaded image: {} (from: {})", filepath, full_path);
+            return pixels;
+        };
+
+        // srgb marks colour textures, whose mip levels are filtered in linear light
+        auto LoadTextureFromFile = [&](const std::string& filepath, bool srgb) -> int {
+            int w, h;
+            std::vector<uint8_t> pixels = LoadImageFromFile(filepath, &w, &h);
+            if (pixels.empty()) return -1;
             
-            grassland::LogInfo("Loaded texture: {} -> index {} (from: {})", filepath, tex_index, full_path);
+            // Uploaded with its full mip chain
+            int tex_index = scene_->AddTexture(w, h, pixels.data(), srgb);
+            grassland::LogInfo("Loaded texture: {} -> index {}", filepath, tex_index);
             return tex_index;
         };
         
@@ -421,21 +453,30 @@ void Application::OnInit() {
         // Note: Path should be relative to assets directory or use FindAssetFile
         // Use the masked texture with transparency for rust color (background removed)
         // Try multiple possible paths for the masked texture
-        int rust_color_tex = LoadTextureFromFile("build/src/Debug/Metal053B_1K-JPG/Metal053B_1K-JPG_Color_Masked.png");
+        int rust_color_tex = LoadTextureFromFile("build/src/Debug/Metal053B_1K-JPG/Metal053B_1K-JPG_Color_Masked.png", true);
         if (rust_color_tex < 0) {
-            rust_color_tex = LoadTextureFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_Color_Masked.png");
+            rust_color_tex = LoadTextureFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_Color_Masked.png", true);
         }
         if (rust_color_tex < 0) {
-            rust_color_tex = LoadTextureFromFile("../build/src/Debug/Metal053B_1K-JPG/Metal053B_1K-JPG_Color_Masked.png");
+            rust_color_tex = LoadTextureFromFile("../build/src/Debug/Metal053B_1K-JPG/Metal053B_1K-JPG_Color_Masked.png", true);
         }
         // Fallback to original if masked version not found
         if (rust_color_tex < 0) {
             grassland::LogWarning("Masked texture not found, trying original Color.jpg");
-            rust_color_tex = LoadTextureFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_Color.jpg");
+            rust_color_tex = LoadTextureFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_Color.jpg", true);
+        }
+        // Metalness and roughness come as separate greyscale maps: pack them into one ORM texture
+        // (roughness in G, metalness in B, no occlusion map so R stays white)
+        int metal_w = 0, metal_h = 0, rough_w = 0, rough_h = 0;
+        std::vector<uint8_t> rust_metallic = LoadImageFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_Metalness.jpg", &metal_w, &metal_h);
+        std::vector<uint8_t> rust_roughness = LoadImageFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_Roughness.jpg", &rough_w, &rough_h);
+        int rust_orm_tex = -1;
+        if (!rust_metallic.empty() && !rust_roughness.empty()) {
+            ChannelSource roughness_map{ rust_roughness.data(), rough_w, rough_h, 0 };
+            ChannelSource metallic_map{ rust_metallic.data(), metal_w, metal_h, 0 };
+            rust_orm_tex = scene_->AddOrmTexture(ChannelSource(), roughness_map, metallic_map);
         }
-        int rust_metallic_tex = LoadTextureFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_Metalness.jpg");
-        int rust_roughness_tex = LoadTextureFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_Roughness.jpg");
-        int rust_normal_tex = LoadTextureFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_NormalGL.jpg");
+        int rust_normal_tex = LoadTextureFromFile("Metal053B_1K-JPG/Metal053B_1K-JPG_NormalGL.jpg", false);
         
         // Create Layer 1 (Base Layer): Green Iron (always create this)
         Material green_iron(
@@ -466,7 +507,7 @@ void Application::OnInit() {
         scene_->AddEntity(multi_layer_cube);
         
         // Check if textures loaded successfully
-        if (rust_color_tex < 0 || rust_metallic_tex < 0 || rust_roughness_tex < 0 || rust_normal_tex < 0) {
+        if (rust_color_tex < 0 || rust_orm_tex < 0 || rust_normal_tex < 0) {
             grassland::LogWarning("Failed to load some Metal053B textures. Creating cube with single-layer material only.");
             grassland::LogWarning("Expected files in: assets/Metal053B_1K-JPG/");
             grassland::LogWarning("  - Metal053B_1K-JPG_Color.jpg");
@@ -477,15 +518,12 @@ void Application::OnInit() {
             // Entity is already created with base material, so we're done
         } else {
             // Create Layer 2 (Outer Layer): Rust (using Metal053B textures)
-            // Note: Since metallic and roughness are separate textures, we use roughness texture
-            // as metallic_roughness_tex. For more accurate results, you could create a combined texture.
             Material rust_layer(
                 glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),  // Base color factor (will be multiplied by texture)
                 rust_color_tex,                      // Rust color texture
-                0.8f,                                // Roughness factor: high roughness (rust is rough)
-                0.3f,                                // Metallic factor: low metalness (rust is not metal)
-                rust_roughness_tex,                  // Metallic_roughness texture (using roughness texture)
-                                                     // Note: For accurate metallic, create combined texture
+                1.0f,                                // Roughness factor: the roughness map carries it
+                1.0f,                                // Metallic factor: the metalness map carries it
+                rust_orm_tex,                        // Packed ORM texture (roughness G, metalness B)
                 glm::vec3(0.0f),                     // No emission
                 -1,                                  // No emissive texture
                 1.0f,                                // AO strength
@@ -609,6 +647,13 @@ void Application::OnInit() {
                 core_->CreateImage(w, h, grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT, &skybox_tex);
                 skybox_tex->UploadData(data);
                 scene_->SetSkyboxTexture(std::move(skybox_tex));
+                if (scene_->KeepsHostTextures()) {
+                    HostTexture host_skybox;
+                    host_skybox.width = w;
+                    host_skybox.height = h;
+                    host_skybox.rgba32f.assign(data, data + static_cast<size_t>(w) * h * 4);
+                    scene_->SetSkyboxHostTexture(std::move(host_skybox));
+                }
                 stbi_image_free(data);
                 grassland::LogInfo("Loaded skybox texture: {}", full_path);
             } else {
@@ -642,6 +687,9 @@ void Application::OnInit() {
         skybox_enabled = true;
     }
 
+    // Coarse levels for camera navigation (kPreviewLod); full detail is built into the TLAS
+    scene_->BuildLods(3);
+
     // Build acceleration structures
     scene_->BuildAccelerationStructures();
 
@@ -657,6 +705,8 @@ void Application::OnInit() {
     core_->CreateBuffer(sizeof(HoverInfo), grassland::graphics::BUFFER_TYPE_DYNAMIC, &hover_info_buffer_);
     HoverInfo initial_hover{};
     initial_hover.hovered_entity_id = -1;
+    initial_hover.cursor_x = -1;
+    initial_hover.cursor_y = -1;
     initial_hover.light_count = static_cast<int>(scene_->GetLightCount());
     hover_info_buffer_->UploadData(&initial_hover, sizeof(HoverInfo));
 
@@ -710,6 +760,7 @@ void Application::OnInit() {
     render_settings.highlight_threshold = highlight_threshold_;
     render_settings.saturation_boost_light = saturation_boost_light_;
     render_settings.saturation_boost_shadow = saturation_boost_shadow_;
+    render_settings.vertex_layout = static_cast<int>(scene_->GetVertexLayout());
     render_settings_buffer_->UploadData(&render_settings, sizeof(RenderSettings));
 
     // Initialize camera state member variables
@@ -761,51 +812,78 @@ void Application::OnInit() {
     core_->CreateImage(window_->GetWidth(), window_->GetHeight(), grassland::graphics::IMAGE_FORMAT_R32_SINT,
         &entity_id_image_);
 
+    // Ring of cursor picks written by RayGenMain, one texel per frame in flight
+    core_->CreateImage(kPickRingSize, 1, grassland::graphics::IMAGE_FORMAT_R32G32B32A32_SFLOAT, &pick_image_);
+
     // Use VirtualFileSystem to include all shader modules for proper #include resolution
     auto shader_vfs = GetShaderVirtualFileSystem();
     core_->CreateShader(shader_vfs, "shaders/shader.hlsl", "RayGenMain", "lib_6_3", &raygen_shader_);
     core_->CreateShader(shader_vfs, "shaders/shader.hlsl", "MissMain", "lib_6_3", &miss_shader_);
     core_->CreateShader(shader_vfs, "shaders/shader.hlsl", "ClosestHitMain", "lib_6_3", &closest_hit_shader_);
     core_->CreateShader(shader_vfs, "shaders/anyhit.hlsl", "AnyHitMain", "lib_6_3", &anyhit_shader_);
+    core_->CreateShader(shader_vfs, "shaders/shader.hlsl", "HighlightMain", "lib_6_3", &highlight_shader_);
     grassland::LogInfo("Shader compiled successfully");
 
     core_->CreateRayTracingProgram(&program_);
     program_->AddRayGenShader(raygen_shader_.get());
     program_->AddMissShader(miss_shader_.get());
     program_->AddHitGroup(closest_hit_shader_.get(), anyhit_shader_.get());
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_ACCELERATION_STRUCTURE, 1);  // space0
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);          // space1 - color output
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);          // space2
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);          // space3 - materials
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);          // space4 - hover info
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);          // space5 - entity ID output
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);          // space6 - accumulated color
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);          // space7 - accumulated samples
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
+    AddSceneBindings(program_.get());
+    program_->Finalize();
+
+    // Hover highlight pass; shares the path tracer's layout so one set of bindings serves both
+    core_->CreateRayTracingProgram(&highlight_program_);
+    highlight_program_->AddRayGenShader(highlight_shader_.get());
+    highlight_program_->AddMissShader(miss_shader_.get());
+    highlight_program_->AddHitGroup(closest_hit_shader_.get(), anyhit_shader_.get());
+    AddSceneBindings(highlight_program_.get());
+    highlight_program_->Finalize();
+}
+
+void Application::AddSceneBindings(grassland::graphics::RayTracingProgram* program) {
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_ACCELERATION_STRUCTURE, 1);   // space0
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);           // space1 - color output
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);           // space2
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);           // space3 - materials
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);           // space4 - hover info
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);           // space5 - entity ID output
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);           // space6 - accumulated color
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);           // space7 - accumulated samples
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
                                                              scene_->GetEntityCount());          // space8 - vertex buffers
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
                                                              scene_->GetEntityCount());          // space9 - index buffers
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
                                                              scene_->GetEntityCount());          // space10 - texcoord buffers
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_IMAGE,
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_IMAGE,
                                                    scene_->GetBaseColorTextureCount());          // space11 - base color textures
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_SAMPLER, 1);                 // space12 - sampler
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_SAMPLER, 1);                  // space12 - sampler
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
                                                              scene_->GetEntityCount());          // space13 - normal buffers
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
                                                              scene_->GetEntityCount());          // space14 - tangent buffers
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);          // space15 - lights buffer
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_IMAGE, 1);                   // space16 - skybox texture
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);          // space17 - volume info
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);          // space18 - sky info
-    program_->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);          // space19 - render settings
-    program_->Finalize();
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);           // space15 - lights buffer
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_IMAGE, 1);                    // space16 - skybox texture
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);           // space17 - volume info
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);           // space18 - sky info
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_UNIFORM_BUFFER, 1);           // space19 - render settings
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);           // space20 - cursor pick ring
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_WRITABLE_IMAGE, 1);           // space21 - developed film image
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
+                                                             scene_->GetEntityCount());          // space22 - interleaved attribute buffers
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER,
+                                                             scene_->GetEntityCount());          // space23 - packed attribute buffers
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);           // space24 - vertex formats
+    program->AddResourceBinding(grassland::graphics::RESOURCE_TYPE_STORAGE_BUFFER, 1);           // space25 - texture mip ranges
 }
 
 void Application::OnClose() {
-    // Clean up graphics resources first
+    // Clean up graphics resources first; the recorded frame commands reference all of them
+    InvalidateFrameContexts();
     program_.reset();
+    highlight_program_.reset();
     raygen_shader_.reset();
+    highlight_shader_.reset();
     miss_shader_.reset();
     closest_hit_shader_.reset();
     anyhit_shader_.reset();
@@ -815,6 +893,7 @@ void Application::OnClose() {
 
     color_image_.reset();
     entity_id_image_.reset();
+    pick_image_.reset();
     camera_object_buffer_.reset();
     hover_info_buffer_.reset();
     volume_info_buffer_.reset();
@@ -825,7 +904,10 @@ void Application::OnClose() {
 }
 
 void Application::RecreateRenderTargets(int width, int height) {
-    // Resize film and recreate color/entity targets for offline export
+    // Resize film and recreate color/entity targets for offline export. The recorded frame commands
+    // reference the old targets, and new ones may reuse their addresses, so drop them explicitly.
+    InvalidateFrameContexts();
+    staging_warm_ = false;
     if (film_) {
         film_->Resize(width, height);
     } else {
@@ -839,53 +921,20 @@ void Application::RecreateRenderTargets(int width, int height) {
 }
 
 void Application::UpdateHoveredEntity() {
-    // Only detect hover when camera is disabled (cursor visible)
-    if (camera_enabled_) {
-        hovered_entity_id_ = -1;
-        hovered_pixel_color_ = glm::vec4(0.0f);
-        return;
-    }
-
-    // Get mouse position in pixel coordinates
-    int x = static_cast<int>(mouse_x_);
-    int y = static_cast<int>(mouse_y_);
-    int width = window_->GetWidth();
-    int height = window_->GetHeight();
-    
-    // Check bounds
-    if (x < 0 || x >= width || y < 0 || y >= height) {
+    // RayGenMain writes the pixel under the cursor (averaged color, entity ID) into one texel of
+    // pick_image_ per frame. Reading the texel written kPickRingSize - 1 frames ago fetches 16 bytes
+    // the GPU has long finished with, so hover picking never waits on the frame in flight.
+    int read_slot = static_cast<int>((pick_frame_ + 1) % kPickRingSize);
+    if (camera_enabled_ || !pick_slot_valid_[read_slot]) {
         hovered_entity_id_ = -1;
         hovered_pixel_color_ = glm::vec4(0.0f);
         return;
     }
 
-    grassland::graphics::Offset2D offset{ x, y };
-    grassland::graphics::Extent2D extent{ 1, 1 };
-    
-    // Read entity ID from the ID buffer at the mouse position
-    // The entity_id_image_ stores the entity index (-1 for no entity)
-    int32_t entity_id = -1;
-    entity_id_image_->DownloadData(&entity_id, offset, extent);
-    hovered_entity_id_ = entity_id;
-    
-    // Read pixel color from accumulated buffer (before highlighting is applied)
-    // Note: This is a synchronous read which may cause a GPU stall
-    // For better performance, consider using a readback buffer with a frame delay
-    float accumulated_rgba[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    film_->GetAccumulatedColorImage()->DownloadData(accumulated_rgba, offset, extent);
-    
-    // Average by sample count to get final color (before highlighting)
-    int sample_count = film_->GetSampleCount();
-    if (sample_count > 0) {
-        hovered_pixel_color_ = glm::vec4(
-            accumulated_rgba[0] / static_cast<float>(sample_count),
-            accumulated_rgba[1] / static_cast<float>(sample_count),
-            accumulated_rgba[2] / static_cast<float>(sample_count),
-            accumulated_rgba[3] / static_cast<float>(sample_count)
-        );
-    } else {
-        hovered_pixel_color_ = glm::vec4(0.0f);
-    }
+    float pick[4] = { 0.0f, 0.0f, 0.0f, -1.0f };
+    pick_image_->DownloadData(pick, grassland::graphics::Offset2D{ read_slot, 0 }, grassland::graphics::Extent2D{ 1, 1 });
+    hovered_pixel_color_ = glm::vec4(pick[0], pick[1], pick[2], 1.0f);
+    hovered_entity_id_ = static_cast<int>(pick[3]);
     
     // Hover state is shown in the UI panels, no logging needed
 }
@@ -897,6 +946,9 @@ void Application::OnUpdate() {
         return;  // Exit update immediately after closing
     }
     if (alive_) {
+        frame_allocation_mark_ = allocation_counter::GetAllocationCount();
+        staging_allocation_mark_ = allocation_counter::GetStagingAllocationCount();
+
         // Process keyboard input to move camera
         ProcessInput();
 
@@ -915,6 +967,8 @@ void Application::OnUpdate() {
         
         // Detect camera state change and reset accumulation if camera started moving
         if (camera_enabled_ != last_camera_enabled_) {
+            // Preview LOD while moving, full detail for accumulation
+            scene_->SelectLod(camera_enabled_ ? kPreviewLod : 0);
             if (camera_enabled_) {
                 // Camera just got enabled - will be moving, so prepare for reset when it stops
                 grassland::LogInfo("Camera enabled - accumulation will reset when camera stops");
@@ -926,13 +980,26 @@ void Application::OnUpdate() {
             last_camera_enabled_ = camera_enabled_;
         }
         
+        // Staging path: hover readback and the per-frame uploads below
+        allocation_counter::StagingScope staging;
+
         // Update which entity is being hovered
         UpdateHoveredEntity();
         
-        // Update hover info buffer
+        // Update hover info buffer; the cursor pick of this frame goes to the next ring slot
+        int pick_slot = static_cast<int>(pick_frame_ % kPickRingSize);
+        int cursor_x = static_cast<int>(mouse_x_);
+        int cursor_y = static_cast<int>(mouse_y_);
+        bool cursor_inside = cursor_x >= 0 && cursor_x < window_->GetWidth() &&
+                             cursor_y >= 0 && cursor_y < window_->GetHeight();
+        pick_slot_valid_[pick_slot] = cursor_inside && !camera_enabled_;
+
         HoverInfo hover_info{};
         hover_info.hovered_entity_id = hovered_entity_id_;
         hover_info.light_count = scene_->GetLightCount();
+        hover_info.cursor_x = pick_slot_valid_[pick_slot] ? cursor_x : -1;
+        hover_info.cursor_y = pick_slot_valid_[pick_slot] ? cursor_y : -1;
+        hover_info.pick_slot = pick_slot;
         hover_info_buffer_->UploadData(&hover_info, sizeof(HoverInfo));
 
         // Update sky info (environment intensity controls)
@@ -990,45 +1057,14 @@ void Application::OnUpdate() {
         render_settings.highlight_threshold = highlight_threshold_;
         render_settings.saturation_boost_light = saturation_boost_light_;
         render_settings.saturation_boost_shadow = saturation_boost_shadow_;
+        render_settings.vertex_layout = static_cast<int>(scene_->GetVertexLayout());
         render_settings_buffer_->UploadData(&render_settings, sizeof(RenderSettings));
 
 
         // Optional: Animate entities
         // For now, entities are static. You can update their transforms and call:
-        // scene_->UpdateInstances();
-    }
-}
-
-void Application::ApplyHoverHighlight(grassland::graphics::Image* image) {
-    // Apply hover highlighting by modifying pixels where entity ID matches hovered entity
-    // This is done as a CPU-side post-process so it doesn't affect accumulation
-    
-    int width = window_->GetWidth();
-    int height = window_->GetHeight();
-    size_t pixel_count = width * height;
-    
-    // Download current image
-    std::vector<float> image_data(pixel_count * 4);
-    image->DownloadData(image_data.data());
-    
-    // Download entity ID buffer
-    std::vector<int32_t> entity_ids(pixel_count);
-    entity_id_image_->DownloadData(entity_ids.data());
-    
-    // Apply highlight to pixels matching hovered entity
-    float highlight_factor = 0.4f; // Blend factor for white highlight
-    for (size_t i = 0; i < pixel_count; i++) {
-        if (entity_ids[i] == hovered_entity_id_) {
-            // Lerp towards white (1, 1, 1) by highlight_factor
-            image_data[i * 4 + 0] = image_data[i * 4 + 0] * (1.0f - highlight_factor) + 1.0f * highlight_factor;
-            image_data[i * 4 + 1] = image_data[i * 4 + 1] * (1.0f - highlight_factor) + 1.0f * highlight_factor;
-            image_data[i * 4 + 2] = image_data[i * 4 + 2] * (1.0f - highlight_factor) + 1.0f * highlight_factor;
-            // Keep alpha unchanged
-        }
+        // scene_->UpdateInstances();  // Only the moved entities' instances are rewritten
     }
-    
-    // Upload modified image
-    image->UploadData(image_data.data());
 }
 
 void Application::SaveAccumulatedOutput(const std::string& filename) {
@@ -1254,6 +1290,12 @@ void Application::RenderInfoOverlay() {
         ImGui::TextColored(ImVec4(0.7f, 0.7f, 0.7f, 1.0f), "Status: Paused");
         ImGui::Text("(Disable camera to accumulate)");
     }
+    if (allocation_counter::IsEnabled()) {
+        // Staging covers the hover readback, the per-frame uploads and the film development; the
+        // frame total also includes input, ImGui and submission inside the graphics backend
+        ImGui::Text("Staging allocations / frame: %llu", static_cast<unsigned long long>(staging_allocations_));
+        ImGui::Text("Heap allocations / frame: %llu", static_cast<unsigned long long>(frame_allocations_));
+    }
 
     ImGui::Spacing();
 
@@ -1406,57 +1448,155 @@ void Application::OnRender() {
         return;
     }
 
-    std::unique_ptr<grassland::graphics::CommandContext> command_context;
-    core_->CreateCommandContext(&command_context);
+    // When camera is disabled, increment sample count and use accumulated image
+    FrameMode mode = kFrameCamera;
+    if (!camera_enabled_) {
+        film_->IncrementSampleCount();
+        film_->DevelopToOutput();
+        mode = hovered_entity_id_ >= 0 ? kFrameHighlight : kFrameAccumulate;
+    }
+    
+    // Render ImGui overlay
+    window_->BeginImGuiFrame();
+    RenderInfoOverlay();
+    RenderEntityPanel();
+    window_->EndImGuiFrame();
+    
+    core_->SubmitCommandContext(FrameCommandContext(mode));
+
+    ++pick_frame_;
+    frame_allocations_ = allocation_counter::GetAllocationCount() - frame_allocation_mark_;
+    staging_allocations_ = allocation_counter::GetStagingAllocationCount() - staging_allocation_mark_;
+    // Film staging is sized with its images and the uploads and readbacks use fixed-size structs,
+    // so once warm the staging paths must not touch the heap
+    if (staging_warm_) {
+        assert(staging_allocations_ == 0);
+    }
+    staging_warm_ = true;
+}
+
+grassland::graphics::CommandContext* Application::FrameCommandContext(FrameMode mode) {
+    uint64_t key = FrameBindingKey();
+    if (!frame_contexts_[mode] || frame_context_keys_[mode] != key) {
+        frame_contexts_[mode].reset();
+        core_->CreateCommandContext(&frame_contexts_[mode]);
+        RecordFrameCommands(frame_contexts_[mode].get(), mode);
+        frame_context_keys_[mode] = key;
+    }
+    return frame_contexts_[mode].get();
+}
+
+void Application::RecordFrameCommands(grassland::graphics::CommandContext* command_context, FrameMode mode) {
     command_context->CmdClearImage(color_image_.get(), { {0.6, 0.7, 0.8, 1.0} });
     
     // Clear entity ID buffer with -1 (no entity)
     command_context->CmdClearImage(entity_id_image_.get(), { {-1, 0, 0, 0} });
     
     command_context->CmdBindRayTracingProgram(program_.get());
+    BindSceneResources(command_context);
+    command_context->CmdDispatchRays(window_->GetWidth(), window_->GetHeight(), 1);
+
+    grassland::graphics::Image* display_image = color_image_.get();
+    if (mode != kFrameCamera) {
+        display_image = film_->GetOutputImage();
+
+        // Hover highlighting as a GPU post-process (doesn't affect accumulation): HighlightMain
+        // tints the developed image by entity ID into color_image_, so no full frame round-trips
+        if (mode == kFrameHighlight) {
+            command_context->CmdBindRayTracingProgram(highlight_program_.get());
+            BindSceneResources(command_context);
+            command_context->CmdDispatchRays(window_->GetWidth(), window_->GetHeight(), 1);
+            display_image = color_image_.get();
+        }
+    }
+
+    command_context->CmdPresent(window_.get(), display_image);
+}
+
+uint64_t Application::FrameBindingKey() const {
+    uint64_t hash = 14695981039346656037ull;
+    HashValue(&hash, static_cast<uint64_t>(window_->GetWidth()));
+    HashValue(&hash, static_cast<uint64_t>(window_->GetHeight()));
+    HashPointer(&hash, program_.get());
+    HashPointer(&hash, highlight_program_.get());
+    HashPointer(&hash, color_image_.get());
+    HashPointer(&hash, entity_id_image_.get());
+    HashPointer(&hash, pick_image_.get());
+    HashPointer(&hash, film_->GetAccumulatedColorImage());
+    HashPointer(&hash, film_->GetAccumulatedSamplesImage());
+    HashPointer(&hash, film_->GetOutputImage());
+    HashPointer(&hash, camera_object_buffer_.get());
+    HashPointer(&hash, hover_info_buffer_.get());
+    HashPointer(&hash, volume_info_buffer_.get());
+    HashPointer(&hash, sky_info_buffer_.get());
+    HashPointer(&hash, render_settings_buffer_.get());
+    HashPointer(&hash, scene_->GetTLAS());
+    HashPointer(&hash, scene_->GetMaterialsBuffer());
+    HashPointer(&hash, scene_->GetLightsBuffer());
+    HashPointer(&hash, scene_->GetSkyboxTexture());
+    HashPointer(&hash, scene_->GetLinearWrapSampler());
+    HashPointer(&hash, scene_->GetVertexFormatsBuffer());
+    HashPointer(&hash, scene_->GetTextureMipsBuffer());
+    HashPointers(&hash, scene_->GetVertexBuffers());
+    HashPointers(&hash, scene_->GetIndexBuffers());
+    HashPointers(&hash, scene_->GetTexcoordBuffers());
+    HashPointers(&hash, scene_->GetBaseColorTextureSRVs());
+    HashPointers(&hash, scene_->GetNormalBuffers());
+    HashPointers(&hash, scene_->GetTangentBuffers());
+    HashPointers(&hash, scene_->GetAttributeBuffers());
+    HashPointers(&hash, scene_->GetPackedVertexBuffers());
+    return hash;
+}
+
+void Application::InvalidateFrameContexts() {
+    for (auto& context : frame_contexts_) {
+        context.reset();
+    }
+}
+
+void Application::BindSceneResources(grassland::graphics::CommandContext* command_context) {
+    // Same layout for program_ and highlight_program_ (see AddSceneBindings)
     command_context->CmdBindResources(0, scene_->GetTLAS(), grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(1, { color_image_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(2, { camera_object_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(3, { scene_->GetMaterialsBuffer() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(4, { hover_info_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(5, { entity_id_image_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(6, { film_->GetAccumulatedColorImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(7, { film_->GetAccumulatedSamplesImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
+    BindImage(command_context, 1, color_image_.get());
+    BindBuffer(command_context, 2, camera_object_buffer_.get());
+    BindBuffer(command_context, 3, scene_->GetMaterialsBuffer());
+    BindBuffer(command_context, 4, hover_info_buffer_.get());
+    BindImage(command_context, 5, entity_id_image_.get());
+    BindImage(command_context, 6, film_->GetAccumulatedColorImage());
+    BindImage(command_context, 7, film_->GetAccumulatedSamplesImage());
     command_context->CmdBindResources(8, scene_->GetVertexBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
     command_context->CmdBindResources(9, scene_->GetIndexBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
     command_context->CmdBindResources(10, scene_->GetTexcoordBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
     command_context->CmdBindResources(11, scene_->GetBaseColorTextureSRVs(), grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(12, { scene_->GetLinearWrapSampler() }, grassland::graphics::BIND_POINT_RAYTRACING);
+    BindSampler(command_context, 12, scene_->GetLinearWrapSampler());
     command_context->CmdBindResources(13, scene_->GetNormalBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
     command_context->CmdBindResources(14, scene_->GetTangentBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
-	command_context->CmdBindResources(15, { scene_->GetLightsBuffer() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(16, { scene_->GetSkyboxTexture() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(17, { volume_info_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(18, { sky_info_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdBindResources(19, { render_settings_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-    command_context->CmdDispatchRays(window_->GetWidth(), window_->GetHeight(), 1);
+    BindBuffer(command_context, 15, scene_->GetLightsBuffer());
+    BindImage(command_context, 16, scene_->GetSkyboxTexture());
+    BindBuffer(command_context, 17, volume_info_buffer_.get());
+    BindBuffer(command_context, 18, sky_info_buffer_.get());
+    BindBuffer(command_context, 19, render_settings_buffer_.get());
+    BindImage(command_context, 20, pick_image_.get());
+    BindImage(command_context, 21, film_->GetOutputImage());
+    command_context->CmdBindResources(22, scene_->GetAttributeBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
+    command_context->CmdBindResources(23, scene_->GetPackedVertexBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
+    BindBuffer(command_context, 24, scene_->GetVertexFormatsBuffer());
+    BindBuffer(command_context, 25, scene_->GetTextureMipsBuffer());
+}
 
-    // When camera is disabled, increment sample count and use accumulated image
-    grassland::graphics::Image* display_image = color_image_.get();
-    if (!camera_enabled_) {
-        film_->IncrementSampleCount();
-        film_->DevelopToOutput();
-        display_image = film_->GetOutputImage();
-    }
-    
-    // Apply hover highlighting as post-process (doesn't affect accumulation)
-    if (hovered_entity_id_ >= 0 && !camera_enabled_) {
-        ApplyHoverHighlight(display_image);
-    }
-    
-    // Render ImGui overlay
-    window_->BeginImGuiFrame();
-    RenderInfoOverlay();
-    RenderEntityPanel();
-    window_->EndImGuiFrame();
-    
-    command_context->CmdPresent(window_.get(), display_image);
-    core_->SubmitCommandContext(command_context.get());
+void Application::BindImage(grassland::graphics::CommandContext* command_context, int slot, grassland::graphics::Image* image) {
+    image_binding_.assign(1, image);
+    command_context->CmdBindResources(slot, image_binding_, grassland::graphics::BIND_POINT_RAYTRACING);
+}
+
+void Application::BindBuffer(grassland::graphics::CommandContext* command_context, int slot, grassland::graphics::Buffer* buffer) {
+    buffer_binding_.assign(1, buffer);
+    command_context->CmdBindResources(slot, buffer_binding_, grassland::graphics::BIND_POINT_RAYTRACING);
+}
+
+void Application::BindSampler(grassland::graphics::CommandContext* command_context, int slot, grassland::graphics::Sampler* sampler) {
+    sampler_binding_.assign(1, sampler);
+    command_context->CmdBindResources(slot, sampler_binding_, grassland::graphics::BIND_POINT_RAYTRACING);
 }
 
 void Application::ExportFrame(const std::string& filename,
@@ -1482,8 +1622,10 @@ void Application::ExportFrame(const std::string& filename,
     max_bounces = std::max(1, max_bounces);
     samples = std::max(1, samples);
 
-    // Update camera state
+    // Update camera state; exports always render full detail
     camera_enabled_ = false;
+    size_t prev_lod = scene_->GetLod();
+    scene_->SelectLod(0);
     camera_pos_ = cam_pos;
     camera_up_ = glm::normalize(cam_up);
     camera_front_ = glm::normalize(cam_target - cam_pos);
@@ -1515,6 +1657,7 @@ void Application::ExportFrame(const std::string& filename,
     render_settings.highlight_threshold = highlight_threshold_;
     render_settings.saturation_boost_light = saturation_boost_light_;
     render_settings.saturation_boost_shadow = saturation_boost_shadow_;
+    render_settings.vertex_layout = static_cast<int>(scene_->GetVertexLayout());
     render_settings_buffer_->UploadData(&render_settings, sizeof(RenderSettings));
 
     // Resize render targets to requested resolution
@@ -1523,40 +1666,23 @@ void Application::ExportFrame(const std::string& filename,
     // Reset accumulation
     film_->Reset();
 
-    for (int i = 0; i < samples; ++i) {
-        std::unique_ptr<grassland::graphics::CommandContext> command_context;
-        core_->CreateCommandContext(&command_context);
-        command_context->CmdClearImage(color_image_.get(), { {0.0f, 0.0f, 0.0f, 1.0f} });
-        command_context->CmdClearImage(entity_id_image_.get(), { {-1, 0, 0, 0} });
-
-        command_context->CmdBindRayTracingProgram(program_.get());
-        command_context->CmdBindResources(0, scene_->GetTLAS(), grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(1, { color_image_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(2, { camera_object_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(3, { scene_->GetMaterialsBuffer() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(4, { hover_info_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(5, { entity_id_image_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(6, { film_->GetAccumulatedColorImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(7, { film_->GetAccumulatedSamplesImage() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(8, scene_->GetVertexBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(9, scene_->GetIndexBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(10, scene_->GetTexcoordBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(11, scene_->GetBaseColorTextureSRVs(), grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(12, { scene_->GetLinearWrapSampler() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(13, scene_->GetNormalBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(14, scene_->GetTangentBuffers(), grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(15, { scene_->GetLightsBuffer() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(16, { scene_->GetSkyboxTexture() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(17, { volume_info_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(18, { sky_info_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdBindResources(19, { render_settings_buffer_.get() }, grassland::graphics::BIND_POINT_RAYTRACING);
-        command_context->CmdDispatchRays(width, height, 1);
+    // Every sample runs the same commands, so record them once
+    std::unique_ptr<grassland::graphics::CommandContext> command_context;
+    core_->CreateCommandContext(&command_context);
+    command_context->CmdClearImage(color_image_.get(), { {0.0f, 0.0f, 0.0f, 1.0f} });
+    command_context->CmdClearImage(entity_id_image_.get(), { {-1, 0, 0, 0} });
 
+    command_context->CmdBindRayTracingProgram(program_.get());
+    BindSceneResources(command_context.get());
+    command_context->CmdDispatchRays(width, height, 1);
+
+    for (int i = 0; i < samples; ++i) {
         core_->SubmitCommandContext(command_context.get());
 
         film_->IncrementSampleCount();
         film_->DevelopToOutput();
     }
+    command_context.reset();
 
     SaveAccumulatedOutput(filename);
 
@@ -1566,6 +1692,7 @@ void Application::ExportFrame(const std::string& filename,
     camera_front_ = prev_front;
     camera_up_ = prev_up;
     camera_enabled_ = prev_camera_enabled;
+    scene_->SelectLod(prev_lod);
 
     CameraObject prev_camera{};
     prev_camera.screen_to_camera = glm::inverse(
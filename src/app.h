@@ -2,52 +2,9 @@
 #include "long_march.h"
 #include "Scene.h"
 #include "Film.h"
+#include "RenderTypes.h"
 #include <memory>
-
-struct CameraObject {
-    glm::mat4 screen_to_camera;
-    glm::mat4 camera_to_world;
-    glm::mat4 prev_camera_to_world;
-    float aperture;
-    float focus_distance;
-    float shutter_speed;
-    int enable_motion_blur;
-};
-
-struct VolumeRegion {
-    glm::vec3 min_p;
-    float pad0;
-    glm::vec3 max_p;
-    float sigma_t;
-    glm::vec3 sigma_s;
-    float pad_align;
-    glm::vec3 emission;  // Volumetric emission (Le)
-    float g; // Henyey-Greenstein anisotropy parameter
-};
-
-struct SkyInfo {
-    int use_skybox;
-    float env_intensity;
-    float bg_intensity;
-    float pad_sky;
-};
-
-struct RenderSettings {
-    int max_bounces;
-    float exposure;
-    int cartoon_enabled;
-    float diffuse_bands;
-    float specular_hardness;
-    float outline_width;
-    float outline_threshold;
-    // Flat cartoon style parameters
-    float binary_threshold;
-    float shadow_ignore_threshold;
-    float highlight_threshold;
-    // Saturation boost parameters
-    float saturation_boost_light;
-    float saturation_boost_shadow;
-};
+#include <vector>
 
 class Application {
 public:
@@ -93,6 +50,10 @@ private:
     struct HoverInfo {
         int hovered_entity_id;
         int light_count;
+        int cursor_x; // Pixel picked by RayGenMain, -1 for none
+        int cursor_y;
+        int pick_slot; // Texel of pick_image_ written this frame
+        int pad[3];
     };
     std::unique_ptr<grassland::graphics::Buffer> hover_info_buffer_;
     std::unique_ptr<grassland::graphics::Buffer> volume_info_buffer_;
@@ -109,6 +70,14 @@ private:
     std::unique_ptr<grassland::graphics::Image> color_image_;
     std::unique_ptr<grassland::graphics::Image> entity_id_image_; // Entity ID buffer for accurate picking
     std::unique_ptr<grassland::graphics::RayTracingProgram> program_;
+
+    // Hover highlight pass (HighlightMain) and the ring of cursor picks it reads back
+    static constexpr int kPickRingSize = 3;
+    std::unique_ptr<grassland::graphics::Shader> highlight_shader_;
+    std::unique_ptr<grassland::graphics::RayTracingProgram> highlight_program_;
+    std::unique_ptr<grassland::graphics::Image> pick_image_;
+    uint64_t pick_frame_ = 0; // Frames rendered; selects the ring slot
+    bool pick_slot_valid_[kPickRingSize] = {};
     bool alive_{ false };
 
     void RecreateRenderTargets(int width, int height);
@@ -132,10 +101,27 @@ private:
     void OnMouseMove(double xpos, double ypos); // Mouse event handler
     void OnMouseButton(int button, int action, int mods, double xpos, double ypos); // Mouse button event handler
     void RenderInfoOverlay(); // Render the info overlay
-    void ApplyHoverHighlight(grassland::graphics::Image* image); // Apply hover highlighting as post-process
     void SaveAccumulatedOutput(const std::string& filename); // Save accumulated output to PNG file
     void SaveToneMappedOutput(const std::string& filename); // Save tone-mapped (on-screen) output
 
+    // Resource layout shared by program_ and highlight_program_ (spaces 0-21)
+    void AddSceneBindings(grassland::graphics::RayTracingProgram* program);
+    void BindSceneResources(grassland::graphics::CommandContext* command_context);
+
+    // Interactive frame commands. Each mode is recorded once and replayed every frame until a bound
+    // resource, program or the window size changes (FrameBindingKey) or the render targets are
+    // recreated, so steady-state frames do not record or allocate a command context.
+    enum FrameMode { kFrameCamera = 0, kFrameAccumulate, kFrameHighlight, kFrameModeCount };
+    grassland::graphics::CommandContext* FrameCommandContext(FrameMode mode);
+    void RecordFrameCommands(grassland::graphics::CommandContext* command_context, FrameMode mode);
+    uint64_t FrameBindingKey() const;
+    void InvalidateFrameContexts();
+
+    // Bind a single resource through a persistent one-element list (no per-frame vector)
+    void BindImage(grassland::graphics::CommandContext* command_context, int slot, grassland::graphics::Image* image);
+    void BindBuffer(grassland::graphics::CommandContext* command_context, int slot, grassland::graphics::Buffer* buffer);
+    void BindSampler(grassland::graphics::CommandContext* command_context, int slot, grassland::graphics::Sampler* sampler);
+
     float yaw_;
     float pitch_;
     float last_x_;
@@ -144,6 +130,7 @@ private:
     bool first_mouse_; // Prevents camera jump on first mouse input
     bool camera_enabled_; // Whether camera movement is enabled
     bool last_camera_enabled_; // Track camera state changes to reset accumulation
+    static constexpr size_t kPreviewLod = 2; // Scene LOD while the camera moves; accumulation uses 0
     bool ui_hidden_; // Whether UI panels are hidden (Tab key toggle)
     
     // Mouse hovering
@@ -180,4 +167,23 @@ private:
     float shutter_speed_{ 0.5f };
     glm::mat4 prev_camera_to_world_{ 1.0f };
     glm::mat4 current_camera_to_world_{ 1.0f };
+
+    // Binding lists kept across frames so steady-state frames do not allocate
+    std::vector<grassland::graphics::Image*> image_binding_;
+    std::vector<grassland::graphics::Buffer*> buffer_binding_;
+    std::vector<grassland::graphics::Sampler*> sampler_binding_;
+
+    std::unique_ptr<grassland::graphics::CommandContext> frame_contexts_[kFrameModeCount];
+    uint64_t frame_context_keys_[kFrameModeCount] = {};
+
+    // Heap allocations between the start of OnUpdate and the end of OnRender
+    // (only counted in SHORTMARCH_COUNT_ALLOCATIONS builds)
+    uint64_t frame_allocation_mark_ = 0;
+    uint64_t frame_allocations_ = 0;
+    // Part of those made on the host staging paths (allocation_counter::StagingScope)
+    uint64_t staging_allocation_mark_ = 0;
+    uint64_t staging_allocations_ = 0;
+    // Set after the first frame following startup or RecreateRenderTargets; from then on the
+    // staging paths must not allocate
+    bool staging_warm_ = false;
 };
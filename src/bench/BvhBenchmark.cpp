@@ -0,0 +1,65 @@
+// BVH build benchmark: loads a glTF scene on the CPU and reports build time and SAH cost
+// of MeshBvh for every entity mesh.
+//
+// Usage: BvhBenchmark [scene.glb] [iterations]
+
+#include "Scene.h"
+#include "Bvh.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cstdlib>
+
+int main(int argc, char** argv) {
+    std::string scene_path = argc > 1 ? argv[1] : "new_scene.glb";
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    Scene scene(nullptr);
+    scene.LoadFromGLB(scene_path);
+    const auto& entities = scene.GetEntities();
+    if (entities.empty()) {
+        grassland::LogError("No meshes loaded from {}", scene_path);
+        return 1;
+    }
+
+    grassland::LogInfo("BVH benchmark: {} meshes, {} iterations, {} worker threads",
+                       entities.size(), iterations, ThreadPool::Instance().GetWorkerCount());
+
+    size_t total_triangles = 0;
+    size_t total_nodes = 0;
+    double total_ms = 0.0;
+    double weighted_sah = 0.0;
+
+    for (size_t i = 0; i < entities.size(); ++i) {
+        const grassland::Mesh<float>& mesh = entities[i]->GetMesh();
+        const glm::vec3* positions = reinterpret_cast<const glm::vec3*>(mesh.Positions());
+        size_t triangles = mesh.NumIndices() / 3;
+        if (triangles == 0) {
+            continue;
+        }
+
+        MeshBvh bvh;
+        double best_ms = 0.0;
+        for (int it = 0; it < iterations; ++it) {
+            auto start = std::chrono::steady_clock::now();
+            bvh.Build(positions, mesh.NumVertices(), mesh.Indices(), mesh.NumIndices());
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best_ms = it == 0 ? ms : std::min(best_ms, ms);
+        }
+
+        float sah = bvh.ComputeSahCost();
+        grassland::LogInfo("mesh {:4}: {:9} tris  {:9} nodes  {:8.3f} ms  {:7.2f} Mtris/s  SAH {:.2f}",
+                           i, triangles, bvh.GetNodes().size(), best_ms,
+                           best_ms > 0.0 ? triangles / best_ms * 1e-3 : 0.0, sah);
+
+        total_triangles += triangles;
+        total_nodes += bvh.GetNodes().size();
+        total_ms += best_ms;
+        weighted_sah += static_cast<double>(sah) * triangles;
+    }
+
+    grassland::LogInfo("total   : {:9} tris  {:9} nodes  {:8.3f} ms  {:7.2f} Mtris/s  SAH (triangle-weighted) {:.2f}",
+                       total_triangles, total_nodes, total_ms,
+                       total_ms > 0.0 ? total_triangles / total_ms * 1e-3 : 0.0,
+                       total_triangles ? weighted_sah / total_triangles : 0.0);
+    return 0;
+}
@@ -0,0 +1,95 @@
+// Film development benchmark: times Film::DevelopPixels against the previous single-threaded
+// scalar implementation (kept below as the reference) at 1080p, 4K and 8K on synthetic HDR
+// accumulation buffers, and reports the largest per-channel difference between the two.
+//
+// Usage: DevelopBenchmark [iterations]
+
+#include "Film.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+namespace {
+// Former Film::DevelopPixels: per-pixel std::log, per-channel pow, one thread
+void DevelopPixelsReference(const float* accumulated_colors, int pixel_count, int sample_count, float* output_colors) {
+    float log_luminance_sum = 0.0f;
+    int valid_pixels = 0;
+    const float inv_samples = 1.0f / static_cast<float>(sample_count);
+    for (int i = 0; i < pixel_count; i++) {
+        float r = accumulated_colors[i * 4 + 0] * inv_samples;
+        float g = accumulated_colors[i * 4 + 1] * inv_samples;
+        float b = accumulated_colors[i * 4 + 2] * inv_samples;
+        float lum = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+        if (lum > 0.0001f) {
+            log_luminance_sum += std::log(lum);
+            valid_pixels++;
+        }
+    }
+    float avg_luminance = valid_pixels > 0 ? std::exp(log_luminance_sum / valid_pixels) : 0.5f;
+    float exposure = glm::clamp(0.18f / std::max(avg_luminance, 0.0001f), 0.1f, 2.0f);
+
+    for (int i = 0; i < pixel_count; i++) {
+        glm::vec3 color = glm::vec3(accumulated_colors[i * 4 + 0],
+                                    accumulated_colors[i * 4 + 1],
+                                    accumulated_colors[i * 4 + 2]) * inv_samples * exposure;
+        color = glm::clamp((color * (2.51f * color + 0.03f)) / (color * (2.43f * color + 0.59f) + 0.14f), 0.0f, 1.0f);
+        output_colors[i * 4 + 0] = pow(color.r, 1.0f / 2.2f);
+        output_colors[i * 4 + 1] = pow(color.g, 1.0f / 2.2f);
+        output_colors[i * 4 + 2] = pow(color.b, 1.0f / 2.2f);
+        output_colors[i * 4 + 3] = 1.0f;
+    }
+}
+
+template <class Fn>
+double BestMs(int iterations, Fn&& fn) {
+    double best = 0.0;
+    for (int it = 0; it < iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = it == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+    constexpr int kSampleCount = 64;
+    struct Resolution {
+        const char* name;
+        int width, height;
+    };
+    const Resolution resolutions[] = { { "1080p", 1920, 1080 }, { "4K", 3840, 2160 }, { "8K", 7680, 4320 } };
+
+    grassland::LogInfo("Develop benchmark: {} threads, {} iterations", ThreadPool::Instance().GetWorkerCount(), iterations);
+    for (const Resolution& res : resolutions) {
+        int pixel_count = res.width * res.height;
+        // Heavy-tailed radiance with some empty (black) pixels, like an early accumulation
+        std::vector<float> accumulated(static_cast<size_t>(pixel_count) * 4);
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        for (size_t i = 0; i < accumulated.size(); ++i) {
+            float x = uniform(rng);
+            accumulated[i] = (i % 4 == 3) ? kSampleCount : (i % 37 == 0 ? 0.0f : x * x * x * 20.0f * kSampleCount);
+        }
+        std::vector<float> reference(accumulated.size()), output(accumulated.size());
+
+        double reference_ms = BestMs(iterations, [&]() {
+            DevelopPixelsReference(accumulated.data(), pixel_count, kSampleCount, reference.data());
+        });
+        double develop_ms = BestMs(iterations, [&]() {
+            Film::DevelopPixels(accumulated.data(), pixel_count, kSampleCount, output.data());
+        });
+
+        float max_error = 0.0f;
+        for (size_t i = 0; i < output.size(); ++i) {
+            max_error = std::max(max_error, std::abs(output[i] - reference[i]));
+        }
+        grassland::LogInfo("{:>5} ({}x{}): reference {:8.2f} ms  develop {:7.2f} ms  ({:.1f}x)  max error {:.2e}",
+                           res.name, res.width, res.height, reference_ms, develop_ms,
+                           develop_ms > 0.0 ? reference_ms / develop_ms : 0.0, max_error);
+    }
+    return 0;
+}
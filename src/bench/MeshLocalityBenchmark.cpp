@@ -0,0 +1,215 @@
+// Mesh locality benchmark: loads a glTF scene as exported, then runs OptimizeMeshLocality
+// (MeshOptimization.h) over every mesh and compares the two versions:
+//   - MeshBvh build time and SAH cost (the CPU equivalent of the BLAS build);
+//   - attribute-fetch cache misses of a 32 KiB 8-way LRU cache (64-byte lines) simulated over
+//     the index and interleaved ShadingVertex reads, once for all triangles in index order and
+//     once for the hits of pinhole-camera primary rays in scanline order;
+//   - the time to trace those rays and fetch the hit attributes.
+//
+// Usage: MeshLocalityBenchmark [scene.glb] [resolution] [iterations]
+
+#include "Scene.h"
+#include "Bvh.h"
+#include "MeshOptimization.h"
+#include <chrono>
+#include <cstdlib>
+#include <unordered_set>
+
+namespace {
+constexpr size_t kCacheLine = 64;
+
+// Set-associative LRU cache that only counts misses
+class CacheSimulator {
+public:
+    CacheSimulator(size_t bytes, size_t ways)
+        : ways_(ways), sets_(bytes / kCacheLine / ways), tags_(sets_ * ways, ~uintptr_t(0)), stamps_(sets_ * ways, 0) {}
+
+    void Access(const void* data, size_t bytes) {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(data) / kCacheLine;
+        uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes - 1) / kCacheLine;
+        for (uintptr_t line = begin; line <= end; ++line) Touch(line);
+    }
+
+    size_t GetMisses() const { return misses_; }
+
+private:
+    void Touch(uintptr_t line) {
+        size_t base = (line % sets_) * ways_;
+        size_t victim = base;
+        ++clock_;
+        for (size_t way = base; way < base + ways_; ++way) {
+            if (tags_[way] == line) {
+                stamps_[way] = clock_;
+                return;
+            }
+            if (stamps_[way] < stamps_[victim]) victim = way;
+        }
+        ++misses_;
+        tags_[victim] = line;
+        stamps_[victim] = clock_;
+    }
+
+    size_t ways_;
+    size_t sets_;
+    std::vector<uintptr_t> tags_;
+    std::vector<uint64_t> stamps_;
+    uint64_t clock_ = 0;
+    size_t misses_ = 0;
+};
+
+struct LocalityResult {
+    double build_ms = 0.0;
+    float sah = 0.0f;
+    double triangle_misses = 0.0; // per triangle, index order
+    double hit_misses = 0.0;      // per primary ray hit
+    double trace_ms = 0.0;
+    size_t hits = 0;
+};
+
+// Camera rays looking at the mesh bounds from a fixed diagonal, in scanline order
+std::vector<CpuRay> MakePrimaryRays(const Aabb& bounds, int resolution) {
+    glm::vec3 center = bounds.Center();
+    float radius = std::max(glm::length(bounds.max_p - bounds.min_p) * 0.5f, 1e-3f);
+    glm::vec3 forward = glm::normalize(glm::vec3(-0.4f, -0.3f, -1.0f));
+    glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    glm::vec3 up = glm::cross(right, forward);
+    glm::vec3 origin = center - forward * (radius * 2.5f);
+    float half_extent = 0.45f;
+
+    std::vector<CpuRay> rays;
+    rays.reserve(static_cast<size_t>(resolution) * resolution);
+    for (int y = 0; y < resolution; ++y) {
+        for (int x = 0; x < resolution; ++x) {
+            float sx = ((x + 0.5f) / resolution * 2.0f - 1.0f) * half_extent;
+            float sy = ((y + 0.5f) / resolution * 2.0f - 1.0f) * half_extent;
+            rays.push_back(CpuRay{ origin, 1e-4f, glm::normalize(forward + right * sx + up * sy), 1e30f });
+        }
+    }
+    return rays;
+}
+
+LocalityResult Measure(const grassland::Mesh<float>& mesh, int resolution, int iterations) {
+    LocalityResult result;
+    const auto* positions = reinterpret_cast<const glm::vec3*>(mesh.Positions());
+    const uint32_t* indices = mesh.Indices();
+    const size_t triangle_count = mesh.NumIndices() / 3;
+    std::vector<ShadingVertex> attributes = MakeShadingVertices(mesh);
+
+    MeshBvh bvh;
+    for (int it = 0; it < iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        bvh.Build(positions, mesh.NumVertices(), indices, mesh.NumIndices());
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        result.build_ms = it == 0 ? ms : std::min(result.build_ms, ms);
+    }
+    result.sah = bvh.ComputeSahCost();
+
+    auto fetch = [&](CacheSimulator& cache, size_t triangle) {
+        const uint32_t* tri = indices + triangle * 3;
+        cache.Access(tri, sizeof(uint32_t) * 3);
+        for (int c = 0; c < 3; ++c) cache.Access(&attributes[tri[c]], sizeof(ShadingVertex));
+    };
+    CacheSimulator triangle_cache(32 * 1024, 8);
+    for (size_t t = 0; t < triangle_count; ++t) fetch(triangle_cache, t);
+    result.triangle_misses = triangle_count ? double(triangle_cache.GetMisses()) / triangle_count : 0.0;
+
+    std::vector<CpuRay> rays = MakePrimaryRays(bvh.GetBounds(), resolution);
+    CacheSimulator hit_cache(32 * 1024, 8);
+    for (const CpuRay& ray : rays) {
+        CpuHit hit;
+        if (bvh.IntersectClosest(ray, &hit)) {
+            fetch(hit_cache, hit.primitive);
+            ++result.hits;
+        }
+    }
+    result.hit_misses = result.hits ? double(hit_cache.GetMisses()) / result.hits : 0.0;
+
+    volatile float sink = 0.0f;
+    for (int it = 0; it < iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        float sum = 0.0f;
+        for (const CpuRay& ray : rays) {
+            CpuHit hit;
+            if (!bvh.IntersectClosest(ray, &hit)) continue;
+            const uint32_t* tri = indices + size_t(hit.primitive) * 3;
+            glm::vec3 normal = attributes[tri[0]].normal * (1.0f - hit.u - hit.v) + attributes[tri[1]].normal * hit.u +
+                               attributes[tri[2]].normal * hit.v;
+            sum += normal.x + normal.y + normal.z;
+        }
+        sink = sink + sum;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        result.trace_ms = it == 0 ? ms : std::min(result.trace_ms, ms);
+    }
+    return result;
+}
+
+void Report(const char* label, const LocalityResult& r, size_t vertices, size_t triangles) {
+    grassland::LogInfo("  {}: {:9} verts {:9} tris  build {:8.3f} ms  SAH {:7.2f}  misses/tri {:5.2f}  "
+                       "misses/hit {:5.2f}  trace+fetch {:8.3f} ms ({} hits)",
+                       label, vertices, triangles, r.build_ms, r.sah, r.triangle_misses, r.hit_misses, r.trace_ms, r.hits);
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string scene_path = argc > 1 ? argv[1] : "new_scene.glb";
+    int resolution = argc > 2 ? std::max(16, std::atoi(argv[2])) : 512;
+    int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+
+    // As exported; the optimized copies are made below
+    Scene scene(nullptr);
+    scene.SetUseSceneCache(false);
+    scene.LoadFromGLB(scene_path);
+    const auto& entities = scene.GetEntities();
+    if (entities.empty()) {
+        grassland::LogError("No meshes loaded from {}", scene_path);
+        return 1;
+    }
+
+    grassland::LogInfo("Mesh locality benchmark: {} entities, {}x{} primary rays, {} iterations",
+                       entities.size(), resolution, resolution, iterations);
+
+    LocalityResult total_before, total_after;
+    size_t total_triangles_before = 0, total_triangles_after = 0, total_hits_before = 0, total_hits_after = 0;
+    double optimize_ms = 0.0;
+    std::unordered_set<const grassland::Mesh<float>*> seen;
+    for (size_t i = 0; i < entities.size(); ++i) {
+        const grassland::Mesh<float>& mesh = entities[i]->GetMesh();
+        if (mesh.NumIndices() < 3 || !seen.insert(&mesh).second) continue;
+
+        auto start = std::chrono::steady_clock::now();
+        MeshOptimizationStats stats;
+        grassland::Mesh<float> optimized = OptimizeMeshLocality(mesh, &stats);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        optimize_ms += ms;
+        if (optimized.NumIndices() < 3) continue;
+
+        LocalityResult before = Measure(mesh, resolution, iterations);
+        LocalityResult after = Measure(optimized, resolution, iterations);
+        grassland::LogInfo("mesh {:4}: optimized in {:.3f} ms", i, ms);
+        Report("before", before, stats.vertices_before, stats.triangles_before);
+        Report("after ", after, stats.vertices_after, stats.triangles_after);
+
+        total_before.build_ms += before.build_ms;
+        total_after.build_ms += after.build_ms;
+        total_before.trace_ms += before.trace_ms;
+        total_after.trace_ms += after.trace_ms;
+        total_before.triangle_misses += before.triangle_misses * stats.triangles_before;
+        total_after.triangle_misses += after.triangle_misses * stats.triangles_after;
+        total_before.hit_misses += before.hit_misses * before.hits;
+        total_after.hit_misses += after.hit_misses * after.hits;
+        total_triangles_before += stats.triangles_before;
+        total_triangles_after += stats.triangles_after;
+        total_hits_before += before.hits;
+        total_hits_after += after.hits;
+    }
+
+    auto per = [](double value, size_t count) { return count ? value / count : 0.0; };
+    grassland::LogInfo("total: optimize {:.1f} ms", optimize_ms);
+    grassland::LogInfo("  before: build {:8.3f} ms  misses/tri {:5.2f}  misses/hit {:5.2f}  trace+fetch {:8.3f} ms",
+                       total_before.build_ms, per(total_before.triangle_misses, total_triangles_before),
+                       per(total_before.hit_misses, total_hits_before), total_before.trace_ms);
+    grassland::LogInfo("  after : build {:8.3f} ms  misses/tri {:5.2f}  misses/hit {:5.2f}  trace+fetch {:8.3f} ms",
+                       total_after.build_ms, per(total_after.triangle_misses, total_triangles_after),
+                       per(total_after.hit_misses, total_hits_after), total_after.trace_ms);
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Ray query micro-benchmark: for every mesh of a glTF scene, traces pinhole-camera primary
+// rays on one thread with the scalar MeshBvh kernels, the 8-wide WideBvh kernels one ray at a
+// time, and WideBvh with 4x2 ray packets. Reports Mrays/s and checks that all three agree.
+//
+// Usage: RayBenchmark [scene.glb] [resolution] [iterations]
+
+#include "Scene.h"
+#include "Bvh.h"
+#include "WideBvh.h"
+#include <chrono>
+#include <cstdlib>
+
+namespace {
+struct ModeResult {
+    double best_ms = 0.0;
+    size_t hits = 0;
+};
+
+// Camera rays looking at the mesh bounds from a fixed diagonal, ordered in 4x2 pixel blocks
+std::vector<CpuRay> MakePrimaryRays(const Aabb& bounds, int resolution) {
+    glm::vec3 center = bounds.Center();
+    float radius = std::max(glm::length(bounds.max_p - bounds.min_p) * 0.5f, 1e-3f);
+    glm::vec3 forward = glm::normalize(glm::vec3(-0.4f, -0.3f, -1.0f));
+    glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    glm::vec3 up = glm::cross(right, forward);
+    glm::vec3 origin = center - forward * (radius * 2.5f);
+    float half_extent = 0.45f; // ~48 degree field of view
+
+    std::vector<CpuRay> rays;
+    rays.reserve(static_cast<size_t>(resolution) * resolution);
+    for (int by = 0; by < resolution; by += 2) {
+        for (int bx = 0; bx < resolution; bx += 4) {
+            for (int lane = 0; lane < RayPacket8::kSize; ++lane) {
+                int x = bx + lane % 4;
+                int y = by + lane / 4;
+                float sx = ((x + 0.5f) / resolution * 2.0f - 1.0f) * half_extent;
+                float sy = ((y + 0.5f) / resolution * 2.0f - 1.0f) * half_extent;
+                glm::vec3 direction = glm::normalize(forward + right * sx + up * sy);
+                rays.push_back(CpuRay{ origin, 1e-4f, direction, 1e30f });
+            }
+        }
+    }
+    return rays;
+}
+
+template <class TraceFn>
+ModeResult TimeMode(int iterations, TraceFn&& trace) {
+    ModeResult result;
+    for (int it = 0; it < iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        size_t hits = trace();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        result.best_ms = it == 0 ? ms : std::min(result.best_ms, ms);
+        result.hits = hits;
+    }
+    return result;
+}
+
+double MegaRays(size_t rays, double ms) {
+    return ms > 0.0 ? rays / ms * 1e-3 : 0.0;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string scene_path = argc > 1 ? argv[1] : "new_scene.glb";
+    int resolution = argc > 2 ? std::max(4, std::atoi(argv[2]) / 4 * 4) : 512;
+    int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+
+    Scene scene(nullptr);
+    scene.LoadFromGLB(scene_path);
+    const auto& entities = scene.GetEntities();
+    if (entities.empty()) {
+        grassland::LogError("No meshes loaded from {}", scene_path);
+        return 1;
+    }
+
+#if defined(SHORTMARCH_SIMD_AVX2)
+    const char* isa = "AVX2";
+#elif defined(SHORTMARCH_SIMD_SSE)
+    const char* isa = "SSE2";
+#else
+    const char* isa = "scalar";
+#endif
+    grassland::LogInfo("Ray benchmark: {} meshes, {}x{} primary rays, {} iterations, {} kernels",
+                       entities.size(), resolution, resolution, iterations, isa);
+
+    double total_ms[3] = { 0.0, 0.0, 0.0 };
+    size_t total_rays = 0;
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < entities.size(); ++i) {
+        const grassland::Mesh<float>& mesh = entities[i]->GetMesh();
+        if (mesh.NumIndices() < 3) {
+            continue;
+        }
+        MeshBvh bvh;
+        bvh.Build(reinterpret_cast<const glm::vec3*>(mesh.Positions()), mesh.NumVertices(), mesh.Indices(), mesh.NumIndices());
+        WideBvh wide;
+        wide.Build(bvh);
+        std::vector<CpuRay> rays = MakePrimaryRays(bvh.GetBounds(), resolution);
+
+        ModeResult scalar = TimeMode(iterations, [&]() {
+            size_t hits = 0;
+            for (const CpuRay& ray : rays) {
+                CpuHit hit;
+                hits += bvh.IntersectClosest(ray, &hit);
+            }
+            return hits;
+        });
+        ModeResult single = TimeMode(iterations, [&]() {
+            size_t hits = 0;
+            for (const CpuRay& ray : rays) {
+                CpuHit hit;
+                hits += wide.IntersectClosest(ray, &hit);
+            }
+            return hits;
+        });
+        ModeResult packet = TimeMode(iterations, [&]() {
+            size_t hits = 0;
+            for (size_t first = 0; first < rays.size(); first += RayPacket8::kSize) {
+                RayPacket8 packet_rays;
+                for (int lane = 0; lane < RayPacket8::kSize; ++lane) {
+                    packet_rays.SetRay(lane, rays[first + lane]);
+                }
+                CpuHit hits8[RayPacket8::kSize];
+                int mask = wide.IntersectClosest(packet_rays, hits8);
+                for (; mask; mask &= mask - 1) ++hits;
+            }
+            return hits;
+        });
+
+        if (single.hits != scalar.hits || packet.hits != scalar.hits) {
+            ++mismatches;
+            grassland::LogWarning("mesh {}: hit counts differ (scalar {}, single {}, packet {})",
+                                  i, scalar.hits, single.hits, packet.hits);
+        }
+        grassland::LogInfo("mesh {:4}: {:8} tris  {:5.1f}% hit  scalar {:7.2f}  simd {:7.2f}  packet {:7.2f} Mrays/s  ({:.2f} MB wide)",
+                           i, bvh.GetTriangleCount(), 100.0 * scalar.hits / rays.size(),
+                           MegaRays(rays.size(), scalar.best_ms), MegaRays(rays.size(), single.best_ms),
+                           MegaRays(rays.size(), packet.best_ms), wide.GetMemoryUsage() / (1024.0 * 1024.0));
+
+        total_ms[0] += scalar.best_ms;
+        total_ms[1] += single.best_ms;
+        total_ms[2] += packet.best_ms;
+        total_rays += rays.size();
+    }
+
+    grassland::LogInfo("total    : {} rays  scalar {:.2f}  simd {:.2f} ({:.2f}x)  packet {:.2f} ({:.2f}x) Mrays/s",
+                       total_rays, MegaRays(total_rays, total_ms[0]),
+                       MegaRays(total_rays, total_ms[1]), total_ms[1] > 0.0 ? total_ms[0] / total_ms[1] : 0.0,
+                       MegaRays(total_rays, total_ms[2]), total_ms[2] > 0.0 ? total_ms[0] / total_ms[2] : 0.0);
+    return mismatches == 0 ? 0 : 1;
+}
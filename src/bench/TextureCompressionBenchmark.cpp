@@ -0,0 +1,128 @@
+// Texture compression benchmark: encodes every texture of a glTF scene (or a synthetic gradient
+// and noise texture when the scene has none) with each BC format and quality preset
+// (TextureCompression.h), and reports encode time, throughput and the PSNR of the decoded result
+// over the channels the format keeps. Totals per format and preset give the quality-vs-time curve.
+//
+// Usage: TextureCompressionBenchmark [scene.glb] [iterations]
+
+#include "Scene.h"
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+namespace {
+struct Result {
+    double ms = 0.0;
+    double squared_error = 0.0;
+    size_t samples = 0;
+    size_t texels = 0;
+};
+
+double Psnr(double squared_error, size_t samples) {
+    if (samples == 0) return 0.0;
+    double mse = squared_error / samples;
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+HostTexture MakeSyntheticTexture(int size) {
+    HostTexture texture;
+    texture.width = size;
+    texture.height = size;
+    texture.rgba8.resize(size_t(size) * size * 4);
+    std::mt19937 rng(7);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            uint8_t* texel = texture.rgba8.data() + (size_t(y) * size + x) * 4;
+            float u = x / float(size), v = y / float(size);
+            int noise = int(rng() % 48) - 24;
+            texel[0] = static_cast<uint8_t>(std::clamp(int(255 * u) + noise, 0, 255));
+            texel[1] = static_cast<uint8_t>(127 + 127 * std::sin(u * 31.0f + v * 7.0f));
+            texel[2] = static_cast<uint8_t>(255 * v);
+            texel[3] = ((x / 32 + y / 32) & 1) ? 255 : 64;
+        }
+    }
+    return texture;
+}
+
+Result Measure(const HostTexture& texture, BcFormat format, BcQuality quality, int iterations) {
+    Result result;
+    result.ms = 1e30;
+    CompressedTexture compressed;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        compressed = CompressTexture(texture.rgba8.data(), texture.width, texture.height, format, quality);
+        result.ms = std::min(result.ms, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::vector<uint8_t> decoded = DecompressTexture(compressed);
+    const int channels = BcChannelCount(format);
+    result.texels = size_t(texture.width) * texture.height;
+    for (size_t t = 0; t < result.texels; ++t) {
+        for (int c = 0; c < channels; ++c) {
+            double d = double(decoded[t * 4 + c]) - texture.rgba8[t * 4 + c];
+            result.squared_error += d * d;
+        }
+    }
+    result.samples = result.texels * channels;
+    return result;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string scene_path = argc > 1 ? argv[1] : "new_scene.glb";
+    int iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+
+    // CPU-only scenes keep every texture on the host
+    Scene scene(nullptr);
+    scene.SetUseSceneCache(false);
+    scene.LoadFromGLB(scene_path);
+    std::vector<HostTexture> textures;
+    for (const HostTexture& texture : scene.GetHostTextures()) {
+        if (!texture.IsValid() || texture.rgba8.empty()) continue;
+        // The encoder reads RGBA8; grey and grey + alpha host textures are expanded like their upload
+        HostTexture rgba = texture;
+        if (texture.channels != 4) {
+            rgba.channels = 4;
+            rgba.rgba8.resize(size_t(texture.width) * texture.height * 4);
+            ExpandToRgba8(texture.rgba8.data(), texture.channels, size_t(texture.width) * texture.height, rgba.rgba8.data());
+        }
+        textures.push_back(std::move(rgba));
+    }
+    if (textures.empty()) {
+        grassland::LogWarning("No textures loaded from {}, using a synthetic 2048x2048 texture", scene_path);
+        textures.push_back(MakeSyntheticTexture(2048));
+    }
+
+    size_t total_texels = 0;
+    for (const HostTexture& texture : textures) total_texels += size_t(texture.width) * texture.height;
+    grassland::LogInfo("Texture compression benchmark: {} textures, {:.1f} Mtexels, {} threads, best of {} iterations",
+                       textures.size(), total_texels / 1e6, ThreadPool::Instance().GetWorkerCount(), iterations);
+
+    const BcFormat formats[] = { BcFormat::kBC1, BcFormat::kBC4, BcFormat::kBC5, BcFormat::kBC7 };
+    const BcQuality qualities[] = { BcQuality::kFast, BcQuality::kBalanced, BcQuality::kHigh };
+    for (BcFormat format : formats) {
+        for (BcQuality quality : qualities) {
+            Result total;
+            for (size_t i = 0; i < textures.size(); ++i) {
+                Result result = Measure(textures[i], format, quality, iterations);
+                total.ms += result.ms;
+                total.squared_error += result.squared_error;
+                total.samples += result.samples;
+                total.texels += result.texels;
+                if (textures.size() > 1) {
+                    grassland::LogInfo("  texture {:3} {}x{}: {} {:8}: {:8.2f} ms  PSNR {:6.2f} dB", i, textures[i].width,
+                                       textures[i].height, BcFormatName(format), BcQualityName(quality), result.ms,
+                                       Psnr(result.squared_error, result.samples));
+                }
+            }
+            grassland::LogInfo("{} {:8}: {:9.2f} ms  {:7.1f} Mtexel/s  PSNR {:6.2f} dB  {:.2f} MB -> {:.2f} MB", BcFormatName(format),
+                               BcQualityName(quality), total.ms, total.ms > 0.0 ? total.texels / (total.ms * 1e3) : 0.0,
+                               Psnr(total.squared_error, total.samples), total.texels * 4 / (1024.0 * 1024.0),
+                               total.texels * BcBlockBytes(format) / 16 / (1024.0 * 1024.0));
+        }
+    }
+    return 0;
+}
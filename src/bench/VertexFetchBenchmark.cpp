@@ -0,0 +1,182 @@
+// Vertex attribute fetch benchmark: for random triangle IDs and barycentrics, loads the three
+// indices and interpolates normal, tangent and texcoord the way ClosestHitMain does, once from
+// the separate per-attribute arrays and once from the interleaved ShadingVertex array
+// (VertexLayout::kInterleaved). The mesh is a grid large enough to spill out of the caches, so
+// the time per hit follows the number of distinct cache lines a hit touches, which is reported
+// alongside.
+//
+// Usage: VertexFetchBenchmark [grid_size] [hits] [iterations]
+
+#include "Entity.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+namespace {
+constexpr size_t kCacheLine = 64;
+
+struct Hit {
+    uint32_t triangle;
+    float b1, b2;
+};
+
+struct Shading {
+    glm::vec3 normal;
+    glm::vec3 tangent;
+    glm::vec2 texcoord;
+};
+
+template <class Fn>
+double BestMs(int iterations, Fn&& fn) {
+    double best = 0.0;
+    for (int it = 0; it < iterations; ++it) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = it == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+// Distinct cache lines covered by the given byte ranges
+size_t CountLines(std::vector<uintptr_t>& lines) {
+    std::sort(lines.begin(), lines.end());
+    return std::unique(lines.begin(), lines.end()) - lines.begin();
+}
+
+void AddLines(std::vector<uintptr_t>& lines, const void* data, size_t bytes) {
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data) / kCacheLine;
+    uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes - 1) / kCacheLine;
+    for (uintptr_t line = begin; line <= end; ++line) lines.push_back(line);
+}
+
+float Checksum(const Shading& s) {
+    return s.normal.x + s.normal.y + s.normal.z + s.tangent.x + s.tangent.y + s.tangent.z + s.texcoord.x + s.texcoord.y;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    int grid = argc > 1 ? std::max(2, std::atoi(argv[1])) : 1024;
+    size_t hit_count = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : size_t(4) << 20;
+    int iterations = argc > 3 ? std::max(1, std::atoi(argv[3])) : 5;
+
+    // Grid mesh with every attribute stream present
+    size_t vertex_count = size_t(grid) * grid;
+    std::vector<grassland::Vector3<float>> positions(vertex_count), normals(vertex_count), tangents(vertex_count);
+    std::vector<grassland::Vector2<float>> texcoords(vertex_count);
+    for (int y = 0; y < grid; ++y) {
+        for (int x = 0; x < grid; ++x) {
+            size_t v = size_t(y) * grid + x;
+            float u = x / float(grid - 1), w = y / float(grid - 1);
+            positions[v] = { u, 0.1f * std::sin(u * 20.0f), w };
+            normals[v] = { -0.1f * std::cos(u * 20.0f), 1.0f, 0.0f };
+            tangents[v] = { 1.0f, 0.0f, 0.1f * w };
+            texcoords[v] = { u, w };
+        }
+    }
+    std::vector<uint32_t> indices;
+    indices.reserve(size_t(grid - 1) * (grid - 1) * 6);
+    for (int y = 0; y + 1 < grid; ++y) {
+        for (int x = 0; x + 1 < grid; ++x) {
+            uint32_t v = uint32_t(y) * grid + x;
+            uint32_t quad[6] = { v, v + grid, v + 1, v + 1, v + grid, v + grid + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    grassland::Mesh<float> mesh(vertex_count, indices.size(), indices.data(), positions.data(), normals.data(),
+                                texcoords.data(), tangents.data());
+    std::vector<ShadingVertex> interleaved = MakeShadingVertices(mesh);
+    const auto* normal_data = reinterpret_cast<const glm::vec3*>(mesh.Normals());
+    const auto* tangent_data = reinterpret_cast<const glm::vec3*>(mesh.Tangents());
+    const auto* texcoord_data = reinterpret_cast<const glm::vec2*>(mesh.TexCoords());
+    const uint32_t* index_data = mesh.Indices();
+
+    size_t triangle_count = indices.size() / 3;
+    std::vector<Hit> hits(hit_count);
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(triangle_count - 1));
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for (Hit& hit : hits) {
+        float b1 = uniform(rng), b2 = uniform(rng);
+        if (b1 + b2 > 1.0f) {
+            b1 = 1.0f - b1;
+            b2 = 1.0f - b2;
+        }
+        hit = { pick(rng), b1, b2 };
+    }
+
+    auto fetch_separate = [&](const Hit& hit) {
+        const uint32_t* tri = index_data + size_t(hit.triangle) * 3;
+        float b0 = 1.0f - hit.b1 - hit.b2;
+        Shading s;
+        s.normal = normal_data[tri[0]] * b0 + normal_data[tri[1]] * hit.b1 + normal_data[tri[2]] * hit.b2;
+        s.tangent = tangent_data[tri[0]] * b0 + tangent_data[tri[1]] * hit.b1 + tangent_data[tri[2]] * hit.b2;
+        s.texcoord = texcoord_data[tri[0]] * b0 + texcoord_data[tri[1]] * hit.b1 + texcoord_data[tri[2]] * hit.b2;
+        return s;
+    };
+    auto fetch_interleaved = [&](const Hit& hit) {
+        const uint32_t* tri = index_data + size_t(hit.triangle) * 3;
+        float b0 = 1.0f - hit.b1 - hit.b2;
+        const ShadingVertex& v0 = interleaved[tri[0]];
+        const ShadingVertex& v1 = interleaved[tri[1]];
+        const ShadingVertex& v2 = interleaved[tri[2]];
+        Shading s;
+        s.normal = v0.normal * b0 + v1.normal * hit.b1 + v2.normal * hit.b2;
+        s.tangent = v0.tangent * b0 + v1.tangent * hit.b1 + v2.tangent * hit.b2;
+        s.texcoord = v0.texcoord * b0 + v1.texcoord * hit.b1 + v2.texcoord * hit.b2;
+        return s;
+    };
+
+    // Cache lines per hit, counted over a sample of the hits
+    size_t sample = std::min<size_t>(hits.size(), 65536);
+    double separate_lines = 0.0, interleaved_lines = 0.0;
+    std::vector<uintptr_t> lines;
+    for (size_t i = 0; i < sample; ++i) {
+        const uint32_t* tri = index_data + size_t(hits[i].triangle) * 3;
+        lines.clear();
+        AddLines(lines, tri, sizeof(uint32_t) * 3);
+        for (int c = 0; c < 3; ++c) {
+            AddLines(lines, normal_data + tri[c], sizeof(glm::vec3));
+            AddLines(lines, tangent_data + tri[c], sizeof(glm::vec3));
+            AddLines(lines, texcoord_data + tri[c], sizeof(glm::vec2));
+        }
+        separate_lines += CountLines(lines);
+        lines.clear();
+        AddLines(lines, tri, sizeof(uint32_t) * 3);
+        for (int c = 0; c < 3; ++c) {
+            AddLines(lines, &interleaved[tri[c]], sizeof(ShadingVertex));
+        }
+        interleaved_lines += CountLines(lines);
+    }
+    separate_lines /= sample;
+    interleaved_lines /= sample;
+
+    float separate_sum = 0.0f, interleaved_sum = 0.0f;
+    double separate_ms = BestMs(iterations, [&]() {
+        float sum = 0.0f;
+        for (const Hit& hit : hits) sum += Checksum(fetch_separate(hit));
+        separate_sum = sum;
+    });
+    double interleaved_ms = BestMs(iterations, [&]() {
+        float sum = 0.0f;
+        for (const Hit& hit : hits) sum += Checksum(fetch_interleaved(hit));
+        interleaved_sum = sum;
+    });
+
+    size_t separate_bytes = vertex_count * (sizeof(glm::vec3) * 2 + sizeof(glm::vec2));
+    size_t interleaved_bytes = vertex_count * sizeof(ShadingVertex);
+    grassland::LogInfo("Vertex fetch benchmark: {}x{} grid ({} vertices, {} triangles), {} random hits, {} iterations",
+                       grid, grid, vertex_count, triangle_count, hits.size(), iterations);
+    grassland::LogInfo("separate   : {:7.2f} ms  {:6.2f} ns/hit  {:.2f} cache lines/hit  ({:.1f} MB attributes)",
+                       separate_ms, separate_ms * 1e6 / hits.size(), separate_lines, separate_bytes / (1024.0 * 1024.0));
+    grassland::LogInfo("interleaved: {:7.2f} ms  {:6.2f} ns/hit  {:.2f} cache lines/hit  ({:.1f} MB attributes)  ({:.2f}x)",
+                       interleaved_ms, interleaved_ms * 1e6 / hits.size(), interleaved_lines,
+                       interleaved_bytes / (1024.0 * 1024.0), interleaved_ms > 0.0 ? separate_ms / interleaved_ms : 0.0);
+    if (separate_sum != interleaved_sum) {
+        grassland::LogWarning("Layouts disagree: checksum {} vs {}", separate_sum, interleaved_sum);
+        return 1;
+    }
+    return 0;
+}
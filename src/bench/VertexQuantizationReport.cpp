@@ -0,0 +1,102 @@
+// Vertex quantization report: encodes the normals, tangents and texcoords of every mesh of a
+// glTF scene with the VertexLayout::kQuantized encodings (VertexQuantization.h), decodes them
+// again and reports the round-trip error together with the attribute memory of each vertex
+// layout (positions and indices are the same in all of them and are left out).
+//
+// Usage: VertexQuantizationReport [scene.glb]
+
+#include "Scene.h"
+#include <cmath>
+#include <unordered_set>
+
+namespace {
+struct ErrorStats {
+    double max = 0.0;
+    double sum = 0.0;
+    size_t count = 0;
+
+    void Add(double e) {
+        max = std::max(max, e);
+        sum += e;
+        ++count;
+    }
+    double Mean() const { return count ? sum / count : 0.0; }
+};
+
+// Angle between two directions in degrees, accurate for tiny angles
+double AngleDegrees(const glm::vec3& a, const glm::vec3& b) {
+    double ax = a.x, ay = a.y, az = a.z, bx = b.x, by = b.y, bz = b.z;
+    double cx = ay * bz - az * by, cy = az * bx - ax * bz, cz = ax * by - ay * bx;
+    return std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), ax * bx + ay * by + az * bz) * 57.29577951308232;
+}
+
+double MiB(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string scene_path = argc > 1 ? argv[1] : "new_scene.glb";
+
+    Scene scene(nullptr);
+    scene.LoadFromGLB(scene_path);
+    const auto& entities = scene.GetEntities();
+    if (entities.empty()) {
+        grassland::LogError("No meshes loaded from {}", scene_path);
+        return 1;
+    }
+
+    ErrorStats normal_error, tangent_error, texcoord_error;
+    size_t separate_bytes = 0, interleaved_bytes = 0, quantized_bytes = 0, vertex_total = 0, mesh_count = 0;
+    std::unordered_set<const grassland::Mesh<float>*> seen;
+    for (const auto& entity : entities) {
+        const grassland::Mesh<float>& mesh = entity->GetMesh();
+        if (!seen.insert(&mesh).second) continue; // Instances share the mesh
+        ++mesh_count;
+
+        VertexFormat format;
+        const std::vector<float>& signs = entity->GetTangentSigns();
+        std::vector<uint32_t> packed = PackVertexStreams(mesh, signs.empty() ? nullptr : signs.data(), &format);
+        const auto* normals = reinterpret_cast<const glm::vec3*>(mesh.Normals());
+        const auto* tangents = reinterpret_cast<const glm::vec3*>(mesh.Tangents());
+        const auto* texcoords = reinterpret_cast<const glm::vec2*>(mesh.TexCoords());
+        uint32_t normal_slot = format.packed_slots & 0xFF;
+        uint32_t tangent_slot = (format.packed_slots >> 8) & 0xFF;
+        uint32_t texcoord_slot = (format.packed_slots >> 16) & 0xFF;
+        for (size_t i = 0; i < mesh.NumVertices(); ++i) {
+            const uint32_t* vertex = packed.data() + i * format.packed_stride;
+            if (normals && glm::length(normals[i]) > 1e-6f) {
+                normal_error.Add(AngleDegrees(glm::normalize(normals[i]), DecodeOctahedral(vertex[normal_slot])));
+            }
+            if (tangents && glm::length(tangents[i]) > 1e-6f) {
+                tangent_error.Add(AngleDegrees(glm::normalize(tangents[i]), DecodeOctahedralTangent(vertex[tangent_slot])));
+            }
+            if (texcoords) {
+                glm::vec2 decoded = UnpackHalf2(vertex[texcoord_slot]);
+                texcoord_error.Add(std::max(std::abs(decoded.x - texcoords[i].x), std::abs(decoded.y - texcoords[i].y)));
+            }
+        }
+
+        // Separate buffers exist for present streams only; interleaved records are full-size
+        // whenever any stream is present
+        separate_bytes += mesh.NumVertices() * ((normals ? sizeof(glm::vec3) : 0) + (tangents ? sizeof(glm::vec4) : 0) +
+                                                (texcoords ? sizeof(glm::vec2) : 0));
+        interleaved_bytes += format.stream_mask ? mesh.NumVertices() * sizeof(ShadingVertex) : 0;
+        quantized_bytes += packed.size() * sizeof(uint32_t);
+        vertex_total += mesh.NumVertices();
+    }
+
+    grassland::LogInfo("Vertex quantization report for {}: {} meshes, {} vertices", scene_path, mesh_count, vertex_total);
+    grassland::LogInfo("normal   (oct 2x16)    : max {:.5f} deg  mean {:.5f} deg  ({} vertices)",
+                       normal_error.max, normal_error.Mean(), normal_error.count);
+    grassland::LogInfo("tangent  (oct 2x15+1)  : max {:.5f} deg  mean {:.5f} deg  ({} vertices)",
+                       tangent_error.max, tangent_error.Mean(), tangent_error.count);
+    grassland::LogInfo("texcoord (half 2x16)   : max {:.6f}  mean {:.6f}  ({:.3f} texels at 4096)  ({} vertices)",
+                       texcoord_error.max, texcoord_error.Mean(), texcoord_error.max * 4096.0, texcoord_error.count);
+    grassland::LogInfo("attribute memory: separate {:.2f} MiB, interleaved {:.2f} MiB, quantized {:.2f} MiB "
+                       "({:.1f} B/vertex, {:.1f}x smaller than interleaved)",
+                       MiB(separate_bytes), MiB(interleaved_bytes), MiB(quantized_bytes),
+                       vertex_total ? double(quantized_bytes) / vertex_total : 0.0,
+                       quantized_bytes ? double(interleaved_bytes) / quantized_bytes : 0.0);
+    return 0;
+}
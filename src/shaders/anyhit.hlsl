@@ -23,9 +23,9 @@ void AnyHitMain(inout RayPayload payload, in BuiltInTriangleIntersectionAttribut
     int index2 = Indices[material_idx][primitiveID * 3 + 2];
 
     // Get texcoords
-    float2 uv0 = Texcoords[material_idx][index0];
-    float2 uv1 = Texcoords[material_idx][index1];
-    float2 uv2 = Texcoords[material_idx][index2];
+    float2 uv0 = LoadTexcoord(material_idx, index0);
+    float2 uv1 = LoadTexcoord(material_idx, index1);
+    float2 uv2 = LoadTexcoord(material_idx, index2);
 
     // Interpolate UV
     float2 bc = attr.barycentrics;
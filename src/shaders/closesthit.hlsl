@@ -25,10 +25,15 @@
   Vertex v1 = Vertices[material_idx][index1];
   Vertex v2 = Vertices[material_idx][index2];
 
+  // Normal, tangent and texcoord of each corner
+  VertexAttributes s0 = LoadShadingVertex(material_idx, index0);
+  VertexAttributes s1 = LoadShadingVertex(material_idx, index1);
+  VertexAttributes s2 = LoadShadingVertex(material_idx, index2);
+
   // Use uv to get texcoords
-  float2 uv0 = Texcoords[material_idx][index0];
-  float2 uv1 = Texcoords[material_idx][index1];
-  float2 uv2 = Texcoords[material_idx][index2];
+  float2 uv0 = s0.texcoord;
+  float2 uv1 = s1.texcoord;
+  float2 uv2 = s2.texcoord;
 
   float2 bc = attr.barycentrics;
   float3 bary = float3(1.0 - bc.x - bc.y, bc.x, bc.y);
@@ -64,12 +69,27 @@
     }
   }
 
-  float3 base_color_tex = (mat.base_color_tex >= 0) ? Textures[mat.base_color_tex].SampleLevel(LinearWrap, uv, 0.0f).rgb : float3(1.0f, 1.0f, 1.0f);
-  float alpha_tex = (mat.base_color_tex >= 0) ? Textures[mat.base_color_tex].SampleLevel(LinearWrap, uv, 0.0f).a : 1.0f;
-  float metallic_roughness_tex = (mat.metallic_roughness_tex >= 0) ? Textures[mat.metallic_roughness_tex].SampleLevel(LinearWrap, uv, 0.0f).b : 1.0f;
-  float roughness_tex = (mat.metallic_roughness_tex >= 0) ? Textures[mat.metallic_roughness_tex].SampleLevel(LinearWrap, uv, 0.0f).g : 1.0f;
-  float3 emissive_tex = (mat.emissive_texture >= 0) ? Textures[mat.emissive_texture].SampleLevel(LinearWrap, uv, 0.0f).rgb : float3(1.0f, 1.0f, 1.0f);
-  float AO_tex = (mat.AO_texture >= 0) ? Textures[mat.AO_texture].SampleLevel(LinearWrap, uv, 0.0f).r : 1.0f;
+  // Ray cone footprint at the hit for texture LOD; generated UVs have no footprint and use level 0
+  float3 world_edge1 = mul((float3x3)ObjectToWorld3x4(), v1.position - v0.position);
+  float3 world_edge2 = mul((float3x3)ObjectToWorld3x4(), v2.position - v0.position);
+  float world_area = length(cross(world_edge1, world_edge2));
+  float2 duv1 = uv1 - uv0;
+  float2 duv2 = uv2 - uv0;
+  float uv_area = abs(duv1.x * duv2.y - duv2.x * duv1.y);
+  float cone_width = payload.cone_width + payload.cone_spread * RayTCurrent();
+  float cone_cos = world_area > 0.0 ? abs(dot(cross(world_edge1, world_edge2) / world_area, normalize(WorldRayDirection()))) : 1.0;
+  float texture_lod = -64.0;
+  if (uv_valid > 0.5 && uv_area > 0.0 && world_area > 0.0) {
+    texture_lod = 0.5 * log2(uv_area / world_area) + log2(max(cone_width, 1e-8) / max(cone_cos, 1e-2));
+  }
+  payload.cone_width = cone_width;
+
+  float3 base_color_tex = (mat.base_color_tex >= 0) ? SampleTexture(mat.base_color_tex, uv, texture_lod).rgb : float3(1.0f, 1.0f, 1.0f);
+  float alpha_tex = (mat.base_color_tex >= 0) ? SampleTexture(mat.base_color_tex, uv, texture_lod).a : 1.0f;
+  float metallic_roughness_tex = (mat.metallic_roughness_tex >= 0) ? SampleTexture(mat.metallic_roughness_tex, uv, texture_lod).b : 1.0f;
+  float roughness_tex = (mat.metallic_roughness_tex >= 0) ? SampleTexture(mat.metallic_roughness_tex, uv, texture_lod).g : 1.0f;
+  float3 emissive_tex = (mat.emissive_texture >= 0) ? SampleTexture(mat.emissive_texture, uv, texture_lod).rgb : float3(1.0f, 1.0f, 1.0f);
+  float AO_tex = (mat.AO_texture >= 0) ? SampleTexture(mat.AO_texture, uv, texture_lod).r : 1.0f;
 
   float3 base_color = mat.base_color_factor.rgb * base_color_tex;
   float alpha = mat.base_color_factor.a * alpha_tex;
@@ -82,12 +102,12 @@
   // Multi-Layer Material: Sample Layer 2 (Outer Layer) Textures
   // ============================================================================
   
-  float3 base_color_tex_layer2 = (mat.base_color_tex_layer2 >= 0) ? Textures[mat.base_color_tex_layer2].SampleLevel(LinearWrap, uv, 0.0f).rgb : float3(1.0f, 1.0f, 1.0f);
-  float alpha_tex_layer2 = (mat.base_color_tex_layer2 >= 0) ? Textures[mat.base_color_tex_layer2].SampleLevel(LinearWrap, uv, 0.0f).a : 1.0f;
-  float metallic_roughness_tex_layer2 = (mat.metallic_roughness_tex_layer2 >= 0) ? Textures[mat.metallic_roughness_tex_layer2].SampleLevel(LinearWrap, uv, 0.0f).b : 1.0f;
-  float roughness_tex_layer2 = (mat.metallic_roughness_tex_layer2 >= 0) ? Textures[mat.metallic_roughness_tex_layer2].SampleLevel(LinearWrap, uv, 0.0f).g : 1.0f;
-  float3 emissive_tex_layer2 = (mat.emissive_texture_layer2 >= 0) ? Textures[mat.emissive_texture_layer2].SampleLevel(LinearWrap, uv, 0.0f).rgb : float3(1.0f, 1.0f, 1.0f);
-  float AO_tex_layer2 = (mat.AO_texture_layer2 >= 0) ? Textures[mat.AO_texture_layer2].SampleLevel(LinearWrap, uv, 0.0f).r : 1.0f;
+  float3 base_color_tex_layer2 = (mat.base_color_tex_layer2 >= 0) ? SampleTexture(mat.base_color_tex_layer2, uv, texture_lod).rgb : float3(1.0f, 1.0f, 1.0f);
+  float alpha_tex_layer2 = (mat.base_color_tex_layer2 >= 0) ? SampleTexture(mat.base_color_tex_layer2, uv, texture_lod).a : 1.0f;
+  float metallic_roughness_tex_layer2 = (mat.metallic_roughness_tex_layer2 >= 0) ? SampleTexture(mat.metallic_roughness_tex_layer2, uv, texture_lod).b : 1.0f;
+  float roughness_tex_layer2 = (mat.metallic_roughness_tex_layer2 >= 0) ? SampleTexture(mat.metallic_roughness_tex_layer2, uv, texture_lod).g : 1.0f;
+  float3 emissive_tex_layer2 = (mat.emissive_texture_layer2 >= 0) ? SampleTexture(mat.emissive_texture_layer2, uv, texture_lod).rgb : float3(1.0f, 1.0f, 1.0f);
+  float AO_tex_layer2 = (mat.AO_texture_layer2 >= 0) ? SampleTexture(mat.AO_texture_layer2, uv, texture_lod).r : 1.0f;
 
   // Compute Layer 2 material properties
   float3 base_color_layer2 = mat.base_color_factor_layer2.rgb * base_color_tex_layer2;
@@ -98,9 +118,9 @@
   float AO_layer2 = 1.0 + (AO_tex_layer2 - 1.0) * mat.AO_strength_layer2;
 
   // Compute normal
-  float3 n0 = Normals[material_idx][index0];
-  float3 n1 = Normals[material_idx][index1];
-  float3 n2 = Normals[material_idx][index2];
+  float3 n0 = s0.normal;
+  float3 n1 = s1.normal;
+  float3 n2 = s2.normal;
 
   float3 normal = float3(0.0, 0.0, 0.0);
   if (length(n0) < 0.001 || length(n1) < 0.001 || length(n2) < 0.001) {
@@ -127,17 +147,24 @@
   }
 
   if (mat.normal_texture >= 0) {
-    float3 tangent = normalize(Tangents[material_idx][index0] * bary.x +
-                     Tangents[material_idx][index1] * bary.y +
-                     Tangents[material_idx][index2] * bary.z);
+    float3 tangent = s0.tangent * bary.x +
+                     s1.tangent * bary.y +
+                     s2.tangent * bary.z;
 
-    float3 world_tangent = normalize(mul((float3x3)ObjectToWorld3x4(), tangent));
+    float3 world_tangent = mul((float3x3)ObjectToWorld3x4(), tangent);
 
-    world_tangent = normalize(world_tangent - dot(world_tangent, world_normal) * world_normal);
+    world_tangent = world_tangent - dot(world_tangent, world_normal) * world_normal;
+    // Zero tangents, or the default +X one of meshes without tangents lying along the normal,
+    // take any direction in the tangent plane instead of normalizing to NaN
+    if (dot(world_tangent, world_tangent) < 1e-12) {
+      float3 up = abs(world_normal.z) < 0.999 ? float3(0, 0, 1) : float3(1, 0, 0);
+      world_tangent = cross(up, world_normal);
+    }
+    world_tangent = normalize(world_tangent);
 
-    float3 world_bitangent = normalize(cross(world_normal, world_tangent));
+    float3 world_bitangent = normalize(cross(world_normal, world_tangent)) * s0.tangent_sign;
 
-    float3 normal_map_sample = Textures[mat.normal_texture].SampleLevel(LinearWrap, uv, 0.0f).rgb;
+    float3 normal_map_sample = SampleTexture(mat.normal_texture, uv, texture_lod).rgb;
     normal_map_sample = normal_map_sample * 2.0 - 1.0;
     normal_map_sample.xy *= mat.normal_scale;
 
@@ -88,6 +88,12 @@ struct Material {
 struct HoverInfo {
   int hovered_entity_id;
   int light_count;
+  int cursor_x;   // Pixel whose result RayGenMain writes to pick_readback, -1 for none
+  int cursor_y;
+  int pick_slot;  // Texel of pick_readback written this frame
+  int pad0;
+  int pad1;
+  int pad2;
 };
 
 struct VolumeRegion {
@@ -123,6 +129,31 @@ struct RenderSettings {
   // Saturation boost parameters
   float saturation_boost_light;
   float saturation_boost_shadow;
+  // VERTEX_LAYOUT_* of the scene's vertex attribute buffers
+  int vertex_layout;
+};
+
+#define VERTEX_LAYOUT_SEPARATE 0
+#define VERTEX_LAYOUT_INTERLEAVED 1
+#define VERTEX_LAYOUT_QUANTIZED 2
+
+#define VERTEX_STREAM_NORMAL 1
+#define VERTEX_STREAM_TANGENT 2
+#define VERTEX_STREAM_TEXCOORD 4
+
+// Vertex streams of one entity (VertexFormat in VertexQuantization.h)
+struct VertexFormat {
+  uint stream_mask;
+  uint packed_stride;
+  uint packed_slots;
+  uint pad;
+};
+
+// Smaller levels of one texture (TextureMipRange in TextureMips.h): level i > 0 is
+// Textures[first_level + i - 1]
+struct TextureMipRange {
+  int first_level;
+  int level_count;
 };
 
 struct Light {
@@ -141,6 +172,22 @@ struct Vertex {
   float3 position;
 };
 
+// Interleaved per-vertex shading attributes (ShadingVertex in Entity.h)
+struct ShadingVertex {
+  float3 normal;
+  float3 tangent;
+  float2 texcoord;
+  float tangent_sign;
+};
+
+// Shading attributes of one vertex as the hit shaders see them, whatever the layout
+struct VertexAttributes {
+  float3 normal;
+  float3 tangent;
+  float tangent_sign; // Bitangent handedness
+  float2 texcoord;
+};
+
 // Now we compute color in RayGenMain
 // So I define RayPayload accordingly
 struct RayPayload {
@@ -204,6 +251,11 @@ struct RayPayload {
   
   // Cartoon style: outline factor (0.0 = no outline, 1.0 = full outline)
   float outline_factor;
+
+  // Ray cone for texture LOD: width at the ray origin and spread angle per unit distance.
+  // The closest hit writes back its width so the next bounce continues the cone.
+  float cone_width;
+  float cone_spread;
 };
 
 // Constants
@@ -225,12 +277,130 @@ StructuredBuffer<float2> Texcoords[] : register(t0, space10);
 Texture2D<float4> Textures[] : register(t0, space11);
 SamplerState LinearWrap : register(s0, space12);
 StructuredBuffer<float3> Normals[] : register(t0, space13);
-StructuredBuffer<float3> Tangents[] : register(t0, space14);
+StructuredBuffer<float4> Tangents[] : register(t0, space14); // w = bitangent handedness
 StructuredBuffer<Light> Lights : register(t0, space15);
 Texture2D<float4> SkyboxTexture : register(t0, space16);
 ConstantBuffer<VolumeRegion> volume_info : register(b0, space17);
 ConstantBuffer<SkyInfo> sky_info : register(b0, space18);
 ConstantBuffer<RenderSettings> render_settings : register(b0, space19);
+RWTexture2D<float4> pick_readback : register(u0, space20);
+RWTexture2D<float4> display_source : register(u0, space21);
+StructuredBuffer<ShadingVertex> ShadingVertices[] : register(t0, space22);
+
+StructuredBuffer<uint> PackedVertices[] : register(t0, space23);
+StructuredBuffer<VertexFormat> vertex_formats : register(t0, space24);
+StructuredBuffer<TextureMipRange> texture_mips : register(t0, space25);
+
+// Decoders for the encodings in VertexQuantization.h
+float3 DecodeOctahedral(float2 p) {
+  float3 n = float3(p, 1.0 - abs(p.x) - abs(p.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+float3 DecodeOctahedralNormal(uint packed) {
+  if (packed == 0x80008000u) {
+    return float3(0.0, 0.0, 0.0); // kOctahedralZero
+  }
+  int2 v = int2(int(packed << 16) >> 16, int(packed) >> 16);
+  return DecodeOctahedral(max(float2(v) / 32767.0, -1.0));
+}
+
+float3 DecodeOctahedralTangent(uint packed, out float sign) {
+  int2 v = int2(int(packed << 17) >> 17, int(packed << 2) >> 17);
+  sign = (packed >> 31) != 0 ? -1.0 : 1.0;
+  return DecodeOctahedral(max(float2(v) / 16383.0, -1.0));
+}
+
+float2 DecodeHalf2(uint packed) {
+  return float2(f16tof32(packed), f16tof32(packed >> 16));
+}
+
+// Attribute fetch for any vertex layout; the layout branch is uniform across the dispatch.
+// Streams missing from VertexFormat::stream_mask are not read (their buffers are a shared dummy)
+// and come back as a zero normal, the +X tangent and zero texcoords.
+VertexAttributes LoadShadingVertex(uint entity, int index) {
+  VertexFormat format = vertex_formats[entity];
+  VertexAttributes v;
+  v.normal = float3(0.0, 0.0, 0.0);
+  v.tangent = float3(1.0, 0.0, 0.0);
+  v.tangent_sign = 1.0;
+  v.texcoord = float2(0.0, 0.0);
+  if (render_settings.vertex_layout == VERTEX_LAYOUT_QUANTIZED) {
+    uint base = uint(index) * format.packed_stride;
+    if ((format.stream_mask & VERTEX_STREAM_NORMAL) != 0) {
+      v.normal = DecodeOctahedralNormal(PackedVertices[entity][base + (format.packed_slots & 0xFF)]);
+    }
+    if ((format.stream_mask & VERTEX_STREAM_TANGENT) != 0) {
+      v.tangent = DecodeOctahedralTangent(PackedVertices[entity][base + ((format.packed_slots >> 8) & 0xFF)], v.tangent_sign);
+    }
+    if ((format.stream_mask & VERTEX_STREAM_TEXCOORD) != 0) {
+      v.texcoord = DecodeHalf2(PackedVertices[entity][base + ((format.packed_slots >> 16) & 0xFF)]);
+    }
+  } else if (render_settings.vertex_layout == VERTEX_LAYOUT_INTERLEAVED) {
+    // Absent streams are default-filled inside the records of meshes that have any stream
+    if (format.stream_mask != 0) {
+      ShadingVertex s = ShadingVertices[entity][index];
+      v.normal = s.normal;
+      v.tangent = s.tangent;
+      v.tangent_sign = s.tangent_sign;
+      v.texcoord = s.texcoord;
+    }
+  } else {
+    if ((format.stream_mask & VERTEX_STREAM_NORMAL) != 0) {
+      v.normal = Normals[entity][index];
+    }
+    if ((format.stream_mask & VERTEX_STREAM_TANGENT) != 0) {
+      float4 tangent = Tangents[entity][index];
+      v.tangent = tangent.xyz;
+      v.tangent_sign = tangent.w;
+    }
+    if ((format.stream_mask & VERTEX_STREAM_TEXCOORD) != 0) {
+      v.texcoord = Texcoords[entity][index];
+    }
+  }
+  return v;
+}
+
+float2 LoadTexcoord(uint entity, int index) {
+  VertexFormat format = vertex_formats[entity];
+  if ((format.stream_mask & VERTEX_STREAM_TEXCOORD) == 0) {
+    return float2(0.0, 0.0);
+  }
+  if (render_settings.vertex_layout == VERTEX_LAYOUT_QUANTIZED) {
+    return DecodeHalf2(PackedVertices[entity][uint(index) * format.packed_stride + ((format.packed_slots >> 16) & 0xFF)]);
+  }
+  if (render_settings.vertex_layout == VERTEX_LAYOUT_INTERLEAVED) {
+    return ShadingVertices[entity][index].texcoord;
+  }
+  return Texcoords[entity][index];
+}
+
+float4 SampleMipLevel(int texture, TextureMipRange range, int level, float2 uv) {
+  int index = level == 0 ? texture : range.first_level + level - 1;
+  return Textures[index].SampleLevel(LinearWrap, uv, 0.0f);
+}
+
+// Trilinear sample at the ray cone LOD (Akenine-Moller et al., "Texture Level of Detail
+// Strategies for Real-Time Ray Tracing"). lod_offset is the LOD without the texture size:
+// 0.5 * log2(uv area / world area) + log2(cone width / |cos|) at the hit.
+float4 SampleTexture(int texture, float2 uv, float lod_offset) {
+  TextureMipRange range = texture_mips[texture];
+  if (range.level_count <= 1) {
+    return Textures[texture].SampleLevel(LinearWrap, uv, 0.0f);
+  }
+  uint width, height;
+  Textures[texture].GetDimensions(width, height);
+  float lod = clamp(lod_offset + 0.5 * log2(float(width) * float(height)), 0.0, float(range.level_count - 1));
+  int level = int(lod);
+  float blend = lod - float(level);
+  float4 result = SampleMipLevel(texture, range, level, uv);
+  if (blend > 0.0 && level + 1 < range.level_count) {
+    result = lerp(result, SampleMipLevel(texture, range, level + 1, uv), blend);
+  }
+  return result;
+}
 
 #endif // COMMON_HLSL
-
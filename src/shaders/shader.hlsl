@@ -134,9 +134,15 @@ float3 apply_saturation_boost(float3 color, float light_boost, float shadow_boos
   float3 radiance = float3(0.0, 0.0, 0.0);
   payload.rng_state = rng_state;
   payload.outline_factor = 0.0; // Initialize outline factor
+  // Ray cone for texture LOD: the spread is the angle between vertically adjacent pixel rays
+  float3 center_dir = normalize(mul(camera_info.screen_to_camera, float4(0, 0, 1, 1)).xyz);
+  float3 next_dir = normalize(mul(camera_info.screen_to_camera, float4(0, 2.0 / DispatchRaysDimensions().y, 1, 1)).xyz);
+  payload.cone_width = 0.0;
+  payload.cone_spread = length(cross(center_dir, next_dir));
   
   // Store information from first hit for outline
   float first_hit_outline_factor = 0.0;
+  int first_hit_entity = -1;
 
   // core of path tracing
 
@@ -154,7 +160,8 @@ float3 apply_saturation_boost(float3 color, float light_boost, float shadow_boos
 
     // record the id of this entity, if hit
     if (depth == 0) {
-      entity_id_output[pixel_coords] = payload.hit ? (int)payload.instance_id : -1;
+      first_hit_entity = payload.hit ? (int)payload.instance_id : -1;
+      entity_id_output[pixel_coords] = first_hit_entity;
       // Store information from first hit for outline
       if (payload.hit) {
         first_hit_outline_factor = payload.outline_factor;
@@ -510,9 +517,28 @@ float3 apply_saturation_boost(float3 color, float light_boost, float shadow_boos
   
   output[pixel_coords] = float4(mapped_radiance, 1.0);
 
-  accumulated_color[pixel_coords] = accumulated_color[pixel_coords] + float4(radiance, 1.0);
+  float4 accumulated = accumulated_color[pixel_coords] + float4(radiance, 1.0);
+  accumulated_color[pixel_coords] = accumulated;
   accumulated_samples[pixel_coords] = frame_count + 1;
 
+  // Cursor pick for the host's readback ring: averaged color and entity under the cursor
+  if (pixel_coords.x == (uint)hover_info.cursor_x && pixel_coords.y == (uint)hover_info.cursor_y) {
+    pick_readback[uint2(hover_info.pick_slot, 0)] = float4(accumulated.rgb / (float)(frame_count + 1), (float)first_hit_entity);
+  }
+}
+
+// ============================================================================
+// Hover highlight - tints the hovered entity in the developed film image on the GPU
+// ============================================================================
+
+[shader("raygeneration")] void HighlightMain() {
+  uint2 pixel_coords = DispatchRaysIndex().xy;
+  float4 color = display_source[pixel_coords];
+  if (hover_info.hovered_entity_id >= 0 && entity_id_output[pixel_coords] == hover_info.hovered_entity_id) {
+    // Lerp towards white by the highlight factor, alpha unchanged
+    color.rgb = lerp(color.rgb, float3(1.0, 1.0, 1.0), 0.4);
+  }
+  output[pixel_coords] = color;
 }
 
 // ============================================================================
@@ -0,0 +1,282 @@
+// Headless batch renderer: loads a scene once and renders every view of a JSON job list with the
+// CPU path tracer. No graphics device, window, ImGui or input handling is created, so it runs on
+// build machines and servers and the scene load/BVH build cost is paid once per batch.
+//
+// Usage: BatchRender jobs.json
+//
+// {
+//   "scene": "new_scene.glb",        // defaults to new_scene.glb
+//   "skybox": "sunset.hdr",          // optional equirectangular HDR
+//   "defaults": { "width": 1280, "height": 720, "spp": 64, "max_bounces": 8 },
+//   "jobs": [
+//     { "output": "front.png", "position": [0, 1, 5], "target": [0, 1, 0] },
+//     { "output": "side.hdr", "position": [4, 1, 0], "yaw": 180, "pitch": -10, "fov": 45, "spp": 256 }
+//   ]
+// }
+//
+// Every job key may also appear in "defaults". The camera looks at "target" when given and along
+// yaw/pitch (degrees, same convention as the interactive camera) otherwise. ".hdr" outputs hold
+// the averaged linear radiance; anything else is written as a tone-mapped PNG.
+
+#include "Scene.h"
+#include "CpuRenderer.h"
+#include "Film.h"
+#include "json.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+using nlohmann::json;
+
+namespace {
+struct RenderJob {
+    std::string output;
+    int width = 1280;
+    int height = 720;
+    int spp = 64;
+    int max_bounces = 8;
+    glm::vec3 position{ 0.0f, 1.0f, 5.0f };
+    glm::vec3 up{ 0.0f, 1.0f, 0.0f };
+    bool has_target = false;
+    glm::vec3 target{ 0.0f };
+    float yaw = -90.0f;
+    float pitch = 0.0f;
+    float fov = 60.0f;
+    float aperture = 0.0f;
+    float focus_distance = -1.0f; // Distance to the target, or 5 without one
+    float exposure = 1.0f;
+    float env_intensity = 1.0f;
+    float bg_intensity = 1.0f;
+};
+
+bool ReadVec3(const json& object, const char* key, glm::vec3* value) {
+    auto it = object.find(key);
+    if (it == object.end()) return false;
+    if (!it->is_array() || it->size() != 3 || !(*it)[0].is_number() || !(*it)[1].is_number() || !(*it)[2].is_number()) {
+        grassland::LogWarning("Job key '{}' must be an array of 3 numbers", key);
+        return false;
+    }
+    *value = glm::vec3((*it)[0].get<float>(), (*it)[1].get<float>(), (*it)[2].get<float>());
+    return true;
+}
+
+template <class T>
+void ReadNumber(const json& object, const char* key, T* value) {
+    auto it = object.find(key);
+    if (it == object.end()) return;
+    if (!it->is_number()) {
+        grassland::LogWarning("Job key '{}' must be a number", key);
+        return;
+    }
+    *value = it->get<T>();
+}
+
+// Overlay the keys present in `object` on top of `job`
+void ReadJob(const json& object, RenderJob* job) {
+    if (object.contains("output") && object["output"].is_string()) {
+        job->output = object["output"].get<std::string>();
+    }
+    ReadNumber(object, "width", &job->width);
+    ReadNumber(object, "height", &job->height);
+    ReadNumber(object, "spp", &job->spp);
+    ReadNumber(object, "max_bounces", &job->max_bounces);
+    ReadVec3(object, "position", &job->position);
+    ReadVec3(object, "up", &job->up);
+    if (ReadVec3(object, "target", &job->target)) {
+        job->has_target = true;
+    }
+    ReadNumber(object, "yaw", &job->yaw);
+    ReadNumber(object, "pitch", &job->pitch);
+    ReadNumber(object, "fov", &job->fov);
+    ReadNumber(object, "aperture", &job->aperture);
+    ReadNumber(object, "focus_distance", &job->focus_distance);
+    ReadNumber(object, "exposure", &job->exposure);
+    ReadNumber(object, "env_intensity", &job->env_intensity);
+    ReadNumber(object, "bg_intensity", &job->bg_intensity);
+}
+
+// Same sun as Application::OnInit so batch renders match the interactive view
+void AddDefaultSun(Scene* scene) {
+    Light sun_light{};
+    sun_light.type = LIGHT_SUN;
+    sun_light.color = glm::vec3(1.0f, 0.83f, 0.7f);
+    sun_light.intensity = 5000.0f;
+    sun_light.angular_radius = glm::radians(2.5f);
+    sun_light.direction = glm::normalize(glm::vec3(-0.9782f, -0.1818f, -0.1059f));
+    scene->AddLight(sun_light);
+}
+
+bool LoadSkybox(Scene* scene, const std::string& path) {
+    int w, h, comp;
+    float* data = stbi_loadf(path.c_str(), &w, &h, &comp, 4);
+    if (!data) {
+        grassland::LogError("Failed to load skybox texture: {}", path);
+        return false;
+    }
+    HostTexture skybox;
+    skybox.width = w;
+    skybox.height = h;
+    skybox.rgba32f.assign(data, data + static_cast<size_t>(w) * h * 4);
+    scene->SetSkyboxHostTexture(std::move(skybox));
+    stbi_image_free(data);
+    grassland::LogInfo("Loaded skybox texture: {}", path);
+    return true;
+}
+
+CpuFrameParams MakeFrameParams(const RenderJob& job, bool use_skybox) {
+    glm::vec3 up = glm::normalize(job.up);
+    glm::vec3 front;
+    float focus_distance = job.focus_distance;
+    if (job.has_target) {
+        front = glm::normalize(job.target - job.position);
+        if (focus_distance <= 0.0f) focus_distance = glm::length(job.target - job.position);
+    } else {
+        front.x = cos(glm::radians(job.yaw)) * cos(glm::radians(job.pitch));
+        front.y = sin(glm::radians(job.pitch));
+        front.z = sin(glm::radians(job.yaw)) * cos(glm::radians(job.pitch));
+        front = glm::normalize(front);
+        if (focus_distance <= 0.0f) focus_distance = 5.0f;
+    }
+
+    CpuFrameParams params{};
+    params.camera.screen_to_camera = glm::inverse(
+        glm::perspective(glm::radians(job.fov), (float)job.width / (float)job.height, 0.1f, 10.0f));
+    params.camera.camera_to_world = glm::inverse(glm::lookAt(job.position, job.position + front, up));
+    params.camera.prev_camera_to_world = params.camera.camera_to_world; // No motion blur for stills
+    params.camera.aperture = job.aperture;
+    params.camera.focus_distance = focus_distance;
+    params.camera.shutter_speed = 0.0f;
+    params.camera.enable_motion_blur = 0;
+
+    // Interactive defaults for everything the job list does not expose
+    params.settings.max_bounces = job.max_bounces;
+    params.settings.exposure = job.exposure;
+    params.settings.cartoon_enabled = 0;
+    params.settings.diffuse_bands = 8.0f;
+    params.settings.specular_hardness = 0.3f;
+    params.settings.outline_width = 0.02f;
+    params.settings.outline_threshold = 0.85f;
+    params.settings.binary_threshold = 0.5f;
+    params.settings.shadow_ignore_threshold = 0.7f;
+    params.settings.highlight_threshold = 0.8f;
+    params.settings.saturation_boost_light = 1.5f;
+    params.settings.saturation_boost_shadow = 1.2f;
+
+    params.sky.use_skybox = use_skybox ? 1 : 0;
+    params.sky.env_intensity = job.env_intensity;
+    params.sky.bg_intensity = job.bg_intensity;
+    params.volume.g = 0.0f;
+    return params;
+}
+
+bool WriteImage(const std::string& filename, const HostFilm& film) {
+    size_t pixel_count = static_cast<size_t>(film.width) * film.height;
+    std::filesystem::path path(filename);
+    if (path.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+
+    if (path.extension() == ".hdr") {
+        std::vector<float> radiance(pixel_count * 3);
+        float inv_samples = 1.0f / static_cast<float>(film.sample_count);
+        for (size_t i = 0; i < pixel_count; ++i) {
+            radiance[i * 3 + 0] = film.accumulated_color[i * 4 + 0] * inv_samples;
+            radiance[i * 3 + 1] = film.accumulated_color[i * 4 + 1] * inv_samples;
+            radiance[i * 3 + 2] = film.accumulated_color[i * 4 + 2] * inv_samples;
+        }
+        return stbi_write_hdr(filename.c_str(), film.width, film.height, 3, radiance.data()) != 0;
+    }
+
+    // Same tone mapping as the interactive film
+    std::vector<float> output_colors(pixel_count * 4);
+    Film::DevelopPixels(film.accumulated_color.data(), static_cast<int>(pixel_count), film.sample_count, output_colors.data());
+    std::vector<uint8_t> byte_data(pixel_count * 4);
+    for (size_t i = 0; i < pixel_count; ++i) {
+        byte_data[i * 4 + 0] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, output_colors[i * 4 + 0])) * 255.0f);
+        byte_data[i * 4 + 1] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, output_colors[i * 4 + 1])) * 255.0f);
+        byte_data[i * 4 + 2] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, output_colors[i * 4 + 2])) * 255.0f);
+        byte_data[i * 4 + 3] = 255;
+    }
+    return stbi_write_png(filename.c_str(), film.width, film.height, 4, byte_data.data(), film.width * 4) != 0;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        grassland::LogError("Usage: BatchRender jobs.json");
+        return 1;
+    }
+
+    std::ifstream file(argv[1]);
+    if (!file) {
+        grassland::LogError("Cannot open job list: {}", argv[1]);
+        return 1;
+    }
+    json config = json::parse(file, nullptr, false);
+    if (config.is_discarded() || !config.is_object() || !config.contains("jobs") || !config["jobs"].is_array()) {
+        grassland::LogError("Job list {} must be a JSON object with a \"jobs\" array", argv[1]);
+        return 1;
+    }
+
+    RenderJob defaults;
+    if (config.contains("defaults") && config["defaults"].is_object()) {
+        ReadJob(config["defaults"], &defaults);
+    }
+    std::vector<RenderJob> jobs;
+    for (const json& entry : config["jobs"]) {
+        RenderJob job = defaults;
+        if (entry.is_object()) {
+            ReadJob(entry, &job);
+        }
+        if (job.output.empty()) {
+            job.output = "render_" + std::to_string(jobs.size()) + ".png";
+        }
+        job.width = std::max(1, job.width);
+        job.height = std::max(1, job.height);
+        job.spp = std::max(1, job.spp);
+        job.max_bounces = std::max(1, job.max_bounces);
+        jobs.push_back(job);
+    }
+
+    // Load once; a Scene without a core keeps everything on the host
+    auto load_start = std::chrono::steady_clock::now();
+    std::string scene_path = config.value("scene", std::string("new_scene.glb"));
+    Scene scene(nullptr);
+    scene.LoadFromGLB(scene_path);
+    if (scene.GetEntities().empty()) {
+        grassland::LogError("No meshes loaded from {}", scene_path);
+        return 1;
+    }
+    AddDefaultSun(&scene);
+    bool use_skybox = false;
+    if (config.contains("skybox") && config["skybox"].is_string()) {
+        use_skybox = LoadSkybox(&scene, config["skybox"].get<std::string>());
+    }
+    scene.BuildAccelerationStructures();
+    double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+    grassland::LogInfo("Scene {} ready in {:.2f} s, rendering {} views", scene_path, load_seconds, jobs.size());
+
+    CpuRenderer renderer(&scene);
+    HostFilm film;
+    int failures = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const RenderJob& job = jobs[i];
+        film.Resize(job.width, job.height); // Also clears the previous view
+        CpuRenderStats stats = renderer.Render(MakeFrameParams(job, use_skybox), job.spp, &film);
+        if (!WriteImage(job.output, film)) {
+            grassland::LogError("Failed to write {}", job.output);
+            ++failures;
+            continue;
+        }
+        grassland::LogInfo("[{}/{}] {} ({}x{}, {} spp, {} bounces) in {:.2f} s, {:.1f} Mrays/s",
+                           i + 1, jobs.size(), std::filesystem::absolute(job.output).string(), job.width, job.height,
+                           job.spp, job.max_bounces, stats.seconds, stats.MegaRaysPerSecond());
+    }
+    return failures == 0 ? 0 : 1;
+}